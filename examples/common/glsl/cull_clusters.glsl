@@ -0,0 +1,74 @@
+// Frustum and back-face culling of mesh clusters (see
+// samples::buildMeshClusters): appends a draw command for each visible
+// cluster, and counts them.
+#version 450
+
+layout(local_size_x = 64) in;
+
+struct MeshCluster {
+  // center, radius
+  vec4 sphere;
+  // normal cone axis, cutoff
+  vec4 cone;
+  uint firstIndex;
+  uint indexCount;
+  uint padding0;
+  uint padding1;
+};
+
+// DrawElementsIndirectCommand
+struct DrawCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+layout(std140, binding = 0) uniform U0 {
+  mat4 modelViewProjMatrix;
+  // camera position in object space
+  vec4 eyePosition;
+  uint clusterCount;
+  uint coneCulling;
+};
+
+layout(std430, binding = 0) readonly buffer Clusters { MeshCluster clusters[]; };
+layout(std430, binding = 1) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 2) buffer DrawCount { uint drawCount; };
+
+// true if the sphere is entirely on the negative side of the plane
+// (plane not normalized)
+bool outside(vec4 plane, vec3 center, float radius) {
+  return dot(plane.xyz, center) + plane.w < -radius * length(plane.xyz);
+}
+
+void main() {
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= clusterCount)
+    return;
+  MeshCluster cluster = clusters[index];
+  vec3 center = cluster.sphere.xyz;
+  float radius = cluster.sphere.w;
+
+  // object-space frustum planes [Gribb & Hartmann 2001], with a [0,1]
+  // depth range (glClipControl ZERO_TO_ONE)
+  mat4 m = transpose(modelViewProjMatrix);
+  if (outside(m[3] + m[0], center, radius) ||
+      outside(m[3] - m[0], center, radius) ||
+      outside(m[3] + m[1], center, radius) ||
+      outside(m[3] - m[1], center, radius) ||
+      outside(m[2], center, radius) ||
+      outside(m[3] - m[2], center, radius))
+    return;
+
+  // all triangles face away from the camera
+  vec3 d = center - eyePosition.xyz;
+  if (coneCulling != 0 &&
+      dot(d, cluster.cone.xyz) >= cluster.cone.w * length(d) + radius)
+    return;
+
+  uint slot = atomicAdd(drawCount, 1);
+  commands[slot] =
+      DrawCommand(cluster.indexCount, 1, cluster.firstIndex, 0, 0);
+}
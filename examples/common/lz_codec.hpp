@@ -0,0 +1,145 @@
+#ifndef LZ_CODEC_HPP
+#define LZ_CODEC_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace samples {
+
+// Small LZ77 codec for in-memory data (painted tiles are mostly flat areas
+// and compress well). Greedy parsing with a hash table of the last position
+// of each 4-byte sequence: fast rather than tight.
+// Block format (close to LZ4): sequences of
+//   token: literal count (high 4 bits), match length - 4 (low 4 bits),
+//          15 means that the count continues in the next bytes (255 = more)
+//   literals
+//   match offset (2 bytes, little endian, 1..65535)
+//   match length extension bytes
+// The last sequence has literals only and ends the block.
+
+namespace detail {
+constexpr unsigned kLzMinMatch = 4;
+constexpr unsigned kLzHashBits = 12;
+constexpr size_t kLzMaxOffset = 65535;
+
+inline uint32_t lzRead32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+inline unsigned lzHash(uint32_t v) {
+  return (v * 2654435761u) >> (32 - kLzHashBits);
+}
+
+inline void lzWriteCount(std::vector<uint8_t>& out, size_t count) {
+  for (; count >= 255; count -= 255)
+    out.push_back(255);
+  out.push_back((uint8_t)count);
+}
+
+inline void lzWriteSequence(std::vector<uint8_t>& out, const uint8_t* literals,
+                            size_t literalCount, size_t offset,
+                            size_t matchLength) {
+  size_t tokenPos = out.size();
+  out.push_back(0);
+  uint8_t t = (uint8_t)(std::min<size_t>(literalCount, 15) << 4);
+  if (literalCount >= 15)
+    lzWriteCount(out, literalCount - 15);
+  out.insert(out.end(), literals, literals + literalCount);
+  if (matchLength) {
+    auto m = matchLength - kLzMinMatch;
+    t |= (uint8_t)std::min<size_t>(m, 15);
+    out.push_back((uint8_t)(offset & 0xFF));
+    out.push_back((uint8_t)(offset >> 8));
+    if (m >= 15)
+      lzWriteCount(out, m - 15);
+  }
+  out[tokenPos] = t;
+}
+
+// reads a count extension, returns false past the end of the input
+inline bool lzReadCount(const uint8_t*& p, const uint8_t* end, size_t& count) {
+  uint8_t b;
+  do {
+    if (p == end)
+      return false;
+    b = *p++;
+    count += b;
+  } while (b == 255);
+  return true;
+}
+}
+
+inline std::vector<uint8_t> lzCompress(const uint8_t* src, size_t size) {
+  using namespace detail;
+  std::vector<uint8_t> out;
+  out.reserve(size / 2 + 16);
+  // last position + 1 of each hash, 0 if none
+  std::vector<uint32_t> table(1u << kLzHashBits, 0);
+  size_t anchor = 0;
+  size_t i = 0;
+  while (i + kLzMinMatch <= size) {
+    auto v = lzRead32(src + i);
+    auto h = lzHash(v);
+    size_t candidate = table[h];
+    table[h] = (uint32_t)(i + 1);
+    if (candidate == 0 || i - (candidate - 1) > kLzMaxOffset ||
+        lzRead32(src + candidate - 1) != v) {
+      ++i;
+      continue;
+    }
+    size_t matchPos = candidate - 1;
+    size_t len = kLzMinMatch;
+    while (i + len < size && src[matchPos + len] == src[i + len])
+      ++len;
+    lzWriteSequence(out, src + anchor, i - anchor, i - matchPos, len);
+    i += len;
+    anchor = i;
+  }
+  lzWriteSequence(out, src + anchor, size - anchor, 0, 0);
+  return out;
+}
+
+// Returns false if `src` is not a valid block or does not decompress to
+// exactly `dstSize` bytes.
+inline bool lzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst,
+                         size_t dstSize) {
+  using namespace detail;
+  const uint8_t* p = src;
+  const uint8_t* end = src + srcSize;
+  size_t o = 0;
+  while (p != end) {
+    uint8_t token = *p++;
+    size_t literalCount = token >> 4;
+    if (literalCount == 15 && !lzReadCount(p, end, literalCount))
+      return false;
+    if ((size_t)(end - p) < literalCount || dstSize - o < literalCount)
+      return false;
+    if (literalCount)
+      memcpy(dst + o, p, literalCount);
+    p += literalCount;
+    o += literalCount;
+    if (p == end)
+      break; // last sequence
+    if (end - p < 2)
+      return false;
+    size_t offset = p[0] | (p[1] << 8);
+    p += 2;
+    size_t len = token & 15;
+    if (len == 15 && !lzReadCount(p, end, len))
+      return false;
+    len += kLzMinMatch;
+    if (offset == 0 || offset > o || dstSize - o < len)
+      return false;
+    // byte by byte: the match can overlap the output
+    for (size_t k = 0; k < len; ++k, ++o)
+      dst[o] = dst[o - offset];
+  }
+  return o == dstSize;
+}
+}
+
+#endif // !LZ_CODEC_HPP
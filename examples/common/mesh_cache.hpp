@@ -0,0 +1,230 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <gsl.h>
+
+#include "mesh_lod.hpp"
+#include "mesh_optimizer.hpp"
+
+namespace samples {
+
+// Binary cache of imported meshes, so that scene files are imported by
+// Assimp only once.
+// Layout: MeshCacheHeader, then the vertex data, the index data (16 or
+// 32-bit indices, all levels of detail), the culling clusters (MeshCluster)
+// and the levels of detail (MeshLod), all in the layout of the GPU buffers
+// and 16-byte aligned. Clusters and levels of detail may be empty.
+// A cache file is valid for one version of the source file (hash of the
+// contents), one set of import flags and post-processing steps.
+constexpr uint32_t kMeshCacheMagic = 0x434D4741; // "AGMC"
+constexpr uint32_t kMeshCacheVersion = 5;
+
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sourceHash;
+  uint32_t importFlags;
+  uint32_t processFlags;
+  // sizeof(MeshVertex) when the cache was written
+  uint32_t vertexSize;
+  // 2 or 4
+  uint32_t indexSize;
+  uint64_t vertexCount;
+  uint64_t indexCount;
+  uint64_t clusterCount;
+  uint64_t lodCount;
+  // byte offsets from the start of the file
+  uint64_t vertexDataOffset;
+  uint64_t indexDataOffset;
+  uint64_t clusterDataOffset;
+  uint64_t lodDataOffset;
+  float boundsMin[3];
+  float boundsMax[3];
+};
+
+inline uint64_t alignMeshCacheOffset(uint64_t offset) {
+  return (offset + 15) & ~uint64_t(15);
+}
+
+// 64-bit FNV-1a hash of the contents of a file, 0 if it cannot be read.
+// The file is mapped in memory and hashed 8 bytes at a time.
+inline uint64_t hashFileContents(const std::string& path) {
+  namespace bip = boost::interprocess;
+  try {
+    bip::file_mapping file{path.c_str(), bip::read_only};
+    bip::mapped_region region{file, bip::read_only};
+    auto data = (const uint8_t*)region.get_address();
+    size_t size = region.get_size();
+    uint64_t hash = 0xCBF29CE484222325ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      uint64_t v;
+      memcpy(&v, data + i, 8);
+      hash = (hash ^ v) * 0x100000001B3ull;
+    }
+    for (; i < size; ++i)
+      hash = (hash ^ data[i]) * 0x100000001B3ull;
+    // an empty file still gets a nonzero hash
+    return (hash ^ size) * 0x100000001B3ull;
+  } catch (bip::interprocess_exception&) {
+    return 0;
+  }
+}
+
+// Writes a cache file. The file is written under a temporary name, then
+// renamed, so that a partially written cache is never read.
+// Returns false on I/O errors (the cache is optional).
+inline bool writeMeshCache(const std::string& cachePath, uint64_t sourceHash,
+                           uint32_t importFlags, uint32_t processFlags,
+                           uint32_t vertexSize,
+                           gsl::span<const gsl::byte> vertexData,
+                           uint32_t indexSize,
+                           gsl::span<const gsl::byte> indexData,
+                           gsl::span<const MeshCluster> clusters,
+                           gsl::span<const MeshLod> lods,
+                           const float boundsMin[3], const float boundsMax[3]) {
+  MeshCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMeshCacheMagic;
+  header.version = kMeshCacheVersion;
+  header.sourceHash = sourceHash;
+  header.importFlags = importFlags;
+  header.processFlags = processFlags;
+  header.vertexSize = vertexSize;
+  header.indexSize = indexSize;
+  header.vertexCount = (uint64_t)vertexData.size_bytes() / vertexSize;
+  header.indexCount = (uint64_t)indexData.size_bytes() / indexSize;
+  header.clusterCount = (uint64_t)clusters.size();
+  header.lodCount = (uint64_t)lods.size();
+  header.vertexDataOffset = alignMeshCacheOffset(sizeof(MeshCacheHeader));
+  header.indexDataOffset = alignMeshCacheOffset(header.vertexDataOffset +
+                                                vertexData.size_bytes());
+  header.clusterDataOffset = alignMeshCacheOffset(header.indexDataOffset +
+                                                  indexData.size_bytes());
+  header.lodDataOffset = alignMeshCacheOffset(header.clusterDataOffset +
+                                              clusters.size_bytes());
+  memcpy(header.boundsMin, boundsMin, sizeof(header.boundsMin));
+  memcpy(header.boundsMax, boundsMax, sizeof(header.boundsMax));
+
+  auto tmpPath = cachePath + ".tmp";
+  FILE* f = fopen(tmpPath.c_str(), "wb");
+  if (!f)
+    return false;
+  const char padding[16] = {};
+  auto pad = [&](uint64_t from, uint64_t to) {
+    return fwrite(padding, 1, (size_t)(to - from), f) == (size_t)(to - from);
+  };
+  bool ok =
+      fwrite(&header, sizeof(header), 1, f) == 1 &&
+      pad(sizeof(header), header.vertexDataOffset) &&
+      fwrite(vertexData.data(), 1, (size_t)vertexData.size_bytes(), f) ==
+          (size_t)vertexData.size_bytes() &&
+      pad(header.vertexDataOffset + vertexData.size_bytes(),
+          header.indexDataOffset) &&
+      fwrite(indexData.data(), 1, (size_t)indexData.size_bytes(), f) ==
+          (size_t)indexData.size_bytes() &&
+      pad(header.indexDataOffset + indexData.size_bytes(),
+          header.clusterDataOffset) &&
+      fwrite(clusters.data(), sizeof(MeshCluster), (size_t)clusters.size(),
+             f) == (size_t)clusters.size() &&
+      pad(header.clusterDataOffset + clusters.size_bytes(),
+          header.lodDataOffset) &&
+      fwrite(lods.data(), sizeof(MeshLod), (size_t)lods.size(), f) ==
+          (size_t)lods.size();
+  ok = fclose(f) == 0 && ok;
+  if (ok) {
+    // rename does not replace an existing file on windows
+    remove(cachePath.c_str());
+    ok = rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+  }
+  if (!ok)
+    remove(tmpPath.c_str());
+  return ok;
+}
+
+// A cache file mapped in memory (read-only).
+// The vertex and index data can be uploaded directly from the mapping.
+class MeshCacheFile {
+public:
+  // Returns false if the file does not exist, or is not a valid cache for
+  // this source file, import and post-processing flags and vertex size.
+  bool open(const std::string& cachePath, uint64_t sourceHash,
+            uint32_t importFlags, uint32_t processFlags, uint32_t vertexSize) {
+    namespace bip = boost::interprocess;
+    try {
+      file = bip::file_mapping{cachePath.c_str(), bip::read_only};
+      region = bip::mapped_region{file, bip::read_only};
+    } catch (bip::interprocess_exception&) {
+      return false;
+    }
+    size_t size = region.get_size();
+    if (size < sizeof(MeshCacheHeader))
+      return false;
+    header = *(const MeshCacheHeader*)region.get_address();
+    if (header.magic != kMeshCacheMagic ||
+        header.version != kMeshCacheVersion ||
+        header.sourceHash != sourceHash || header.importFlags != importFlags ||
+        header.processFlags != processFlags ||
+        header.vertexSize != vertexSize ||
+        (header.indexSize != 2 && header.indexSize != 4))
+      return false;
+    // bounds check, with care for overflows in corrupt files
+    if (header.vertexDataOffset > size ||
+        header.vertexCount > (size - header.vertexDataOffset) / vertexSize ||
+        header.indexDataOffset > size ||
+        header.indexCount >
+            (size - header.indexDataOffset) / header.indexSize ||
+        header.clusterDataOffset > size ||
+        header.clusterCount >
+            (size - header.clusterDataOffset) / sizeof(MeshCluster) ||
+        header.lodDataOffset > size ||
+        header.lodCount > (size - header.lodDataOffset) / sizeof(MeshLod))
+      return false;
+    return true;
+  }
+
+  const MeshCacheHeader& getHeader() const { return header; }
+
+  gsl::span<const gsl::byte> getVertexData() const {
+    return gsl::span<const gsl::byte>(
+        (const gsl::byte*)region.get_address() + header.vertexDataOffset,
+        (std::ptrdiff_t)(header.vertexCount * header.vertexSize));
+  }
+
+  // indices of getHeader().indexSize bytes
+  gsl::span<const gsl::byte> getIndexData() const {
+    return gsl::span<const gsl::byte>(
+        (const gsl::byte*)region.get_address() + header.indexDataOffset,
+        (std::ptrdiff_t)(header.indexCount * header.indexSize));
+  }
+
+  gsl::span<const MeshCluster> getClusters() const {
+    return gsl::span<const MeshCluster>(
+        (const MeshCluster*)((const gsl::byte*)region.get_address() +
+                             header.clusterDataOffset),
+        (std::ptrdiff_t)header.clusterCount);
+  }
+
+  gsl::span<const MeshLod> getLods() const {
+    return gsl::span<const MeshLod>(
+        (const MeshLod*)((const gsl::byte*)region.get_address() +
+                         header.lodDataOffset),
+        (std::ptrdiff_t)header.lodCount);
+  }
+
+private:
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+  MeshCacheHeader header;
+};
+}
+
+#endif // !MESH_CACHE_HPP
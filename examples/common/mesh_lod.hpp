@@ -0,0 +1,357 @@
+#ifndef MESH_LOD_HPP
+#define MESH_LOD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "mesh_optimizer.hpp"
+
+namespace samples {
+
+// A level of detail: a range of the index buffer. All levels share the
+// vertices of the full mesh.
+struct MeshLod {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // object-space geometric error of the level, 0 for the full mesh
+  float error;
+  uint32_t padding;
+};
+static_assert(sizeof(MeshLod) == 16, "Unexpected padding");
+
+constexpr unsigned kMaxMeshLods = 8;
+// meshes smaller than this are not simplified further
+constexpr unsigned kMinLodTriangles = 256;
+
+namespace detail {
+// Symmetric 4x4 error quadric [Garland & Heckbert 1997, "Surface
+// simplification using quadric error metrics"]: sum of the squared
+// distances to a set of planes. `weight` counts the planes, so that
+// evaluate() / weight is the mean squared distance.
+struct Quadric {
+  double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+  double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+  double a22 = 0.0, a23 = 0.0;
+  double a33 = 0.0;
+  double weight = 0.0;
+
+  // plane ax + by + cz + d = 0, with (a,b,c) normalized
+  void addPlane(double a, double b, double c, double d) {
+    a00 += a * a;
+    a01 += a * b;
+    a02 += a * c;
+    a03 += a * d;
+    a11 += b * b;
+    a12 += b * c;
+    a13 += b * d;
+    a22 += c * c;
+    a23 += c * d;
+    a33 += d * d;
+    weight += 1.0;
+  }
+
+  Quadric& operator+=(const Quadric& q) {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a03 += q.a03;
+    a11 += q.a11;
+    a12 += q.a12;
+    a13 += q.a13;
+    a22 += q.a22;
+    a23 += q.a23;
+    a33 += q.a33;
+    weight += q.weight;
+    return *this;
+  }
+
+  double evaluate(double x, double y, double z) const {
+    return x * x * a00 + y * y * a11 + z * z * a22 +
+           2.0 * (x * y * a01 + x * z * a02 + y * z * a12 + x * a03 +
+                  y * a13 + z * a23) +
+           a33;
+  }
+};
+
+// unnormalized normal of a triangle
+template <typename P>
+void triangleNormal(const P& p0, const P& p1, const P& p2, double n[3]) {
+  double e1[3] = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+  double e2[3] = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+  n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+}
+
+// Simplifies a triangle mesh by collapsing edges, cheapest first according
+// to the quadric error of the collapse, until the number of indices is
+// below `targetIndexCount` or no edge can be collapsed.
+// Edges collapse onto one of their vertices, so that the simplified mesh
+// uses the vertices (and attributes) of the original mesh. Vertices on
+// open or non-manifold edges (including texture seams) never move, and
+// collapses that would flip a triangle are rejected.
+// Each pass evaluates all edges in parallel, then applies the cheapest
+// collapses that do not touch the same neighborhoods.
+// Returns the indices of the simplified mesh; `error` receives the
+// object-space error: the largest RMS distance, over all collapses, between
+// the destination vertex and the original planes merged into it.
+template <typename Vertex>
+std::vector<unsigned> simplifyMesh(const std::vector<Vertex>& vertices,
+                                   const std::vector<unsigned>& indices,
+                                   size_t targetIndexCount,
+                                   float* error = nullptr) {
+  size_t vertexCount = vertices.size();
+  std::vector<unsigned> result = indices;
+  double maxError = 0.0;
+
+  // vertex quadrics, from the planes of the adjacent triangles
+  std::vector<detail::Quadric> quadrics(vertexCount);
+  {
+    detail::VertexTriangleAdjacency adjacency{result, vertexCount};
+    detail::parallelFor(vertexCount, [&](size_t begin, size_t end) {
+      for (size_t v = begin; v < end; ++v) {
+        for (unsigned j = adjacency.offsets[v]; j < adjacency.offsets[v + 1];
+             ++j) {
+          unsigned t = adjacency.triangles[j];
+          const auto& p0 = vertices[result[t * 3]].position;
+          const auto& p1 = vertices[result[t * 3 + 1]].position;
+          const auto& p2 = vertices[result[t * 3 + 2]].position;
+          double n[3];
+          detail::triangleNormal(p0, p1, p2, n);
+          double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+          if (len == 0.0)
+            continue;
+          n[0] /= len;
+          n[1] /= len;
+          n[2] /= len;
+          quadrics[v].addPlane(n[0], n[1], n[2],
+                               -(n[0] * p0.x + n[1] * p0.y + n[2] * p0.z));
+        }
+      }
+    });
+  }
+
+  // lock the vertices of edges that do not have exactly two triangles
+  std::vector<bool> locked(vertexCount, false);
+  {
+    std::vector<uint64_t> edges;
+    edges.reserve(result.size());
+    for (size_t t = 0; t < result.size(); t += 3)
+      for (int i = 0; i < 3; ++i) {
+        uint64_t a = result[t + i], b = result[t + (i + 1) % 3];
+        edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+      }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+      size_t j = i;
+      while (j < edges.size() && edges[j] == edges[i])
+        ++j;
+      if (j - i != 2) {
+        locked[(size_t)(edges[i] >> 32)] = true;
+        locked[(size_t)(edges[i] & 0xFFFFFFFFu)] = true;
+      }
+      i = j;
+    }
+  }
+
+  struct Collapse {
+    unsigned src;
+    unsigned dst;
+    double cost;
+  };
+  const double kInvalid = std::numeric_limits<double>::max();
+  std::vector<uint64_t> edges;
+  std::vector<Collapse> collapses;
+  std::vector<uint8_t> state(vertexCount);
+  std::vector<unsigned> remap(vertexCount);
+
+  while (result.size() > targetIndexCount) {
+    detail::VertexTriangleAdjacency adjacency{result, vertexCount};
+
+    // true if moving src to dst flips or degenerates an adjacent triangle
+    auto flips = [&](unsigned src, unsigned dst) {
+      const auto& target = vertices[dst].position;
+      for (unsigned j = adjacency.offsets[src]; j < adjacency.offsets[src + 1];
+           ++j) {
+        const unsigned* tri = &result[adjacency.triangles[j] * 3];
+        if (tri[0] == dst || tri[1] == dst || tri[2] == dst)
+          continue; // removed by the collapse
+        auto p0 = vertices[tri[0]].position;
+        auto p1 = vertices[tri[1]].position;
+        auto p2 = vertices[tri[2]].position;
+        double before[3], after[3];
+        detail::triangleNormal(p0, p1, p2, before);
+        if (tri[0] == src)
+          p0 = target;
+        else if (tri[1] == src)
+          p1 = target;
+        else
+          p2 = target;
+        detail::triangleNormal(p0, p1, p2, after);
+        if (before[0] * after[0] + before[1] * after[1] +
+                before[2] * after[2] <=
+            0.0)
+          return true;
+      }
+      return false;
+    };
+
+    // unique edges
+    edges.clear();
+    for (size_t t = 0; t < result.size(); t += 3)
+      for (int i = 0; i < 3; ++i) {
+        uint64_t a = result[t + i], b = result[t + (i + 1) % 3];
+        edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+      }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    // cost of the best direction of each edge
+    collapses.resize(edges.size());
+    detail::parallelFor(edges.size(), [&](size_t begin, size_t end) {
+      for (size_t e = begin; e < end; ++e) {
+        unsigned a = (unsigned)(edges[e] >> 32);
+        unsigned b = (unsigned)(edges[e] & 0xFFFFFFFFu);
+        auto cost = [&](unsigned src, unsigned dst) {
+          if (locked[src])
+            return kInvalid;
+          detail::Quadric q = quadrics[src];
+          q += quadrics[dst];
+          const auto& p = vertices[dst].position;
+          return std::max(q.evaluate(p.x, p.y, p.z), 0.0);
+        };
+        double costAB = cost(a, b);
+        double costBA = cost(b, a);
+        Collapse c = costAB <= costBA ? Collapse{a, b, costAB}
+                                      : Collapse{b, a, costBA};
+        if (c.cost != kInvalid && flips(c.src, c.dst)) {
+          // try the other direction
+          c = costAB <= costBA ? Collapse{b, a, costBA}
+                               : Collapse{a, b, costAB};
+          if (c.cost != kInvalid && flips(c.src, c.dst))
+            c.cost = kInvalid;
+        }
+        collapses[e] = c;
+      }
+    });
+    collapses.erase(std::remove_if(collapses.begin(), collapses.end(),
+                                   [&](const Collapse& c) {
+                                     return c.cost == kInvalid;
+                                   }),
+                    collapses.end());
+    if (collapses.empty())
+      break;
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& x, const Collapse& y) {
+                return x.cost < y.cost;
+              });
+
+    // each collapse removes about two triangles; only the cheapest third of
+    // the candidates is considered, since costs change after a pass
+    size_t budget = std::max<size_t>(
+        (result.size() - targetIndexCount) / 6, 1);
+    size_t limit = std::max<size_t>(collapses.size() / 3, 1);
+    // kMoved: src of a collapse of this pass. kPinned: in the neighborhood
+    // of a moved vertex, can still be the destination of a collapse.
+    const uint8_t kFree = 0, kPinned = 1, kMoved = 2;
+    std::fill(state.begin(), state.end(), kFree);
+    for (unsigned v = 0; v < vertexCount; ++v)
+      remap[v] = v;
+    size_t applied = 0;
+    for (size_t i = 0; i < limit && applied < budget; ++i) {
+      const auto& c = collapses[i];
+      if (state[c.src] != kFree || state[c.dst] == kMoved)
+        continue;
+      // the flip test assumed that the neighbors of src do not move
+      bool neighborMoved = false;
+      for (unsigned j = adjacency.offsets[c.src];
+           j < adjacency.offsets[c.src + 1] && !neighborMoved; ++j)
+        for (int k = 0; k < 3; ++k)
+          if (state[result[adjacency.triangles[j] * 3 + k]] == kMoved)
+            neighborMoved = true;
+      if (neighborMoved)
+        continue;
+      for (unsigned j = adjacency.offsets[c.src];
+           j < adjacency.offsets[c.src + 1]; ++j)
+        for (int k = 0; k < 3; ++k)
+          state[result[adjacency.triangles[j] * 3 + k]] = kPinned;
+      state[c.src] = kMoved;
+      remap[c.src] = c.dst;
+      quadrics[c.dst] += quadrics[c.src];
+      // c.cost is a sum over the merged planes: normalize to a mean
+      // squared distance
+      if (quadrics[c.dst].weight > 0.0)
+        maxError = std::max(maxError, c.cost / quadrics[c.dst].weight);
+      ++applied;
+    }
+    if (!applied)
+      break;
+
+    // remap, and remove the collapsed triangles
+    size_t out = 0;
+    for (size_t t = 0; t < result.size(); t += 3) {
+      unsigned a = remap[result[t]], b = remap[result[t + 1]],
+               c = remap[result[t + 2]];
+      if (a == b || b == c || a == c)
+        continue;
+      result[out++] = a;
+      result[out++] = b;
+      result[out++] = c;
+    }
+    result.resize(out);
+  }
+
+  if (error)
+    *error = (float)std::sqrt(maxError);
+  return result;
+}
+
+// Builds a chain of levels of detail, each with about half the triangles
+// of the previous one, and appends their indices to `indices`. Level 0 is
+// the full mesh (the original indices). The levels are optimized for the
+// vertex cache. Stops at kMaxMeshLods levels, kMinLodTriangles triangles,
+// or when the simplification stalls.
+template <typename Vertex>
+std::vector<MeshLod> buildMeshLods(const std::vector<Vertex>& vertices,
+                                   std::vector<unsigned>& indices,
+                                   unsigned maxLods = kMaxMeshLods) {
+  std::vector<MeshLod> lods;
+  lods.push_back(MeshLod{0, (uint32_t)indices.size(), 0.0f, 0});
+  std::vector<unsigned> current{indices};
+  float error = 0.0f;
+  while (lods.size() < maxLods && current.size() / 3 >= kMinLodTriangles) {
+    float lodError = 0.0f;
+    auto simplified =
+        simplifyMesh(vertices, current, current.size() / 6 * 3, &lodError);
+    if (simplified.size() > current.size() * 9 / 10)
+      break;
+    detail::VertexTriangleAdjacency adjacency{simplified, vertices.size()};
+    simplified = optimizeVertexCache(simplified, vertices.size(), adjacency,
+                                     nullptr);
+    // each level is simplified from the previous one: errors add up
+    error += lodError;
+    lods.push_back(MeshLod{(uint32_t)indices.size(),
+                           (uint32_t)simplified.size(), error, 0});
+    indices.insert(indices.end(), simplified.begin(), simplified.end());
+    current = std::move(simplified);
+  }
+  return lods;
+}
+
+// Returns the coarsest level whose error, projected on the screen, is below
+// `maxPixelError` pixels. `pixelsPerUnit` is the size on the screen of one
+// object-space unit at the distance of the mesh.
+inline size_t selectMeshLod(const std::vector<MeshLod>& lods,
+                            float pixelsPerUnit, float maxPixelError = 1.0f) {
+  for (size_t i = lods.size(); i > 1; --i)
+    if (lods[i - 1].error * pixelsPerUnit <= maxPixelError)
+      return i - 1;
+  return 0;
+}
+}
+
+#endif // !MESH_LOD_HPP
@@ -0,0 +1,612 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <autograph/utils.hpp>
+
+namespace samples {
+
+// Post-processing steps applied to imported meshes
+enum class MeshProcessFlags : unsigned {
+  None = 0,
+  // reorder triangles for the post-transform vertex cache (Tipsify)
+  OptimizeVertexCache = 1 << 0,
+  // reorder the clusters of triangles found by Tipsify so that the
+  // outward-facing ones are drawn first (requires OptimizeVertexCache)
+  OptimizeOverdraw = 1 << 1,
+  // reorder vertices in the order of first use by the index buffer
+  OptimizeVertexFetch = 1 << 2,
+  // use 16-bit indices if the mesh has less than 65536 vertices
+  NarrowIndices = 1 << 3,
+  // compute per-vertex tangents from the texture coordinates
+  ComputeTangents = 1 << 4,
+  // split the triangles in clusters for GPU culling (see buildMeshClusters)
+  BuildClusters = 1 << 5,
+  // append simplified levels of detail to the index buffer (see
+  // buildMeshLods)
+  BuildLods = 1 << 6,
+  All = (1 << 7) - 1
+};
+}
+
+template <>
+struct is_enum_flags<samples::MeshProcessFlags> : public std::true_type {};
+
+namespace samples {
+
+namespace detail {
+// triangles adjacent to each vertex, in compressed rows
+struct VertexTriangleAdjacency {
+  VertexTriangleAdjacency(const std::vector<unsigned>& indices,
+                          size_t vertexCount)
+      : offsets(vertexCount + 1, 0), triangles(indices.size()) {
+    for (auto v : indices)
+      ++offsets[v + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+      triangles[fill[indices[i]]++] = (unsigned)(i / 3);
+  }
+
+  unsigned degree(unsigned v) const { return offsets[v + 1] - offsets[v]; }
+
+  std::vector<unsigned> offsets;
+  std::vector<unsigned> triangles;
+};
+
+// runs f(begin, end) on ranges of [0,count) on all cores
+template <typename F> void parallelFor(size_t count, F f) {
+  size_t numThreads =
+      std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                       (count + 4095) / 4096);
+  if (numThreads <= 1) {
+    f(size_t(0), count);
+    return;
+  }
+  std::vector<std::thread> threads;
+  size_t chunk = (count + numThreads - 1) / numThreads;
+  for (size_t begin = 0; begin < count; begin += chunk)
+    threads.emplace_back(f, begin, std::min(begin + chunk, count));
+  for (auto& t : threads)
+    t.join();
+}
+}
+
+// Tipsify [Sander et al. 2007, "Fast triangle reordering for vertex
+// locality and reduced overdraw"]: fans around vertices, choosing the
+// next fanning vertex among the vertices still in the (simulated) FIFO
+// cache. Returns the reordered indices. If `clusters` is not null, it
+// receives the index of the first triangle of each cluster: a new cluster
+// starts when the traversal hits a dead end and jumps elsewhere.
+template <typename Adjacency>
+std::vector<unsigned> optimizeVertexCache(const std::vector<unsigned>& indices,
+                                          size_t vertexCount,
+                                          const Adjacency& adjacency,
+                                          std::vector<unsigned>* clusters,
+                                          unsigned cacheSize = 16) {
+  size_t triangleCount = indices.size() / 3;
+  std::vector<unsigned> out;
+  out.reserve(indices.size());
+  std::vector<unsigned> liveTriangles(vertexCount);
+  for (unsigned v = 0; v < vertexCount; ++v)
+    liveTriangles[v] = adjacency.degree(v);
+  std::vector<unsigned> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<unsigned> deadEnds;
+  std::vector<unsigned> candidates;
+  unsigned time = cacheSize + 1;
+  unsigned cursor = 0;
+
+  auto skipDeadEnd = [&]() -> int {
+    while (!deadEnds.empty()) {
+      unsigned v = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveTriangles[v])
+        return (int)v;
+    }
+    for (; cursor < vertexCount; ++cursor)
+      if (liveTriangles[cursor])
+        return (int)cursor;
+    return -1;
+  };
+
+  int fan = skipDeadEnd();
+  if (clusters && fan >= 0)
+    clusters->push_back(0);
+  while (fan >= 0) {
+    candidates.clear();
+    auto f = (unsigned)fan;
+    for (unsigned k = adjacency.offsets[f]; k < adjacency.offsets[f + 1]; ++k) {
+      unsigned t = adjacency.triangles[k];
+      if (emitted[t])
+        continue;
+      for (unsigned j = 0; j < 3; ++j) {
+        unsigned v = indices[t * 3 + j];
+        out.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        --liveTriangles[v];
+        if (time - cacheTime[v] > cacheSize)
+          cacheTime[v] = time++;
+      }
+      emitted[t] = true;
+    }
+
+    // next fanning vertex: a candidate that will still be in the cache
+    // after its remaining triangles are emitted, the oldest one first
+    int next = -1;
+    int bestPriority = -1;
+    for (auto v : candidates) {
+      if (!liveTriangles[v])
+        continue;
+      int priority = 0;
+      if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+        priority = (int)(time - cacheTime[v]);
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        next = (int)v;
+      }
+    }
+    if (next < 0) {
+      next = skipDeadEnd();
+      if (clusters && next >= 0)
+        clusters->push_back((unsigned)(out.size() / 3));
+    }
+    fan = next;
+  }
+  return out;
+}
+
+// Sorts the clusters of triangles so that the clusters facing away from
+// the center of the mesh are drawn first: they are more likely to occlude
+// the others. Vertex cache locality is preserved inside the clusters.
+template <typename Vertex>
+std::vector<unsigned> optimizeOverdraw(const std::vector<unsigned>& indices,
+                                       const std::vector<Vertex>& vertices,
+                                       const std::vector<unsigned>& clusters) {
+  size_t triangleCount = indices.size() / 3;
+  if (clusters.size() <= 1)
+    return indices;
+
+  // mesh centroid
+  double center[3] = {0.0, 0.0, 0.0};
+  for (const auto& v : vertices) {
+    center[0] += v.position.x;
+    center[1] += v.position.y;
+    center[2] += v.position.z;
+  }
+  for (auto& c : center)
+    c /= (double)std::max<size_t>(vertices.size(), 1);
+
+  // sort key: dot(cluster centroid - mesh center, cluster normal)
+  std::vector<float> sortKeys(clusters.size());
+  detail::parallelFor(clusters.size(), [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      size_t first = clusters[c];
+      size_t last = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+      double centroid[3] = {0.0, 0.0, 0.0};
+      double normal[3] = {0.0, 0.0, 0.0};
+      double area = 0.0;
+      for (size_t t = first; t < last; ++t) {
+        const auto& p0 = vertices[indices[t * 3]].position;
+        const auto& p1 = vertices[indices[t * 3 + 1]].position;
+        const auto& p2 = vertices[indices[t * 3 + 2]].position;
+        double e1[3] = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+        double e2[3] = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+        // area-weighted normal
+        double n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                       e1[2] * e2[0] - e1[0] * e2[2],
+                       e1[0] * e2[1] - e1[1] * e2[0]};
+        double a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        centroid[0] += (p0.x + p1.x + p2.x) / 3.0 * a;
+        centroid[1] += (p0.y + p1.y + p2.y) / 3.0 * a;
+        centroid[2] += (p0.z + p1.z + p2.z) / 3.0 * a;
+        for (int k = 0; k < 3; ++k)
+          normal[k] += n[k];
+        area += a;
+      }
+      if (area > 0.0)
+        for (auto& x : centroid)
+          x /= area;
+      sortKeys[c] = (float)((centroid[0] - center[0]) * normal[0] +
+                            (centroid[1] - center[1]) * normal[1] +
+                            (centroid[2] - center[2]) * normal[2]);
+    }
+  });
+
+  std::vector<unsigned> order(clusters.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return sortKeys[a] > sortKeys[b];
+  });
+
+  std::vector<unsigned> out;
+  out.reserve(indices.size());
+  for (auto c : order) {
+    size_t first = clusters[c];
+    size_t last = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+    out.insert(out.end(), indices.begin() + first * 3,
+               indices.begin() + last * 3);
+  }
+  return out;
+}
+
+// Reorders the vertices in the order of first reference by the indices,
+// and remaps the indices. Unreferenced vertices are removed.
+template <typename Vertex>
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<unsigned>& indices) {
+  const unsigned kUnassigned = ~0u;
+  std::vector<unsigned> remap(vertices.size(), kUnassigned);
+  std::vector<Vertex> out;
+  out.reserve(vertices.size());
+  for (auto& i : indices) {
+    if (remap[i] == kUnassigned) {
+      remap[i] = (unsigned)out.size();
+      out.push_back(vertices[i]);
+    }
+    i = remap[i];
+  }
+  vertices = std::move(out);
+}
+
+// Per-vertex tangents, from the texture coordinates [Lengyel 2001],
+// orthogonalized against the normal. Vertices without a usable texture
+// mapping get an arbitrary tangent orthogonal to the normal.
+template <typename Vertex, typename Adjacency>
+void computeTangents(std::vector<Vertex>& vertices,
+                     const std::vector<unsigned>& indices,
+                     const Adjacency& adjacency) {
+  size_t triangleCount = indices.size() / 3;
+  // per-triangle tangents (not normalized: weighted by the area)
+  std::vector<float> triangleTangents(triangleCount * 3);
+  detail::parallelFor(triangleCount, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      const auto& v0 = vertices[indices[t * 3]];
+      const auto& v1 = vertices[indices[t * 3 + 1]];
+      const auto& v2 = vertices[indices[t * 3 + 2]];
+      float e1[3] = {v1.position.x - v0.position.x,
+                     v1.position.y - v0.position.y,
+                     v1.position.z - v0.position.z};
+      float e2[3] = {v2.position.x - v0.position.x,
+                     v2.position.y - v0.position.y,
+                     v2.position.z - v0.position.z};
+      float du1 = v1.texcoords.x - v0.texcoords.x;
+      float dv1 = v1.texcoords.y - v0.texcoords.y;
+      float du2 = v2.texcoords.x - v0.texcoords.x;
+      float dv2 = v2.texcoords.y - v0.texcoords.y;
+      float det = du1 * dv2 - du2 * dv1;
+      float* out = &triangleTangents[t * 3];
+      if (std::abs(det) < 1e-12f) {
+        out[0] = out[1] = out[2] = 0.0f;
+        continue;
+      }
+      // the sign of the determinant keeps mirrored mappings consistent;
+      // the magnitude is dropped so that the tangents are area-weighted
+      float s = det > 0.0f ? 1.0f : -1.0f;
+      for (int k = 0; k < 3; ++k)
+        out[k] = (e1[k] * dv2 - e2[k] * dv1) * s;
+    }
+  });
+
+  detail::parallelFor(vertices.size(), [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      float t[3] = {0.0f, 0.0f, 0.0f};
+      for (unsigned k = adjacency.offsets[v]; k < adjacency.offsets[v + 1];
+           ++k) {
+        const float* tt = &triangleTangents[adjacency.triangles[k] * 3];
+        t[0] += tt[0];
+        t[1] += tt[1];
+        t[2] += tt[2];
+      }
+      auto& vert = vertices[v];
+      float n[3] = {vert.normal.x, vert.normal.y, vert.normal.z};
+      // Gram-Schmidt
+      float d = n[0] * t[0] + n[1] * t[1] + n[2] * t[2];
+      for (int k = 0; k < 3; ++k)
+        t[k] -= n[k] * d;
+      float len = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+      if (len < 1e-12f) {
+        // any vector orthogonal to the normal
+        float a[3] = {0.0f, 0.0f, 0.0f};
+        a[std::abs(n[0]) < 0.9f ? 0 : 1] = 1.0f;
+        t[0] = a[1] * n[2] - a[2] * n[1];
+        t[1] = a[2] * n[0] - a[0] * n[2];
+        t[2] = a[0] * n[1] - a[1] * n[0];
+        len = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+        if (len < 1e-12f) {
+          t[0] = 1.0f;
+          len = 1.0f;
+        }
+      }
+      vert.tangent.x = t[0] / len;
+      vert.tangent.y = t[1] / len;
+      vert.tangent.z = t[2] / len;
+    }
+  });
+}
+
+// A run of triangles of the index buffer, with bounds for culling.
+// Layout matches the std430 `MeshCluster` struct of cull_clusters.glsl.
+struct MeshCluster {
+  // bounding sphere
+  float center[3];
+  float radius;
+  // cone containing the face normals: all triangles face away from a point
+  // p if dot(center - p, coneAxis) >= coneCutoff * |center - p| + radius.
+  // coneCutoff is the sine of the cone angle, 1 if the cone is wider than
+  // an hemisphere (never culled).
+  float coneAxis[3];
+  float coneCutoff;
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  uint32_t padding[2];
+};
+static_assert(sizeof(MeshCluster) == 48, "Unexpected padding");
+
+constexpr unsigned kMaxClusterTriangles = 128;
+
+// Groups neighboring triangles in clusters of at most `maxTriangles`
+// triangles. Clusters are grown from the first unassigned triangle by
+// adding the adjacent triangle closest to the cluster centroid, with a
+// penalty for normals deviating from the cluster normal, so that the
+// clusters are compact and have narrow normal cones. Returns the index of
+// the first triangle of each cluster in the reordered indices; triangles
+// keep their relative order inside a cluster (vertex cache locality).
+template <typename Vertex, typename Adjacency>
+std::vector<unsigned> partitionClusters(std::vector<unsigned>& indices,
+                                        const std::vector<Vertex>& vertices,
+                                        const Adjacency& adjacency,
+                                        unsigned maxTriangles) {
+  size_t triangleCount = indices.size() / 3;
+  // centroids and unit normals
+  std::vector<std::array<float, 6>> triangleInfo(triangleCount);
+  detail::parallelFor(triangleCount, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      const auto& p0 = vertices[indices[t * 3]].position;
+      const auto& p1 = vertices[indices[t * 3 + 1]].position;
+      const auto& p2 = vertices[indices[t * 3 + 2]].position;
+      float e1[3] = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+      float e2[3] = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+      float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                    e1[2] * e2[0] - e1[0] * e2[2],
+                    e1[0] * e2[1] - e1[1] * e2[0]};
+      float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (len > 0.0f)
+        for (auto& x : n)
+          x /= len;
+      triangleInfo[t] = {{(p0.x + p1.x + p2.x) / 3.0f,
+                          (p0.y + p1.y + p2.y) / 3.0f,
+                          (p0.z + p1.z + p2.z) / 3.0f, n[0], n[1], n[2]}};
+    }
+  });
+
+  std::vector<bool> assigned(triangleCount, false);
+  std::vector<unsigned> out;
+  out.reserve(indices.size());
+  std::vector<unsigned> clusterStarts;
+  std::vector<unsigned> members;
+  std::vector<unsigned> candidates;
+  size_t seed = 0;
+  for (;;) {
+    while (seed < triangleCount && assigned[seed])
+      ++seed;
+    if (seed == triangleCount)
+      break;
+    members.clear();
+    candidates.clear();
+    float centroid[3] = {0.0f, 0.0f, 0.0f};
+    float normal[3] = {0.0f, 0.0f, 0.0f};
+    unsigned next = (unsigned)seed;
+    while (true) {
+      assigned[next] = true;
+      members.push_back(next);
+      const auto& info = triangleInfo[next];
+      float k = 1.0f / (float)members.size();
+      for (int i = 0; i < 3; ++i) {
+        centroid[i] += (info[i] - centroid[i]) * k;
+        normal[i] += info[3 + i];
+      }
+      if (members.size() == maxTriangles)
+        break;
+      for (int i = 0; i < 3; ++i) {
+        unsigned v = indices[next * 3 + i];
+        for (unsigned j = adjacency.offsets[v]; j < adjacency.offsets[v + 1];
+             ++j) {
+          unsigned t = adjacency.triangles[j];
+          if (!assigned[t] &&
+              std::find(candidates.begin(), candidates.end(), t) ==
+                  candidates.end())
+            candidates.push_back(t);
+        }
+      }
+      // drop the candidates assigned since they were added
+      candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                      [&](unsigned t) { return assigned[t]; }),
+                       candidates.end());
+      if (candidates.empty())
+        break;
+      float normalLen = std::sqrt(normal[0] * normal[0] +
+                                  normal[1] * normal[1] + normal[2] * normal[2]);
+      float bestScore = std::numeric_limits<float>::max();
+      size_t best = 0;
+      for (size_t c = 0; c < candidates.size(); ++c) {
+        const auto& ci = triangleInfo[candidates[c]];
+        float d[3] = {ci[0] - centroid[0], ci[1] - centroid[1],
+                      ci[2] - centroid[2]};
+        float dist = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        float cosine = normalLen > 0.0f ? (ci[3] * normal[0] +
+                                           ci[4] * normal[1] +
+                                           ci[5] * normal[2]) /
+                                              normalLen
+                                        : 1.0f;
+        float score = dist * (2.0f - cosine);
+        if (score < bestScore) {
+          bestScore = score;
+          best = c;
+        }
+      }
+      next = candidates[best];
+      candidates[best] = candidates.back();
+      candidates.pop_back();
+    }
+    std::sort(members.begin(), members.end());
+    clusterStarts.push_back((unsigned)(out.size() / 3));
+    for (auto t : members)
+      out.insert(out.end(), indices.begin() + t * 3,
+                 indices.begin() + t * 3 + 3);
+  }
+  indices = std::move(out);
+  return clusterStarts;
+}
+
+// Partitions the triangles in clusters (see partitionClusters), reordering
+// the indices, and computes the bounds of the clusters. Run after the
+// other reordering steps. Triangles are front-facing when
+// counter-clockwise.
+template <typename Vertex>
+std::vector<MeshCluster>
+buildMeshClusters(const std::vector<Vertex>& vertices,
+                  std::vector<unsigned>& indices,
+                  unsigned maxTriangles = kMaxClusterTriangles) {
+  size_t triangleCount = indices.size() / 3;
+  std::vector<unsigned> clusterStarts;
+  {
+    detail::VertexTriangleAdjacency adjacency{indices, vertices.size()};
+    clusterStarts =
+        partitionClusters(indices, vertices, adjacency, maxTriangles);
+  }
+  size_t clusterCount = clusterStarts.size();
+  std::vector<MeshCluster> clusters(clusterCount);
+  detail::parallelFor(clusterCount, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      auto& cluster = clusters[c];
+      size_t first = clusterStarts[c];
+      size_t last = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+      memset(&cluster, 0, sizeof(cluster));
+      cluster.firstIndex = (uint32_t)(first * 3);
+      cluster.indexCount = (uint32_t)((last - first) * 3);
+
+      // sphere around the center of the bounding box
+      float bmin[3], bmax[3];
+      const auto& p = vertices[indices[first * 3]].position;
+      bmin[0] = bmax[0] = p.x;
+      bmin[1] = bmax[1] = p.y;
+      bmin[2] = bmax[2] = p.z;
+      for (size_t i = first * 3; i < last * 3; ++i) {
+        const auto& q = vertices[indices[i]].position;
+        const float v[3] = {q.x, q.y, q.z};
+        for (int k = 0; k < 3; ++k) {
+          bmin[k] = std::min(bmin[k], v[k]);
+          bmax[k] = std::max(bmax[k], v[k]);
+        }
+      }
+      for (int k = 0; k < 3; ++k)
+        cluster.center[k] = (bmin[k] + bmax[k]) * 0.5f;
+      float radius2 = 0.0f;
+      for (size_t i = first * 3; i < last * 3; ++i) {
+        const auto& q = vertices[indices[i]].position;
+        float d[3] = {q.x - cluster.center[0], q.y - cluster.center[1],
+                      q.z - cluster.center[2]};
+        radius2 = std::max(radius2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+      }
+      cluster.radius = std::sqrt(radius2);
+
+      // normal cone: average of the unit face normals, and the largest
+      // angle between the average and a face normal
+      std::vector<std::array<float, 3>> normals;
+      normals.reserve(last - first);
+      float axis[3] = {0.0f, 0.0f, 0.0f};
+      for (size_t t = first; t < last; ++t) {
+        const auto& p0 = vertices[indices[t * 3]].position;
+        const auto& p1 = vertices[indices[t * 3 + 1]].position;
+        const auto& p2 = vertices[indices[t * 3 + 2]].position;
+        float e1[3] = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+        float e2[3] = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+        std::array<float, 3> n = {{e1[1] * e2[2] - e1[2] * e2[1],
+                                   e1[2] * e2[0] - e1[0] * e2[2],
+                                   e1[0] * e2[1] - e1[1] * e2[0]}};
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        // degenerate triangles are never rasterized
+        if (len == 0.0f)
+          continue;
+        for (int k = 0; k < 3; ++k) {
+          n[k] /= len;
+          axis[k] += n[k];
+        }
+        normals.push_back(n);
+      }
+      float axisLen =
+          std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+      float minDot = -1.0f;
+      if (axisLen > 0.0f) {
+        for (auto& a : axis)
+          a /= axisLen;
+        minDot = 1.0f;
+        for (const auto& n : normals)
+          minDot = std::min(minDot, n[0] * axis[0] + n[1] * axis[1] +
+                                        n[2] * axis[2]);
+      }
+      for (int k = 0; k < 3; ++k)
+        cluster.coneAxis[k] = axis[k];
+      cluster.coneCutoff =
+          minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    }
+  });
+  return clusters;
+}
+
+// Runs the post-processing steps. Tangents are computed on another thread
+// while the triangles are reordered. The clusters are built last, into
+// `clusters` if not null.
+template <typename Vertex>
+void processMesh(std::vector<Vertex>& vertices, std::vector<unsigned>& indices,
+                 MeshProcessFlags flags,
+                 std::vector<MeshCluster>* clusters = nullptr) {
+  auto has = [flags](MeshProcessFlags f) {
+    return (flags & f) != MeshProcessFlags::None;
+  };
+  if (indices.empty())
+    return;
+  detail::VertexTriangleAdjacency adjacency{indices, vertices.size()};
+
+  std::future<void> tangents;
+  if (has(MeshProcessFlags::ComputeTangents))
+    tangents = std::async(std::launch::async, [&]() {
+      computeTangents(vertices, indices, adjacency);
+    });
+
+  std::vector<unsigned> reordered;
+  if (has(MeshProcessFlags::OptimizeVertexCache)) {
+    std::vector<unsigned> clusters;
+    reordered = optimizeVertexCache(
+        indices, vertices.size(), adjacency,
+        has(MeshProcessFlags::OptimizeOverdraw) ? &clusters : nullptr);
+    if (has(MeshProcessFlags::OptimizeOverdraw))
+      reordered = optimizeOverdraw(reordered, vertices, clusters);
+  }
+  if (tangents.valid())
+    tangents.get();
+  // the tangent pass reads the indices until here
+  if (!reordered.empty())
+    indices = std::move(reordered);
+
+  if (has(MeshProcessFlags::OptimizeVertexFetch))
+    optimizeVertexFetch(vertices, indices);
+
+  if (clusters && has(MeshProcessFlags::BuildClusters))
+    *clusters = buildMeshClusters(vertices, indices);
+}
+}
+
+#endif // !MESH_OPTIMIZER_HPP
@@ -1,14 +1,21 @@
 #ifndef SAMPLE_HPP
 #define SAMPLE_HPP
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <memory>
+#include <string>
 
 #include <filesystem/path.h>
 
 #include <autograph/backend/opengl/backend.hpp>
+#include <autograph/compute.hpp>
 #include <autograph/device.hpp>
 #include <autograph/draw.hpp>
 #include <autograph/pipeline.hpp>
+#include <autograph/pixel_conversion.hpp>
+#include <autograph/stats_backend.hpp>
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
@@ -16,11 +23,19 @@
 #include <glm/glm.hpp>
 #include <shaderpp/shaderpp.hpp>
 
+#include "mesh_cache.hpp"
+#include "mesh_lod.hpp"
+#include "mesh_optimizer.hpp"
 #include "uniforms.hpp"
 
 namespace samples {
 
+#ifdef AG_FRAME_STATS
+// counts the device events of each frame (Device::frameStats)
+using GL = ag::StatsBackend<ag::opengl::OpenGLBackend>;
+#else
 using GL = ag::opengl::OpenGLBackend;
+#endif
 
 struct Vertex2D {
   float x;
@@ -29,6 +44,7 @@ struct Vertex2D {
   float ty;
 };
 
+// full-precision vertex, used on the CPU
 struct Vertex3D {
   glm::vec3 position;
   glm::vec3 normal;
@@ -36,20 +52,143 @@ struct Vertex3D {
   glm::vec2 texcoords;
 };
 
+// Quantized vertex, used in the mesh vertex buffers (24 bytes instead of 44)
+// - normal and tangent: signed normalized 10_10_10_2 (INT_2_10_10_10_REV),
+//   with w = 1
+// - texcoords: half floats
+// Positions are kept in full precision: quantizing them would require a
+// per-mesh scale and bias in the shaders.
+struct PackedVertex3D {
+  float position[3];
+  uint32_t normal;
+  uint32_t tangent;
+  uint16_t texcoords[2];
+};
+static_assert(sizeof(PackedVertex3D) == 24, "Unexpected padding");
+
+// vertex type of the mesh vertex buffers
+using MeshVertex = PackedVertex3D;
+
+// x in the low bits, w in the high bits
+inline uint32_t packSnorm2_10_10_10Rev(float x, float y, float z, float w) {
+  auto field = [](float v, float scale, unsigned bits) {
+    v = std::min(std::max(v, -1.0f), 1.0f);
+    return (uint32_t)(int32_t)std::round(v * scale) & ((1u << bits) - 1);
+  };
+  return field(x, 511.0f, 10) | (field(y, 511.0f, 10) << 10) |
+         (field(z, 511.0f, 10) << 20) | (field(w, 1.0f, 2) << 30);
+}
+
+inline PackedVertex3D packVertex(const Vertex3D& v) {
+  PackedVertex3D out;
+  out.position[0] = v.position.x;
+  out.position[1] = v.position.y;
+  out.position[2] = v.position.z;
+  out.normal = packSnorm2_10_10_10Rev(v.normal.x, v.normal.y, v.normal.z, 1.0f);
+  out.tangent =
+      packSnorm2_10_10_10Rev(v.tangent.x, v.tangent.y, v.tangent.z, 1.0f);
+  out.texcoords[0] = ag::floatToHalf(v.texcoords.x);
+  out.texcoords[1] = ag::floatToHalf(v.texcoords.y);
+  return out;
+}
+
 template <typename D> struct Mesh {
+  // CPU copies of the mesh data, empty if the mesh was read from the cache
   std::vector<Vertex3D> vertices;
   std::vector<unsigned int> indices;
-  ag::Buffer<D, Vertex3D[]> vbo;
+  ag::Buffer<D, MeshVertex[]> vbo;
+  // 32-bit (ibo) or 16-bit (ibo16) indices, of all levels of detail
   std::experimental::optional<ag::Buffer<D, unsigned int[]>> ibo;
+  std::experimental::optional<ag::Buffer<D, unsigned short[]>> ibo16;
+  // ranges of the index buffer (MeshProcessFlags::BuildLods), empty if the
+  // index buffer holds only the full mesh
+  std::vector<MeshLod> lods;
+  // object-space bounding box
+  glm::vec3 boundsMin{0.0f, 0.0f, 0.0f};
+  glm::vec3 boundsMax{0.0f, 0.0f, 0.0f};
+  // culling clusters (MeshProcessFlags::BuildClusters), and the draw
+  // commands of the visible clusters, written by cullMeshClusters
+  std::experimental::optional<ag::Buffer<D, MeshCluster[]>> clusters;
+  std::experimental::optional<ag::Buffer<D, ag::DrawIndexedIndirectCommand[]>>
+      clusterDrawCommands;
+  std::experimental::optional<ag::Buffer<D, uint32_t>> clusterDrawCount;
 };
 
+// Assimp post-processing steps of the imported meshes (part of the mesh
+// cache key)
+constexpr unsigned kMeshImportFlags =
+    aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph | aiProcess_Triangulate |
+    aiProcess_JoinIdenticalVertices | aiProcess_SortByPType;
+
+// import the first mesh of a scene file (CPU only)
+inline void importMesh(const std::string& full_path,
+                       std::vector<Vertex3D>& vertices,
+                       std::vector<unsigned int>& indices,
+                       glm::vec3& boundsMin, glm::vec3& boundsMax) {
+  Assimp::Importer importer;
+
+  const aiScene* scene =
+      importer.ReadFile(full_path.c_str(), kMeshImportFlags);
+
+  if (!scene)
+    ag::failWith("Could not load scene");
+
+  // load the first mesh
+  if (scene->mNumMeshes > 0) {
+    auto mesh = scene->mMeshes[0];
+    vertices.resize(mesh->mNumVertices);
+    indices.resize(mesh->mNumFaces * 3);
+    for (unsigned i = 0; i < mesh->mNumVertices; ++i)
+      vertices[i].position = glm::vec3(
+          mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+    if (mesh->mNormals)
+      for (unsigned i = 0; i < mesh->mNumVertices; ++i)
+        vertices[i].normal = glm::vec3(
+            mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+    if (mesh->mTextureCoords[0])
+      for (unsigned i = 0; i < mesh->mNumVertices; ++i)
+        vertices[i].texcoords = glm::vec2(mesh->mTextureCoords[0][i].x,
+                                          mesh->mTextureCoords[0][i].y);
+    for (unsigned i = 0; i < mesh->mNumFaces; ++i) {
+      indices[i * 3 + 0] = mesh->mFaces[i].mIndices[0];
+      indices[i * 3 + 1] = mesh->mFaces[i].mIndices[1];
+      indices[i * 3 + 2] = mesh->mFaces[i].mIndices[2];
+    }
+  }
+
+  if (!vertices.empty()) {
+    boundsMin = boundsMax = vertices[0].position;
+    for (const auto& v : vertices) {
+      boundsMin.x = std::min(boundsMin.x, v.position.x);
+      boundsMin.y = std::min(boundsMin.y, v.position.y);
+      boundsMin.z = std::min(boundsMin.z, v.position.z);
+      boundsMax.x = std::max(boundsMax.x, v.position.x);
+      boundsMax.y = std::max(boundsMax.y, v.position.y);
+      boundsMax.z = std::max(boundsMax.z, v.position.z);
+    }
+  }
+}
+
+// draws one level of detail of the mesh (0 is the full mesh)
 template <typename D, typename RenderTarget, typename... ShaderResources>
-void drawMesh(Mesh<D>& mesh, ag::Device<D>& device, RenderTarget&& rt,
-              ag::GraphicsPipeline<D>& pipeline,
-              ShaderResources&&... resources) {
-  if (mesh.ibo)
-    ag::draw(device, rt, pipeline, ag::DrawIndexed(ag::PrimitiveType::Triangles,
-                                                   0, (uint32_t)mesh.ibo->size(), 0),
+void drawMeshLod(Mesh<D>& mesh, size_t lod, ag::Device<D>& device,
+                 RenderTarget&& rt, ag::GraphicsPipeline<D>& pipeline,
+                 ShaderResources&&... resources) {
+  uint32_t first = 0;
+  uint32_t count = mesh.ibo16 ? (uint32_t)mesh.ibo16->size()
+                              : mesh.ibo ? (uint32_t)mesh.ibo->size() : 0;
+  if (lod < mesh.lods.size()) {
+    first = mesh.lods[lod].firstIndex;
+    count = mesh.lods[lod].indexCount;
+  }
+  if (mesh.ibo16)
+    ag::draw(device, rt, pipeline,
+             ag::DrawIndexed(ag::PrimitiveType::Triangles, first, count, 0),
+             ag::VertexBuffer(mesh.vbo), ag::IndexBuffer(mesh.ibo16.value()),
+             std::forward<ShaderResources>(resources)...);
+  else if (mesh.ibo)
+    ag::draw(device, rt, pipeline,
+             ag::DrawIndexed(ag::PrimitiveType::Triangles, first, count, 0),
              ag::VertexBuffer(mesh.vbo), ag::IndexBuffer(mesh.ibo.value()),
              std::forward<ShaderResources>(resources)...);
   else
@@ -59,6 +198,107 @@ void drawMesh(Mesh<D>& mesh, ag::Device<D>& device, RenderTarget&& rt,
              std::forward<ShaderResources>(resources)...);
 }
 
+template <typename D, typename RenderTarget, typename... ShaderResources>
+void drawMesh(Mesh<D>& mesh, ag::Device<D>& device, RenderTarget&& rt,
+              ag::GraphicsPipeline<D>& pipeline,
+              ShaderResources&&... resources) {
+  drawMeshLod(mesh, 0, device, std::forward<RenderTarget>(rt), pipeline,
+              std::forward<ShaderResources>(resources)...);
+}
+
+// Selects the level of detail of the mesh whose error is below
+// `maxPixelError` pixels on the screen, at the point of the bounding sphere
+// of the mesh nearest to the camera.
+template <typename D>
+size_t selectMeshLod(const Mesh<D>& mesh, const glm::mat4& modelMatrix,
+                     const glm::mat4& viewMatrix, const glm::mat4& projMatrix,
+                     float viewportHeight, float maxPixelError = 1.0f) {
+  if (mesh.lods.size() <= 1)
+    return 0;
+  auto columnLength = [&](int i) {
+    return std::sqrt(modelMatrix[i][0] * modelMatrix[i][0] +
+                     modelMatrix[i][1] * modelMatrix[i][1] +
+                     modelMatrix[i][2] * modelMatrix[i][2]);
+  };
+  float scale = std::max(columnLength(0), std::max(columnLength(1),
+                                                   columnLength(2)));
+  glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+  glm::vec3 extent = mesh.boundsMax - center;
+  float radius = scale * std::sqrt(extent.x * extent.x + extent.y * extent.y +
+                                   extent.z * extent.z);
+  glm::vec4 viewCenter =
+      viewMatrix * (modelMatrix * glm::vec4(center, 1.0f));
+  // size of one object-space unit in pixels, at a distance of 1
+  float pixelsPerUnit = scale * projMatrix[1][1] * viewportHeight * 0.5f;
+  // perspective projection
+  if (projMatrix[3][3] == 0.0f) {
+    float distance = std::sqrt(viewCenter.x * viewCenter.x +
+                               viewCenter.y * viewCenter.y +
+                               viewCenter.z * viewCenter.z) -
+                     radius;
+    if (distance <= 1e-6f)
+      return 0;
+    pixelsPerUnit /= distance;
+  }
+  return selectMeshLod(mesh.lods, pixelsPerUnit, maxPixelError);
+}
+
+// Culls the clusters of the mesh against the view frustum and their normal
+// cones on the GPU, and writes the draw commands used by drawMeshClusters.
+// `pipeline` is the [cull_clusters.glsl] compute pipeline. Back-face cone
+// culling assumes closed meshes with counter-clockwise front faces.
+// Returns false if the mesh has no clusters.
+template <typename D>
+bool cullMeshClusters(Mesh<D>& mesh, ag::Device<D>& device,
+                      ag::ComputePipeline<D>& pipeline,
+                      const glm::mat4& modelMatrix, const glm::mat4& viewMatrix,
+                      const glm::mat4& projMatrix, bool coneCulling = true) {
+  if (!mesh.clusters)
+    return false;
+  // commands past the count are drawn without ARB_indirect_parameters
+  if (!device.backend.supportsIndirectDrawCount())
+    ag::clear(device, mesh.clusterDrawCommands.value());
+  ag::clear(device, mesh.clusterDrawCount.value());
+  uniforms::ClusterCull params;
+  auto modelView = viewMatrix * modelMatrix;
+  params.modelViewProjMatrix = projMatrix * modelView;
+  params.eyePosition = glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  params.clusterCount = (uint32_t)mesh.clusters->size();
+  params.coneCulling = coneCulling ? 1 : 0;
+  ag::compute(device, pipeline,
+              ag::ThreadGroupCount{(unsigned)ag::divRoundUp(
+                  (int)params.clusterCount, 64)},
+              params, ag::RWBufferUnit(0, mesh.clusters.value()),
+              ag::RWBufferUnit(1, mesh.clusterDrawCommands.value()),
+              ag::RWBufferUnit(2, mesh.clusterDrawCount.value()));
+  return true;
+}
+
+// Draws the clusters left by the last call to cullMeshClusters with one
+// indirect draw, or the whole mesh if it has no clusters.
+template <typename D, typename RenderTarget, typename... ShaderResources>
+void drawMeshClusters(Mesh<D>& mesh, ag::Device<D>& device, RenderTarget&& rt,
+                      ag::GraphicsPipeline<D>& pipeline,
+                      ShaderResources&&... resources) {
+  if (!mesh.clusters) {
+    drawMesh(mesh, device, rt, pipeline,
+             std::forward<ShaderResources>(resources)...);
+    return;
+  }
+  auto drawCommand =
+      ag::DrawIndexedIndirect(ag::PrimitiveType::Triangles,
+                              mesh.clusterDrawCommands.value(),
+                              mesh.clusterDrawCount.value());
+  if (mesh.ibo16)
+    ag::draw(device, rt, pipeline, drawCommand, ag::VertexBuffer(mesh.vbo),
+             ag::IndexBuffer(mesh.ibo16.value()),
+             std::forward<ShaderResources>(resources)...);
+  else
+    ag::draw(device, rt, pipeline, drawCommand, ag::VertexBuffer(mesh.vbo),
+             ag::IndexBuffer(mesh.ibo.value()),
+             std::forward<ShaderResources>(resources)...);
+}
+
 std::array<float, 16> perspectiveFovRH(float fovY, float aspectRatio,
                                        float zNear, float zFar) {
   std::array<float, 16> out;
@@ -85,11 +325,14 @@ std::array<float, 16> perspectiveFovRH(float fovY, float aspectRatio,
   return out;
 }
 
+// vertex layout of the mesh vertex buffers (MeshVertex)
 constexpr ag::opengl::VertexAttribute kMeshVertexDesc[] = {
-    {0, gl::FLOAT, 3, 3 * sizeof(float), false},
-    {0, gl::FLOAT, 3, 3 * sizeof(float), false},
-    {0, gl::FLOAT, 3, 3 * sizeof(float), false},
-    {0, gl::FLOAT, 2, 2 * sizeof(float), false}};
+    {0, gl::FLOAT, 3, 3 * sizeof(float), false,
+     offsetof(PackedVertex3D, position)},
+    {0, gl::INT_2_10_10_10_REV, 4, 4, true, offsetof(PackedVertex3D, normal)},
+    {0, gl::INT_2_10_10_10_REV, 4, 4, true, offsetof(PackedVertex3D, tangent)},
+    {0, gl::HALF_FLOAT, 2, 2 * sizeof(uint16_t), false,
+     offsetof(PackedVertex3D, texcoords)}};
 
 constexpr ag::opengl::VertexAttribute vertexAttribs_2D[] = {
 	{ 0, gl::FLOAT, 2, 2 * sizeof(float), false },
@@ -130,6 +373,7 @@ public:
     options.framebufferWidth = width;
     options.framebufferHeight = height;
     options.windowTitle = std::string(window_title_);
+    options.enableProfiler = true;
     device = std::make_unique<ag::Device<GL>>(gl, options);
     loadPipelines();
     loadSamplers();
@@ -170,45 +414,136 @@ public:
         ag::extra::image_io::loadTexture2D(*device, full_path.str().c_str()));
   }
 
-  Mesh<GL> loadMesh(const char* asset_path) {
-    auto full_path = samplesRoot / asset_path;
-    Assimp::Importer importer;
-
-    const aiScene* scene = importer.ReadFile(
-        full_path.str().c_str(),
-        aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
-            aiProcess_Triangulate | aiProcess_JoinIdenticalVertices |
-            aiProcess_SortByPType);
-
-    if (!scene)
-      ag::failWith("Could not load scene");
-
-    // load the first mesh
-    std::vector<Vertex3D> vertices;
-    std::vector<unsigned int> indices;
-    if (scene->mNumMeshes > 0) {
-      auto mesh = scene->mMeshes[0];
-      vertices.resize(mesh->mNumVertices);
-      indices.resize(mesh->mNumFaces * 3);
-      for (unsigned i = 0; i < mesh->mNumVertices; ++i)
-        vertices[i].position = glm::vec3(
-            mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-      if (mesh->mNormals)
-        for (unsigned i = 0; i < mesh->mNumVertices; ++i)
-          vertices[i].normal = glm::vec3(
-              mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
-      for (unsigned i = 0; i < mesh->mNumFaces; ++i) {
-        indices[i * 3 + 0] = mesh->mFaces[i].mIndices[0];
-        indices[i * 3 + 1] = mesh->mFaces[i].mIndices[1];
-        indices[i * 3 + 2] = mesh->mFaces[i].mIndices[2];
-      }
+  static void createIndexBuffer(GL& backend, Mesh<GL>& mesh, size_t indexSize,
+                                size_t indexCount, const void* data) {
+    auto handle = backend.createBuffer(indexCount * indexSize, data,
+                                       ag::BufferUsage::Default);
+    if (indexSize == 2)
+      mesh.ibo16 = ag::Buffer<GL, unsigned short[]>(indexCount, std::move(handle));
+    else
+      mesh.ibo = ag::Buffer<GL, unsigned int[]>(indexCount, std::move(handle));
+  }
+
+  // cluster bounds, and one draw command per cluster
+  static void createClusterBuffers(GL& backend, Mesh<GL>& mesh,
+                                   gsl::span<const MeshCluster> clusters) {
+    if (clusters.empty())
+      return;
+    auto count = (size_t)clusters.size();
+    mesh.clusters = ag::Buffer<GL, MeshCluster[]>(
+        count, backend.createBuffer(count * sizeof(MeshCluster),
+                                    clusters.data(), ag::BufferUsage::Default));
+    mesh.clusterDrawCommands = ag::Buffer<GL, ag::DrawIndexedIndirectCommand[]>(
+        count,
+        backend.createBuffer(count * sizeof(ag::DrawIndexedIndirectCommand),
+                             nullptr, ag::BufferUsage::Default));
+    mesh.clusterDrawCount = ag::Buffer<GL, uint32_t>(backend.createBuffer(
+        sizeof(uint32_t), nullptr, ag::BufferUsage::Default));
+  }
+
+  // Loads the first mesh of a scene file and creates its buffers.
+  // The mesh is read from the cache file next to the scene file
+  // (<file>.agmesh) if it matches the contents of the scene file, and
+  // uploaded directly from the mapped cache. Otherwise, the scene is
+  // imported with Assimp, post-processed, and the cache is written for the
+  // next time.
+  static void loadMeshBuffers(GL& backend, const std::string& full_path,
+                              MeshProcessFlags processFlags, Mesh<GL>& mesh) {
+    auto cachePath = full_path + ".agmesh";
+    auto sourceHash = hashFileContents(full_path);
+    MeshCacheFile cache;
+    if (sourceHash &&
+        cache.open(cachePath, sourceHash, kMeshImportFlags,
+                   (uint32_t)processFlags, sizeof(MeshVertex))) {
+      const auto& header = cache.getHeader();
+      auto vertexData = cache.getVertexData();
+      mesh.vbo = ag::Buffer<GL, MeshVertex[]>(
+          (size_t)header.vertexCount,
+          backend.createBuffer((size_t)vertexData.size_bytes(),
+                               vertexData.data(), ag::BufferUsage::Default));
+      createIndexBuffer(backend, mesh, header.indexSize,
+                        (size_t)header.indexCount,
+                        cache.getIndexData().data());
+      mesh.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1],
+                                 header.boundsMin[2]);
+      mesh.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1],
+                                 header.boundsMax[2]);
+      createClusterBuffers(backend, mesh, cache.getClusters());
+      auto lods = cache.getLods();
+      mesh.lods.assign(lods.begin(), lods.end());
+      return;
+    }
+
+    importMesh(full_path, mesh.vertices, mesh.indices, mesh.boundsMin,
+               mesh.boundsMax);
+    std::vector<MeshCluster> clusters;
+    processMesh(mesh.vertices, mesh.indices, processFlags, &clusters);
+    if ((processFlags & MeshProcessFlags::BuildLods) != MeshProcessFlags::None)
+      mesh.lods = buildMeshLods(mesh.vertices, mesh.indices);
+    // quantize
+    std::vector<MeshVertex> packedVertices(mesh.vertices.size());
+    std::transform(mesh.vertices.begin(), mesh.vertices.end(),
+                   packedVertices.begin(), packVertex);
+    mesh.vbo = ag::Buffer<GL, MeshVertex[]>(
+        packedVertices.size(),
+        backend.createBuffer(packedVertices.size() * sizeof(MeshVertex),
+                             packedVertices.data(), ag::BufferUsage::Default));
+    std::vector<unsigned short> indices16;
+    if ((processFlags & MeshProcessFlags::NarrowIndices) !=
+            MeshProcessFlags::None &&
+        mesh.vertices.size() <= 65536)
+      indices16.assign(mesh.indices.begin(), mesh.indices.end());
+    gsl::span<const gsl::byte> indexData =
+        indices16.empty()
+            ? gsl::as_bytes(gsl::span<const unsigned int>(mesh.indices.data(),
+                                                          mesh.indices.size()))
+            : gsl::as_bytes(gsl::span<const unsigned short>(indices16.data(),
+                                                            indices16.size()));
+    uint32_t indexSize = indices16.empty() ? 4 : 2;
+    createIndexBuffer(backend, mesh, indexSize, mesh.indices.size(),
+                      indexData.data());
+    createClusterBuffers(
+        backend, mesh,
+        gsl::span<const MeshCluster>(clusters.data(), clusters.size()));
+    if (sourceHash) {
+      float boundsMin[3] = {mesh.boundsMin.x, mesh.boundsMin.y,
+                            mesh.boundsMin.z};
+      float boundsMax[3] = {mesh.boundsMax.x, mesh.boundsMax.y,
+                            mesh.boundsMax.z};
+      writeMeshCache(cachePath, sourceHash, kMeshImportFlags,
+                     (uint32_t)processFlags, sizeof(MeshVertex),
+                     gsl::as_bytes(gsl::span<const MeshVertex>(
+                         packedVertices.data(), packedVertices.size())),
+                     indexSize, indexData,
+                     gsl::span<const MeshCluster>(clusters.data(),
+                                                  clusters.size()),
+                     gsl::span<const MeshLod>(mesh.lods.data(),
+                                              mesh.lods.size()),
+                     boundsMin, boundsMax);
     }
+  }
 
-    auto vbo = device->createBufferFromSpan(gsl::span<const Vertex3D>(vertices));
-    auto ibo = device->createBufferFromSpan(gsl::span<const unsigned int>(indices));
+  Mesh<GL> loadMesh(const char* asset_path,
+                    MeshProcessFlags processFlags = MeshProcessFlags::All) {
+    Mesh<GL> mesh;
+    loadMeshBuffers(device->backend, (samplesRoot / asset_path).str(),
+                    processFlags, mesh);
+    return mesh;
+  }
 
-    return Mesh<GL>{std::move(vertices), std::move(indices), std::move(vbo),
-                    std::move(ibo)};
+  // load the mesh and create the buffers on the loader thread;
+  // `onReady` is called on the render thread with the mesh
+  template <typename F>
+  void loadMeshAsync(const char* asset_path, F onReady,
+                     MeshProcessFlags processFlags = MeshProcessFlags::All) {
+    auto full_path = (samplesRoot / asset_path).str();
+    auto mesh = std::make_shared<Mesh<GL>>();
+    auto& backend = device->backend;
+    backend.runOnLoaderThread(
+        [&backend, mesh, full_path, processFlags]() {
+          loadMeshBuffers(backend, full_path, processFlags, *mesh);
+        },
+        [mesh, onReady]() mutable { onReady(std::move(*mesh)); });
   }
 
   ag::GraphicsPipeline<GL>
@@ -261,7 +596,7 @@ public:
 protected:
   unsigned width;
   unsigned height;
-  ag::opengl::OpenGLBackend gl;
+  GL gl;
   std::unique_ptr<ag::Device<GL>> device;
   // autograph source tree root (contains src,ext,examples)
   filesystem::path projectRoot;
@@ -271,8 +606,12 @@ protected:
   ag::GraphicsPipeline<GL> ppDefault;
   ag::GraphicsPipeline<GL> ppCopyTex;
   ag::GraphicsPipeline<GL> ppCopyTexWithMask;
+  // [cull_clusters.glsl], see cullMeshClusters
+  ag::ComputePipeline<GL> ppCullMeshClusters;
 
   ag::Sampler<GL> samLinearClamp;
+  // linear filtering between mip levels, for minified textures
+  ag::Sampler<GL> samTrilinearClamp;
   ag::Sampler<GL> samNearestClamp;
   ag::Sampler<GL> samLinearRepeat;
   ag::Sampler<GL> samNearestRepeat;
@@ -302,6 +641,13 @@ private:
     info.VSSource = VSSource.c_str();
     info.PSSource = PSSource.c_str();
     ppCopyTexWithMask = device->createGraphicsPipeline(info);
+
+    ShaderSource src_cull(
+        (samplesRoot / "common/glsl/cull_clusters.glsl").str().c_str());
+    ag::opengl::ComputePipelineInfo cullInfo;
+    auto CSSource = src_cull.preprocess(PipelineStage::Compute, nullptr, nullptr);
+    cullInfo.CSSource = CSSource.c_str();
+    ppCullMeshClusters = device->createComputePipeline(cullInfo);
   }
   void loadSamplers() {
     ag::SamplerInfo info;
@@ -323,6 +669,8 @@ private:
     info.minFilter = ag::TextureFilter::Linear;
     info.magFilter = ag::TextureFilter::Linear;
     samLinearClamp = device->createSampler(info);
+    info.mipmapMode = ag::MipmapMode::Linear;
+    samTrilinearClamp = device->createSampler(info);
   }
 };
 }
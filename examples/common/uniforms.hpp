@@ -1,6 +1,8 @@
 #ifndef UNIFORMS_HPP
 #define UNIFORMS_HPP
 
+#include <cstdint>
+
 #include <glm/glm.hpp>
 
 namespace samples {
@@ -15,6 +17,15 @@ struct Scene {
 struct Object {
   glm::mat4 modelMatrix;
 };
+
+// [cull_clusters.glsl]
+struct ClusterCull {
+  glm::mat4 modelViewProjMatrix;
+  // camera position in object space (w unused)
+  glm::vec4 eyePosition;
+  uint32_t clusterCount;
+  uint32_t coneCulling;
+};
 }
 }
 
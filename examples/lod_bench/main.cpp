@@ -0,0 +1,64 @@
+// Levels of detail of a mesh: simplification time, and triangles rendered
+// at increasing camera distances.
+// Usage: sample_lod_bench <mesh file> [max pixel error]
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <format.h>
+
+#include "../common/sample.hpp"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: sample_lod_bench <mesh file> [max pixel error]\n";
+    return 1;
+  }
+  float maxPixelError = argc >= 3 ? (float)std::atof(argv[2]) : 1.0f;
+  // vertical field of view and resolution of the simulated camera
+  const float kFovY = 45.0f * 3.14159265f / 180.0f;
+  const float kViewportHeight = 1080.0f;
+
+  std::vector<samples::Vertex3D> vertices;
+  std::vector<unsigned> indices;
+  glm::vec3 boundsMin, boundsMax;
+  samples::importMesh(argv[1], vertices, indices, boundsMin, boundsMax);
+  samples::processMesh(vertices, indices,
+                       samples::MeshProcessFlags::OptimizeVertexCache |
+                           samples::MeshProcessFlags::OptimizeVertexFetch);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  auto lods = samples::buildMeshLods(vertices, indices);
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << fmt::format(
+      "{} vertices, {} triangles: {} levels built in {:.1f} ms\n",
+      vertices.size(), lods[0].indexCount / 3, lods.size(),
+      std::chrono::duration<double>(end - start).count() * 1000.0);
+  for (size_t i = 0; i < lods.size(); ++i)
+    std::cout << fmt::format("  LOD {}: {:>9} triangles, error {:.6f}\n", i,
+                             lods[i].indexCount / 3, lods[i].error);
+
+  float extent[3] = {boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y,
+                     boundsMax.z - boundsMin.z};
+  float radius = 0.5f * std::sqrt(extent[0] * extent[0] +
+                                  extent[1] * extent[1] + extent[2] * extent[2]);
+  // pixels per unit at a distance of 1 (same as samples::selectMeshLod)
+  float projScale = 1.0f / std::tan(kFovY * 0.5f) * kViewportHeight * 0.5f;
+
+  std::cout << fmt::format("\nmax. error {} px, {} px viewport\n",
+                           maxPixelError, kViewportHeight);
+  std::cout << fmt::format("{:>14} {:>12} {:>4} {:>12} {:>8}\n", "distance",
+                           "screen size", "LOD", "triangles", "of full");
+  for (float zoom = 1.5f; zoom <= 1024.0f; zoom *= 2.0f) {
+    float distance = radius * zoom;
+    float pixelsPerUnit = projScale / (distance - radius);
+    auto lod = samples::selectMeshLod(lods, pixelsPerUnit, maxPixelError);
+    std::cout << fmt::format(
+        "{:>8.1f} radii {:>9.0f} px {:>4} {:>12} {:>7.1f}%\n", zoom,
+        2.0f * radius * projScale / distance, lod, lods[lod].indexCount / 3,
+        100.0 * lods[lod].indexCount / lods[0].indexCount);
+  }
+  return 0;
+}
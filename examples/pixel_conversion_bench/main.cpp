@@ -0,0 +1,103 @@
+// Throughput of ag::convertPixels for the common conversion pairs.
+// Usage: sample_pixel_conversion_bench [width height]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <format.h>
+
+#include <autograph/pixel_conversion.hpp>
+
+struct ConversionCase {
+  const char* name;
+  ag::PixelFormat src;
+  ag::PixelFormat dst;
+  ag::ColorTransfer transfer;
+};
+
+int main(int argc, char** argv) {
+  using ag::PixelFormat;
+  using ag::ColorTransfer;
+  size_t width = 2048, height = 2048;
+  if (argc == 3) {
+    width = (size_t)std::atoi(argv[1]);
+    height = (size_t)std::atoi(argv[2]);
+  }
+  const size_t numPixels = width * height;
+
+  const ConversionCase cases[] = {
+      {"Unorm8x4 -> Float4", PixelFormat::Unorm8x4, PixelFormat::Float4,
+       ColorTransfer::None},
+      {"Float4 -> Unorm8x4", PixelFormat::Float4, PixelFormat::Unorm8x4,
+       ColorTransfer::None},
+      {"Unorm8x4 (sRGB) -> Float4", PixelFormat::Unorm8x4,
+       PixelFormat::Float4, ColorTransfer::SRGBToLinear},
+      {"Float4 -> Unorm8x4 (sRGB)", PixelFormat::Float4,
+       PixelFormat::Unorm8x4, ColorTransfer::LinearToSRGB},
+      {"Float4 -> Float16x4", PixelFormat::Float4, PixelFormat::Float16x4,
+       ColorTransfer::None},
+      {"Float16x4 -> Float4", PixelFormat::Float16x4, PixelFormat::Float4,
+       ColorTransfer::None},
+      {"Unorm8x3 -> Unorm8x4", PixelFormat::Unorm8x3, PixelFormat::Unorm8x4,
+       ColorTransfer::None},
+      {"Unorm8x4 -> Unorm8x3", PixelFormat::Unorm8x4, PixelFormat::Unorm8x3,
+       ColorTransfer::None},
+      {"Unorm10x3_1x2 -> Float4", PixelFormat::Unorm10x3_1x2,
+       PixelFormat::Float4, ColorTransfer::None},
+      {"Float4 -> Unorm10x3_1x2", PixelFormat::Float4,
+       PixelFormat::Unorm10x3_1x2, ColorTransfer::None},
+      // generic path, for reference
+      {"Unorm8x4 -> Float16x4 (generic)", PixelFormat::Unorm8x4,
+       PixelFormat::Float16x4, ColorTransfer::None},
+      {"Unorm16x4 -> Unorm8x4 (generic)", PixelFormat::Unorm16x4,
+       PixelFormat::Unorm8x4, ColorTransfer::None},
+  };
+
+  std::cout << fmt::format("{} x {} pixels, SIMD path: {}\n", width, height,
+                           ag::getPixelConversionSIMDPath());
+  std::mt19937 rng{42};
+  for (const auto& c : cases) {
+    size_t srcSize = ag::getPixelSize(c.src) * numPixels;
+    size_t dstSize = ag::getPixelSize(c.dst) * numPixels;
+    std::vector<uint8_t> src(srcSize);
+    std::vector<uint8_t> dst(dstSize);
+    if (c.src == PixelFormat::Float4) {
+      std::uniform_real_distribution<float> dist{0.0f, 1.0f};
+      auto values = (float*)src.data();
+      for (size_t i = 0; i < numPixels * 4; ++i)
+        values[i] = dist(rng);
+    } else if (c.src == PixelFormat::Float16x4) {
+      std::uniform_real_distribution<float> dist{0.0f, 1.0f};
+      auto values = (uint16_t*)src.data();
+      for (size_t i = 0; i < numPixels * 4; ++i)
+        values[i] = ag::floatToHalf(dist(rng));
+    } else {
+      for (auto& b : src)
+        b = (uint8_t)rng();
+    }
+
+    auto run = [&]() {
+      ag::convertPixels(
+          c.src, c.dst,
+          gsl::as_bytes(gsl::span<const uint8_t>(src.data(), src.size())),
+          gsl::as_writeable_bytes(gsl::span<uint8_t>(dst.data(), dst.size())),
+          c.transfer);
+    };
+    // warm up (page faults, sRGB tables)
+    run();
+    const int kIterations = 10;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < kIterations; ++i)
+      run();
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds =
+        std::chrono::duration<double>(end - start).count() / kIterations;
+    std::cout << fmt::format("{:<34} {:8.2f} ms {:8.1f} Mpixel/s {:8.1f} MB/s\n",
+                             c.name, seconds * 1000.0,
+                             numPixels / seconds / 1e6,
+                             (srcSize + dstSize) / seconds / 1e6);
+  }
+  return 0;
+}
@@ -1,6 +1,7 @@
 #ifndef BRUSH_PATH_HPP
 #define BRUSH_PATH_HPP
 
+#include <algorithm>
 #include <vector>
 
 #include "ui.hpp"
@@ -74,13 +75,26 @@ glm::mat3x4 getSplatTransform(unsigned tipWidth, unsigned tipHeight,
                  scale));
 }
 
+// Bounding box of the (rotated) splat quad, in pixels.
+// Clamped to zero on the top left, not clipped on the bottom right.
 ag::Box2D getSplatFootprint(unsigned tipWidth, unsigned tipHeight,
                             const SplatProperties& splat) {
   auto transform = getSplatTransform(tipWidth, tipHeight, splat);
-  auto topleft = transform * glm::vec3{-1.0f, -1.0f, 1.0f};
-  auto bottomright = transform * glm::vec3{1.0f, 1.0f, 1.0f};
-  return ag::Box2D{(unsigned)topleft.x, (unsigned)topleft.y,
-                   (unsigned)bottomright.x, (unsigned)bottomright.y};
+  glm::vec2 corners[4] = {
+      glm::vec2(transform * glm::vec3{-1.0f, -1.0f, 1.0f}),
+      glm::vec2(transform * glm::vec3{1.0f, -1.0f, 1.0f}),
+      glm::vec2(transform * glm::vec3{-1.0f, 1.0f, 1.0f}),
+      glm::vec2(transform * glm::vec3{1.0f, 1.0f, 1.0f})};
+  glm::vec2 minCorner = corners[0];
+  glm::vec2 maxCorner = corners[0];
+  for (const auto& c : corners) {
+    minCorner = glm::min(minCorner, c);
+    maxCorner = glm::max(maxCorner, c);
+  }
+  minCorner = glm::max(glm::floor(minCorner), glm::vec2{0.0f});
+  maxCorner = glm::max(glm::ceil(maxCorner), glm::vec2{0.0f});
+  return ag::Box2D{(unsigned)minCorner.x, (unsigned)minCorner.y,
+                   (unsigned)maxCorner.x, (unsigned)maxCorner.y};
 }
 
 template <typename T> T evalJitter(T ref, T jitter) {
@@ -101,6 +115,50 @@ SplatProperties evalSplat(const BrushProperties& props, glm::vec2 center) {
   return ret;
 }
 
+// Segment of a brush path between two pointer events, with the splats
+// spaced along it. Input of the analytic stroke rasterizer: std430 layout of
+// StrokeSegment in glsl/stroke_mask.glsl.
+// The width (radius), pressure and opacity of the splats are interpolated
+// between the two ends; the radius of a splat is width * pressure.
+struct StrokeSegment {
+  glm::vec2 p0;
+  glm::vec2 p1;
+  float width0;
+  float width1;
+  float pressure0;
+  float pressure1;
+  float opacity0;
+  float opacity1;
+  // distance along the segment of the first splat, and between two splats
+  float firstSplat;
+  float spacing;
+  unsigned splatCount;
+  // index of the first splat in the stroke (seeds the per-splat jitter)
+  unsigned splatIndex;
+  unsigned padding[2];
+};
+
+// center of the i-th splat of a segment
+inline glm::vec2 getSplatCenter(const StrokeSegment& seg, unsigned i) {
+  auto length = glm::distance(seg.p0, seg.p1);
+  auto pos = seg.firstSplat + (float)i * seg.spacing;
+  return glm::mix(seg.p0, seg.p1, (length > 0.01f) ? pos / length : 0.0f);
+}
+
+// Bounding box of the splats of a segment, in pixels (not clipped).
+// `widthJitter` is the maximum deviation of the width of a splat.
+inline ag::Box2D getSegmentFootprint(const StrokeSegment& seg,
+                                     float widthJitter) {
+  auto reach = std::max(seg.width0 * seg.pressure0, seg.width1 * seg.pressure1) +
+               widthJitter;
+  auto minCorner = glm::max(
+      glm::floor(glm::min(seg.p0, seg.p1) - glm::vec2{reach}), glm::vec2{0.0f});
+  auto maxCorner = glm::max(
+      glm::ceil(glm::max(seg.p0, seg.p1) + glm::vec2{reach}), glm::vec2{0.0f});
+  return ag::Box2D{(unsigned)minCorner.x, (unsigned)minCorner.y,
+                   (unsigned)maxCorner.x, (unsigned)maxCorner.y};
+}
+
 // Brush path: convert a sequence of pointer position to a sequence of
 // splat positions.
 // TODO smoothing
@@ -109,38 +167,67 @@ struct BrushPath {
   template <typename F>
   void addPointerEvent(const PointerEvent& ev, const BrushProperties& props,
                        F f) {
+    auto seg = addSegment(ev, props);
+    for (unsigned i = 0; i < seg.splatCount; ++i)
+      f(evalSplat(props, getSplatCenter(seg, i)));
+  }
+
+  // Same as addPointerEvent, but returns the segment from the previous
+  // pointer event to `ev` instead of evaluating the splats one by one.
+  // The width and opacity jitters are left to the rasterizer.
+  StrokeSegment addSegment(const PointerEvent& ev,
+                           const BrushProperties& props) {
     // eval spacing
     auto spacing = evalJitter(props.spacing, props.spacingJitter);
     if (spacing < 0.1f)
       spacing = 0.1f;
 
+    StrokeSegment seg{};
+    glm::vec2 curF((float)ev.positionX, (float)ev.positionY);
+    seg.p1 = curF;
+    seg.width1 = props.width;
+    seg.pressure1 = ev.pressure;
+    seg.opacity1 = 1.0f;
+    seg.spacing = spacing;
+    seg.splatIndex = splatCount;
+
     if (pointerEvents.empty()) {
       pointerEvents.push_back(ev);
-      f(evalSplat(props, glm::vec2((float)ev.positionX, (float)ev.positionY)));
-      return;
+      // one splat on the first position
+      seg.p0 = curF;
+      seg.width0 = seg.width1;
+      seg.pressure0 = seg.pressure1;
+      seg.opacity0 = seg.opacity1;
+      seg.splatCount = 1;
+      splatCount += seg.splatCount;
+      return seg;
     }
 
     auto last = pointerEvents.back();
-    glm::vec2 curF((float)ev.positionX, (float)ev.positionY);
     glm::vec2 lastF((float)last.positionX, (float)last.positionY);
+    seg.p0 = lastF;
+    seg.width0 = props.width;
+    seg.pressure0 = last.pressure;
+    seg.opacity0 = 1.0f;
     auto length = glm::distance(lastF, curF);
     auto slack = pathLength;
     pathLength += length;
-    auto pos = spacing - slack;
+    seg.firstSplat = spacing - slack;
 
     while (pathLength > spacing) {
-      // emit splat
-      auto P = glm::mix(lastF, curF, (length > 0.01f) ? pos / length : 0.0f);
-      f(evalSplat(props, P));
+      ++seg.splatCount;
       pathLength -= spacing;
-      pos += spacing;
     }
 
+    splatCount += seg.splatCount;
     pointerEvents.push_back(ev);
+    return seg;
   }
 
   std::vector<PointerEvent> pointerEvents;
-  float pathLength;
+  float pathLength = 0.0f;
+  // number of splats emitted since the beginning of the path
+  unsigned splatCount = 0;
 };
 
 #endif
@@ -0,0 +1,153 @@
+#ifndef BRUSH_TIP_ATLAS_HPP
+#define BRUSH_TIP_ATLAS_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <autograph/copy.hpp>
+#include <autograph/draw.hpp>
+#include <autograph/mipmap.hpp>
+
+#include "imgui/stb_rect_pack.h"
+
+#include "types.hpp"
+
+struct BrushTipTexture {
+  std::string name;
+  Texture2D<ag::RGBA8> tex;
+};
+
+// All brush tips in one texture, so that splats using different tips
+// can be drawn without rebinding.
+// uvRects[i] = (offset.x, offset.y, size.x, size.y) of tip i, in texture
+// coordinates (for arrays, the tip is in layer i).
+struct BrushTipAtlas {
+  Texture2D<ag::RGBA8> atlas;
+  Texture2DArray<ag::RGBA8> array;
+  // linear, clamped, with mipmaps
+  Sampler sampler;
+  std::vector<glm::vec4> uvRects;
+  std::vector<glm::uvec2> tipSizes;
+  bool isArray = false;
+
+  bool empty() const { return uvRects.empty(); }
+};
+
+// Tips are placed at the corner of cells aligned on
+// 2^(kBrushTipAtlasMipLevels-1) texels, with at least that much white
+// (transparent for tips) space on the right and bottom: the tips do not
+// bleed into each other in any of the mip levels, even with linear filtering.
+constexpr unsigned kBrushTipAtlasMipLevels = 4;
+constexpr unsigned kBrushTipAtlasPadding = 1 << (kBrushTipAtlasMipLevels - 1);
+constexpr unsigned kBrushTipAtlasMaxSize = 8192;
+
+inline unsigned alignBrushTipCell(unsigned size) {
+  return (size + kBrushTipAtlasPadding + kBrushTipAtlasPadding - 1) /
+         kBrushTipAtlasPadding * kBrushTipAtlasPadding;
+}
+
+inline Sampler createBrushTipSampler(Device& device) {
+  ag::SamplerInfo info;
+  info.addrU = ag::TextureAddressMode::Clamp;
+  info.addrV = ag::TextureAddressMode::Clamp;
+  info.addrW = ag::TextureAddressMode::Clamp;
+  info.minFilter = ag::TextureFilter::Linear;
+  info.magFilter = ag::TextureFilter::Linear;
+  info.mipmapMode = ag::MipmapMode::Linear;
+  return device.createSampler(info);
+}
+
+// Packs the tips in a mipmapped 2D atlas with stb_rect_pack
+// (the smallest power-of-two square that fits).
+// Returns an empty atlas if the tips do not fit in kBrushTipAtlasMaxSize.
+inline BrushTipAtlas buildBrushTipAtlas(Device& device,
+                                        const std::vector<BrushTipTexture>& tips) {
+  BrushTipAtlas out;
+  if (tips.empty())
+    return out;
+
+  std::vector<stbrp_rect> rects(tips.size());
+  unsigned area = 0;
+  for (size_t i = 0; i < tips.size(); ++i) {
+    auto dim = tips[i].tex.info.dimensions;
+    rects[i].id = (int)i;
+    // cell sizes are multiples of the alignment, and so are the positions
+    // chosen by the packer
+    rects[i].w = (stbrp_coord)alignBrushTipCell(dim.x);
+    rects[i].h = (stbrp_coord)alignBrushTipCell(dim.y);
+    area += rects[i].w * rects[i].h;
+  }
+
+  unsigned size = 64;
+  while (size * size < area)
+    size *= 2;
+  std::vector<stbrp_node> nodes;
+  for (; size <= kBrushTipAtlasMaxSize; size *= 2) {
+    stbrp_context ctx;
+    nodes.resize(size);
+    stbrp_init_target(&ctx, (int)size, (int)size, nodes.data(),
+                      (int)nodes.size());
+    stbrp_pack_rects(&ctx, rects.data(), (int)rects.size());
+    if (std::all_of(rects.begin(), rects.end(),
+                    [](const stbrp_rect& r) { return r.was_packed != 0; }))
+      break;
+  }
+  if (size > kBrushTipAtlasMaxSize)
+    return out;
+
+  out.atlas = device.createTexture2D<ag::RGBA8>(glm::uvec2{size, size},
+                                                kBrushTipAtlasMipLevels);
+  out.sampler = createBrushTipSampler(device);
+  ag::clear(device, out.atlas, ag::ClearColor{1.0f, 1.0f, 1.0f, 1.0f});
+  out.uvRects.resize(tips.size());
+  out.tipSizes.resize(tips.size());
+  for (const auto& r : rects) {
+    const auto& tex = tips[r.id].tex;
+    auto dim = tex.info.dimensions;
+    glm::uvec2 offset{(unsigned)r.x, (unsigned)r.y};
+    ag::copy(device, tex, ag::Box2D{0, 0, dim.x, dim.y}, out.atlas, offset);
+    out.uvRects[r.id] =
+        glm::vec4{(float)offset.x, (float)offset.y, (float)dim.x, (float)dim.y} /
+        (float)size;
+    out.tipSizes[r.id] = dim;
+  }
+  ag::generateMips(device, out.atlas);
+  return out;
+}
+
+// One tip per layer of a texture array, with layers as large as the largest
+// tip. Wastes memory if the tip sizes differ a lot, but tips cannot bleed
+// into each other. Layers are not mipmapped: the texels outside the tips are
+// undefined.
+inline BrushTipAtlas buildBrushTipArray(Device& device,
+                                        const std::vector<BrushTipTexture>& tips) {
+  BrushTipAtlas out;
+  if (tips.empty())
+    return out;
+  glm::uvec2 maxDim{0, 0};
+  for (const auto& tip : tips) {
+    maxDim.x = std::max(maxDim.x, tip.tex.info.dimensions.x);
+    maxDim.y = std::max(maxDim.y, tip.tex.info.dimensions.y);
+  }
+
+  out.isArray = true;
+  out.sampler = createBrushTipSampler(device);
+  out.array =
+      device.createTexture2DArray<ag::RGBA8>(maxDim, (unsigned)tips.size());
+  out.uvRects.resize(tips.size());
+  out.tipSizes.resize(tips.size());
+  for (unsigned i = 0; i < tips.size(); ++i) {
+    auto dim = tips[i].tex.info.dimensions;
+    ag::copy(device, tips[i].tex, ag::Box2D{0, 0, dim.x, dim.y}, out.array, i,
+             glm::uvec2{0, 0});
+    out.uvRects[i] = glm::vec4{0.0f, 0.0f, (float)dim.x / (float)maxDim.x,
+                               (float)dim.y / (float)maxDim.y};
+    out.tipSizes[i] = dim;
+  }
+  return out;
+}
+
+#endif // !BRUSH_TIP_ATLAS_HPP
@@ -6,6 +6,7 @@
 #include "../common/sample.hpp" // for Vertex2D
 #include "brush_path.hpp"
 #include "canvas.hpp"
+#include "layers/color_layer.hpp"
 #include "pipelines.hpp"
 #include "types.hpp"
 #include "ui.hpp"
@@ -31,9 +32,32 @@ struct ToolResources {
   Buffer<samples::Vertex2D[]>& vboQuad;
 };
 
+// Starts paging in the tiles of `layer` that the stroke is about to touch:
+// the footprint of the last splat, moved one footprint ahead in the
+// direction of the stroke (`motion` is the displacement since the previous
+// splat).
+inline void prefetchAlongStroke(TiledLayer& layer, const ag::Box2D& footprint,
+                                glm::vec2 motion) {
+  layer.prefetch(footprint);
+  float len = std::sqrt(motion.x * motion.x + motion.y * motion.y);
+  if (len == 0.0f)
+    return;
+  float dist = (float)std::max(footprint.width(), footprint.height());
+  int dx = (int)(motion.x / len * dist);
+  int dy = (int)(motion.y / len * dist);
+  auto shift = [](unsigned v, int d) {
+    return (unsigned)std::max((int)v + d, 0);
+  };
+  layer.prefetch(ag::Box2D{shift(footprint.xmin, dx), shift(footprint.ymin, dy),
+                           shift(footprint.xmax, dx),
+                           shift(footprint.ymax, dy)});
+}
+
 class ToolInstance {
 public:
   virtual ~ToolInstance() {}
+  // once per frame, after the input events of the frame
+  virtual void update() {}
 };
 
 // Object holding the state of a stroke of a brush-like tool
@@ -94,78 +118,178 @@ protected:
 class ColorBrushTool : public BrushTool {
 public:
   ColorBrushTool(const ToolResources& resources_)
-      : BrushTool(resources_), res(resources_) {
+      : BrushTool(resources_), res(resources_),
+        pendingRegion(resources_.canvas.width, resources_.canvas.height) {
     // allocate stroke mask
     fmt::print(std::clog, "Init ColorBrushTool\n");
     texStrokeMask = res.device.createTexture2D<ag::RGBA8>(
         {res.canvas.width, res.canvas.height});
+    ag::clear(res.device, texStrokeMask,
+              ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
   }
 
   virtual ~ColorBrushTool() {}
 
   void beginStroke(const PointerEvent& event) override {
     // reset state:
-    //    clear stroke mask
+    //    clear stroke mask (only the part touched by the previous stroke)
     //    clear brush path
     // get brush properties from UI
     // add point to brush path
-    ag::clear(res.device, texStrokeMask,
-              ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
+    if (!isEmptyRect(strokeBounds))
+      ag::clear(res.device, texStrokeMask,
+                ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f}, strokeBounds);
+    strokeBounds = ag::Box2D{0, 0, 0, 0};
+    res.canvas.history.beginStep();
     brushPath = {};
     brushProps = brushPropsFromUi(res.ui);
-    brushPath.addPointerEvent(event, brushProps,
-                              [this](auto splat) { this->paintSplat(splat); });
+    lastSplatCenter.reset();
+    addPointerEvent(event);
   }
 
   void continueStroke(const PointerEvent& event) override {
-    brushPath.addPointerEvent(event, brushProps,
-                              [this](auto splat) { this->paintSplat(splat); });
+    addPointerEvent(event);
   }
 
+  void update() override { rasterizeSegments(); }
+
   void endStroke(const PointerEvent& event) override {
     fmt::print("Flatten\n");
-    ag::compute(
-        res.device, res.pipelines.ppFlattenStroke,
-        ag::makeThreadGroupCount2D(res.canvas.width, res.canvas.height, 16, 16),
+    rasterizeSegments();
+    if (isEmptyRect(strokeBounds)) {
+      res.canvas.history.endStep();
+      return;
+    }
+    if (auto target = getLayerTarget()) {
+      // painting on a layer: only this layer is evaluated again, the
+      // shading curves are not affected
+      res.canvas.history.recordTiles(res.device, *target, strokeBounds);
+      flattenStroke(*target);
+      res.canvas.getActiveLayer()->dirty.add(strokeBounds);
+      res.canvas.history.endStep();
+      return;
+    }
+    // only the pixels under the stroke change
+    res.canvas.history.recordTiles(res.device, res.canvas.baseColorUV,
+                                   strokeBounds);
+    // the old pixels leave the shading curve histogram
+    beginShadingCurveUpdate(res.device, res.pipelines, res.canvas, res.ui,
+                            strokeBounds);
+    flattenStroke(res.canvas.baseColorUV);
+    res.canvas.dirty.add(strokeBounds);
+    res.canvas.history.endStep();
+    endShadingCurveUpdate(res.device, res.pipelines, res.canvas, res.ui,
+                          strokeBounds);
+  }
+
+  // Tiled layer painted by the brush when the active layer has its own
+  // pixels (the colors of a color layer, or the mask of any layer); nullptr
+  // for the base color of the canvas.
+  TiledLayer* getLayerTarget() {
+    auto layer = res.canvas.getActiveLayer();
+    if (!layer)
+      return nullptr;
+    if (res.ui.paintLayerMask && layer->mask)
+      return layer->mask.get();
+    if (layer->type == LayerType::Constant)
+      return &static_cast<ColorLayer*>(layer)->colors;
+    return nullptr;
+  }
+
+  // blends the stroke mask with the brush color into `layer`
+  void flattenStroke(TiledLayer& layer) {
+    layer.allocate(res.device, strokeBounds);
+    computeOverRects(
+        res.device, res.pipelines.ppFlattenStroke, {strokeBounds},
         glm::vec2{res.canvas.width, res.canvas.height},
         glm::vec4{brushProps.color[0], brushProps.color[1], brushProps.color[2],
                   brushProps.opacity},
-        texStrokeMask, ag::RWTextureUnit(0, res.canvas.texBaseColorUV));
-    computeShadingCurve(res.device, res.pipelines, res.canvas, res.ui);
+        texStrokeMask, ag::RWTextureUnit(0, layer.tiles),
+        ag::RWTextureUnit(1, layer.pageTable));
   }
 
   //
   void previewCanvas(Texture2D<ag::RGBA8>& texTarget) {}
 
+  // Round tips are rasterized analytically, one dispatch per frame for all
+  // the segments of the frame (see rasterizeSegments); the other tips are
+  // drawn splat by splat.
+  void addPointerEvent(const PointerEvent& event) {
+    if (res.ui.brushTip != BrushTip::Round) {
+      brushPath.addPointerEvent(
+          event, brushProps, [this](auto splat) { this->paintSplat(splat); });
+      return;
+    }
+    auto seg = brushPath.addSegment(event, brushProps);
+    if (!seg.splatCount)
+      return;
+    auto footprint = getSegmentFootprint(seg, brushProps.widthJitter);
+    pendingSegments.push_back(seg);
+    pendingRegion.add(footprint);
+    strokeBounds = clipRect(unionRect(strokeBounds, footprint),
+                            res.canvas.width, res.canvas.height);
+    auto target = getLayerTarget();
+    prefetchAlongStroke(target ? *target : res.canvas.baseColorUV, footprint,
+                        seg.p1 - seg.p0);
+  }
+
+  // Evaluates the coverage of the pending segments over the tiles covered by
+  // their footprints, writing each pixel of the stroke mask once.
+  void rasterizeSegments() {
+    if (pendingSegments.empty())
+      return;
+    struct StrokeParams {
+      float widthJitter;
+      float smoothness;
+    };
+    auto segments = res.device.pushDataToUploadBuffer(
+        gsl::as_span(pendingSegments),
+        GL::kShaderStorageBufferOffsetAlignment);
+    computeOverRects(res.device, res.pipelines.ppRasterizeStroke,
+                     pendingRegion.getRects(),
+                     StrokeParams{brushProps.widthJitter, brushProps.smoothness},
+                     ag::RWBufferUnit(0, segments),
+                     ag::RWTextureUnit(0, texStrokeMask));
+    // the stroke mask is sampled by the flatten pass
+    ag::memoryBarrier(res.device);
+    pendingSegments.clear();
+    pendingRegion.clear();
+  }
+
+  // draws a splat of the textured tip to the stroke mask
   void paintSplat(const SplatProperties& splat) {
-    // draw splat to stroke mask
+    // the atlas is empty until the tips are loaded
+    if ((size_t)res.ui.selectedBrushTip >= res.ui.brushTipAtlas.tipSizes.size())
+      return;
     fmt::print("Splat {} {} {}\n", splat.center.x, splat.center.y, splat.width);
     uniforms::Splat uSplat;
     uSplat.center = splat.center;
     uSplat.width = splat.width;
     uSplat.smoothness = splat.smoothness;
-    if (res.ui.brushTip == BrushTip::Round) {
-      auto dim =
-          res.ui.brushTipTextures[res.ui.selectedBrushTip].tex.info.dimensions;
-      uSplat.transform =
-          getSplatTransform((unsigned)dim.x, (unsigned)dim.y, splat);
-    } else
-      uSplat.transform = getSplatTransform((unsigned)splat.width,
-                                           (unsigned)splat.width, splat);
-
-    if (res.ui.brushTip == BrushTip::Round)
-      ag::draw(res.device, texStrokeMask,
-               res.pipelines.ppDrawRoundSplatToStrokeMask,
-               ag::DrawArrays(ag::PrimitiveType::Triangles, res.vboQuad),
-               glm::vec2{res.canvas.width, res.canvas.height}, uSplat);
-    else if (res.ui.brushTip == BrushTip::Textured)
-      ag::draw(res.device, texStrokeMask,
-               res.pipelines.ppDrawTexturedSplatToStrokeMask,
-               ag::DrawArrays(ag::PrimitiveType::Triangles, res.vboQuad),
-               ag::TextureUnit(
-                   0, res.ui.brushTipTextures[res.ui.selectedBrushTip].tex,
-                   res.samLinearClamp),
-               glm::vec2{res.canvas.width, res.canvas.height}, uSplat);
+    auto dim = res.ui.brushTipAtlas.tipSizes[res.ui.selectedBrushTip];
+    uSplat.transform =
+        getSplatTransform((unsigned)dim.x, (unsigned)dim.y, splat);
+    auto footprint = getSplatFootprint((unsigned)dim.x, (unsigned)dim.y, splat);
+    strokeBounds =
+        clipRect(unionRect(strokeBounds, footprint), res.canvas.width,
+                 res.canvas.height);
+    // the base color under the stroke is paged in when the stroke is
+    // flattened: read the paged out tiles in the meantime
+    auto target = getLayerTarget();
+    prefetchAlongStroke(target ? *target : res.canvas.baseColorUV, footprint,
+                        lastSplatCenter ? splat.center - *lastSplatCenter
+                                        : glm::vec2{0.0f, 0.0f});
+    lastSplatCenter = splat.center;
+
+    // all tips are in the same texture: only the UV rect changes between
+    // splats
+    uSplat.tipUVRect = res.ui.brushTipAtlas.uvRects[res.ui.selectedBrushTip];
+    ag::draw(res.device, texStrokeMask,
+             res.pipelines.ppDrawTexturedSplatToStrokeMask,
+             ag::DrawArrays(ag::PrimitiveType::Triangles, res.vboQuad),
+             ag::TextureUnit(0, res.ui.brushTipAtlas.atlas,
+                             res.ui.brushTipAtlas.sampler),
+             glm::vec2{res.canvas.width, res.canvas.height}, uSplat);
   }
 
 private:
@@ -174,6 +298,13 @@ private:
   BrushProperties brushProps;
   BrushPath brushPath;
   Texture2D<ag::RGBA8> texStrokeMask;
+  // pixels touched by the current (or last) stroke, clipped to the canvas
+  ag::Box2D strokeBounds{0, 0, 0, 0};
+  // segments of the stroke not rasterized yet, and their footprints
+  std::vector<StrokeSegment> pendingSegments;
+  DirtyRegion pendingRegion;
+  // center of the previous splat of the stroke
+  std::experimental::optional<glm::vec2> lastSplatCenter;
 };
 
 #endif // !BRUSH_TOOL_HPP
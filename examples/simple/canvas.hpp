@@ -1,7 +1,14 @@
 #ifndef CANVAS_HPP
 #define CANVAS_HPP
 
+#include <memory>
+#include <vector>
+
+#include "dirty_region.hpp"
+#include "layer.hpp"
+#include "tiled_layer.hpp"
 #include "types.hpp"
+#include "undo_history.hpp"
 
 // NOTE for future reference.
 // Do not put constants as static const data members of a class,
@@ -18,12 +25,29 @@
 
 // value must match the one defined in shaders
 constexpr unsigned kShadingCurveSamplesSize = 256;
+// channels of the shading curve histogram (H, S, V sums and count), must
+// match glsl/shading_curve.glsl
+constexpr unsigned kShadingHistogramChannels = 4;
+// strokes added incrementally to the shading curve histogram before it is
+// recomputed from the whole canvas
+constexpr unsigned kShadingHistogramRebuildInterval = 64;
 // lit sphere resolution
 // constexpr unsigned kLitSphereWidth = 512;
 // constexpr unsigned kLitSphereHeight = 512;
 constexpr unsigned kCSThreadGroupSizeX = 16;
 constexpr unsigned kCSThreadGroupSizeY = 16;
 constexpr unsigned kCSThreadGroupSizeZ = 1;
+// uniform slot of the dispatch region, must match glsl/region.glsl
+constexpr unsigned kRegionUniformSlot = 7;
+// max radius of the blur pass of the evaluator, in pixels
+constexpr unsigned kEvalBlurMargin = 30;
+// tiles of each UV layer kept in GPU memory (64 MB), the least recently used
+// tiles over this budget are paged out to disk
+constexpr unsigned kTileResidencyBudget = 256;
+// tiles of the canvas processed per frame by the passes over the whole
+// canvas (histogram rebuild, evaluation of the layer stack), so that they
+// stay within the residency budget
+constexpr unsigned kTileBatchSize = kTileResidencyBudget / 4;
 
 //class Layer;
 
@@ -32,19 +56,15 @@ constexpr unsigned kCSThreadGroupSizeZ = 1;
 struct Canvas {
 
   Canvas(Device& device, unsigned width_, unsigned height_)
-      : width(width_), height(height_) {
-
-    texHistH = device.createTexture1D<ag::R32UI>(kShadingCurveSamplesSize);
-    texHistS = device.createTexture1D<ag::R32UI>(kShadingCurveSamplesSize);
-    texHistV = device.createTexture1D<ag::R32UI>(kShadingCurveSamplesSize);
-    texHistAccum = device.createTexture1D<ag::R32UI>(kShadingCurveSamplesSize);
-
-    /*ag::clear(device, texHistH, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
-    ag::clear(device, texHistS, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
-    ag::clear(device, texHistV,
-              ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
-    ag::clear(device, texHistAccum,
-              ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});*/
+      : width(width_), height(height_), dirty(width_, height_),
+        baseColorUV(device, width_, height_),
+        blurParametersUV(device, width_, height_),
+        hsvOffsetUV(device, width_, height_), history(device),
+        shadingHistogram(device, kShadingCurveSamplesSize,
+                         kShadingHistogramChannels,
+                         ag::divRoundUp((int)width_, (int)kCSThreadGroupSizeX) *
+                             ag::divRoundUp((int)height_,
+                                            (int)kCSThreadGroupSizeY)) {
 
     texDepth = device.createTexture2D<ag::Depth32>(glm::uvec2{width, height});
     texNormals =
@@ -54,17 +74,15 @@ struct Canvas {
 
     texShadingProfileLN =
         device.createTexture1D<ag::RGBA8>(kShadingCurveSamplesSize);
+    shadingProfileChanged = RawBuffer(
+        sizeof(uint32_t), device.backend.createBuffer(
+                              sizeof(uint32_t), nullptr,
+                              ag::BufferUsage::Default));
+    ag::clear(device, shadingProfileChanged);
     texBlurParametersLN =
         device.createTexture1D<ag::RGBA8>(kShadingCurveSamplesSize);
     texDetailMaskLN = device.createTexture1D<ag::RGBA8>(kShadingCurveSamplesSize);
 
-    texBaseColorUV =
-        device.createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
-    texHSVOffsetUV =
-        device.createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
-    texBlurParametersUV =
-        device.createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
-
     texShadingTerm =
         device.createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
     texShadingTermSmooth =
@@ -72,17 +90,37 @@ struct Canvas {
     texShadingTermSmooth0 =
         device.createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
 
-    ag::clear(device, texBaseColorUV, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
-    ag::clear(device, texHSVOffsetUV, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
-    ag::clear(device, texBlurParametersUV,
-              ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
     ag::clear(device, texBlurParametersLN,
               ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
+    // nothing evaluated yet
+    dirty.addAll();
+
+    baseColorUV.setResidencyBudget(kTileResidencyBudget);
+    blurParametersUV.setResidencyBudget(kTileResidencyBudget);
+    hsvOffsetUV.setResidencyBudget(kTileResidencyBudget);
+  }
+
+  // once per frame: tile paging of the UV layers and of the layer stack
+  void updateLayers(Device& device) {
+    baseColorUV.update(device);
+    blurParametersUV.update(device);
+    hsvOffsetUV.update(device);
+    for (auto& layer : layers)
+      layer->update(device);
+  }
+
+  Layer* getActiveLayer() {
+    return activeLayer < layers.size() ? layers[activeLayer].get() : nullptr;
   }
 
   unsigned width;
   unsigned height;
 
+  // regions of the canvas state modified since they were last evaluated (by
+  // the layers that read it, see Layer::readsCanvas)
+  // (tools mark the parts of the canvas they modify)
+  DirtyRegion dirty;
+
   // rendered from geometry
   Texture2D<ag::Depth32> texDepth;
   Texture2D<ag::Unorm10x3_1x2> texNormals;
@@ -94,124 +132,95 @@ struct Canvas {
 
   Texture2D<ag::RGBA32F> texGradient;
 
-  //
-  Texture1D<ag::R32UI> texHistH;
-  Texture1D<ag::R32UI> texHistS;
-  Texture1D<ag::R32UI> texHistV;
-  Texture1D<ag::R32UI> texHistAccum;
-
   // L dot N space
   Texture1D<ag::RGBA8> texShadingProfileLN;
   Texture1D<ag::RGBA8> texBlurParametersLN;
   Texture1D<ag::RGBA8> texDetailMaskLN;
 
-  // UV (XY) space
-  Texture2D<ag::RGBA8> texBaseColorUV;
-  Texture2D<ag::RGBA8> texBlurParametersUV;
-  Texture2D<ag::RGBA8> texHSVOffsetUV;
+  // UV (XY) space, sparse: only the painted tiles use memory
+  TiledLayer baseColorUV;
+  TiledLayer blurParametersUV;
+  TiledLayer hsvOffsetUV;
   // TODO shading detail map?
+
+  // modifications of the UV layers
+  UndoHistory history;
+
+  // layer stack, bottom to top (see LayerCompositor)
+  std::vector<std::unique_ptr<Layer>> layers;
+  // layer edited by the tools
+  size_t activeLayer = 0;
+
+  // H, S, V sums and pixel count of each L dot N bin
+  GpuHistogram shadingHistogram;
+  // false if the base color was modified without updating the histogram
+  bool shadingHistogramValid = false;
+  // a rebuild of the histogram from the whole canvas is in progress (see
+  // updateShadingCurveRebuild)
+  bool shadingHistogramRebuilding = false;
+  // tiles of baseColorUV not accumulated yet by the rebuild
+  std::vector<unsigned> shadingHistogramRebuildQueue;
+  // tiles of baseColorUV accumulated by the rebuild
+  std::vector<char> shadingHistogramTileDone;
+  // light direction of the histogram
+  glm::vec3 shadingHistogramLight{0.0f};
+  // incremental updates since the histogram was computed from the whole
+  // canvas
+  unsigned shadingHistogramUpdates = 0;
+  // nonzero if texShadingProfileLN changed since the last readback (see
+  // pollShadingProfileChanges)
+  RawBuffer shadingProfileChanged;
+  RawBuffer shadingProfileChangedReadback;
+  const uint32_t* shadingProfileChangedData = nullptr;
+  bool shadingProfileReadbackPending = false;
+  // expires with the canvas, checked by the frame completion callbacks
+  std::shared_ptr<bool> alive = std::make_shared<bool>(true);
 };
 
 
-// Invoke the 'evaluate' CS
+// Origin and size of the rectangle processed by a dispatch
+struct RegionUniforms {
+  glm::ivec2 origin;
+  glm::ivec2 size;
+};
+
+// Invoke a CS once for each rectangle of `rects` (in pixels).
+// The CS gets the rectangle in the uniform block of glsl/region.glsl.
+template <typename... Resources>
+void computeOverRects(Device& device, ComputePipeline& pipeline,
+                      const std::vector<ag::Box2D>& rects,
+                      Resources&&... resources) {
+  for (const auto& rect : rects) {
+    RegionUniforms region{glm::ivec2{(int)rect.xmin, (int)rect.ymin},
+                          glm::ivec2{(int)rect.width(), (int)rect.height()}};
+    ag::compute(device, pipeline,
+                ag::makeThreadGroupCount2D(rect.width(), rect.height(),
+                                           kCSThreadGroupSizeX,
+                                           kCSThreadGroupSizeY),
+                resources..., ag::Uniform(kRegionUniformSlot, region));
+  }
+}
+
+// Invoke the 'evaluate' CS over `rects`
 template <typename... Resources>
 void previewCanvas(Device& device, Canvas& canvas, Texture2D<ag::RGBA8>& out,
-                   ComputePipeline& pipeline, RawBufferSlice& canvasData, Sampler& sampler,
+                   ComputePipeline& pipeline,
+                   const std::vector<ag::Box2D>& rects,
+                   RawBufferSlice& canvasData, Sampler& sampler,
                    Resources&&... resources) {
-  ag::compute(
-      device, pipeline,
-	  ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
-      canvasData,
+  computeOverRects(
+      device, pipeline, rects, canvasData,
       ag::TextureUnit(0, canvas.texShadingProfileLN, sampler),
       ag::TextureUnit(1, canvas.texBlurParametersLN, sampler),
       ag::TextureUnit(2, canvas.texDetailMaskLN, sampler),
-      ag::TextureUnit(3, canvas.texBaseColorUV, sampler),
-      ag::TextureUnit(4, canvas.texHSVOffsetUV, sampler),
-      ag::TextureUnit(5, canvas.texBlurParametersUV, sampler),
       ag::TextureUnit(6, canvas.texShadingTermSmooth, sampler),
       ag::TextureUnit(7, canvas.texStencil, sampler),
       ag::TextureUnit(8, canvas.texGradient, sampler),
-      ag::RWTextureUnit(0, out), std::forward<Resources>(resources)...);
-}
-
-/////////////////////////////////
-// Layers
-/*struct SpecialLayers
-{
-    Texture2D<ag::R8>& texStencil;
-    Texture2D<ag::R32F>& texShadingTerm;
-    Texture2D<ag::R32F>& texShadingTermSmooth;
-    Texture2D<ag::Depth32>& texDepth;
-    Texture2D<ag::Unorm10x3_1x2>& texNormals;
-};
-
-
-struct LayerContext {
-  Device& device;
-  int layerIndex; // index of the current layer in the layer stack
-  Texture2D<ag::RGBA8>& target;
-  ag::Box2D dirtyRect; // read/write
-  Camera& camera;
-  Canvas& canvas;
-  Pipelines& pipelines;
-};
-
-
-enum class LayerType {
-  // Shading curves
-  DynamicColor,
-  // Constant color
-  Constant,
-  // LdotN space blur
-  Blur,
-  // Detail layer
-  Detail,
-  ////////////// Special layers
-  // Global layer mask (editable)
-  Special_GlobalMask,
-  Special_LdotN,
-  Special_SmoothedLdotN,
-  Special_Gradient,
-  Special_Normals,
-  // also: occlusion, etc.
-};
-
-enum class LayerFlags {
-  None = 0,
-  ReadOnly = (1 << 0), // cannot be the target of brush operations
-  ProcessOnCPU = (1 << 1),
-  NonLocalProcess = (1 << 2)
-};
-
-struct Layer {
-  Layer(LayerType type_) : type(type_) {}
-
-  virtual ~Layer() {}
-
-  virtual void draw(LayerContext& context) = 0;
-
-  LayerType type;
-  LayerFlags flags = LayerFlags::None;
-};
-
-template <LayerType Type> struct TLayer : public Layer {
-  TLayer() : Layer(Type) {}
-};
-
-// apply a CS over a region of the canvas
-template <typename... Resources>
-void applyComputeShaderOverRect(Device& device, Canvas& canvas, const ag::Box2D& rect,
-                                ComputePipeline& pipeline,
-                                RawBufferSlice& canvasData,
-                                Resources&&... resources) {
-  ag::compute(device, pipeline,
-              ag::ThreadGroupCount{
-                  (unsigned)divRoundUp(rect.width(), kCSThreadGroupSizeX),
-                  (unsigned)divRoundUp(rect.height(), kCSThreadGroupSizeY),
-                  1u},
-              canvasData, std::forward<Resources>(resources)...);
+      ag::RWTextureUnit(0, out),
+      ag::RWTextureUnit(2, canvas.hsvOffsetUV.tiles),
+      ag::RWTextureUnit(3, canvas.hsvOffsetUV.pageTable),
+      std::forward<Resources>(resources)...);
 }
 
-*/
 
 #endif
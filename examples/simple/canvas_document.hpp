@@ -0,0 +1,607 @@
+#ifndef CANVAS_DOCUMENT_HPP
+#define CANVAS_DOCUMENT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <autograph/error.hpp>
+
+#include "../common/lz_codec.hpp"
+#include "canvas.hpp"
+#include "layers/blur_layer.hpp"
+#include "layers/color_layer.hpp"
+
+// Canvas document file.
+// Layout: CanvasDocumentHeader, the parameter maps in L dot N space
+// (kDocumentParamMapCount maps of kShadingCurveSamplesSize RGBA8 texels), the
+// layer stack (DocumentLayerEntry, bottom to top), the tile index
+// (DocumentTileEntry, layerCount * tilesX * tilesY entries, layer by layer),
+// then the tiles, each compressed separately with lzCompress. Tiles can thus
+// be loaded individually, in any order.
+// The tiled layers in the index are the kDocumentCanvasLayerCount layers of
+// the canvas, then the tiled layers of the layer stack in order (see
+// getDocumentLayers).
+// The header and the index are written last: a file with a wrong magic
+// number was not saved completely.
+constexpr uint32_t kCanvasDocumentMagic = 0x44434741; // "AGCD"
+// 2: layer stack
+constexpr uint32_t kCanvasDocumentVersion = 2;
+// baseColorUV, blurParametersUV, hsvOffsetUV
+constexpr unsigned kDocumentCanvasLayerCount = 3;
+// texBlurParametersLN, texDetailMaskLN
+constexpr unsigned kDocumentParamMapCount = 2;
+constexpr size_t kDocumentParamMapBytes = kShadingCurveSamplesSize * 4;
+constexpr size_t kDocumentLayerNameSize = 32;
+
+struct CanvasDocumentHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tileSize;
+  // tiled layers in the index
+  uint32_t layerCount;
+  uint32_t tilesX;
+  uint32_t tilesY;
+  // layers in the layer stack
+  uint32_t stackSize;
+  uint32_t padding;
+  // byte offsets from the start of the file
+  uint64_t paramMapsOffset;
+  uint64_t stackOffset;
+  uint64_t indexOffset;
+};
+
+// DocumentLayerEntry::flags
+constexpr uint32_t kDocumentLayerVisible = 1;
+constexpr uint32_t kDocumentLayerHasMask = 2;
+
+struct DocumentLayerEntry {
+  // LayerType
+  uint32_t type;
+  // LayerBlendMode
+  uint32_t blendMode;
+  float opacity;
+  uint32_t flags;
+  // null-terminated
+  char name[kDocumentLayerNameSize];
+};
+
+struct DocumentTileEntry {
+  // byte offset of the compressed tile, 0 if the tile is not allocated
+  uint64_t offset;
+  uint32_t size;
+  // checksumDocumentTile of the compressed data
+  uint32_t checksum;
+};
+
+// 32-bit FNV-1a hash
+inline uint32_t checksumDocumentTile(const uint8_t* data, size_t size) {
+  uint32_t hash = 0x811C9DC5u;
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ data[i]) * 0x01000193u;
+  return hash;
+}
+
+// The tiled layers saved in a document: the layers of the canvas, then for
+// each layer of the stack, the colors of color layers and the mask.
+inline std::vector<TiledLayer*> getDocumentLayers(Canvas& canvas) {
+  std::vector<TiledLayer*> tiledLayers{
+      &canvas.baseColorUV, &canvas.blurParametersUV, &canvas.hsvOffsetUV};
+  for (auto& layer : canvas.layers) {
+    if (layer->type == LayerType::Constant)
+      tiledLayers.push_back(&static_cast<ColorLayer&>(*layer).colors);
+    if (layer->mask)
+      tiledLayers.push_back(layer->mask.get());
+  }
+  return tiledLayers;
+}
+
+inline std::unique_ptr<Layer> createDocumentLayer(Device& device,
+                                                  LayerType type,
+                                                  unsigned width,
+                                                  unsigned height) {
+  switch (type) {
+  case LayerType::DynamicColor:
+    return std::make_unique<DynamicColorLayer>(device, width, height);
+  case LayerType::Constant:
+    return std::make_unique<ColorLayer>(device, width, height);
+  default:
+    return std::make_unique<BlurLayer>(device, width, height);
+  }
+}
+
+// number of tiles compressed or decompressed at once by worker threads
+inline unsigned getDocumentWorkerCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// fseek with 64-bit offsets (long is 32-bit on windows), returns true on
+// success
+inline bool seekDocument(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+  return _fseeki64(file, (int64_t)offset, SEEK_SET) == 0;
+#else
+  return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+///////////////////////////////////////
+// CanvasDocumentWriter
+// Saves a canvas in the background.
+// All resident tiles are read back in the frame where the writer is created
+// (so the saved document is the canvas at that frame), then compressed by
+// worker threads and appended to the file as they complete, over the next
+// frames. The file is written under a temporary name and renamed when
+// complete.
+class CanvasDocumentWriter {
+public:
+  CanvasDocumentWriter(Device& device, Canvas& canvas, std::string path_)
+      : path(std::move(path_)), tmpPath(path + ".tmp"),
+        alive(std::make_shared<bool>(true)) {
+    memset(&header, 0, sizeof(header));
+    header.version = kCanvasDocumentVersion;
+    header.width = canvas.width;
+    header.height = canvas.height;
+    header.tileSize = kCanvasTileSize;
+    auto tiledLayers = getDocumentLayers(canvas);
+    header.layerCount = (uint32_t)tiledLayers.size();
+    header.tilesX = canvas.baseColorUV.tilesX;
+    header.tilesY = canvas.baseColorUV.tilesY;
+    header.stackSize = (uint32_t)canvas.layers.size();
+    header.paramMapsOffset = sizeof(CanvasDocumentHeader);
+    header.stackOffset =
+        header.paramMapsOffset + kDocumentParamMapCount * kDocumentParamMapBytes;
+    header.indexOffset =
+        header.stackOffset + header.stackSize * sizeof(DocumentLayerEntry);
+    unsigned tilesPerLayer = header.tilesX * header.tilesY;
+    index.resize(tiledLayers.size() * tilesPerLayer);
+    memset(index.data(), 0, index.size() * sizeof(DocumentTileEntry));
+    fileEnd = header.indexOffset + index.size() * sizeof(DocumentTileEntry);
+
+    file = fopen(tmpPath.c_str(), "wb");
+    if (!file)
+      ag::failWith("Could not open " + tmpPath + " for writing");
+    // header and index are written at the end
+    std::vector<char> placeholder(fileEnd, 0);
+    ok = fwrite(placeholder.data(), 1, placeholder.size(), file) ==
+         placeholder.size();
+    std::vector<DocumentLayerEntry> stack(canvas.layers.size());
+    memset(stack.data(), 0, stack.size() * sizeof(DocumentLayerEntry));
+    for (size_t i = 0; i < stack.size(); ++i) {
+      const auto& layer = *canvas.layers[i];
+      stack[i].type = (uint32_t)layer.type;
+      stack[i].blendMode = (uint32_t)layer.blendMode;
+      stack[i].opacity = layer.opacity;
+      stack[i].flags = (layer.visible ? kDocumentLayerVisible : 0) |
+                       (layer.mask ? kDocumentLayerHasMask : 0);
+      strncpy(stack[i].name, layer.name.c_str(), kDocumentLayerNameSize - 1);
+    }
+    ok = ok && seekDocument(file, header.stackOffset) &&
+         fwrite(stack.data(), sizeof(DocumentLayerEntry), stack.size(),
+                file) == stack.size() &&
+         seekDocument(file, fileEnd);
+
+    // tiles not in GPU memory are read now, the others are read back
+    unsigned residentCount = 0;
+    for (unsigned l = 0; l < tiledLayers.size(); ++l) {
+      auto& layer = *tiledLayers[l];
+      for (unsigned tile = 0; tile < tilesPerLayer; ++tile) {
+        if (!layer.isTileAllocated(tile))
+          continue;
+        Job job{l * tilesPerLayer + tile};
+        if (layer.isTileResident(tile))
+          job.readbackOffset = (residentCount++) * kCanvasTileBytes;
+        else {
+          job.pixels.resize(kCanvasTileBytes);
+          layer.readNonResidentTile(tile, job.pixels.data());
+        }
+        jobs.push_back(std::move(job));
+      }
+    }
+
+    size_t paramMapsOffset = residentCount * kCanvasTileBytes;
+    readbackBuffer = device.createReadbackBuffer(
+        paramMapsOffset + kDocumentParamMapCount * kDocumentParamMapBytes);
+    readbackData = (const uint8_t*)device.mapReadbackBuffer(readbackBuffer);
+    for (const auto& job : jobs) {
+      if (!job.pixels.empty())
+        continue;
+      auto& layer = *tiledLayers[job.entry / tilesPerLayer];
+      layer.readbackTile(device, job.entry % tilesPerLayer,
+                         readbackBuffer, job.readbackOffset);
+    }
+    Texture1D<ag::RGBA8>* paramMaps[kDocumentParamMapCount] = {
+        &canvas.texBlurParametersLN, &canvas.texDetailMaskLN};
+    for (unsigned i = 0; i < kDocumentParamMapCount; ++i) {
+      RawBufferSlice dest{readbackBuffer.handle.get(),
+                          paramMapsOffset + i * kDocumentParamMapBytes,
+                          kDocumentParamMapBytes};
+      ag::copy(device, *paramMaps[i], dest,
+               ag::Box1D{0, kShadingCurveSamplesSize});
+    }
+    std::weak_ptr<bool> weakAlive = alive;
+    device.onFrameComplete([this, weakAlive]() {
+      if (weakAlive.lock())
+        readbackComplete = true;
+    });
+  }
+
+  ~CanvasDocumentWriter() {
+    inFlight.clear();
+    if (file) {
+      fclose(file);
+      remove(tmpPath.c_str());
+    }
+  }
+
+  CanvasDocumentWriter(const CanvasDocumentWriter&) = delete;
+  CanvasDocumentWriter& operator=(const CanvasDocumentWriter&) = delete;
+
+  // Call once per frame: writes the compressed tiles and starts compressing
+  // more. Returns true when the document has been written (or has failed, see
+  // succeeded).
+  bool update() {
+    if (!file)
+      return true;
+    if (!readbackComplete)
+      return false;
+    if (!paramMapsWritten) {
+      auto paramMaps = readbackData + (readbackBuffer.byteSize -
+                                       kDocumentParamMapCount *
+                                           kDocumentParamMapBytes);
+      ok = ok && seekDocument(file, header.paramMapsOffset) &&
+           fwrite(paramMaps, kDocumentParamMapBytes, kDocumentParamMapCount,
+                  file) == kDocumentParamMapCount &&
+           seekDocument(file, fileEnd);
+      paramMapsWritten = true;
+    }
+    // completed tiles, in order
+    while (!inFlight.empty() &&
+           inFlight.front().second.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready) {
+      auto entry = inFlight.front().first;
+      auto data = inFlight.front().second.get();
+      inFlight.pop_front();
+      index[entry].offset = fileEnd;
+      index[entry].size = (uint32_t)data.size();
+      index[entry].checksum = checksumDocumentTile(data.data(), data.size());
+      ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+      fileEnd += data.size();
+    }
+    while (nextJob < jobs.size() && inFlight.size() < getDocumentWorkerCount()) {
+      auto& job = jobs[nextJob++];
+      const uint8_t* pixels = job.pixels.empty()
+                                  ? readbackData + job.readbackOffset
+                                  : (const uint8_t*)job.pixels.data();
+      inFlight.emplace_back(job.entry, std::async(std::launch::async, [pixels]() {
+                              return samples::lzCompress(pixels,
+                                                         kCanvasTileBytes);
+                            }));
+    }
+    if (!inFlight.empty() || nextJob < jobs.size())
+      return false;
+    finish();
+    return true;
+  }
+
+  bool succeeded() const { return ok; }
+
+private:
+  struct Job {
+    // entry in the tile index
+    unsigned entry;
+    // pixels of non-resident tiles
+    std::vector<char> pixels;
+    // offset in the readback buffer of resident tiles
+    size_t readbackOffset = 0;
+  };
+
+  // writes the header and the index, and renames the file
+  void finish() {
+    header.magic = kCanvasDocumentMagic;
+    ok = ok && seekDocument(file, header.indexOffset) &&
+         fwrite(index.data(), sizeof(DocumentTileEntry), index.size(), file) ==
+             index.size() &&
+         seekDocument(file, 0) &&
+         fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    if (ok) {
+      // rename does not replace an existing file on windows
+      remove(path.c_str());
+      ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+    if (!ok)
+      remove(tmpPath.c_str());
+  }
+
+  std::string path;
+  std::string tmpPath;
+  FILE* file = nullptr;
+  bool ok = false;
+  CanvasDocumentHeader header;
+  std::vector<DocumentTileEntry> index;
+  // where the next tile is written
+  uint64_t fileEnd;
+  RawBuffer readbackBuffer;
+  const uint8_t* readbackData = nullptr;
+  bool readbackComplete = false;
+  bool paramMapsWritten = false;
+  std::vector<Job> jobs;
+  size_t nextJob = 0;
+  // (entry, compressed tile), read the readback buffer and jobs
+  std::deque<std::pair<unsigned, std::future<std::vector<uint8_t>>>> inFlight;
+  // expires with the writer, checked by the readback callback
+  std::shared_ptr<bool> alive;
+};
+
+///////////////////////////////////////
+// CanvasDocumentFile
+// A document mapped in memory (read-only). Opening a document only reads the
+// header and the index.
+class CanvasDocumentFile {
+public:
+  // Returns false if the file does not exist or is not a valid document.
+  bool open(const std::string& path) {
+    namespace bip = boost::interprocess;
+    try {
+      file = bip::file_mapping{path.c_str(), bip::read_only};
+      region = bip::mapped_region{file, bip::read_only};
+    } catch (bip::interprocess_exception&) {
+      return false;
+    }
+    size = region.get_size();
+    if (size < sizeof(CanvasDocumentHeader))
+      return false;
+    header = *(const CanvasDocumentHeader*)region.get_address();
+    if (header.magic != kCanvasDocumentMagic ||
+        header.version != kCanvasDocumentVersion ||
+        header.tileSize != kCanvasTileSize ||
+        header.stackSize == 0 ||
+        header.layerCount < kDocumentCanvasLayerCount ||
+        header.layerCount - kDocumentCanvasLayerCount > 2 * header.stackSize ||
+        header.tilesX != (header.width + kCanvasTileSize - 1) / kCanvasTileSize ||
+        header.tilesY !=
+            (header.height + kCanvasTileSize - 1) / kCanvasTileSize)
+      return false;
+    uint64_t entryCount =
+        (uint64_t)header.layerCount * header.tilesX * header.tilesY;
+    // bounds check, with care for overflows in corrupt files
+    if (header.paramMapsOffset > size ||
+        size - header.paramMapsOffset <
+            kDocumentParamMapCount * kDocumentParamMapBytes ||
+        header.stackOffset > size ||
+        header.stackSize >
+            (size - header.stackOffset) / sizeof(DocumentLayerEntry) ||
+        header.indexOffset > size ||
+        entryCount > (size - header.indexOffset) / sizeof(DocumentTileEntry))
+      return false;
+    stack = (const DocumentLayerEntry*)(getData() + header.stackOffset);
+    for (uint32_t i = 0; i < header.stackSize; ++i)
+      if (stack[i].type > (uint32_t)LayerType::Blur ||
+          stack[i].blendMode > (uint32_t)LayerBlendMode::Replace ||
+          stack[i].name[kDocumentLayerNameSize - 1] != 0)
+        return false;
+    index = (const DocumentTileEntry*)(getData() + header.indexOffset);
+    for (uint64_t i = 0; i < entryCount; ++i)
+      if (index[i].offset > size || index[i].size > size - index[i].offset)
+        return false;
+    return true;
+  }
+
+  const CanvasDocumentHeader& getHeader() const { return header; }
+
+  const DocumentLayerEntry& getLayerEntry(unsigned layer) const {
+    return stack[layer];
+  }
+
+  const DocumentTileEntry& getTileEntry(unsigned layer, unsigned tile) const {
+    return index[layer * header.tilesX * header.tilesY + tile];
+  }
+
+  const uint8_t* getParamMap(unsigned i) const {
+    return getData() + header.paramMapsOffset + i * kDocumentParamMapBytes;
+  }
+
+  // Decompresses a tile to `pixels` (kCanvasTileBytes). Returns false if
+  // the tile is corrupt.
+  bool readTile(unsigned layer, unsigned tile, void* pixels) const {
+    const auto& entry = getTileEntry(layer, tile);
+    auto data = getData() + entry.offset;
+    return checksumDocumentTile(data, entry.size) == entry.checksum &&
+           samples::lzDecompress(data, entry.size, (uint8_t*)pixels,
+                                 kCanvasTileBytes);
+  }
+
+private:
+  const uint8_t* getData() const {
+    return (const uint8_t*)region.get_address();
+  }
+
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+  size_t size = 0;
+  CanvasDocumentHeader header;
+  const DocumentLayerEntry* stack = nullptr;
+  const DocumentTileEntry* index = nullptr;
+};
+
+///////////////////////////////////////
+// CanvasDocumentLoader
+// Loads a document into a canvas of the same size. The layer stack of the
+// canvas is replaced by the one of the document.
+// The tiles overlapping `viewport` are loaded immediately, the others are
+// pending in the layers of the canvas: they are decompressed by worker
+// threads and uploaded by update, or loaded on demand if the canvas uses them
+// before. The regions of the canvas are marked dirty as they are loaded: the
+// canvas shows its previous contents elsewhere until then.
+class CanvasDocumentLoader {
+public:
+  CanvasDocumentLoader(Device& device, Canvas& canvas_,
+                       std::shared_ptr<const CanvasDocumentFile> document_,
+                       const ag::Box2D& viewport)
+      : canvas(canvas_), document(std::move(document_)) {
+    const auto& header = document->getHeader();
+    if (header.width != canvas.width || header.height != canvas.height)
+      ag::failWith("Document size does not match the canvas");
+    unsigned layerCount = kDocumentCanvasLayerCount;
+    for (unsigned i = 0; i < header.stackSize; ++i) {
+      const auto& entry = document->getLayerEntry(i);
+      if (entry.type == (uint32_t)LayerType::Constant)
+        ++layerCount;
+      if (entry.flags & kDocumentLayerHasMask)
+        ++layerCount;
+    }
+    if (layerCount != header.layerCount)
+      ag::failWith("Layer stack does not match the tile index");
+    canvas.history.clear();
+    canvas.layers.clear();
+    for (unsigned i = 0; i < header.stackSize; ++i) {
+      const auto& entry = document->getLayerEntry(i);
+      auto layer = createDocumentLayer(device, (LayerType)entry.type,
+                                       canvas.width, canvas.height);
+      layer->name = entry.name;
+      layer->blendMode = (LayerBlendMode)entry.blendMode;
+      layer->opacity = entry.opacity;
+      layer->visible = (entry.flags & kDocumentLayerVisible) != 0;
+      if (entry.flags & kDocumentLayerHasMask)
+        layer->addMask(device);
+      // evaluated as the tiles are loaded (see markLoaded)
+      layer->dirty.clear();
+      canvas.layers.push_back(std::move(layer));
+    }
+    canvas.activeLayer = std::min(canvas.activeLayer, canvas.layers.size() - 1);
+    tiledLayers = getDocumentLayers(canvas);
+    ag::copy(device, gsl::span<const ag::RGBA8>(
+                         (const ag::RGBA8*)document->getParamMap(0),
+                         kShadingCurveSamplesSize),
+             canvas.texBlurParametersLN);
+    ag::copy(device, gsl::span<const ag::RGBA8>(
+                         (const ag::RGBA8*)document->getParamMap(1),
+                         kShadingCurveSamplesSize),
+             canvas.texDetailMaskLN);
+
+    std::vector<char> pixels(kCanvasTileBytes);
+    // tiles with no pixels in any layer of the document
+    std::vector<char> emptyTiles(header.tilesX * header.tilesY, true);
+    for (unsigned l = 0; l < tiledLayers.size(); ++l) {
+      auto& layer = *tiledLayers[l];
+      layer.freeAllTiles(device);
+      std::vector<char> inViewport(layer.tilesX * layer.tilesY, false);
+      for (auto tile : layer.getTiles(viewport)) {
+        inViewport[tile] = true;
+        if (!document->getTileEntry(l, tile).offset)
+          continue;
+        readTile(l, tile, pixels.data());
+        layer.restoreTile(device, tile, pixels.data());
+      }
+      std::vector<unsigned> pending;
+      for (unsigned tile = 0; tile < layer.tilesX * layer.tilesY; ++tile) {
+        if (!document->getTileEntry(l, tile).offset)
+          continue;
+        emptyTiles[tile] = false;
+        if (!inViewport[tile]) {
+          pending.push_back(tile);
+          queue.push_back(std::make_pair(l, tile));
+        }
+      }
+      auto doc = document;
+      layer.setPendingTiles(pending, [doc, l](unsigned tile, void* pixels) {
+        readTile(*doc, l, tile, pixels);
+      });
+    }
+    for (unsigned tile = 0; tile < emptyTiles.size(); ++tile)
+      if (emptyTiles[tile])
+        markLoaded(canvas.baseColorUV.getTileRect(tile));
+    markLoaded(viewport);
+  }
+
+  // Call once per frame: uploads the tiles decompressed in the background.
+  // Returns true when all tiles are loaded.
+  bool update(Device& device) {
+    while (!inFlight.empty() &&
+           inFlight.front().future.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready) {
+      auto& t = inFlight.front();
+      auto pixels = t.future.get();
+      auto& layer = *tiledLayers[t.layer];
+      // not loaded on demand in the meantime
+      if (layer.isTilePending(t.tile))
+        layer.restoreTile(device, t.tile, pixels.data());
+      markLoaded(layer.getTileRect(t.tile));
+      inFlight.pop_front();
+    }
+    while (!queue.empty() && inFlight.size() < getDocumentWorkerCount()) {
+      auto l = queue.front().first;
+      auto tile = queue.front().second;
+      queue.pop_front();
+      auto& layer = *tiledLayers[l];
+      if (!layer.isTilePending(tile)) {
+        // loaded on demand
+        markLoaded(layer.getTileRect(tile));
+        continue;
+      }
+      auto doc = document;
+      inFlight.push_back(
+          InFlightTile{l, tile, std::async(std::launch::async, [doc, l, tile]() {
+                         std::vector<char> pixels(kCanvasTileBytes);
+                         readTile(*doc, l, tile, pixels.data());
+                         return pixels;
+                       })});
+    }
+    return queue.empty() && inFlight.empty();
+  }
+
+private:
+  struct InFlightTile {
+    unsigned layer;
+    unsigned tile;
+    std::future<std::vector<char>> future;
+  };
+
+  // corrupt tiles are loaded as transparent black
+  static void readTile(const CanvasDocumentFile& doc, unsigned layer,
+                       unsigned tile, void* pixels) {
+    if (!doc.readTile(layer, tile, pixels)) {
+      std::clog << "Corrupt tile " << tile << " in layer " << layer
+                << " of the document\n";
+      memset(pixels, 0, kCanvasTileBytes);
+    }
+  }
+
+  void readTile(unsigned layer, unsigned tile, void* pixels) {
+    readTile(*document, layer, tile, pixels);
+  }
+
+  // The layers of the stack are new: all of them are evaluated over the
+  // regions of the document that are loaded.
+  void markLoaded(const ag::Box2D& rect) {
+    canvas.dirty.add(rect);
+    for (auto& layer : canvas.layers)
+      layer->dirty.add(rect);
+  }
+
+  Canvas& canvas;
+  std::shared_ptr<const CanvasDocumentFile> document;
+  // see getDocumentLayers
+  std::vector<TiledLayer*> tiledLayers;
+  // (layer, tile) not loaded yet
+  std::deque<std::pair<unsigned, unsigned>> queue;
+  std::deque<InFlightTile> inFlight;
+};
+
+#endif // !CANVAS_DOCUMENT_HPP
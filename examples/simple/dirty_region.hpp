@@ -0,0 +1,175 @@
+#ifndef DIRTY_REGION_HPP
+#define DIRTY_REGION_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <autograph/rect.hpp>
+
+// size of the tracked tiles, in pixels
+constexpr unsigned kDirtyTileSize = 64;
+
+inline bool isEmptyRect(const ag::Box2D& rect) {
+  return rect.xmax <= rect.xmin || rect.ymax <= rect.ymin;
+}
+
+// smallest rectangle containing a and b (empty rectangles are ignored)
+inline ag::Box2D unionRect(const ag::Box2D& a, const ag::Box2D& b) {
+  if (isEmptyRect(a))
+    return b;
+  if (isEmptyRect(b))
+    return a;
+  return ag::Box2D{std::min(a.xmin, b.xmin), std::min(a.ymin, b.ymin),
+                   std::max(a.xmax, b.xmax), std::max(a.ymax, b.ymax)};
+}
+
+// intersection of `rect` with the rectangle (0,0)-(width,height)
+inline ag::Box2D clipRect(const ag::Box2D& rect, unsigned width,
+                          unsigned height) {
+  return ag::Box2D{std::min(rect.xmin, width), std::min(rect.ymin, height),
+                   std::min(rect.xmax, width), std::min(rect.ymax, height)};
+}
+
+///////////////////////////////////////
+// DirtyRegion
+// Regions of an image modified since the last time they were processed,
+// tracked with a bitmap of square tiles.
+// The dirty tiles are merged into rectangles so that a pass over the dirty
+// region is a handful of dispatches.
+class DirtyRegion {
+public:
+  DirtyRegion(unsigned width_, unsigned height_,
+              unsigned tileSize_ = kDirtyTileSize)
+      : width(width_), height(height_), tileSize(tileSize_),
+        tilesX((width_ + tileSize_ - 1) / tileSize_),
+        tilesY((height_ + tileSize_ - 1) / tileSize_),
+        tiles(tilesX * tilesY, false) {}
+
+  // marks the tiles overlapping `rect` (in pixels, clipped to the image)
+  void add(const ag::Box2D& rect) {
+    auto xmax = std::min(rect.xmax, width);
+    auto ymax = std::min(rect.ymax, height);
+    if (rect.xmin >= xmax || rect.ymin >= ymax)
+      return;
+    for (auto ty = rect.ymin / tileSize; ty <= (ymax - 1) / tileSize; ++ty)
+      for (auto tx = rect.xmin / tileSize; tx <= (xmax - 1) / tileSize; ++tx)
+        tiles[ty * tilesX + tx] = true;
+    isEmpty = false;
+  }
+
+  void addAll() {
+    std::fill(tiles.begin(), tiles.end(), true);
+    isEmpty = tiles.empty();
+  }
+
+  void clear() {
+    std::fill(tiles.begin(), tiles.end(), false);
+    isEmpty = true;
+  }
+
+  bool empty() const { return isEmpty; }
+
+  // a copy of this region grown by `margin` pixels in all directions
+  // (for passes that read a neighborhood of each pixel)
+  DirtyRegion dilated(unsigned margin) const {
+    DirtyRegion out{width, height, tileSize};
+    if (isEmpty)
+      return out;
+    unsigned m = (margin + tileSize - 1) / tileSize;
+    for (unsigned ty = 0; ty < tilesY; ++ty)
+      for (unsigned tx = 0; tx < tilesX; ++tx) {
+        if (!tiles[ty * tilesX + tx])
+          continue;
+        for (auto y = ty > m ? ty - m : 0; y <= std::min(ty + m, tilesY - 1);
+             ++y)
+          for (auto x = tx > m ? tx - m : 0; x <= std::min(tx + m, tilesX - 1);
+               ++x)
+            out.tiles[y * tilesX + x] = true;
+      }
+    out.isEmpty = false;
+    return out;
+  }
+
+  // The dirty tiles merged into disjoint rectangles, in pixels (clipped to
+  // the image). Horizontal runs of tiles are merged with the run of the
+  // previous row when they have the same extent.
+  std::vector<ag::Box2D> getRects() const {
+    std::vector<ag::Box2D> rects;
+    if (isEmpty)
+      return rects;
+    // rectangles (in tiles) that can still grow downwards
+    std::vector<ag::Box2D> open, next;
+    for (unsigned ty = 0; ty < tilesY; ++ty) {
+      next.clear();
+      unsigned tx = 0;
+      while (tx < tilesX) {
+        if (!tiles[ty * tilesX + tx]) {
+          ++tx;
+          continue;
+        }
+        unsigned x0 = tx;
+        while (tx < tilesX && tiles[ty * tilesX + tx])
+          ++tx;
+        auto it = std::find_if(open.begin(), open.end(), [&](const auto& r) {
+          return r.xmin == x0 && r.xmax == tx;
+        });
+        if (it != open.end()) {
+          next.push_back(ag::Box2D{x0, it->ymin, tx, ty + 1});
+          open.erase(it);
+        } else
+          next.push_back(ag::Box2D{x0, ty, tx, ty + 1});
+      }
+      // the runs that did not continue on this row are done
+      for (const auto& r : open)
+        rects.push_back(tilesToPixels(r));
+      std::swap(open, next);
+    }
+    for (const auto& r : open)
+      rects.push_back(tilesToPixels(r));
+    return rects;
+  }
+
+  // Removes up to `maxTiles` dirty tiles from the region (row by row) and
+  // returns them, so that a pass over a large region can be split across
+  // frames.
+  DirtyRegion takeTiles(unsigned maxTiles) {
+    DirtyRegion out{width, height, tileSize};
+    if (isEmpty)
+      return out;
+    unsigned count = 0;
+    for (size_t i = 0; i < tiles.size() && count < maxTiles; ++i)
+      if (tiles[i]) {
+        tiles[i] = false;
+        out.tiles[i] = true;
+        ++count;
+      }
+    out.isEmpty = count == 0;
+    isEmpty = std::find(tiles.begin(), tiles.end(), true) == tiles.end();
+    return out;
+  }
+
+  // bounding rectangle of the dirty tiles, in pixels
+  ag::Box2D getBounds() const {
+    ag::Box2D bounds{0, 0, 0, 0};
+    for (const auto& r : getRects())
+      bounds = unionRect(bounds, r);
+    return bounds;
+  }
+
+private:
+  ag::Box2D tilesToPixels(const ag::Box2D& r) const {
+    return ag::Box2D{r.xmin * tileSize, r.ymin * tileSize,
+                     std::min(r.xmax * tileSize, width),
+                     std::min(r.ymax * tileSize, height)};
+  }
+
+  unsigned width;
+  unsigned height;
+  unsigned tileSize;
+  unsigned tilesX;
+  unsigned tilesY;
+  std::vector<bool> tiles;
+  bool isEmpty = true;
+};
+
+#endif // !DIRTY_REGION_HPP
@@ -4,26 +4,32 @@
 #include "canvas.glsl"
 #include "utils.glsl"
 #include "rgb_hsv.glsl"
+#include "region.glsl"
+#include "tiled_layer.glsl"
 
 layout(binding = 0) uniform U0 { Canvas canvas; };
 layout(binding = 1) uniform U1 { vec3 lightPos; };
 
 
 layout(binding = 0) uniform sampler1D mapShadingProfileLN;
-layout(binding = 1) uniform sampler2D mapBaseColorUV;
-layout(binding = 2) uniform sampler2D texShadingTermSmooth;
-layout(binding = 3) uniform sampler2D texMask;
+layout(binding = 1) uniform sampler2D texShadingTermSmooth;
+layout(binding = 2) uniform sampler2D texMask;
 
-layout(binding = 0, rgba8) writeonly uniform image2D mapHSVOffsetUV;
+// tiled layers
+layout(binding = 0, rgba8) writeonly uniform image2DArray mapHSVOffsetUV;
+layout(binding = 1, rgba8) readonly uniform image2DArray mapBaseColorUV;
+layout(binding = 2, r32ui) readonly uniform uimage2D pagesHSVOffsetUV;
+layout(binding = 3, r32ui) readonly uniform uimage2D pagesBaseColorUV;
 
 
 layout(local_size_x = 16, local_size_y = 16) in;
 
 void main() {
-  ivec2 texelCoords = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 texelCoords;
+  if (!getRegionTexel(texelCoords)) return;
   float ldotn = texelFetch(texShadingTermSmooth, texelCoords, 0).r;
   vec3 hsvcurve = texture(mapShadingProfileLN, ldotn).rgb;
-  vec4 ref = texelFetch(mapBaseColorUV, texelCoords, 0);
+  vec4 ref = TILED_LOAD(mapBaseColorUV, pagesBaseColorUV, texelCoords);
   vec3 offset = rgb2hsv(ref.rgb) - hsvcurve;
-  imageStore(mapHSVOffsetUV, texelCoords, vec4(offset / 2.0f + vec3(0.5f), ref.a)); 
+  TILED_STORE(mapHSVOffsetUV, pagesHSVOffsetUV, texelCoords, vec4(offset / 2.0f + vec3(0.5f), ref.a));
 }
@@ -7,6 +7,7 @@ struct BrushSplat
 	vec2 center;	// center (also contained in transform)
 	float width;
 	float smoothness;
+	vec4 tipUVRect;	// location of the tip in the atlas (offset, size)
 };
 
 //////////////// Round brush kernel
@@ -1,13 +1,13 @@
 #version 450
+/////////////// Splats of textured brush tips
+// (round tips are rasterized by stroke_mask.glsl)
 #include "brush.glsl"
 #include "canvas.glsl"
 
 layout(std140, binding = 1) uniform U1 { BrushSplat splat; };
 layout(std140, binding = 0) uniform U0 { Canvas canvas; };
 
-#ifdef TEXTURED
 layout(binding = 0) uniform sampler2D texBrushTip;
-#endif
 
 /////////////// VS
 #ifdef _VERTEX_
@@ -26,14 +26,9 @@ void main() {
 #ifdef _PIXEL_
 in vec2 fTexcoord;
 layout(location = 0) out vec4 color;
-in vec4 gl_FragCoord;
 void main() {
-  vec2 pos = gl_FragCoord.xy;
-#ifdef TEXTURED
-  float Sa = 1.0 - texture(texBrushTip, fTexcoord).r;
-#else
-  float Sa = roundBrushKernel(pos, splat.center, splat.width, splat.smoothness);
-#endif
+  vec2 uv = splat.tipUVRect.xy + fTexcoord * splat.tipUVRect.zw;
+  float Sa = 1.0 - texture(texBrushTip, uv).r;
   color = vec4(Sa);
 }
 #endif
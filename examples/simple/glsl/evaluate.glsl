@@ -4,6 +4,8 @@
 #include "canvas.glsl"
 #include "utils.glsl"
 #include "rgb_hsv.glsl"
+#include "region.glsl"
+#include "tiled_layer.glsl"
 
 /////////////// Uniforms
 layout(binding = 0) uniform U0 { Canvas canvas; };
@@ -20,13 +22,10 @@ layout(binding = 1) uniform sampler1D mapBlurParametersLN;
 // detail texture contrib
 layout(binding = 2) uniform sampler1D mapDetailMaskLN;
 
-/////////////// 2d/texcoord parameter maps
-// base color (albedo?)
-layout(binding = 3) uniform sampler2D mapBaseColorXY;
+/////////////// 2d/texcoord parameter maps (tiled layers)
 // HSV offset
-layout(binding = 4) uniform sampler2D mapHSVOffsetXY;
-// blur parameters
-layout(binding = 5) uniform sampler2D mapBlurParametersXY;
+layout(binding = 2, rgba8) readonly uniform image2DArray mapHSVOffsetXY;
+layout(binding = 3, r32ui) readonly uniform uimage2D pagesHSVOffsetXY;
 // other ideas
 // HSV warp map
 
@@ -64,8 +63,8 @@ float nrand(vec2 n) {
 
 /////////////////////////////////////////////
 void main() {
-  ivec2 texelCoords = ivec2(gl_GlobalInvocationID.xy);
-  texelCoords = clamp(texelCoords, ivec2(0,0), ivec2(canvas.size)-ivec2(1,1));
+  ivec2 texelCoords;
+  if (!getRegionTexel(texelCoords)) return;
   vec2 uv = vec2(texelCoords) / canvas.size;
 
   //vec4 D = imageLoad(imgTarget, texelCoords);
@@ -89,7 +88,7 @@ void main() {
 
   /////////////////////////////////////////////
   // shading offset
-  vec4 hsvoffset = texelFetch(mapHSVOffsetXY, texelCoords, 0);
+  vec4 hsvoffset = TILED_LOAD(mapHSVOffsetXY, pagesHSVOffsetXY, texelCoords);
   vec3 tmp = hsvcurve /* + (hsvoffset.rgb * 2.0f - 1.0f)*/;
   S = blend(S, vec4(hsv2rgb(tmp), 1.0));
 
@@ -124,7 +123,8 @@ float G(float x2y2, float sigma2)
 void main()
 {
   // 
-  ivec2 texelCoords = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 texelCoords;
+  if (!getRegionTexel(texelCoords)) return;
   vec2 uv = vec2(texelCoords) / canvas.size;
 
   /////////////////////////////////////////////
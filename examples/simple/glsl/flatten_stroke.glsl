@@ -3,6 +3,8 @@
 #include "brush.glsl"
 #include "canvas.glsl"
 #include "utils.glsl"
+#include "region.glsl"
+#include "tiled_layer.glsl"
 
 /////////////// Uniforms
 layout(binding = 0) uniform U0 { Canvas canvas; };
@@ -13,35 +15,39 @@ layout(binding = 1) uniform U1{vec4 brushColor; };
 /////////////// Stroke mask
 layout(binding = 0) uniform sampler2D texStrokeMask;
 
-/////////////// UV parameter maps
+/////////////// UV parameter maps (tiled layers)
 // base color (albedo?)
 #ifdef TOOL_BASE_COLOR_UV
-layout(binding = 0, rgba8) coherent uniform image2D mapBaseColorXY;
+layout(binding = 0, rgba8) coherent uniform image2DArray mapBaseColorXY;
+layout(binding = 1, r32ui) readonly uniform uimage2D pagesBaseColorXY;
 #endif
 
 // HSV offset
 #ifdef TOOL_HSV_OFFSET_UV
-layout(binding = 0, rgba8) coherent uniform image2D mapHSVOffsetXY;
+layout(binding = 0, rgba8) coherent uniform image2DArray mapHSVOffsetXY;
+layout(binding = 1, r32ui) readonly uniform uimage2D pagesHSVOffsetXY;
 #endif
 
 // blur parameters
 #ifdef TOOL_BLUR_UV
-layout(binding = 0, rgba8) coherent uniform image2D mapBlurParametersXY;
+layout(binding = 0, rgba8) coherent uniform image2DArray mapBlurParametersXY;
+layout(binding = 1, r32ui) readonly uniform uimage2D pagesBlurParametersXY;
 #endif
 
 layout(local_size_x = 16, local_size_y = 16) in;
 
 /////////////// CODE
 void main() {
-  ivec2 texelCoords = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 texelCoords;
+  if (!getRegionTexel(texelCoords)) return;
   vec2 uv = vec2(texelCoords) / canvas.size;
 #ifdef TOOL_BASE_COLOR_UV
   // brush: paint base color
   // Blend into base color map
-  vec4 D = imageLoad(mapBaseColorXY, texelCoords);
+  vec4 D = TILED_LOAD(mapBaseColorXY, pagesBaseColorXY, texelCoords);
   vec4 baseColor = brushColor;
   baseColor.a *= texture(texStrokeMask, uv).r;
-  imageStore(mapBaseColorXY, texelCoords, blend(baseColor, D));
+  TILED_STORE(mapBaseColorXY, pagesBaseColorXY, texelCoords, blend(baseColor, D));
   //imageStore(mapBaseColorXY, texelCoords, vec4(1.0f));
   memoryBarrierImage();
 #endif
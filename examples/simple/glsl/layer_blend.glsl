@@ -0,0 +1,77 @@
+#version 450
+/////////////// Layer compositor (see LayerCompositor)
+// Layer outputs have straight alpha, composites are premultiplied.
+// A layer with opacity k (opacity x mask) is combined with the composite B
+// of the layers below as
+//     result = c + (1 - a) * B
+// with c the premultiplied output of the layer times k, and a = c.a for
+// the 'over' blend mode, or a = k for the 'replace' blend mode.
+#include "region.glsl"
+#include "tiled_layer.glsl"
+
+layout(std140, binding = 0) uniform U0 {
+  float opacity;
+  int replace;
+};
+
+layout(binding = 0, rgba8) readonly uniform image2D imgLayer;
+// mask of the layer (tiled layer, the alpha hides the layer)
+layout(binding = 1, rgba8) readonly uniform image2DArray maskTiles;
+layout(binding = 2, r32ui) readonly uniform uimage2D maskPages;
+
+#ifdef BLEND_OVER
+// composite of the layers below the layer
+layout(binding = 3, rgba8) uniform image2D imgDest;
+#endif
+
+#ifdef BLEND_UNDER
+// composite of the layers above the layer: color and transmittance
+layout(binding = 3, rgba8) uniform image2D imgDest;
+layout(binding = 4, r8) uniform image2D imgDestTransmittance;
+#endif
+
+#ifdef BLEND_FINAL
+layout(binding = 3, rgba8) readonly uniform image2D imgBelow;
+layout(binding = 4, rgba8) readonly uniform image2D imgAbove;
+layout(binding = 5, r8) readonly uniform image2D imgAboveTransmittance;
+layout(binding = 6, rgba8) writeonly uniform image2D imgTarget;
+#endif
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+// contribution of the layer at `texel`
+vec4 layerColor(ivec2 texel, out float alpha)
+{
+  float k = opacity * (1.0 - TILED_LOAD(maskTiles, maskPages, texel).a);
+  vec4 S = imageLoad(imgLayer, texel);
+  vec4 c = vec4(S.rgb * S.a, S.a) * k;
+  alpha = replace != 0 ? k : c.a;
+  return c;
+}
+
+void main()
+{
+  ivec2 texelCoords;
+  if (!getRegionTexel(texelCoords)) return;
+  float a;
+  vec4 c = layerColor(texelCoords, a);
+
+#ifdef BLEND_OVER
+  vec4 D = imageLoad(imgDest, texelCoords);
+  imageStore(imgDest, texelCoords, c + (1.0 - a) * D);
+#endif
+
+#ifdef BLEND_UNDER
+  vec4 D = imageLoad(imgDest, texelCoords);
+  float T = imageLoad(imgDestTransmittance, texelCoords).r;
+  imageStore(imgDest, texelCoords, D + T * c);
+  imageStore(imgDestTransmittance, texelCoords, vec4(T * (1.0 - a)));
+#endif
+
+#ifdef BLEND_FINAL
+  vec4 B = c + (1.0 - a) * imageLoad(imgBelow, texelCoords);
+  vec4 A = imageLoad(imgAbove, texelCoords);
+  float T = imageLoad(imgAboveTransmittance, texelCoords).r;
+  imageStore(imgTarget, texelCoords, A + T * B);
+#endif
+}
@@ -0,0 +1,12 @@
+// Rectangle of the canvas processed by a dispatch (see computeOverRects)
+// The binding must match kRegionUniformSlot
+layout(std140, binding = 7) uniform URegion { ivec2 regionOrigin; ivec2 regionSize; };
+
+// Texel processed by the current invocation.
+// Returns false if the invocation is outside the region.
+bool getRegionTexel(out ivec2 texelCoords)
+{
+	ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+	texelCoords = regionOrigin + p;
+	return all(lessThan(p, regionSize));
+}
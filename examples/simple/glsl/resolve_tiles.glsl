@@ -0,0 +1,17 @@
+#version 450
+// Copy a tiled layer to a regular texture
+#include "region.glsl"
+#include "tiled_layer.glsl"
+
+layout(binding = 0, rgba8) readonly uniform image2DArray srcTiles;
+layout(binding = 1, r32ui) readonly uniform uimage2D srcPageTable;
+layout(binding = 2, rgba8) writeonly uniform image2D imgTarget;
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+void main() {
+  ivec2 texelCoords;
+  if (!getRegionTexel(texelCoords)) return;
+  imageStore(imgTarget, texelCoords,
+             TILED_LOAD(srcTiles, srcPageTable, texelCoords));
+}
@@ -1,37 +1,57 @@
 // Compute the average shading curves
+// (accumulation pass of a GpuHistogram, see shading_curve_smooth.glsl for
+// the averages)
+// Processes a region of the canvas: its pixels are added to the histogram,
+// or subtracted if `weight` is negative (incremental updates).
 #version 450
 #include "canvas.glsl"
 #include "rgb_hsv.glsl"
 #include "utils.glsl"
+#include "tiled_layer.glsl"
+#include "region.glsl"
 
 layout(std140, binding = 0) uniform U0 { Canvas canvas; };
 layout(std140, binding = 1) uniform U1 { vec3 lightPos; };
+layout(std140, binding = 2) uniform U2 { int weight; };
 
 #define CURVE_SAMPLES 256
+// sums of H, S, V (x255) and count
+#define HISTOGRAM_BINS CURVE_SAMPLES
+#define HISTOGRAM_CHANNELS 4
+#include "histogram/glsl/histogram.glsl"
 
 layout(local_size_x = 16, local_size_y = 16) in;
 layout(binding = 0) uniform sampler2D texNormals;
 layout(binding = 1) uniform sampler2D texMask;	// same size as the canvas
-layout(binding = 2) uniform sampler2D texBaseColor;
 
-layout(binding = 0, r32ui) coherent uniform uimage1D imgCurveH;
-layout(binding = 1, r32ui) coherent uniform uimage1D imgCurveS;
-layout(binding = 2, r32ui) coherent uniform uimage1D imgCurveV;
-layout(binding = 3, r32ui) coherent uniform uimage1D imgCurveAccum;
+// base color (tiled layer)
+layout(binding = 4, rgba8) readonly uniform image2DArray imgBaseColor;
+layout(binding = 5, r32ui) readonly uniform uimage2D pagesBaseColor;
 
 
 void main()
 {
-  ivec2 texelCoords = ivec2(gl_GlobalInvocationID.xy);
-  vec4 C = texelFetch(texBaseColor, texelCoords, 0);
-  float S = shadingTerm(texNormals, texelCoords, lightPos);
-  int bin = clamp(int(floor(S * CURVE_SAMPLES)), 0, CURVE_SAMPLES);
-
-  uvec3 hsv = uvec3(rgb2hsv(C.xyz)*255.0f);
-  imageAtomicAdd(imgCurveH, bin, hsv.x);
-  imageAtomicAdd(imgCurveS, bin, hsv.y);
-  imageAtomicAdd(imgCurveV, bin, hsv.z);
-  imageAtomicAdd(imgCurveAccum, bin, 1);
-
-  memoryBarrierImage();
+  histogramBegin();
+
+  ivec2 texelCoords;
+  if (getRegionTexel(texelCoords)) {
+    vec4 C = TILED_LOAD(imgBaseColor, pagesBaseColor, texelCoords);
+    float S = shadingTerm(texNormals, texelCoords, lightPos);
+    uint bin = uint(clamp(int(floor(S * CURVE_SAMPLES)), 0, CURVE_SAMPLES - 1));
+
+    uvec3 hsv = uvec3(rgb2hsv(C.xyz)*255.0f);
+    if (weight < 0) {
+      histogramSubtract(bin, 0, hsv.x);
+      histogramSubtract(bin, 1, hsv.y);
+      histogramSubtract(bin, 2, hsv.z);
+      histogramSubtract(bin, 3, 1);
+    } else {
+      histogramAdd(bin, 0, hsv.x);
+      histogramAdd(bin, 1, hsv.y);
+      histogramAdd(bin, 2, hsv.z);
+      histogramAdd(bin, 3, 1);
+    }
+  }
+
+  histogramEnd();
 }
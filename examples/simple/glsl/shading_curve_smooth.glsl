@@ -0,0 +1,47 @@
+// Average and smooth the shading curves computed by shading_curve.glsl,
+// and pack them into the shading profile
+#version 450
+
+#define CURVE_SAMPLES 256
+#define KERNEL_RADIUS 20
+
+layout(local_size_x = CURVE_SAMPLES) in;
+
+// merged histogram: H, S, V sums and count of each bin
+layout(std430, binding = 0) readonly buffer Bins { uint bins[]; };
+// set to nonzero if the packed profile differs from the previous one
+layout(std430, binding = 1) buffer Changed { uint profileChanged; };
+layout(binding = 0, rgba8) uniform image1D imgShadingProfile;
+
+const float gaussK[2*KERNEL_RADIUS+1] = float[](
+      0.000027f, 0.00006f,  0.000125f, 0.000251f, 0.000484f, 0.000898f,
+      0.001601f, 0.002743f, 0.004515f, 0.007141f, 0.010853f, 0.01585f,
+      0.022243f, 0.029995f, 0.038867f, 0.048396f, 0.057906f, 0.066577f,
+      0.073554f, 0.078087f, 0.079659f, 0.078087f, 0.073554f, 0.066577f,
+      0.057906f, 0.048396f, 0.038867f, 0.029995f, 0.022243f, 0.01585f,
+      0.010853f, 0.007141f, 0.004515f, 0.002743f, 0.001601f, 0.000898f,
+      0.000484f, 0.000251f, 0.000125f, 0.00006f,  0.000027f);
+
+shared vec3 averages[CURVE_SAMPLES];
+
+void main()
+{
+  int i = int(gl_LocalInvocationID.x);
+  uint count = bins[i*4+3];
+  averages[i] = count != 0 ?
+    vec3(bins[i*4], bins[i*4+1], bins[i*4+2]) / (255.0f * float(count)) :
+    vec3(0.0f);
+  memoryBarrierShared();
+  barrier();
+
+  // smooth them (a lot)
+  vec3 a = vec3(0.0f);
+  for (int w = -KERNEL_RADIUS; w <= KERNEL_RADIUS; ++w) {
+    a += averages[clamp(i + w, 0, CURVE_SAMPLES - 1)] * gaussK[w + KERNEL_RADIUS];
+  }
+  vec4 packed = vec4(clamp(a, 0.0f, 1.0f), 1.0f);
+  vec4 old = imageLoad(imgShadingProfile, i);
+  if (any(notEqual(round(old * 255.0f), round(packed * 255.0f))))
+    atomicOr(profileChanged, 1u);
+  imageStore(imgShadingProfile, i, packed);
+}
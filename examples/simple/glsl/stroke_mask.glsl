@@ -0,0 +1,94 @@
+#version 450
+/////////////// Analytic rasterization of round brush strokes
+// Each invocation evaluates the coverage of one pixel of the stroke mask by
+// all the splats of the segments of the frame, and writes the pixel once.
+// The splats of a segment are at regular intervals along it: only the
+// splats within reach of the pixel are evaluated (the segment is skipped
+// if the pixel is outside of its capsule).
+#include "brush.glsl"
+#include "region.glsl"
+
+// must match StrokeSegment in brush_path.hpp
+struct StrokeSegment
+{
+	vec2 p0;
+	vec2 p1;
+	float width0;
+	float width1;
+	float pressure0;
+	float pressure1;
+	float opacity0;
+	float opacity1;
+	float firstSplat;	// distance of the first splat from p0
+	float spacing;	// distance between two splats
+	uint splatCount;
+	uint splatIndex;	// index of the first splat in the stroke
+	uint padding0;
+	uint padding1;
+};
+
+layout(std140, binding = 0) uniform U0 {
+	float widthJitter;
+	float smoothness;
+};
+
+layout(std430, binding = 0) readonly buffer Segments { StrokeSegment segments[]; };
+
+layout(binding = 0, rgba8) uniform image2D imgStrokeMask;
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+// uniform in [0,1)
+float hashSplat(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return float(x) * (1.0 / 4294967296.0);
+}
+
+void main()
+{
+	ivec2 texelCoords;
+	if (!getRegionTexel(texelCoords)) return;
+	// pixel centers, same convention as gl_FragCoord
+	vec2 p = vec2(texelCoords) + 0.5;
+
+	// fraction of the pixel not covered by the splats
+	float T = 1.0;
+	for (int i = 0; i < segments.length(); ++i) {
+		StrokeSegment s = segments[i];
+		float reach = max(s.width0 * s.pressure0, s.width1 * s.pressure1) + widthJitter;
+		vec2 d = s.p1 - s.p0;
+		float len = length(d);
+		float h = len > 0.0 ? clamp(dot(p - s.p0, d) / (len * len), 0.0, 1.0) : 0.0;
+		if (distance(p, s.p0 + h * d) > reach)
+			continue;
+		// splats at a distance along the segment less than `reach` from the
+		// projection of the pixel
+		int kmin = 0;
+		int kmax = int(s.splatCount) - 1;
+		// very short segments: all splats are on p0 (see BrushPath)
+		bool onP0 = len <= 0.01;
+		if (!onP0) {
+			float proj = dot(p - s.p0, d) / len;
+			kmin = max(kmin, int(ceil((proj - reach - s.firstSplat) / s.spacing)));
+			kmax = min(kmax, int(floor((proj + reach - s.firstSplat) / s.spacing)));
+		}
+		for (int k = kmin; k <= kmax; ++k) {
+			float t = onP0 ? 0.0 : (s.firstSplat + float(k) * s.spacing) / len;
+			vec2 center = mix(s.p0, s.p1, t);
+			float width = mix(s.width0 * s.pressure0, s.width1 * s.pressure1, t) +
+				(2.0 * hashSplat(s.splatIndex + uint(k)) - 1.0) * widthJitter;
+			float Sa = roundBrushKernel(p, center, width, smoothness) * mix(s.opacity0, s.opacity1, t);
+			T *= 1.0 - clamp(Sa, 0.0, 1.0);
+		}
+	}
+	if (T == 1.0) return;
+
+	// same blending as the splat draws: mask = Sa + (1 - Sa) * mask
+	vec4 mask = imageLoad(imgStrokeMask, texelCoords);
+	imageStore(imgStrokeMask, texelCoords, vec4(1.0) - (vec4(1.0) - mask) * T);
+}
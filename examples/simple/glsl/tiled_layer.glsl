@@ -0,0 +1,27 @@
+// Access to tiled layers (see TiledLayer).
+// A tiled layer is a texture array of tiles (the tile pool) and a page table
+// (r32ui) that maps the coordinates of a tile to its layer in the pool plus
+// one, or 0 if the tile is not allocated.
+// Must match kCanvasTileSize
+#define TILE_SIZE 256
+
+// Layer of the tile containing `texel` in the pool, -1 if not allocated
+#define TILE_LAYER(pageTable, texel) \
+	(int(imageLoad(pageTable, (texel) / TILE_SIZE).r) - 1)
+
+// Coordinates of `texel` in the tile pool
+#define TILE_TEXEL(texel, layer) ivec3((texel) % TILE_SIZE, (layer))
+
+// Texel of a tiled layer, transparent black if the tile is not allocated
+#define TILED_LOAD(tiles, pageTable, texel) \
+	(TILE_LAYER(pageTable, texel) >= 0 ? \
+		imageLoad(tiles, TILE_TEXEL(texel, TILE_LAYER(pageTable, texel))) : \
+		vec4(0.0f))
+
+// Writes a texel of a tiled layer (nothing if the tile is not allocated)
+#define TILED_STORE(tiles, pageTable, texel, value) \
+	{ \
+		int tileLayer_ = TILE_LAYER(pageTable, texel); \
+		if (tileLayer_ >= 0) \
+			imageStore(tiles, TILE_TEXEL(texel, tileLayer_), (value)); \
+	}
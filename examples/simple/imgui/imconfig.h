@@ -32,6 +32,10 @@
 //---- Implement STB libraries in a namespace to avoid conflicts
 //#define IMGUI_STB_NAMESPACE     ImGuiStb
 
+//---- stb_rect_pack is also used by the brush tip atlas: it is implemented once,
+//---- with external linkage, in stb_rect_pack.cpp
+#define IMGUI_DISABLE_STB_RECT_PACK_IMPLEMENTATION
+
 //---- Define constructor and implicit cast operators to convert back<>forth from your math types and ImVec2/ImVec4.
 /*
 #define IM_VEC2_CLASS_EXTRA                                                 \
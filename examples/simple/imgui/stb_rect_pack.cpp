@@ -0,0 +1,7 @@
+// Implementation of stb_rect_pack, shared by ImGui (font atlas) and the brush
+// tip atlas (see IMGUI_DISABLE_STB_RECT_PACK_IMPLEMENTATION in imconfig.h)
+#include "imgui.h"
+
+#define STBRP_ASSERT(x) IM_ASSERT(x)
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb_rect_pack.h"
@@ -1,8 +1,121 @@
 #ifndef LAYER_HPP
 #define LAYER_HPP
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <autograph/draw.hpp>
+
+#include "dirty_region.hpp"
+#include "tiled_layer.hpp"
 #include "types.hpp"
-#include "camera.hpp"
 
+struct Canvas;
+struct Pipelines;
+
+enum class LayerType {
+  // Shading curves
+  DynamicColor,
+  // Constant color
+  Constant,
+  // LdotN space blur
+  Blur,
+};
+
+// how the output of a layer is combined with the layers below
+enum class LayerBlendMode {
+  // alpha blending
+  Over,
+  // the output replaces the layers below (filters)
+  Replace,
+};
+
+// inputs of the layer passes
+struct LayerContext {
+  Device& device;
+  Canvas& canvas;
+  Pipelines& pipelines;
+  RawBufferSlice& canvasData;
+  Sampler& sampler;
+  glm::vec3 lightPos;
+};
+
+///////////////////////////////////////
+// Layer
+// An element of the layer stack of the canvas: a process evaluated over
+// regions of the canvas into `output` (RGBA8, straight alpha), blended over
+// the layers below by the LayerCompositor, with the opacity and the mask of
+// the layer.
+// The output is kept between frames: only the dirty regions of the layer
+// are evaluated again.
+class Layer {
+public:
+  Layer(Device& device, LayerType type_, std::string name_, unsigned width,
+        unsigned height)
+      : type(type_), name(std::move(name_)), dirty(width, height) {
+    output = device.createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
+    // nothing evaluated yet: transparent until the dirty tiles are evaluated
+    // (they can be evaluated over several frames, see LayerCompositor)
+    ag::clear(device, output, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
+    dirty.addAll();
+  }
+
+  virtual ~Layer() {}
+
+  Layer(const Layer&) = delete;
+  Layer& operator=(const Layer&) = delete;
+
+  // Evaluates the layer over `rects` into `output`. `input` is the output of
+  // the layer below (transparent for the first layer).
+  virtual void evaluate(LayerContext& context,
+                        const std::vector<ag::Box2D>& rects,
+                        Texture2D<ag::RGBA8>& input) = 0;
+
+  // true if the output depends on `input`: the layer is evaluated again
+  // over the region modified in the layer below
+  virtual bool readsInput() const { return false; }
+
+  // How far around a pixel the layer reads `input`, in pixels (layers that
+  // read input). The output of the layer is evaluated again over the region
+  // modified in `input` grown by this margin (not over the modified region
+  // only: the pixels around it read modified inputs too).
+  virtual unsigned getInputMargin() const { return 0; }
+
+  // true if the output depends on the state of the canvas (g-buffers, UV
+  // layers, shading profile): the layer is evaluated again over
+  // Canvas::dirty
+  virtual bool readsCanvas() const { return true; }
+
+  // true if `tiles` are pixels of the layer (undo/redo)
+  virtual bool ownsTiles(const TiledLayer& tiles) const {
+    return mask.get() == &tiles;
+  }
+
+  // once per frame: paging of the tiled layers owned by the layer
+  virtual void update(Device& device) {
+    if (mask)
+      mask->update(device);
+  }
+
+  // The alpha of the mask hides the layer (tiles that are not allocated
+  // leave it visible).
+  void addMask(Device& device) {
+    if (!mask)
+      mask = std::make_unique<TiledLayer>(device, output.info.dimensions.x,
+                                          output.info.dimensions.y);
+  }
+
+  LayerType type;
+  std::string name;
+  LayerBlendMode blendMode = LayerBlendMode::Over;
+  float opacity = 1.0f;
+  bool visible = true;
+  std::unique_ptr<TiledLayer> mask;
+  // regions of the layer modified since the last composite (regions
+  // modified in the canvas state are in Canvas::dirty)
+  DirtyRegion dirty;
+  Texture2D<ag::RGBA8> output;
+};
 
 #endif
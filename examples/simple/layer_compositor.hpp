@@ -0,0 +1,175 @@
+#ifndef LAYER_COMPOSITOR_HPP
+#define LAYER_COMPOSITOR_HPP
+
+#include <autograph/compute.hpp>
+#include <autograph/profiler.hpp>
+
+#include "canvas.hpp"
+#include "layer.hpp"
+#include "pipelines.hpp"
+
+// dirty tiles (of DirtyRegion) of a layer evaluated per frame: large regions
+// are evaluated over several frames, within the residency budget of the
+// tiled layers read by the layers
+constexpr unsigned kLayerEvalBatchTiles =
+    kTileBatchSize * (kCanvasTileSize / kDirtyTileSize) *
+    (kCanvasTileSize / kDirtyTileSize);
+
+// opacity and blend mode of a layer, U0 of glsl/layer_blend.glsl
+struct LayerBlendUniforms {
+  float opacity;
+  int replace;
+};
+
+///////////////////////////////////////
+// LayerCompositor
+// Evaluates the layer stack of a canvas and blends the outputs of the layers.
+// The composites of the layers below and above the active layer (the one
+// being edited) are cached: when only the active layer is modified, the
+// frame costs the evaluation of the active layer and one blend of the three
+// over the modified region.
+// A layer is evaluated again over its own dirty region, the dirty region of
+// the canvas if the layer reads the canvas state, and for layers that read
+// their input the region modified in the layer below, grown by their margin.
+// At most kLayerEvalBatchTiles of the dirty region of a layer are evaluated
+// per frame, the rest stays dirty.
+class LayerCompositor {
+public:
+  LayerCompositor(Device& device, unsigned width_, unsigned height_)
+      : width(width_), height(height_), noMask(device, width_, height_) {
+    auto size = glm::uvec2{width, height};
+    texEmpty = device.createTexture2D<ag::RGBA8>(size);
+    texBelow = device.createTexture2D<ag::RGBA8>(size);
+    texAbove = device.createTexture2D<ag::RGBA8>(size);
+    texAboveTransmittance = device.createTexture2D<ag::R8>(size);
+    ag::clear(device, texEmpty, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
+  }
+
+  // Updates `out` with the composite of the layers of `canvas`, over the
+  // regions modified since the last call. Returns these regions.
+  std::vector<ag::Box2D> composite(LayerContext& context,
+                                   Texture2D<ag::RGBA8>& out) {
+    auto& device = context.device;
+    auto& canvas = context.canvas;
+    auto& layers = canvas.layers;
+    auto active = canvas.activeLayer;
+    ag::ProfileZone<GL> zone(device, "composite");
+
+    // the cached composites are split at the active layer: blend everything
+    // again when it moves (the outputs of the layers are still valid)
+    bool reblend = active != cachedActiveLayer ||
+                   layers.size() != cachedLayerCount || &out != cachedTarget;
+    cachedActiveLayer = active;
+    cachedLayerCount = layers.size();
+    cachedTarget = &out;
+    auto canvasRects = canvas.dirty.getRects();
+    canvas.dirty.clear();
+
+    // evaluate the modified parts of the layers
+    DirtyRegion belowChanged{width, height};
+    DirtyRegion aboveChanged{width, height};
+    DirtyRegion changed{width, height};
+    DirtyRegion previousChanged{width, height};
+    for (size_t i = 0; i < layers.size(); ++i) {
+      auto& layer = *layers[i];
+      if (layer.readsCanvas())
+        for (const auto& rect : canvasRects)
+          layer.dirty.add(rect);
+      if (layer.readsInput())
+        for (const auto& rect :
+             previousChanged.dilated(layer.getInputMargin()).getRects())
+          layer.dirty.add(rect);
+      auto evaluated = layer.dirty.takeTiles(kLayerEvalBatchTiles);
+      auto rects = evaluated.getRects();
+      if (!rects.empty()) {
+        layer.evaluate(context, rects,
+                       i > 0 ? layers[i - 1]->output : texEmpty);
+        ag::memoryBarrier(device);
+      }
+      for (const auto& rect : rects) {
+        if (i < active)
+          belowChanged.add(rect);
+        else if (i > active)
+          aboveChanged.add(rect);
+        changed.add(rect);
+      }
+      previousChanged = std::move(evaluated);
+    }
+    if (reblend) {
+      belowChanged.addAll();
+      aboveChanged.addAll();
+      changed.addAll();
+    }
+
+    // layers below the active layer, bottom to top
+    auto rects = belowChanged.getRects();
+    for (const auto& rect : rects)
+      ag::clear(device, texBelow, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f},
+                rect);
+    for (size_t i = 0; i < active && !rects.empty(); ++i)
+      blendLayer(context, *layers[i], rects, context.pipelines.ppBlendLayerOver,
+                 ag::RWTextureUnit(3, texBelow));
+
+    // layers above the active layer, top to bottom
+    rects = aboveChanged.getRects();
+    for (const auto& rect : rects) {
+      ag::clear(device, texAbove, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f},
+                rect);
+      ag::clear(device, texAboveTransmittance,
+                ag::ClearColor{1.0f, 1.0f, 1.0f, 1.0f}, rect);
+    }
+    for (auto i = layers.size(); i > active + 1 && !rects.empty(); --i)
+      blendLayer(context, *layers[i - 1], rects,
+                 context.pipelines.ppBlendLayerUnder,
+                 ag::RWTextureUnit(3, texAbove),
+                 ag::RWTextureUnit(4, texAboveTransmittance));
+
+    // active layer between the two
+    rects = changed.getRects();
+    if (!rects.empty() && active < layers.size()) {
+      auto& layer = *layers[active];
+      blendLayer(context, layer, rects, context.pipelines.ppBlendLayerFinal,
+                 ag::RWTextureUnit(3, texBelow), ag::RWTextureUnit(4, texAbove),
+                 ag::RWTextureUnit(5, texAboveTransmittance),
+                 ag::RWTextureUnit(6, out));
+    }
+    return rects;
+  }
+
+private:
+  template <typename... Resources>
+  void blendLayer(LayerContext& context, Layer& layer,
+                  const std::vector<ag::Box2D>& rects,
+                  ComputePipeline& pipeline, Resources&&... resources) {
+    auto& mask = layer.mask ? *layer.mask : noMask;
+    for (const auto& rect : rects)
+      mask.makeResident(context.device, rect);
+    LayerBlendUniforms u{layer.visible ? layer.opacity : 0.0f,
+                         layer.blendMode == LayerBlendMode::Replace};
+    computeOverRects(context.device, pipeline, rects, u,
+                     ag::RWTextureUnit(0, layer.output),
+                     ag::RWTextureUnit(1, mask.tiles),
+                     ag::RWTextureUnit(2, mask.pageTable),
+                     std::forward<Resources>(resources)...);
+    ag::memoryBarrier(context.device);
+  }
+
+  unsigned width;
+  unsigned height;
+  // mask of the layers without one (no tiles allocated)
+  TiledLayer noMask;
+  // input of the first layer (transparent)
+  Texture2D<ag::RGBA8> texEmpty;
+  // composite of the layers below the active layer
+  Texture2D<ag::RGBA8> texBelow;
+  // composite of the layers above the active layer, and the fraction of
+  // the layers below that shows through them
+  Texture2D<ag::RGBA8> texAbove;
+  Texture2D<ag::R8> texAboveTransmittance;
+  // the caches are valid for this state
+  size_t cachedActiveLayer = (size_t)-1;
+  size_t cachedLayerCount = 0;
+  Texture2D<ag::RGBA8>* cachedTarget = nullptr;
+};
+
+#endif // !LAYER_COMPOSITOR_HPP
@@ -2,17 +2,30 @@
 #define BLUR_LAYER_HPP
 
 #include "../canvas.hpp"
+#include "../layer.hpp"
+#include "../pipelines.hpp"
 
-class BlurLayer : public TLayer<LayerType::Blur>
-{
+// LdotN space blur of the layer below (the blur radius is the blur
+// parameter map of the canvas), replaces the layers below
+// [evaluate.glsl, EVAL_BLUR]
+class BlurLayer : public Layer {
 public:
-	void draw(LayerContext& context) override
-    {
-    	
-    }
-    
-private:
+  BlurLayer(Device& device, unsigned width, unsigned height)
+      : Layer(device, LayerType::Blur, "Blur", width, height) {
+    blendMode = LayerBlendMode::Replace;
+  }
 
+  void evaluate(LayerContext& context, const std::vector<ag::Box2D>& rects,
+                Texture2D<ag::RGBA8>& input) override {
+    previewCanvas(context.device, context.canvas, output,
+                  context.pipelines.ppEvaluateBlurPass, rects,
+                  context.canvasData, context.sampler,
+                  ag::RWTextureUnit(1, input));
+  }
+
+  bool readsInput() const override { return true; }
+
+  unsigned getInputMargin() const override { return kEvalBlurMargin; }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,35 +2,58 @@
 #define COLOR_LAYER_HPP
 
 #include "../canvas.hpp"
+#include "../layer.hpp"
+#include "../pipelines.hpp"
 
 // dynamic color layer (color curves)
-class DynamicColorLayer : public TLayer<LayerType::DynamicColor>
-{
+// Shading profile of the canvas, with the HSV offsets and the detail mask
+// [evaluate.glsl, EVAL_MAIN]
+class DynamicColorLayer : public Layer {
 public:
-    DynamicColorLayer(gsl::span<float> initCurveH, gsl::span<float> initCurveS, gsl::span<float> initCurveV)
-    void draw(LayerContext& context) override
-    {
-
-    }
-
-private:
-    // details are merged with
-    // used for histogram calculation
-
+  DynamicColorLayer(Device& device, unsigned width, unsigned height)
+      : Layer(device, LayerType::DynamicColor, "Shading", width, height) {}
+
+  void evaluate(LayerContext& context, const std::vector<ag::Box2D>& rects,
+                Texture2D<ag::RGBA8>& input) override {
+    for (const auto& rect : rects)
+      context.canvas.hsvOffsetUV.makeResident(context.device, rect);
+    previewCanvas(context.device, context.canvas, output,
+                  context.pipelines.ppEvaluate, rects, context.canvasData,
+                  context.sampler, context.lightPos);
+  }
 };
 
 // static color layer (non-varying)
 // use for drawing contours, etc.
-class ColorLayer : public TLayer<LayerType::Constant>
-{
+// The colors are painted with the brush tool when the layer is active.
+class ColorLayer : public Layer {
 public:
-    void draw(LayerContext& context) override
-    {
-
-    }
-
-private:
-    Texture2D<ag::RGBA8> tex;
+  ColorLayer(Device& device, unsigned width, unsigned height)
+      : Layer(device, LayerType::Constant, "Color", width, height),
+        colors(device, width, height) {}
+
+  void evaluate(LayerContext& context, const std::vector<ag::Box2D>& rects,
+                Texture2D<ag::RGBA8>& input) override {
+    for (const auto& rect : rects)
+      colors.makeResident(context.device, rect);
+    computeOverRects(context.device, context.pipelines.ppResolveTiles, rects,
+                     ag::RWTextureUnit(0, colors.tiles),
+                     ag::RWTextureUnit(1, colors.pageTable),
+                     ag::RWTextureUnit(2, output));
+  }
+
+  void update(Device& device) override {
+    Layer::update(device);
+    colors.update(device);
+  }
+
+  bool readsCanvas() const override { return false; }
+
+  bool ownsTiles(const TiledLayer& tiles) const override {
+    return &tiles == &colors || Layer::ownsTiles(tiles);
+  }
+
+  TiledLayer colors;
 };
 
 #endif
@@ -1,6 +1,7 @@
 #ifndef PAINTER_HPP
 #define PAINTER_HPP
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -12,10 +13,13 @@
 #include <autograph/compute.hpp>
 #include <autograph/device.hpp>
 #include <autograph/draw.hpp>
+#include <autograph/mipmap.hpp>
 #include <autograph/pipeline.hpp>
 #include <autograph/pixel_format.hpp>
+#include <autograph/profiler.hpp>
 #include <autograph/surface.hpp>
 
+#include <extra/image_io/batch_loader.hpp>
 #include <extra/image_io/load_image.hpp>
 #include <extra/input/input.hpp>
 #include <extra/input/input_glfw.hpp>
@@ -26,12 +30,18 @@
 #include "brush_path.hpp"
 #include "camera.hpp"
 #include "canvas.hpp"
+#include "canvas_document.hpp"
+#include "layer_compositor.hpp"
 #include "pipelines.hpp"
 
+#include "layers/blur_layer.hpp"
+#include "layers/color_layer.hpp"
+
 #include "tools/blur.hpp"
 #include "tools/smudge.hpp"
 #include "tools/detail.hpp"
 
+#include <boost/filesystem.hpp>
 #include <filesystem\path.h>
 
 #define USE_AWAIT
@@ -51,11 +61,23 @@ public:
         trackball(TrackballCameraSettings{}) {
     pipelines = std::make_unique<Pipelines>(*device, samplesRoot);
     // 1000x1000 canvas
-    mesh = loadMesh("common/meshes/lucy.fbx");
+    // the mesh is imported in the background, draw nothing until it is ready
+    loadMeshAsync("common/meshes/lucy.fbx", [this](Mesh loadedMesh) {
+      mesh = std::move(loadedMesh);
+      meshLoaded = true;
+    });
     canvas = std::make_unique<Canvas>(*device, width, height);
-    texEvalCanvas =
-        device->createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
-    texEvalCanvasBlur =
+    // default layer stack: shading, then the blur of the shading
+    canvas->layers.push_back(
+        std::make_unique<DynamicColorLayer>(*device, width, height));
+    canvas->layers.push_back(
+        std::make_unique<BlurLayer>(*device, width, height));
+    compositor = std::make_unique<LayerCompositor>(*device, width, height);
+    // mip levels for the downscaled views, updated with the canvas
+    texEvalCanvas = device->createTexture2D<ag::RGBA8>(
+        glm::uvec2{width, height},
+        ag::getMipLevelCount(glm::uvec2{width, height}));
+    texTiledLayerView =
         device->createTexture2D<ag::RGBA8>(glm::uvec2{width, height});
 
     input = std::make_unique<input::input2>();
@@ -79,34 +101,68 @@ public:
         samLinearClamp, samNearestRepeat, samNearestClamp, vboQuad});
 
     toolInstance = std::make_unique<ColorBrushTool>(*toolResources);
+    ui->saveCanvas.observable().subscribe(
+        [this](auto) { this->saveRequested = true; });
+    ui->loadCanvas.observable().subscribe(
+        [this](auto) { this->loadRequested = true; });
     std::clog << "make task\n";
     // task = std::make_unique<co::task>([this]() {this->test_async();});
   }
 
   // load brush tips from img directories
+  // (decoded in the background, see updateBrushTips)
   void loadBrushTips() {
-    using namespace fs;
-    auto path1 = fs::path(samplesRoot.str().c_str()) / "simple/img/brushes";
-    auto path2 = fs::path(samplesRoot.str().c_str()) / "common/img/brushes";
-
-    /*if (exists(path1) && is_directory(path1))
-      for (auto it = fs::directory_iterator(path1);
-           it != fs::directory_iterator(); ++it)
+    namespace bfs = boost::filesystem;
+    brushTipLoader =
+        std::make_unique<image_io::BatchTextureLoader<GL>>(*device);
+    auto path1 = bfs::path(samplesRoot.str()) / "simple/img/brushes";
+    auto path2 = bfs::path(samplesRoot.str()) / "common/img/brushes";
+
+    if (bfs::exists(path1) && bfs::is_directory(path1))
+      for (auto it = bfs::directory_iterator(path1);
+           it != bfs::directory_iterator(); ++it)
         loadBrushTip((*it).path());
 
-    if (exists(path2) && is_directory(path2))
-      for (auto it = fs::directory_iterator(path2);
-           it != fs::directory_iterator(); ++it)
-        loadBrushTip((*it).path());*/
+    if (bfs::exists(path2) && bfs::is_directory(path2))
+      for (auto it = bfs::directory_iterator(path2);
+           it != bfs::directory_iterator(); ++it)
+        loadBrushTip((*it).path());
   }
 
-  void loadBrushTip(const fs::path& path) {
+  void loadBrushTip(const boost::filesystem::path& path) {
     // filter by extension...
-    /*if (path.extension() != ".png")
+    if (path.extension() != ".png")
       return;
-    ui->brushTipTextures.emplace_back(BrushTipTexture{
-        path.stem().string(),
-        image_io::loadTexture2D(*device, path.string().c_str())});*/
+    pendingBrushTips.emplace_back(
+        path.stem().string(), brushTipLoader->load(path.string()));
+  }
+
+  // issue the uploads of decoded brush tips and add the ready ones to the UI
+  void updateBrushTips() {
+    if (pendingBrushTips.empty())
+      return;
+    brushTipLoader->update();
+    for (auto it = pendingBrushTips.begin(); it != pendingBrushTips.end();) {
+      if (it->second.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+        ++it;
+        continue;
+      }
+      try {
+        ui->brushTipTextures.emplace_back(
+            BrushTipTexture{it->first, it->second.get()});
+        brushTipsAdded = true;
+      } catch (std::runtime_error& e) {
+        std::clog << "Could not load brush tip " << it->first << ": "
+                  << e.what() << "\n";
+      }
+      it = pendingBrushTips.erase(it);
+    }
+    // repack all tips in the atlas, once all of them are loaded
+    if (pendingBrushTips.empty() && brushTipsAdded) {
+      ui->brushTipAtlas = buildBrushTipAtlas(*device, ui->brushTipTextures);
+      brushTipsAdded = false;
+    }
   }
 
   // coroutine test
@@ -145,14 +201,22 @@ public:
         uCanvasData, GL::kUniformBufferOffsetAlignment);
   }
 
-  void baseColorToShadingOffset(Canvas& canvas) {
+  void baseColorToShadingOffset(Canvas& canvas,
+                                const std::vector<ag::Box2D>& rects) {
     auto lightPos =
         glm::normalize(glm::vec3{ui->lightPosXY[0], ui->lightPosXY[1], -2.0f});
-    ag::compute(*device, pipelines->ppBaseColorToOffset,
-                ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
-                canvasData, lightPos, canvas.texShadingProfileLN,
-                canvas.texBaseColorUV, canvas.texShadingTermSmooth,
-                canvas.texStencil, ag::RWTextureUnit(0, canvas.texHSVOffsetUV));
+    // offsets are only stored where there is a base color
+    for (const auto& rect : rects) {
+      canvas.baseColorUV.makeResident(*device, rect);
+      canvas.hsvOffsetUV.allocateLike(*device, canvas.baseColorUV, rect);
+    }
+    computeOverRects(*device, pipelines->ppBaseColorToOffset, rects,
+                     canvasData, lightPos, canvas.texShadingProfileLN,
+                     canvas.texShadingTermSmooth, canvas.texStencil,
+                     ag::RWTextureUnit(0, canvas.hsvOffsetUV.tiles),
+                     ag::RWTextureUnit(1, canvas.baseColorUV.tiles),
+                     ag::RWTextureUnit(2, canvas.hsvOffsetUV.pageTable),
+                     ag::RWTextureUnit(3, canvas.baseColorUV.pageTable));
   }
 
   void renderShading(Canvas& canvas) {
@@ -165,24 +229,39 @@ public:
         BlurParams{{(float)canvas.width, (float)canvas.height}, 11, 3.0f};
     auto lightPos =
         glm::normalize(glm::vec3{ui->lightPosXY[0], ui->lightPosXY[1], -2.0f});
-    ag::draw(
-        *device, canvas.texShadingTerm, pipelines->ppShadingOverlay,
-        ag::DrawArrays(ag::PrimitiveType::Triangles, 0, 3), canvas.texNormals,
-        canvasData,
-        glm::normalize(glm::vec3{ui->lightPosXY[0], ui->lightPosXY[1], -2.0f}));
-    ag::compute(*device, pipelines->ppBlurH,
-                ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
-                params, RWTextureUnit(0, canvas.texShadingTerm),
-                RWTextureUnit(1, canvas.texShadingTermSmooth0));
-    ag::compute(*device, pipelines->ppBlurV,
-                ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
-                params, RWTextureUnit(0, canvas.texShadingTermSmooth0),
-                RWTextureUnit(1, canvas.texShadingTermSmooth));
+    ag::ProfileZone<GL> zone(*device, "shading");
+    {
+      ag::ProfileZone<GL> zone(*device, "shading overlay");
+      ag::draw(*device, canvas.texShadingTerm, pipelines->ppShadingOverlay,
+               ag::DrawArrays(ag::PrimitiveType::Triangles, 0, 3),
+               canvas.texNormals, canvasData, lightPos);
+    }
+    {
+      ag::ProfileZone<GL> zone(*device, "blurH");
+      ag::compute(
+          *device, pipelines->ppBlurH,
+          ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
+          params, RWTextureUnit(0, canvas.texShadingTerm),
+          RWTextureUnit(1, canvas.texShadingTermSmooth0));
+    }
+    {
+      ag::ProfileZone<GL> zone(*device, "blurV");
+      ag::compute(
+          *device, pipelines->ppBlurV,
+          ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
+          params, RWTextureUnit(0, canvas.texShadingTermSmooth0),
+          RWTextureUnit(1, canvas.texShadingTermSmooth));
+    }
     // shading gradient
-    ag::compute(*device, pipelines->ppGradient,
-                ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
-    glm::vec2{(float)canvas.width, (float)canvas.height}, TextureUnit(0, canvas.texShadingTermSmooth, samLinearClamp),
-                RWTextureUnit(0, canvas.texGradient));
+    {
+      ag::ProfileZone<GL> zone(*device, "gradient");
+      ag::compute(
+          *device, pipelines->ppGradient,
+          ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
+          glm::vec2{(float)canvas.width, (float)canvas.height},
+          TextureUnit(0, canvas.texShadingTermSmooth, samLinearClamp),
+          RWTextureUnit(0, canvas.texGradient));
+    }
   }
 
   void updateActiveTool() {
@@ -213,76 +292,243 @@ public:
         break;
       }
     }
+    if (toolInstance)
+      toolInstance->update();
   }
 
   void render() {
     using namespace glm;
+    ag::ProfileZone<GL> frameZone(*device, "frame");
+    updateBrushTips();
     updateCamera();
     makeSceneData();
     makeCanvasData();
     ag::clear(*device, surfOut, ag::ClearColor{0.0f, 0.0f, 0.0f, 1.0f});
     ag::clearDepth(*device, surfOut, 1.0f);
-    ag::clearDepth(*device, canvas->texDepth, 1.0f);
-    ag::clear(*device, canvas->texNormals,
-              ag::ClearColor{0.0f, 0.0f, 0.0f, 1.0f});
-    ag::clear(*device, canvas->texStencil,
-              ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
-    renderMesh(*canvas);
-    renderShading(*canvas);
+    // the g-buffers and the shading term only depend on the view, the light
+    // and the mesh: they are rendered again only when one of them changes
+    if (updateShadingState()) {
+      ag::clearDepth(*device, canvas->texDepth, 1.0f);
+      ag::clear(*device, canvas->texNormals,
+                ag::ClearColor{0.0f, 0.0f, 0.0f, 1.0f});
+      ag::clear(*device, canvas->texStencil,
+                ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
+      {
+        ag::ProfileZone<GL> zone(*device, "gbuffers");
+        renderMesh(*canvas);
+      }
+      renderShading(*canvas);
+      canvas->dirty.addAll();
+      // the pixels of the histogram moved to other L dot N bins
+      canvas->shadingHistogramValid = false;
+    }
+    updateLayerStack();
     updateActiveTool();
-    if (ui->overrideShadingCurve)
+    canvas->updateLayers(*device);
+    updateHistory();
+    updateDocument();
+    updateShadingCurveRebuild(*device, *pipelines, *canvas, *ui);
+    pollShadingProfileChanges(*device, *canvas);
+    if (ui->overrideShadingCurve) {
       loadShadingCurve(*canvas);
+      if (!shadingCurveOverridden)
+        canvas->dirty.addAll();
+    }
+    shadingCurveOverridden = ui->overrideShadingCurve;
     renderCanvas();
     if (ui->showReferenceShading)
       drawShadingOverlay(*canvas);
     if (ui->showHSVOffset)
-      copyTex(canvas->texHSVOffsetUV, surfOut, width, height,
-              glm::vec2{0.0f, 0.0f}, 1.0f);
+      showTiledLayer(canvas->hsvOffsetUV);
     if (ui->showBaseColor)
-      copyTex(canvas->texBaseColorUV, surfOut, width, height,
-              glm::vec2{0.0f, 0.0f}, 1.0f);
+      showTiledLayer(canvas->baseColorUV);
+    if (ui->showOverview)
+      drawOverview(ui->overviewScale);
     if (ui->showGradient)
         copyTex(canvas->texGradient, surfOut, width, height,
                 glm::vec2{0.0f, 0.0f}, 1.0f);
-    updateBlurHist(*canvas);
-    ui->render(*device);
+    {
+      ag::ProfileZone<GL> zone(*device, "blur histogram");
+      updateBlurHist(*canvas);
+    }
+    {
+      ag::ProfileZone<GL> zone(*device, "ui");
+      ui->render(*device);
+    }
+  }
+
+  // layer selection and properties edited in the UI
+  void updateLayerStack() {
+    if (ui->addColorLayerRequested) {
+      canvas->layers.push_back(
+          std::make_unique<ColorLayer>(*device, canvas->width, canvas->height));
+      ui->activeLayer = (int)canvas->layers.size() - 1;
+    }
+    ui->addColorLayerRequested = false;
+    ui->activeLayer = std::min(std::max(ui->activeLayer, 0),
+                               (int)canvas->layers.size() - 1);
+    ui->layerCount = (int)canvas->layers.size();
+    auto layer = canvas->layers[ui->activeLayer].get();
+    if ((size_t)ui->activeLayer != canvas->activeLayer) {
+      canvas->activeLayer = (size_t)ui->activeLayer;
+      showActiveLayer();
+      return;
+    }
+    ui->activeLayerName = layer->name;
+    if (ui->layerOpacity != layer->opacity ||
+        ui->layerVisible != layer->visible) {
+      layer->opacity = ui->layerOpacity;
+      layer->visible = ui->layerVisible;
+      // the output of the layer is unchanged, but it must be blended again
+      layer->dirty.addAll();
+    }
+    if (ui->paintLayerMask)
+      layer->addMask(*device);
+  }
+
+  // shows the properties of the active layer in the UI
+  void showActiveLayer() {
+    auto layer = canvas->getActiveLayer();
+    ui->activeLayer = (int)canvas->activeLayer;
+    ui->layerCount = (int)canvas->layers.size();
+    ui->activeLayerName = layer->name;
+    ui->layerOpacity = layer->opacity;
+    ui->layerVisible = layer->visible;
+  }
+
+  // undo/redo requested by the UI, compression of the history
+  void updateHistory() {
+    bool changed = false;
+    DirtyRegion restored{canvas->width, canvas->height};
+    std::vector<TiledLayer*> restoredLayers;
+    if (ui->undoRequested)
+      changed = canvas->history.undo(*device, restored, &restoredLayers);
+    else if (ui->redoRequested)
+      changed = canvas->history.redo(*device, restored, &restoredLayers);
+    ui->undoRequested = false;
+    ui->redoRequested = false;
+    if (changed) {
+      // tiles of the layers are only evaluated again in their layer, the
+      // other tiles belong to the canvas
+      auto rects = restored.getRects();
+      for (auto tiles : restoredLayers) {
+        bool owned = false;
+        for (auto& layer : canvas->layers)
+          if (layer->ownsTiles(*tiles)) {
+            for (const auto& rect : rects)
+              layer->dirty.add(rect);
+            owned = true;
+          }
+        if (!owned)
+          for (const auto& rect : rects)
+            canvas->dirty.add(rect);
+      }
+      // the shading curve only depends on the base color
+      if (std::find(restoredLayers.begin(), restoredLayers.end(),
+                    &canvas->baseColorUV) != restoredLayers.end())
+        computeShadingCurve(*device, *pipelines, *canvas, *ui);
+    }
+    canvas->history.update(*device);
+  }
+
+  // saving and loading of the canvas, in the background
+  void updateDocument() {
+    if (saveRequested && !documentWriter) {
+      try {
+        documentWriter = std::make_unique<CanvasDocumentWriter>(
+            *device, *canvas, ui->saveFileName);
+      } catch (std::runtime_error& e) {
+        std::clog << "Could not save the canvas: " << e.what() << "\n";
+      }
+    }
+    saveRequested = false;
+    if (documentWriter && documentWriter->update()) {
+      if (!documentWriter->succeeded())
+        std::clog << "Error writing " << ui->saveFileName << "\n";
+      documentWriter.reset();
+    }
+
+    if (loadRequested) {
+      auto document = std::make_shared<CanvasDocumentFile>();
+      if (!document->open(ui->saveFileName))
+        std::clog << ui->saveFileName << " is not a valid document\n";
+      else {
+        try {
+          // the part of the canvas visible on the mesh is not known:
+          // nothing is loaded synchronously, the tiles are streamed in by
+          // the loader or loaded on demand when a layer evaluates them
+          ag::Box2D viewport{0, 0, 0, 0};
+          documentLoader = std::make_unique<CanvasDocumentLoader>(
+              *device, *canvas, std::move(document), viewport);
+          // the layer stack was replaced
+          showActiveLayer();
+        } catch (std::runtime_error& e) {
+          std::clog << "Could not load the canvas: " << e.what() << "\n";
+        }
+      }
+    }
+    loadRequested = false;
+    // the shading curve is computed from the whole base color layer: wait
+    // for all tiles
+    if (documentLoader && documentLoader->update(*device)) {
+      documentLoader.reset();
+      computeShadingCurve(*device, *pipelines, *canvas, *ui);
+    }
   }
 
   void updateCamera() {
     camera = trackball.getCamera((float)canvas->width / (float)canvas->height);
   }
 
+  // returns true if the inputs of the shading term changed since the last
+  // call
+  bool updateShadingState() {
+    auto lightPos =
+        glm::normalize(glm::vec3{ui->lightPosXY[0], ui->lightPosXY[1], -2.0f});
+    bool changed = !shadingValid || meshLoaded != lastMeshLoaded ||
+                   camera.viewMat != lastViewMat ||
+                   camera.projMat != lastProjMat || lightPos != lastLightPos;
+    shadingValid = true;
+    lastMeshLoaded = meshLoaded;
+    lastViewMat = camera.viewMat;
+    lastProjMat = camera.projMat;
+    lastLightPos = lightPos;
+    return changed;
+  }
+
   void renderCanvas() {
+    ag::ProfileZone<GL> zone(*device, "evaluate");
     auto lightPos =
         glm::normalize(glm::vec3{ui->lightPosXY[0], ui->lightPosXY[1], -2.0f});
-    ag::clear(*device, texEvalCanvas, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f});
-
-    /*if (isMakingStroke && ui->activeTool == Tool::Brush) {
-      auto brushProps = this->brushPropsFromUi();
-      // preview canvas
-      previewCanvas(*canvas, texEvalCanvasBlur,
-                    pipelines->ppEvaluatePreviewBaseColorUV, canvasData,
-                    lightPos, canvas->texStrokeMask,
-                    glm::vec4{brushProps.color[0], brushProps.color[1],
-                              brushProps.color[2], brushProps.opacity});
-    } else*/
-
-    previewCanvas(*device, *canvas, texEvalCanvasBlur, pipelines->ppEvaluate,
-                  canvasData, samLinearClamp, lightPos);
-    // blur pass
-    previewCanvas(*device, *canvas, texEvalCanvas,
-                  pipelines->ppEvaluateBlurPass, canvasData, samLinearClamp,
-                  RWTextureUnit(1, texEvalCanvasBlur));
-    // detail pass
-    /*previewCanvas(*device, *canvas, texEvalCanvasBlur,
-                  pipelines->ppEvaluateDetail, canvasData, samLinearClamp,
-                  RWTextureUnit(1, texEvalCanvas));*/
+    // only the regions modified since the last frame are evaluated and
+    // blended, the rest of texEvalCanvas is still valid
+    LayerContext context{*device,    *canvas,        *pipelines,
+                         canvasData, samLinearClamp, lightPos};
+    auto rects = compositor->composite(context, texEvalCanvas);
+    // the mip levels of the modified tiles only
+    for (const auto& rect : rects)
+      ag::generateMips(*device, texEvalCanvas, rect);
 
     copyTex(canvas->texNormals, surfOut, width, height, glm::vec2{0.0f, 0.0f},
             1.0f);
     copyTex(texEvalCanvas, surfOut, width, height, glm::vec2{0.0f, 0.0f}, 1.0f);
   }
 
+  // Draws the evaluated canvas scaled down by `scale` in the top left corner.
+  // The sampler selects the mip level matching the scale: the cost of the
+  // view is proportional to its size on screen, not to the canvas size.
+  void drawOverview(float scale) {
+    samples::Vertex2D rect[6];
+    makeCopyRect(texEvalCanvas.info.dimensions.x,
+                 texEvalCanvas.info.dimensions.y, width, height,
+                 glm::vec2{0.0f, 0.0f}, scale, rect);
+    ag::draw(*device, surfOut, ppCopyTex,
+             ag::DrawArrays(ag::PrimitiveType::Triangles,
+                            gsl::span<samples::Vertex2D>(rect)),
+             glm::vec2(width, height),
+             ag::TextureUnit(0, texEvalCanvas, samTrilinearClamp));
+  }
+
   void setupInput() {
     // on key presses
     /*input->keys().subscribe(
@@ -290,10 +536,24 @@ public:
   }
 
   void renderMesh(Canvas& canvas) {
-    drawMesh(mesh, *device, ag::SurfaceRT(canvas.texDepth, canvas.texNormals,
-                                          canvas.texStencil),
-             pipelines->ppRenderGbuffers, sceneData,
-             glm::scale(glm::mat4{1.0f}, glm::vec3{0.2f}));
+    if (!meshLoaded)
+      return;
+    auto modelMatrix = glm::scale(glm::mat4{1.0f}, glm::vec3{0.2f});
+    auto rt = ag::SurfaceRT(canvas.texDepth, canvas.texNormals,
+                            canvas.texStencil);
+    // simplified meshes when zoomed out
+    auto lod = selectMeshLod(mesh, modelMatrix, camera.viewMat,
+                             camera.projMat, (float)canvas.height);
+    if (lod != 0) {
+      drawMeshLod(mesh, lod, *device, rt, pipelines->ppRenderGbuffers,
+                  sceneData, modelMatrix);
+      return;
+    }
+    // only the clusters visible from the camera are drawn
+    cullMeshClusters(mesh, *device, ppCullMeshClusters, modelMatrix,
+                     camera.viewMat, camera.projMat);
+    drawMeshClusters(mesh, *device, rt, pipelines->ppRenderGbuffers,
+                     sceneData, modelMatrix);
   }
 
 
@@ -313,6 +573,27 @@ public:
              canvas.texShadingProfileLN);
   }
 
+  // copies a tiled layer to texTiledLayerView and draws it
+  // The view of the layer is refreshed kTileBatchSize tiles per frame, so
+  // that it stays within the residency budget of the layer.
+  void showTiledLayer(TiledLayer& layer) {
+    auto tileCount = layer.tilesX * layer.tilesY;
+    auto batchSize = std::min(kTileBatchSize, tileCount);
+    std::vector<ag::Box2D> rects;
+    for (unsigned i = 0; i < batchSize; ++i) {
+      auto rect = layer.getTileRect((tiledLayerViewTile + i) % tileCount);
+      layer.makeResident(*device, rect);
+      rects.push_back(rect);
+    }
+    tiledLayerViewTile = (tiledLayerViewTile + batchSize) % tileCount;
+    computeOverRects(*device, pipelines->ppResolveTiles, rects,
+                     RWTextureUnit(0, layer.tiles),
+                     RWTextureUnit(1, layer.pageTable),
+                     RWTextureUnit(2, texTiledLayerView));
+    copyTex(texTiledLayerView, surfOut, width, height, glm::vec2{0.0f, 0.0f},
+            1.0f);
+  }
+
   void drawShadingOverlay(Canvas& canvas) {
     copyTex(canvas.texShadingTermSmooth, surfOut, width, height,
             glm::vec2{0.0f, 0.0f}, 1.0f);
@@ -336,6 +617,20 @@ private:
   std::unique_ptr<Canvas> canvas;
   // mesh
   Mesh mesh;
+  bool meshLoaded = false;
+  // inputs of the last rendering of the shading term
+  bool shadingValid = false;
+  bool lastMeshLoaded = false;
+  glm::mat4 lastViewMat;
+  glm::mat4 lastProjMat;
+  glm::vec3 lastLightPos;
+  bool shadingCurveOverridden = false;
+  // brush tips
+  std::unique_ptr<image_io::BatchTextureLoader<GL>> brushTipLoader;
+  std::vector<std::pair<std::string, std::future<Texture2D<ag::RGBA8>>>>
+      pendingBrushTips;
+  // tips loaded since the atlas was last built
+  bool brushTipsAdded = false;
   // UI
   std::unique_ptr<Ui> ui;
   // input
@@ -348,8 +643,12 @@ private:
   std::unique_ptr<ToolInstance> toolInstance;
 
   // evaluated canvas
-  Texture2D<ag::RGBA8> texEvalCanvasBlur;
+  std::unique_ptr<LayerCompositor> compositor;
   Texture2D<ag::RGBA8> texEvalCanvas;
+  // debug views of tiled layers
+  Texture2D<ag::RGBA8> texTiledLayerView;
+  // next tile refreshed in texTiledLayerView
+  unsigned tiledLayerViewTile = 0;
 
   Buffer<samples::Vertex2D[]> vboQuad;
 
@@ -364,6 +663,13 @@ private:
   /////////// Brush tool state
   // current brush path
   BrushPath brushPath;
+
+  /////////// Documents (set by the Save/Load buttons)
+  bool saveRequested = false;
+  bool loadRequested = false;
+  // save or load in progress
+  std::unique_ptr<CanvasDocumentWriter> documentWriter;
+  std::unique_ptr<CanvasDocumentLoader> documentLoader;
 };
 
 #endif
@@ -24,6 +24,8 @@ struct Splat {
   glm::vec2 center;
   float width;
   float smoothness;
+  // location of the tip in the brush tip atlas (offset, size)
+  glm::vec4 tipUVRect;
 };
 }
 
@@ -37,12 +39,16 @@ struct Pipelines {
         loadShaderSource(samplesRoot / "simple/glsl/normal_map.glsl");
     ShaderSource draw_stroke_mask =
         loadShaderSource(samplesRoot / "simple/glsl/draw_stroke_mask.glsl");
+    ShaderSource stroke_mask =
+        loadShaderSource(samplesRoot / "simple/glsl/stroke_mask.glsl");
     ShaderSource flatten_stroke =
         loadShaderSource(samplesRoot / "simple/glsl/flatten_stroke.glsl");
     ShaderSource evaluate =
         loadShaderSource(samplesRoot / "simple/glsl/evaluate.glsl");
     ShaderSource curves =
         loadShaderSource(samplesRoot / "simple/glsl/shading_curve.glsl");
+    ShaderSource curves_smooth =
+        loadShaderSource(samplesRoot / "simple/glsl/shading_curve_smooth.glsl");
     ShaderSource shading_overlay =
         loadShaderSource(samplesRoot / "simple/glsl/shading_overlay.glsl");
     ShaderSource smudge =
@@ -52,6 +58,10 @@ struct Pipelines {
     ShaderSource blur = loadShaderSource(samplesRoot / "simple/glsl/blur.glsl");
     ShaderSource blur_brush = loadShaderSource(samplesRoot / "simple/glsl/blur_brush.glsl");
     ShaderSource gradient = loadShaderSource(samplesRoot / "simple/glsl/gradient.glsl");
+    ShaderSource resolve_tiles =
+        loadShaderSource(samplesRoot / "simple/glsl/resolve_tiles.glsl");
+    ShaderSource layer_blend =
+        loadShaderSource(samplesRoot / "simple/glsl/layer_blend.glsl");
 
     {
       GraphicsPipelineInfo g;
@@ -69,18 +79,17 @@ struct Pipelines {
           draw_stroke_mask.preprocess(PipelineStage::Pixel, nullptr, nullptr);
       g.VSSource = VSSource.c_str();
       g.PSSource = PSSource.c_str();
-      ppDrawRoundSplatToStrokeMask = device.createGraphicsPipeline(g);
-
-      const char *defines[] = {"TEXTURED"};
-      VSSource =
-          draw_stroke_mask.preprocess(PipelineStage::Vertex, defines, nullptr);
-      PSSource =
-          draw_stroke_mask.preprocess(PipelineStage::Pixel, defines, nullptr);
-      g.VSSource = VSSource.c_str();
-      g.PSSource = PSSource.c_str();
       ppDrawTexturedSplatToStrokeMask = device.createGraphicsPipeline(g);
     }
 
+    {
+      ComputePipelineInfo c;
+      auto CSSource =
+          stroke_mask.preprocess(PipelineStage::Compute, nullptr, nullptr);
+      c.CSSource = CSSource.c_str();
+      ppRasterizeStroke = device.createComputePipeline(c);
+    }
+
     {
       GraphicsPipelineInfo g;
       g.depthStencilState.depthTestEnable = true;
@@ -170,10 +179,18 @@ struct Pipelines {
 
     {
       ComputePipelineInfo c;
+      // shaders of the extras (histogram/glsl/histogram.glsl)
+      auto extraShaders = (samplesRoot.parent_path() / "src/extra").str();
+      const char *includePaths[] = {extraShaders.c_str()};
       auto CSSource =
-          curves.preprocess(PipelineStage::Compute, nullptr, nullptr);
+          curves.preprocess(PipelineStage::Compute, nullptr, includePaths);
       c.CSSource = CSSource.c_str();
       ppComputeShadingCurveHSV = device.createComputePipeline(c);
+
+      CSSource =
+          curves_smooth.preprocess(PipelineStage::Compute, nullptr, nullptr);
+      c.CSSource = CSSource.c_str();
+      ppSmoothShadingCurve = device.createComputePipeline(c);
     }
 
     {
@@ -192,6 +209,35 @@ struct Pipelines {
       ppBlurBrush = device.createComputePipeline(c);
     }
 
+    {
+      ComputePipelineInfo c;
+      auto CSSource =
+          resolve_tiles.preprocess(PipelineStage::Compute, nullptr, nullptr);
+      c.CSSource = CSSource.c_str();
+      ppResolveTiles = device.createComputePipeline(c);
+    }
+
+    {
+      ComputePipelineInfo c;
+      const char *defines_over[] = {"BLEND_OVER"};
+      auto CSSource =
+          layer_blend.preprocess(PipelineStage::Compute, defines_over, nullptr);
+      c.CSSource = CSSource.c_str();
+      ppBlendLayerOver = device.createComputePipeline(c);
+
+      const char *defines_under[] = {"BLEND_UNDER"};
+      CSSource =
+          layer_blend.preprocess(PipelineStage::Compute, defines_under, nullptr);
+      c.CSSource = CSSource.c_str();
+      ppBlendLayerUnder = device.createComputePipeline(c);
+
+      const char *defines_final[] = {"BLEND_FINAL"};
+      CSSource =
+          layer_blend.preprocess(PipelineStage::Compute, defines_final, nullptr);
+      c.CSSource = CSSource.c_str();
+      ppBlendLayerFinal = device.createComputePipeline(c);
+    }
+
     {
       ComputePipelineInfo c;
 
@@ -215,14 +261,19 @@ struct Pipelines {
   // Compute the average shading curve
   // [shading_curve.glsl]
   ComputePipeline ppComputeShadingCurveHSV;
+  // Average, smooth and pack the shading curve into the shading profile
+  // [shading_curve_smooth.glsl]
+  ComputePipeline ppSmoothShadingCurve;
 
   // Compute the lit-sphere
   // ComputePipeline ppComputeLitSphere;
 
-  // Draw stroke mask
+  // Draw stroke mask (textured tips)
   // [draw_stroke_mask.glsl]
-  GraphicsPipeline ppDrawRoundSplatToStrokeMask;
   GraphicsPipeline ppDrawTexturedSplatToStrokeMask;
+  // all the segments of a frame with a round tip
+  // [stroke_mask.glsl]
+  ComputePipeline ppRasterizeStroke;
 
   // Shading overlay
   GraphicsPipeline ppShadingOverlay;
@@ -249,6 +300,19 @@ struct Pipelines {
   // [blur_brush.glsl]
   ComputePipeline ppBlurBrush;
 
+  // Copy a tiled layer to a texture
+  // [resolve_tiles.glsl]
+  ComputePipeline ppResolveTiles;
+
+  // Layer compositor
+  // [layer_blend.glsl]
+  // blend a layer over the composite of the layers below
+  ComputePipeline ppBlendLayerOver;
+  // blend a layer under the composite of the layers above
+  ComputePipeline ppBlendLayerUnder;
+  // blend the active layer between the two
+  ComputePipeline ppBlendLayerFinal;
+
   // Process passes
   // [process_dynamic_color.glsl]
   ComputePipeline ppProcessDynamicColor;
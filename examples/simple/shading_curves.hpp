@@ -1,84 +1,184 @@
 #ifndef SHADING_CURVES_HPP
 #define SHADING_CURVES_HPP
 
+#include <autograph/copy.hpp>
+#include <autograph/profiler.hpp>
+
 #include "canvas.hpp"
 #include "pipelines.hpp"
 #include "ui.hpp"
 
-// compute shading curve from the base color layer, alse update UI
-void computeShadingCurve(Device& device, Pipelines& pipelines, Canvas& canvas,
-                         Ui& ui) {
-  // workaround
-  ag::ClearColorInt clear = {{0, 0, 0, 0}};
-  ag::clearInteger(device, canvas.texHistH, clear);
-  ag::clearInteger(device, canvas.texHistS, clear);
-  ag::clearInteger(device, canvas.texHistV, clear);
-  ag::clearInteger(device, canvas.texHistAccum, clear);
+inline glm::vec3 getLightDirection(const Ui& ui) {
+  return glm::normalize(glm::vec3{ui.lightPosXY[0], ui.lightPosXY[1], -2.0f});
+}
 
-  ag::compute(
+// Adds (weight = 1) or subtracts (weight = -1) the base color of `rect` to
+// the shading curve histogram
+void accumulateShadingHistogram(Device& device, Pipelines& pipelines,
+                                Canvas& canvas, const ag::Box2D& rect,
+                                int weight) {
+  canvas.baseColorUV.makeResident(device, rect);
+  RegionUniforms region{glm::ivec2{(int)rect.xmin, (int)rect.ymin},
+                        glm::ivec2{(int)rect.width(), (int)rect.height()}};
+  canvas.shadingHistogram.accumulate(
       device, pipelines.ppComputeShadingCurveHSV,
-      ag::makeThreadGroupCount2D(canvas.width, canvas.height, 16, 16),
-      glm::vec2 {canvas.width, canvas.height},
-      glm::normalize(glm::vec3{ui.lightPosXY[0], ui.lightPosXY[1], -2.0f}),
-      canvas.texNormals, canvas.texStencil, canvas.texBaseColorUV,
-      RWTextureUnit(0, canvas.texHistH), RWTextureUnit(1, canvas.texHistS),
-      RWTextureUnit(2, canvas.texHistV), RWTextureUnit(3, canvas.texHistAccum));
+      ag::makeThreadGroupCount2D(rect.width(), rect.height(),
+                                 kCSThreadGroupSizeX, kCSThreadGroupSizeY),
+      glm::vec2{canvas.width, canvas.height}, canvas.shadingHistogramLight,
+      weight, canvas.texNormals, canvas.texStencil,
+      RWTextureUnit(4, canvas.baseColorUV.tiles),
+      RWTextureUnit(5, canvas.baseColorUV.pageTable),
+      ag::Uniform(kRegionUniformSlot, region));
+}
 
-  // read back histograms
-  std::vector<uint32_t> histH(kShadingCurveSamplesSize),
-      histS(kShadingCurveSamplesSize), histV(kShadingCurveSamplesSize),
-      histAccum(kShadingCurveSamplesSize);
-  std::vector<ag::RGBA8> HSVCurve(kShadingCurveSamplesSize);
-  ag::copySync(device, canvas.texHistH, gsl::as_span(histH));
-  ag::copySync(device, canvas.texHistS, gsl::as_span(histS));
-  ag::copySync(device, canvas.texHistV, gsl::as_span(histV));
-  ag::copySync(device, canvas.texHistAccum, gsl::as_span(histAccum));
+// Averages and smooths the histogram into the shading profile, and updates
+// the UI plots asynchronously when the GPU has finished.
+void packShadingCurve(Device& device, Pipelines& pipelines, Canvas& canvas,
+                      Ui& ui) {
+  ag::compute(device, pipelines.ppSmoothShadingCurve, ag::ThreadGroupCount{1},
+              ag::RWBufferUnit(0, canvas.shadingHistogram.getBins()),
+              ag::RWBufferUnit(1, canvas.shadingProfileChanged),
+              RWTextureUnit(0, canvas.texShadingProfileLN));
+  ag::memoryBarrier(device);
 
-  for (unsigned i = 0; i < kShadingCurveSamplesSize; ++i) {
-    if (histAccum[i]) {
-      ui.histH[i] = float(histH[i]) / (255.0f * float(histAccum[i]));
-      ui.histS[i] = float(histS[i]) / (255.0f * float(histAccum[i]));
-      ui.histV[i] = float(histV[i]) / (255.0f * float(histAccum[i]));
-    } else {
-      ui.histH[i] = 0.0f;
-      ui.histS[i] = 0.0f;
-      ui.histV[i] = 0.0f;
-    }
+  // plot the average H, S, V of each bin, a frame late; skipped if the
+  // previous readback is still in flight
+  canvas.shadingHistogram.readbackAsync(
+      device, [&ui](gsl::span<const uint32_t> bins) {
+        for (unsigned i = 0; i < kShadingCurveSamplesSize; ++i) {
+          auto bin = i * kShadingHistogramChannels;
+          auto count = bins[bin + 3];
+          if (count) {
+            ui.histH[i] = float(bins[bin]) / (255.0f * float(count));
+            ui.histS[i] = float(bins[bin + 1]) / (255.0f * float(count));
+            ui.histV[i] = float(bins[bin + 2]) / (255.0f * float(count));
+          } else {
+            ui.histH[i] = 0.0f;
+            ui.histS[i] = 0.0f;
+            ui.histV[i] = 0.0f;
+          }
+        }
+      });
+}
+
+// The shading profile is used for all pixels, but most strokes do not
+// change it at 8-bit precision: the whole canvas is evaluated again only
+// when ppSmoothShadingCurve reports a change, a frame late. Call once per
+// frame.
+void pollShadingProfileChanges(Device& device, Canvas& canvas) {
+  if (canvas.shadingProfileReadbackPending)
+    return;
+  if (!canvas.shadingProfileChangedData) {
+    canvas.shadingProfileChangedReadback =
+        device.createReadbackBuffer(sizeof(uint32_t));
+    canvas.shadingProfileChangedData = (const uint32_t*)device.mapReadbackBuffer(
+        canvas.shadingProfileChangedReadback);
+  }
+  RawBufferSlice src{canvas.shadingProfileChanged.handle.get(), 0,
+                     sizeof(uint32_t)};
+  RawBufferSlice dest{canvas.shadingProfileChangedReadback.handle.get(), 0,
+                      sizeof(uint32_t)};
+  ag::copy(device, src, dest);
+  ag::clear(device, canvas.shadingProfileChanged);
+  canvas.shadingProfileReadbackPending = true;
+  std::weak_ptr<bool> weakAlive = canvas.alive;
+  device.onFrameComplete([&canvas, weakAlive]() {
+    if (!weakAlive.lock())
+      return;
+    canvas.shadingProfileReadbackPending = false;
+    if (*canvas.shadingProfileChangedData)
+      canvas.dirty.addAll();
+  });
+}
+
+// Accumulates the next kTileBatchSize tiles of the base color into the
+// histogram being rebuilt, and packs the shading profile once all tiles are
+// done. Call once per frame.
+void updateShadingCurveRebuild(Device& device, Pipelines& pipelines,
+                               Canvas& canvas, Ui& ui) {
+  if (!canvas.shadingHistogramRebuilding)
+    return;
+  ag::ProfileZone<GL> zone(device, "histogram");
+  auto& queue = canvas.shadingHistogramRebuildQueue;
+  for (unsigned i = 0; i < kTileBatchSize && !queue.empty(); ++i) {
+    auto tile = queue.back();
+    queue.pop_back();
+    accumulateShadingHistogram(device, pipelines, canvas,
+                               canvas.baseColorUV.getTileRect(tile), 1);
+    canvas.shadingHistogramTileDone[tile] = true;
   }
+  if (!queue.empty())
+    return;
+  canvas.shadingHistogramRebuilding = false;
+  packShadingCurve(device, pipelines, canvas, ui);
+}
 
-  static constexpr float gaussK[] = {
-      0.000027f, 0.00006f,  0.000125f, 0.000251f, 0.000484f, 0.000898f,
-      0.001601f, 0.002743f, 0.004515f, 0.007141f, 0.010853f, 0.01585f,
-      0.022243f, 0.029995f, 0.038867f, 0.048396f, 0.057906f, 0.066577f,
-      0.073554f, 0.078087f, 0.079659f, 0.078087f, 0.073554f, 0.066577f,
-      0.057906f, 0.048396f, 0.038867f, 0.029995f, 0.022243f, 0.01585f,
-      0.010853f, 0.007141f, 0.004515f, 0.002743f, 0.001601f, 0.000898f,
-      0.000484f, 0.000251f, 0.000125f, 0.00006f,  0.000027f};
+// Compute the shading curve from the base color layer, and pack it into the
+// shading profile. Everything stays on the GPU: the histogram of the canvas
+// is accumulated per-workgroup in shared memory (GpuHistogram), then
+// averaged and smoothed by ppSmoothShadingCurve.
+// The tiles of the canvas are accumulated in batches over the next frames
+// (see updateShadingCurveRebuild), so that the pass stays within the
+// residency budget of the base color layer.
+void computeShadingCurve(Device& device, Pipelines& pipelines, Canvas& canvas,
+                         Ui& ui) {
+  canvas.shadingHistogramLight = getLightDirection(ui);
+  canvas.shadingHistogram.clear(device);
+  auto tileCount = canvas.baseColorUV.tilesX * canvas.baseColorUV.tilesY;
+  canvas.shadingHistogramRebuildQueue.resize(tileCount);
+  for (unsigned tile = 0; tile < tileCount; ++tile)
+    canvas.shadingHistogramRebuildQueue[tile] = tileCount - 1 - tile;
+  canvas.shadingHistogramTileDone.assign(tileCount, false);
+  canvas.shadingHistogramRebuilding = true;
+  canvas.shadingHistogramValid = true;
+  canvas.shadingHistogramUpdates = 0;
+  updateShadingCurveRebuild(device, pipelines, canvas, ui);
+}
 
-  // smooth them (a lot)
-  for (int i = 0; i < kShadingCurveSamplesSize; ++i) {
-    float ah = 0.0f;
-    float as = 0.0f;
-    float av = 0.0f;
-    for (int w = -20; w < +20; w++) {
-      int x = glm::clamp(i + w, 0, (int)kShadingCurveSamplesSize - 1);
-      ah += ui.histH[x] * gaussK[w + 20];
-      as += ui.histS[x] * gaussK[w + 20];
-      av += ui.histV[x] * gaussK[w + 20];
+// Incremental update of the shading curve around a modification of the base
+// color in `rect`: call beginShadingCurveUpdate before, and
+// endShadingCurveUpdate after. The cost is proportional to the area of
+// `rect`; the histogram is recomputed from the whole canvas every
+// kShadingHistogramRebuildInterval updates, or if it is not up to date.
+// During a rebuild, the tiles of `rect` already accumulated are removed from
+// the histogram and queued again.
+void beginShadingCurveUpdate(Device& device, Pipelines& pipelines,
+                             Canvas& canvas, Ui& ui, const ag::Box2D& rect) {
+  if (!canvas.shadingHistogramValid ||
+      canvas.shadingHistogramLight != getLightDirection(ui) ||
+      canvas.shadingHistogramUpdates >= kShadingHistogramRebuildInterval) {
+    // recomputed at the end
+    canvas.shadingHistogramValid = false;
+    return;
+  }
+  ag::ProfileZone<GL> zone(device, "histogram (remove)");
+  if (canvas.shadingHistogramRebuilding) {
+    for (auto tile : canvas.baseColorUV.getTiles(rect)) {
+      if (!canvas.shadingHistogramTileDone[tile])
+        continue;
+      accumulateShadingHistogram(device, pipelines, canvas,
+                                 canvas.baseColorUV.getTileRect(tile), -1);
+      canvas.shadingHistogramTileDone[tile] = false;
+      canvas.shadingHistogramRebuildQueue.push_back(tile);
     }
-    ui.histH[i] = ah;
-    ui.histS[i] = as;
-    ui.histV[i] = av;
-    HSVCurve[i][0].value = (uint8_t)(ah * 255.0f);
-    HSVCurve[i][1].value = (uint8_t)(as * 255.0f);
-    HSVCurve[i][2].value = (uint8_t)(av * 255.0f);
-    HSVCurve[i][3].value = 255;
+    return;
   }
+  accumulateShadingHistogram(device, pipelines, canvas, rect, -1);
+}
 
-  // write back
-  ag::copy(device, gsl::span<const ag::RGBA8>((const ag::RGBA8*)HSVCurve.data(),
-                                              HSVCurve.size()),
-           canvas.texShadingProfileLN);
+void endShadingCurveUpdate(Device& device, Pipelines& pipelines,
+                           Canvas& canvas, Ui& ui, const ag::Box2D& rect) {
+  if (!canvas.shadingHistogramValid) {
+    computeShadingCurve(device, pipelines, canvas, ui);
+    return;
+  }
+  // queued by beginShadingCurveUpdate
+  if (canvas.shadingHistogramRebuilding)
+    return;
+  ag::ProfileZone<GL> zone(device, "histogram (add)");
+  accumulateShadingHistogram(device, pipelines, canvas, rect, 1);
+  ++canvas.shadingHistogramUpdates;
+  packShadingCurve(device, pipelines, canvas, ui);
 }
 
 #endif
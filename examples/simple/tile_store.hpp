@@ -0,0 +1,100 @@
+#ifndef TILE_STORE_HPP
+#define TILE_STORE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <autograph/error.hpp>
+#include <filesystem/path.h>
+
+///////////////////////////////////////
+// TileBackingStore
+// Scratch file holding the tiles of a layer that were evicted from GPU
+// memory. The file has one slot per tile of the layer, at a fixed offset,
+// and is mapped in memory: writes go to the page cache and are flushed to
+// disk by the OS when memory is needed.
+// The file is created (sparse) on the first write and deleted with the
+// store.
+class TileBackingStore {
+public:
+  TileBackingStore(size_t tileBytes_, unsigned tileCount_)
+      : tileBytes(tileBytes_), tileCount(tileCount_) {}
+
+  ~TileBackingStore() {
+    region = boost::interprocess::mapped_region{};
+    file = boost::interprocess::file_mapping{};
+    if (!path.empty())
+      path.remove_file();
+  }
+
+  TileBackingStore(const TileBackingStore&) = delete;
+  TileBackingStore& operator=(const TileBackingStore&) = delete;
+
+  void write(unsigned tile, const void* data) {
+    if (!region.get_address())
+      create();
+    memcpy(getSlot(tile), data, tileBytes);
+  }
+
+  // contents of a slot previously written with write()
+  const void* read(unsigned tile) const {
+    if (!region.get_address())
+      ag::failWith("Reading a tile that was never written to the store");
+    return getSlot(tile);
+  }
+
+  size_t getTileBytes() const { return tileBytes; }
+
+private:
+  void create() {
+    namespace bip = boost::interprocess;
+    // unique name: creation time, and a counter for the stores created at
+    // the same time
+    static std::atomic<unsigned> storeCount{0};
+    auto name = "autograph-tiles-" +
+                std::to_string(std::chrono::system_clock::now()
+                                   .time_since_epoch()
+                                   .count()) +
+                "-" + std::to_string(storeCount++) + ".bin";
+    path = getTempDirectory() / filesystem::path{name};
+    FILE* f = fopen(path.str().c_str(), "wb");
+    if (!f)
+      ag::failWith("Could not create the tile backing file " + path.str());
+    fclose(f);
+    if (!path.resize_file((size_t)tileBytes * tileCount))
+      ag::failWith("Could not resize the tile backing file " + path.str());
+    try {
+      file = bip::file_mapping{path.str().c_str(), bip::read_write};
+      region = bip::mapped_region{file, bip::read_write};
+    } catch (bip::interprocess_exception& e) {
+      ag::failWith(std::string{"Could not map the tile backing file: "} +
+                   e.what());
+    }
+  }
+
+  static filesystem::path getTempDirectory() {
+    for (auto var : {"TMPDIR", "TMP", "TEMP"})
+      if (auto dir = std::getenv(var))
+        return filesystem::path{dir};
+    return filesystem::path::getcwd();
+  }
+
+  char* getSlot(unsigned tile) const {
+    return (char*)region.get_address() + (size_t)tile * tileBytes;
+  }
+
+  size_t tileBytes;
+  unsigned tileCount;
+  filesystem::path path;
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+};
+
+#endif // !TILE_STORE_HPP
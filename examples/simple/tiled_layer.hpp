@@ -0,0 +1,569 @@
+#ifndef TILED_LAYER_HPP
+#define TILED_LAYER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <autograph/copy.hpp>
+#include <autograph/draw.hpp>
+#include <autograph/error.hpp>
+
+#include "dirty_region.hpp"
+#include "tile_store.hpp"
+#include "types.hpp"
+
+// size of the tiles of tiled layers, must match TILE_SIZE in
+// glsl/tiled_layer.glsl
+constexpr unsigned kCanvasTileSize = 256;
+// initial number of tiles in the tile pool of a layer
+constexpr unsigned kInitialTilePoolSize = 16;
+// GL_MAX_ARRAY_TEXTURE_LAYERS is at least 2048
+constexpr unsigned kMaxTilePoolSize = 2048;
+// page table entry of unallocated tiles
+constexpr uint32_t kNoTile = 0;
+// number of tiles that can be in flight to the backing store at once
+constexpr unsigned kTileReadbackSlots = 16;
+constexpr size_t kCanvasTileBytes = kCanvasTileSize * kCanvasTileSize * 4;
+
+// counters of the tile paging of a layer, since its creation
+struct TilePagingStats {
+  // tile accesses (makeResident) that found the tile in GPU memory
+  uint64_t hits = 0;
+  // tile accesses that had to read the tile from the backing store
+  uint64_t misses = 0;
+  // tiles read ahead of their use by prefetch
+  uint64_t prefetches = 0;
+  uint64_t bytesPagedOut = 0;
+  uint64_t bytesPagedIn = 0;
+};
+
+///////////////////////////////////////
+// TiledLayer
+// Sparse RGBA8 canvas layer.
+// The layer is divided in kCanvasTileSize^2 tiles, stored in the layers of a
+// texture array (the tile pool). The page table maps the coordinates of a tile
+// to its layer in the pool plus one, or kNoTile if the tile is not allocated.
+// Tiles are allocated on first write (call allocate before dispatching a
+// shader that writes to the layer), unallocated tiles read as transparent
+// black. Memory usage thus depends on the painted area, not on the size of the
+// layer.
+// Shaders access the layer with the macros of glsl/tiled_layer.glsl.
+//
+// With a residency budget (setResidencyBudget), the least recently used tiles
+// over the budget are paged out to a scratch file (TileBackingStore): they are
+// read back asynchronously, and removed from the pool once the copy has
+// completed. Paged out tiles read as unallocated in shaders: call
+// makeResident on the region read by a pass before dispatching it (allocate
+// pages tiles in as well). prefetch reads paged out tiles from the file in
+// the background, ahead of their use.
+// Tiles can also be pending (setPendingTiles): their contents are produced by
+// a TileLoader (e.g. read from a document) when they are first used.
+// Nonmovable: pending page-outs refer to the layer.
+class TiledLayer {
+public:
+  // writes the kCanvasTileBytes of pixel data of a tile to `pixels`
+  using TileLoader = std::function<void(unsigned tile, void* pixels)>;
+
+  TiledLayer(Device& device, unsigned width_, unsigned height_)
+      : width(width_), height(height_),
+        tilesX((width_ + kCanvasTileSize - 1) / kCanvasTileSize),
+        tilesY((height_ + kCanvasTileSize - 1) / kCanvasTileSize),
+        pages(tilesX * tilesY, kNoTile), tileStates(tilesX * tilesY),
+        store(kCanvasTileBytes, tilesX * tilesY),
+        alive(std::make_shared<bool>(true)) {
+    tiles = device.createTexture2DArray<ag::RGBA8>(
+        glm::uvec2{kCanvasTileSize, kCanvasTileSize}, kInitialTilePoolSize);
+    for (unsigned i = kInitialTilePoolSize; i > 0; --i)
+      freeTiles.push_back(i - 1);
+    pageTable = device.createTexture2D<ag::R32UI>(glm::uvec2{tilesX, tilesY});
+    uploadPageTable(device);
+  }
+
+  TiledLayer(const TiledLayer&) = delete;
+  TiledLayer& operator=(const TiledLayer&) = delete;
+
+  // Allocates the tiles overlapping `rect` (in pixels) that are not
+  // allocated yet. New tiles are cleared to transparent black, paged out
+  // tiles are paged in.
+  void allocate(Device& device, const ag::Box2D& rect) {
+    forEachTile(rect, [&](unsigned tx, unsigned ty) {
+      auto tile = ty * tilesX + tx;
+      touchTile(device, tile);
+      if (pages[tile] == kNoTile)
+        allocateTile(device, tile);
+    });
+    if (pageTableDirty)
+      uploadPageTable(device);
+  }
+
+  // Allocates the tiles overlapping `rect` that are allocated in `other`
+  // (a layer of the same size)
+  void allocateLike(Device& device, const TiledLayer& other,
+                    const ag::Box2D& rect) {
+    forEachTile(rect, [&](unsigned tx, unsigned ty) {
+      auto tile = ty * tilesX + tx;
+      touchTile(device, tile);
+      if (pages[tile] == kNoTile && other.hasTile(tx, ty))
+        allocateTile(device, tile);
+    });
+    if (pageTableDirty)
+      uploadPageTable(device);
+  }
+
+  // Pages in the tiles overlapping `rect` that were paged out, and marks the
+  // tiles as used in this frame.
+  void makeResident(Device& device, const ag::Box2D& rect) {
+    forEachTile(rect, [&](unsigned tx, unsigned ty) {
+      touchTile(device, ty * tilesX + tx);
+    });
+    if (pageTableDirty)
+      uploadPageTable(device);
+  }
+
+  // Starts reading the paged out tiles overlapping `rect` from the backing
+  // store in the background. They are uploaded by update once read.
+  void prefetch(const ag::Box2D& rect) {
+    forEachTile(rect, [&](unsigned tx, unsigned ty) {
+      auto tile = ty * tilesX + tx;
+      if (!tileStates[tile].pagedOut || prefetches.count(tile))
+        return;
+      const char* src = (const char*)store.read(tile);
+      prefetches[tile] = std::async(std::launch::async, [src]() {
+        return std::vector<char>(src, src + kCanvasTileBytes);
+      });
+      ++stats.prefetches;
+    });
+  }
+
+  // Maximum number of tiles kept in GPU memory, 0 for no limit.
+  // Tiles used in the current frame are never paged out, so the budget can
+  // be exceeded temporarily.
+  void setResidencyBudget(unsigned maxResidentTiles) {
+    residencyBudget = maxResidentTiles;
+  }
+
+  // Call once per frame: uploads the prefetched tiles, starts paging out
+  // the least recently used tiles over the budget, and shrinks the tile pool
+  // when most of it is unused.
+  void update(Device& device) {
+    ++frame;
+    for (auto it = prefetches.begin(); it != prefetches.end();) {
+      if (it->second.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+        ++it;
+        continue;
+      }
+      auto tile = it->first;
+      auto data = it->second.get();
+      it = prefetches.erase(it);
+      pageIn(device, tile, data.data());
+      tileStates[tile].lastUse = frame;
+    }
+    if (residencyBudget)
+      pageOutTiles(device);
+    shrinkPool(device);
+    if (pageTableDirty)
+      uploadPageTable(device);
+  }
+
+  // allocated, in GPU memory, paged out or pending
+  bool hasTile(unsigned tx, unsigned ty) const {
+    if (tx >= tilesX || ty >= tilesY)
+      return false;
+    auto tile = ty * tilesX + tx;
+    return pages[tile] != kNoTile || tileStates[tile].pagedOut ||
+           tileStates[tile].pending;
+  }
+
+  // number of tiles in GPU memory
+  unsigned getTileCount() const {
+    return tiles.info.layers - (unsigned)freeTiles.size();
+  }
+
+  const TilePagingStats& getPagingStats() const { return stats; }
+
+  ////////////////////////// Per-tile access
+  // (tiles are designated by their index, ty * tilesX + tx)
+
+  // indices of the tiles overlapping `rect`
+  std::vector<unsigned> getTiles(const ag::Box2D& rect) const {
+    std::vector<unsigned> out;
+    forEachTile(rect, [&](unsigned tx, unsigned ty) {
+      out.push_back(ty * tilesX + tx);
+    });
+    return out;
+  }
+
+  // pixels covered by a tile, clipped to the layer
+  ag::Box2D getTileRect(unsigned tile) const {
+    auto x = (tile % tilesX) * kCanvasTileSize;
+    auto y = (tile / tilesX) * kCanvasTileSize;
+    return clipRect(ag::Box2D{x, y, x + kCanvasTileSize, y + kCanvasTileSize},
+                    width, height);
+  }
+
+  bool isTileAllocated(unsigned tile) const {
+    return hasTile(tile % tilesX, tile / tilesX);
+  }
+
+  // Copies an allocated tile to a layer of `dest` (pages it in if needed)
+  void copyTile(Device& device, unsigned tile,
+                Texture2DArray<ag::RGBA8>& dest, unsigned destLayer) {
+    touchTile(device, tile);
+    if (pageTableDirty)
+      uploadPageTable(device);
+    auto layer = pages[tile] - 1;
+    ag::copy(device, tiles,
+             ag::Box3D{0, 0, layer, kCanvasTileSize, kCanvasTileSize,
+                       layer + 1},
+             dest, glm::uvec3{0, 0, destLayer});
+  }
+
+  // Copies a resident tile to `dest` at `offset` (kCanvasTileBytes)
+  void readbackTile(Device& device, unsigned tile, RawBuffer& dest,
+                    size_t offset) {
+    auto layer = pages[tile] - 1;
+    RawBufferSlice slice{dest.handle.get(), offset, kCanvasTileBytes};
+    ag::copy(device, tiles, slice,
+             ag::Box3D{0, 0, layer, kCanvasTileSize, kCanvasTileSize,
+                       layer + 1});
+  }
+
+  // Replaces the contents of a tile (allocating it if needed) with a layer
+  // of `src`
+  void restoreTile(Device& device, unsigned tile,
+                   const Texture2DArray<ag::RGBA8>& src, unsigned srcLayer) {
+    auto layer = getWritableLayer(device, tile);
+    ag::copy(device, src,
+             ag::Box3D{0, 0, srcLayer, kCanvasTileSize, kCanvasTileSize,
+                       srcLayer + 1},
+             tiles, glm::uvec3{0, 0, layer});
+    if (pageTableDirty)
+      uploadPageTable(device);
+  }
+
+  // Same as above with kCanvasTileBytes of pixel data in CPU memory
+  void restoreTile(Device& device, unsigned tile, const void* data) {
+    uploadTile(device, getWritableLayer(device, tile), data);
+    if (pageTableDirty)
+      uploadPageTable(device);
+  }
+
+  // deallocates a tile, it reads as transparent black again
+  void freeTile(Device& device, unsigned tile) {
+    dropContents(tile);
+    touchTile(device, tile);
+    if (pages[tile] != kNoTile) {
+      freeTiles.push_back(pages[tile] - 1);
+      pages[tile] = kNoTile;
+      uploadPageTable(device);
+    }
+  }
+
+  // deallocates all tiles
+  void freeAllTiles(Device& device) {
+    for (unsigned tile = 0; tile < pages.size(); ++tile) {
+      dropContents(tile);
+      // cancels the page-outs in flight
+      tileStates[tile].lastUse = frame;
+      if (pages[tile] != kNoTile)
+        freeTiles.push_back(pages[tile] - 1);
+      pages[tile] = kNoTile;
+    }
+    uploadPageTable(device);
+  }
+
+  // Marks unallocated tiles as pending: `loader` is called for each of them
+  // when it is first used (or by restoreTile).
+  void setPendingTiles(const std::vector<unsigned>& pendingTiles,
+                       TileLoader loader) {
+    tileLoader = std::move(loader);
+    for (auto tile : pendingTiles)
+      if (pages[tile] == kNoTile && !tileStates[tile].pagedOut)
+        tileStates[tile].pending = true;
+  }
+
+  bool isTilePending(unsigned tile) const { return tileStates[tile].pending; }
+
+  // In GPU memory: the contents can be read with copyTile
+  bool isTileResident(unsigned tile) const { return pages[tile] != kNoTile; }
+
+  // Reads the contents of an allocated tile that is not resident (paged out
+  // or pending) to `pixels` (kCanvasTileBytes).
+  void readNonResidentTile(unsigned tile, void* pixels) const {
+    if (tileStates[tile].pending)
+      tileLoader(tile, pixels);
+    else
+      memcpy(pixels, store.read(tile), kCanvasTileBytes);
+  }
+
+  // size of the tile pool in bytes
+  size_t getMemoryUsage() const {
+    return (size_t)tiles.info.layers * kCanvasTileSize * kCanvasTileSize * 4;
+  }
+
+  unsigned width;
+  unsigned height;
+  unsigned tilesX;
+  unsigned tilesY;
+  // tile pool
+  Texture2DArray<ag::RGBA8> tiles;
+  // tilesX * tilesY page table
+  Texture2D<ag::R32UI> pageTable;
+
+private:
+  template <typename F> void forEachTile(const ag::Box2D& rect, F f) const {
+    auto r = clipRect(rect, width, height);
+    if (isEmptyRect(r))
+      return;
+    for (auto ty = r.ymin / kCanvasTileSize;
+         ty <= (r.ymax - 1) / kCanvasTileSize; ++ty)
+      for (auto tx = r.xmin / kCanvasTileSize;
+           tx <= (r.xmax - 1) / kCanvasTileSize; ++tx)
+        f(tx, ty);
+  }
+
+  struct TileState {
+    // value of `frame` when the tile was last used
+    uint64_t lastUse = 0;
+    // contents in the backing store, not in the pool
+    bool pagedOut = false;
+    // a copy to the backing store is in flight
+    bool pagingOut = false;
+    // contents produced by tileLoader on first use
+    bool pending = false;
+  };
+
+  // marks a tile as used in this frame, and pages it in if necessary
+  void touchTile(Device& device, unsigned tile) {
+    auto& state = tileStates[tile];
+    state.lastUse = frame;
+    if (state.pending) {
+      std::vector<char> pixels(kCanvasTileBytes);
+      tileLoader(tile, pixels.data());
+      state.pending = false;
+      pageIn(device, tile, pixels.data());
+      ++stats.misses;
+      return;
+    }
+    if (!state.pagedOut) {
+      if (pages[tile] != kNoTile)
+        ++stats.hits;
+      return;
+    }
+    auto it = prefetches.find(tile);
+    if (it != prefetches.end()) {
+      // read ahead, may still be in progress
+      auto data = it->second.get();
+      prefetches.erase(it);
+      pageIn(device, tile, data.data());
+      ++stats.hits;
+    } else {
+      pageIn(device, tile, store.read(tile));
+      ++stats.misses;
+    }
+  }
+
+  // forgets the paged out or pending contents of a tile
+  void dropContents(unsigned tile) {
+    auto& state = tileStates[tile];
+    if (state.pagedOut) {
+      prefetches.erase(tile);
+      state.pagedOut = false;
+    }
+    state.pending = false;
+  }
+
+  unsigned allocateLayer(Device& device) {
+    if (freeTiles.empty())
+      growPool(device);
+    auto layer = freeTiles.back();
+    freeTiles.pop_back();
+    return layer;
+  }
+
+  void allocateTile(Device& device, unsigned tile) {
+    auto layer = allocateLayer(device);
+    ag::Box3D tileBox{0, 0, layer, kCanvasTileSize, kCanvasTileSize,
+                      layer + 1};
+    ag::clear(device, tiles, ag::ClearColor{0.0f, 0.0f, 0.0f, 0.0f},
+              tileBox);
+    pages[tile] = layer + 1;
+    pageTableDirty = true;
+  }
+
+  // layer of a tile whose contents are about to be replaced: paged out
+  // contents are dropped instead of being read back
+  unsigned getWritableLayer(Device& device, unsigned tile) {
+    dropContents(tile);
+    touchTile(device, tile);
+    if (pages[tile] == kNoTile) {
+      pages[tile] = allocateLayer(device) + 1;
+      pageTableDirty = true;
+    }
+    return pages[tile] - 1;
+  }
+
+  void uploadTile(Device& device, unsigned layer, const void* data) {
+    ag::copy(device,
+             gsl::span<const ag::RGBA8>(
+                 (const ag::RGBA8*)data,
+                 (std::ptrdiff_t)(kCanvasTileSize * kCanvasTileSize)),
+             tiles, layer);
+  }
+
+  void pageIn(Device& device, unsigned tile, const void* data) {
+    auto layer = allocateLayer(device);
+    uploadTile(device, layer, data);
+    pages[tile] = layer + 1;
+    tileStates[tile].pagedOut = false;
+    pageTableDirty = true;
+    stats.bytesPagedIn += kCanvasTileBytes;
+  }
+
+  // starts copying the least recently used tiles over the budget to the
+  // readback buffer
+  void pageOutTiles(Device& device) {
+    unsigned resident = getTileCount() - pagingOutCount;
+    if (resident <= residencyBudget)
+      return;
+    std::vector<unsigned> candidates;
+    for (unsigned tile = 0; tile < pages.size(); ++tile)
+      if (pages[tile] != kNoTile && !tileStates[tile].pagingOut &&
+          tileStates[tile].lastUse < frame)
+        candidates.push_back(tile);
+    std::sort(candidates.begin(), candidates.end(),
+              [&](unsigned a, unsigned b) {
+                return tileStates[a].lastUse < tileStates[b].lastUse;
+              });
+    if (!readbackData) {
+      readbackBuffer =
+          device.createReadbackBuffer(kTileReadbackSlots * kCanvasTileBytes);
+      readbackData = (const char*)device.mapReadbackBuffer(readbackBuffer);
+      for (unsigned i = kTileReadbackSlots; i > 0; --i)
+        freeReadbackSlots.push_back(i - 1);
+    }
+    for (auto tile : candidates) {
+      if (resident <= residencyBudget || freeReadbackSlots.empty())
+        break;
+      auto slot = freeReadbackSlots.back();
+      freeReadbackSlots.pop_back();
+      auto layer = pages[tile] - 1;
+      RawBufferSlice dest{readbackBuffer.handle.get(),
+                          slot * kCanvasTileBytes, kCanvasTileBytes};
+      ag::copy(device, tiles, dest,
+               ag::Box3D{0, 0, layer, kCanvasTileSize, kCanvasTileSize,
+                         layer + 1});
+      tileStates[tile].pagingOut = true;
+      ++pagingOutCount;
+      --resident;
+      auto lastUse = tileStates[tile].lastUse;
+      std::weak_ptr<bool> weakAlive = alive;
+      device.onFrameComplete([this, weakAlive, tile, slot, lastUse]() {
+        if (weakAlive.lock())
+          finishPageOut(tile, slot, lastUse);
+      });
+    }
+  }
+
+  // the copy of a tile to the readback buffer has completed
+  void finishPageOut(unsigned tile, unsigned slot, uint64_t lastUse) {
+    auto& state = tileStates[tile];
+    state.pagingOut = false;
+    --pagingOutCount;
+    freeReadbackSlots.push_back(slot);
+    // the tile was used (and maybe modified) since the copy: keep it
+    if (state.lastUse != lastUse)
+      return;
+    store.write(tile, readbackData + slot * kCanvasTileBytes);
+    freeTiles.push_back(pages[tile] - 1);
+    pages[tile] = kNoTile;
+    state.pagedOut = true;
+    pageTableDirty = true;
+    stats.bytesPagedOut += kCanvasTileBytes;
+  }
+
+  // doubles the size of the tile pool
+  void growPool(Device& device) {
+    auto oldSize = tiles.info.layers;
+    if (oldSize >= kMaxTilePoolSize)
+      ag::failWith("Tile pool is full");
+    auto newSize = std::min(oldSize * 2, kMaxTilePoolSize);
+    auto newTiles = device.createTexture2DArray<ag::RGBA8>(
+        glm::uvec2{kCanvasTileSize, kCanvasTileSize}, newSize);
+    ag::copy(device, tiles,
+             ag::Box3D{0, 0, 0, kCanvasTileSize, kCanvasTileSize, oldSize},
+             newTiles, glm::uvec3{0, 0, 0});
+    tiles = std::move(newTiles);
+    for (auto i = newSize; i > oldSize; --i)
+      freeTiles.push_back(i - 1);
+  }
+
+  // Halves the size of the tile pool when at most a quarter of it is used
+  // (after page-outs or frees), moving the tiles to the beginning of the
+  // pool.
+  void shrinkPool(Device& device) {
+    auto oldSize = tiles.info.layers;
+    if (oldSize <= kInitialTilePoolSize || getTileCount() > oldSize / 4)
+      return;
+    auto newSize = oldSize / 2;
+    auto newTiles = device.createTexture2DArray<ag::RGBA8>(
+        glm::uvec2{kCanvasTileSize, kCanvasTileSize}, newSize);
+    unsigned used = 0;
+    for (auto& page : pages) {
+      if (page == kNoTile)
+        continue;
+      auto layer = page - 1;
+      ag::copy(device, tiles,
+               ag::Box3D{0, 0, layer, kCanvasTileSize, kCanvasTileSize,
+                         layer + 1},
+               newTiles, glm::uvec3{0, 0, used});
+      page = ++used;
+    }
+    // page-outs in flight may still read the old pool
+    device.deferDestroy(std::move(tiles));
+    tiles = std::move(newTiles);
+    freeTiles.clear();
+    for (auto i = newSize; i > used; --i)
+      freeTiles.push_back(i - 1);
+    pageTableDirty = true;
+  }
+
+  void uploadPageTable(Device& device) {
+    ag::copy(device, gsl::span<const uint32_t>(pages.data(),
+                                               (std::ptrdiff_t)pages.size()),
+             pageTable);
+    pageTableDirty = false;
+  }
+
+  // CPU copy of the page table
+  std::vector<uint32_t> pages;
+  bool pageTableDirty = false;
+  // unused layers of the tile pool
+  std::vector<unsigned> freeTiles;
+
+  // paging
+  std::vector<TileState> tileStates;
+  // incremented by update
+  uint64_t frame = 1;
+  unsigned residencyBudget = 0;
+  TileBackingStore store;
+  TileLoader tileLoader;
+  std::map<unsigned, std::future<std::vector<char>>> prefetches;
+  RawBuffer readbackBuffer;
+  const char* readbackData = nullptr;
+  std::vector<unsigned> freeReadbackSlots;
+  unsigned pagingOutCount = 0;
+  TilePagingStats stats;
+  // expires with the layer, checked by the page-out callbacks
+  std::shared_ptr<bool> alive;
+};
+
+#endif // !TILED_LAYER_HPP
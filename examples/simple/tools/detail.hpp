@@ -40,6 +40,8 @@ public:
         ag::makeThreadGroupCount2D(kShadingCurveSamplesSize, 1u, 16u, 1u),
         Uniforms{splat.center, splat.width}, res.canvas.texShadingTermSmooth,
         RWTextureUnit(0, res.canvas.texDetailMaskLN));
+    // LdotN-space parameters apply to the whole canvas
+    res.canvas.dirty.addAll();
   }
 
 private:
@@ -22,6 +22,8 @@ public:
 
     brushPath = {};
     brushProps = brushPropsFromUi(res.ui);
+    lastSplatCenter.reset();
+    res.canvas.history.beginStep();
     brushPath.addPointerEvent(
         event, brushProps, [this](auto splat) { this->smudge(splat, true); });
   }
@@ -34,6 +36,10 @@ public:
   void endStroke(const PointerEvent& event) override {
     // brushPath.addPointerEvent(event, brushProps, [&](auto
     // splat){paintSplat(splat);});
+    res.canvas.history.endStep();
+    // the shading curve histogram does not follow the smudged pixels:
+    // recompute it on the next update
+    res.canvas.shadingHistogramValid = false;
   }
 
   void smudge(const SplatProperties& splat, bool first) {
@@ -55,20 +61,33 @@ public:
                      {footprintBox.width(), footprintBox.height()},
                      first ? 0.0f : res.ui.strokeOpacity};
 
-    if (res.ui.brushTip == BrushTip::Textured)
+    if (res.ui.brushTip == BrushTip::Textured) {
+      res.canvas.history.recordTiles(res.device, res.canvas.baseColorUV,
+                                     footprintBox);
+      res.canvas.baseColorUV.allocate(res.device, footprintBox);
       ag::compute(
           res.device, res.pipelines.ppSmudge,
 		  ag::makeThreadGroupCount2D(footprintBox.width(), footprintBox.height(), 16, 16),
           glm::vec2{(float)res.canvas.width, (float)res.canvas.height},
-          RWTextureUnit(0, res.canvas.texBaseColorUV),
-          RWTextureUnit(1, texSmudgeFootprint), u,
+          RWTextureUnit(0, res.canvas.baseColorUV.tiles),
+          RWTextureUnit(1, texSmudgeFootprint),
+          RWTextureUnit(2, res.canvas.baseColorUV.pageTable), u,
           res.ui.brushTipTextures[res.ui.selectedBrushTip].tex);
+    }
+    res.canvas.dirty.add(footprintBox);
+    // the next splats read and write ahead of this one
+    prefetchAlongStroke(res.canvas.baseColorUV, footprintBox,
+                        lastSplatCenter ? splat.center - *lastSplatCenter
+                                        : glm::vec2{0.0f, 0.0f});
+    lastSplatCenter = splat.center;
   }
 
 private:
   Texture2D<ag::RGBA8> texSmudgeFootprint;
   BrushPath brushPath;
   BrushProperties brushProps;
+  // center of the previous splat of the stroke
+  std::experimental::optional<glm::vec2> lastSplatCenter;
   ToolResources res;
 };
 
@@ -3,16 +3,27 @@
 
 #include <autograph/backend/opengl/backend.hpp>
 #include <autograph/device.hpp>
+#include <autograph/stats_backend.hpp>
+#include <histogram/histogram.hpp>
 
+// same as samples::GL
+#ifdef AG_FRAME_STATS
+using GL = ag::StatsBackend<ag::opengl::OpenGLBackend>;
+#else
 using GL = ag::opengl::OpenGLBackend;
+#endif
 using Device = ag::Device<GL>;
 template <typename Pixel> using Texture2D = ag::Texture2D<Pixel, GL>;
 template <typename Pixel> using Texture1D = ag::Texture1D<Pixel, GL>;
+template <typename Pixel>
+using Texture2DArray = ag::Texture2DArray<Pixel, GL>;
 using GraphicsPipeline = ag::GraphicsPipeline<GL>;
 using ComputePipeline = ag::ComputePipeline<GL>;
 using Mesh = samples::Mesh<GL>;
 template <typename T> using Buffer = ag::Buffer<GL, T>;
+using RawBuffer = ag::RawBuffer<GL>;
 using RawBufferSlice = ag::RawBufferSlice<GL>;
 using Sampler = ag::Sampler<GL>;
+using GpuHistogram = ag::extra::histogram::GpuHistogram<GL>;
 
 #endif
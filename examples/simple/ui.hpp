@@ -1,6 +1,7 @@
 #ifndef UI_HPP
 #define UI_HPP
 
+#include <fstream>
 #include <string>
 
 #include <glm/glm.hpp>
@@ -12,6 +13,7 @@
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw_gl3.h"
 
+#include "brush_tip_atlas.hpp"
 #include "canvas.hpp"
 #include "tool.hpp"
 #include "types.hpp"
@@ -42,11 +44,6 @@ struct event {
   rxsub::subject<event_t> subject;
 };
 
-struct BrushTipTexture {
-  std::string name;
-  Texture2D<ag::RGBA8> tex;
-};
-
 // ImGui-based user interface
 class Ui {
 public:
@@ -203,6 +200,8 @@ public:
     ImGui::Checkbox("DEBUG - Show base color", &showBaseColor);
     ImGui::Checkbox("DEBUG - Show shading offsets", &showHSVOffset);
     ImGui::Checkbox("DEBUG - Show gradient", &showGradient);
+    ImGui::Checkbox("Show overview", &showOverview);
+    ImGui::SliderFloat("Overview scale", &overviewScale, 0.05f, 0.5f);
 
     if (ImGui::Button("Save"))
       saveCanvas.signal();
@@ -212,6 +211,12 @@ public:
 
     ImGui::InputText("Path", saveFileName, 100);
 
+    if (ImGui::Button("Undo"))
+      undoRequested = true;
+    ImGui::SameLine();
+    if (ImGui::Button("Redo"))
+      redoRequested = true;
+
     ImGui::PlotHistogram("H curve", histH.data(), kShadingCurveSamplesSize, 0,
                          "", 0.0, 1.0,
                          ImVec2((float)kShadingCurveSamplesSize, 60.0f));
@@ -225,6 +230,44 @@ public:
                          kShadingCurveSamplesSize, 0, "", 0.0, 1.0,
                          ImVec2((float)kShadingCurveSamplesSize, 60.0f));
 
+    if (ImGui::CollapsingHeader("Layers")) {
+      if (layerCount > 0) {
+        ImGui::SliderInt("Active layer", &activeLayer, 0, layerCount - 1);
+        ImGui::Text("%s", activeLayerName.c_str());
+      }
+      ImGui::SliderFloat("Layer opacity", &layerOpacity, 0.0f, 1.0f);
+      ImGui::Checkbox("Layer visible", &layerVisible);
+      ImGui::Checkbox("Paint layer mask", &paintLayerMask);
+      if (ImGui::Button("Add color layer"))
+        addColorLayerRequested = true;
+    }
+
+    if (ImGui::CollapsingHeader("Frame pacing")) {
+      const auto& pacing = device.getFramePacingStats();
+      ImGui::Text("CPU frame %.3f ms (fence wait %.3f ms, limiter %.3f ms)",
+                  pacing.cpuFrameTime, pacing.cpuWaitTime,
+                  pacing.limiterWaitTime);
+      ImGui::Text("GPU frame %.3f ms", pacing.gpuFrameTime);
+      ImGui::Text("Queue depth %u / %u frames in flight", pacing.queueDepth,
+                  pacing.framesInFlight);
+    }
+
+    if (device.profiler && ImGui::CollapsingHeader("Profiler")) {
+      for (const auto& zone : device.profiler->getSummary()) {
+        const auto& stats = zone.second;
+        ImGui::Text("%-16s CPU %.3f/%.3f/%.3f ms  GPU %.3f/%.3f/%.3f ms",
+                    zone.first.c_str(), stats.cpuMin, stats.cpuAvg(),
+                    stats.cpuMax, stats.gpuMin, stats.gpuAvg(), stats.gpuMax);
+      }
+      if (ImGui::Button("Reset stats"))
+        device.profiler->resetSummary();
+      ImGui::SameLine();
+      if (ImGui::Button("Export trace")) {
+        std::ofstream traceFile("trace.json");
+        device.profiler->exportChromeTrace(traceFile);
+      }
+    }
+
     ImGui::Render();
   }
 
@@ -255,9 +298,29 @@ public:
   bool showHSVOffset = false;
   bool showBaseColor = false;
   bool showGradient = false;
+  // downscaled view of the whole canvas, in a corner
+  bool showOverview = false;
+  float overviewScale = 0.25f;
+  // set by the undo/redo buttons, reset by the painter
+  bool undoRequested = false;
+  bool redoRequested = false;
+
+  // layer stack, synchronized with the canvas by the painter
+  int activeLayer = 0;
+  int layerCount = 0;
+  std::string activeLayerName;
+  // opacity and visibility of the active layer
+  float layerOpacity = 1.0f;
+  bool layerVisible = true;
+  // the brush paints the mask of the active layer instead of its colors
+  bool paintLayerMask = false;
+  // set by the 'Add color layer' button, reset by the painter
+  bool addColorLayerRequested = false;
 
   char saveFileName[100] = "output.paint";
   std::vector<BrushTipTexture> brushTipTextures;
+  // all tips of brushTipTextures, same indices
+  BrushTipAtlas brushTipAtlas;
   int selectedBrushTip = 0;
 
   Tool activeTool = Tool::Brush;
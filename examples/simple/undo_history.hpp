@@ -0,0 +1,326 @@
+#ifndef UNDO_HISTORY_HPP
+#define UNDO_HISTORY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "../common/lz_codec.hpp"
+#include "dirty_region.hpp"
+#include "tiled_layer.hpp"
+#include "types.hpp"
+
+// memory used by the snapshots of the undo history (GPU and CPU), the oldest
+// steps are dropped above this
+constexpr size_t kUndoMemoryBudget = 256 * 1024 * 1024;
+// number of most recent steps kept uncompressed in GPU memory
+constexpr unsigned kUndoHotSteps = 4;
+constexpr unsigned kUndoInitialPoolSize = 16;
+// number of snapshots in flight to the CPU at once
+constexpr unsigned kUndoReadbackSlots = 8;
+
+///////////////////////////////////////
+// UndoHistory
+// Undo/redo of the modifications of tiled layers, at tile granularity.
+// Before modifying a region of a layer, tools call recordTiles: the tiles of
+// the region that were not recorded yet in the current step are copied (on
+// the GPU) into a pool of snapshot tiles. Undoing a step swaps the snapshots
+// with the current contents of the tiles, so that the cost of undo and redo
+// depends only on the number of tiles modified by the step.
+// Snapshots of the steps older than kUndoHotSteps are read back and
+// compressed (lzCompress) by worker threads, and leave the pool.
+class UndoHistory {
+public:
+  UndoHistory(Device& device, size_t memoryBudget_ = kUndoMemoryBudget)
+      : memoryBudget(memoryBudget_), alive(std::make_shared<bool>(true)) {
+    pool = device.createTexture2DArray<ag::RGBA8>(
+        glm::uvec2{kCanvasTileSize, kCanvasTileSize}, kUndoInitialPoolSize);
+    for (unsigned i = kUndoInitialPoolSize; i > 0; --i)
+      freeSlots.push_back(i - 1);
+  }
+
+  UndoHistory(const UndoHistory&) = delete;
+  UndoHistory& operator=(const UndoHistory&) = delete;
+
+  // starts a step (a stroke)
+  void beginStep() {
+    currentStep = std::make_unique<Step>();
+  }
+
+  // Saves the tiles of `layer` overlapping `rect` before they are modified.
+  // Tiles already saved in the current step are skipped.
+  void recordTiles(Device& device, TiledLayer& layer, const ag::Box2D& rect) {
+    if (!currentStep)
+      return;
+    for (auto tile : layer.getTiles(rect)) {
+      auto& snapshots = currentStep->snapshots;
+      auto it =
+          std::find_if(snapshots.begin(), snapshots.end(), [&](const auto& s) {
+            return s->layer == &layer && s->tile == tile;
+          });
+      if (it == snapshots.end())
+        snapshots.push_back(capture(device, layer, tile));
+    }
+  }
+
+  // Ends the current step. Steps that did not record anything are dropped.
+  void endStep() {
+    if (!currentStep)
+      return;
+    if (!currentStep->snapshots.empty()) {
+      undoSteps.push_back(std::move(*currentStep));
+      for (auto& step : redoSteps)
+        releaseStep(step);
+      redoSteps.clear();
+    }
+    currentStep.reset();
+  }
+
+  // forgets all steps (e.g. when a document is loaded)
+  void clear() {
+    for (auto& step : undoSteps)
+      releaseStep(step);
+    for (auto& step : redoSteps)
+      releaseStep(step);
+    if (currentStep)
+      releaseStep(*currentStep);
+    undoSteps.clear();
+    redoSteps.clear();
+    currentStep.reset();
+  }
+
+  bool canUndo() const { return !currentStep && !undoSteps.empty(); }
+  bool canRedo() const { return !currentStep && !redoSteps.empty(); }
+
+  // Reverts the last step, the restored tiles are added to `dirty`, and the
+  // layers they belong to to `layers` (if not null).
+  // Returns false if there is nothing to undo.
+  bool undo(Device& device, DirtyRegion& dirty,
+            std::vector<TiledLayer*>* layers = nullptr) {
+    if (!canUndo())
+      return false;
+    auto step = std::move(undoSteps.back());
+    undoSteps.pop_back();
+    swapStep(device, step, dirty, layers);
+    redoSteps.push_back(std::move(step));
+    return true;
+  }
+
+  bool redo(Device& device, DirtyRegion& dirty,
+            std::vector<TiledLayer*>* layers = nullptr) {
+    if (!canRedo())
+      return false;
+    auto step = std::move(redoSteps.back());
+    redoSteps.pop_back();
+    swapStep(device, step, dirty, layers);
+    undoSteps.push_back(std::move(step));
+    return true;
+  }
+
+  // Call once per frame: starts compressing the snapshots of cold steps and
+  // drops the oldest steps over the memory budget.
+  void update(Device& device) {
+    for (auto& step : undoSteps)
+      for (auto& s : step.snapshots)
+        if (s->compressing.valid() &&
+            s->compressing.wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready)
+          s->compressed = s->compressing.get();
+    compressColdSteps(device);
+    // keep at least the last step
+    while (undoSteps.size() > 1 && getMemoryUsage() > memoryBudget) {
+      releaseStep(undoSteps.front());
+      undoSteps.pop_front();
+    }
+  }
+
+  // memory used by the snapshots, in bytes
+  size_t getMemoryUsage() const {
+    size_t bytes = 0;
+    auto add = [&](const Step& step) {
+      for (const auto& s : step.snapshots) {
+        if (s->slot >= 0 || s->compressing.valid())
+          bytes += kCanvasTileBytes;
+        bytes += s->compressed.size();
+      }
+    };
+    for (const auto& step : undoSteps)
+      add(step);
+    for (const auto& step : redoSteps)
+      add(step);
+    if (currentStep)
+      add(*currentStep);
+    return bytes;
+  }
+
+private:
+  // saved state of a tile
+  struct Snapshot {
+    TiledLayer* layer;
+    unsigned tile;
+    // false if the tile was not allocated: nothing else is saved
+    bool allocated = false;
+    // layer of the snapshot pool, -1 if the snapshot is not in GPU memory
+    int slot = -1;
+    // a copy of the slot to the CPU is in flight
+    bool readbackPending = false;
+    std::future<std::vector<uint8_t>> compressing;
+    std::vector<uint8_t> compressed;
+  };
+
+  struct Step {
+    std::vector<std::shared_ptr<Snapshot>> snapshots;
+  };
+
+  std::shared_ptr<Snapshot> capture(Device& device, TiledLayer& layer,
+                                    unsigned tile) {
+    auto s = std::make_shared<Snapshot>();
+    s->layer = &layer;
+    s->tile = tile;
+    s->allocated = layer.isTileAllocated(tile);
+    if (s->allocated) {
+      s->slot = (int)allocateSlot(device);
+      layer.copyTile(device, tile, pool, (unsigned)s->slot);
+    }
+    return s;
+  }
+
+  void restore(Device& device, Snapshot& s) {
+    if (!s.allocated) {
+      s.layer->freeTile(device, s.tile);
+      return;
+    }
+    if (s.slot >= 0) {
+      s.layer->restoreTile(device, s.tile, pool, (unsigned)s.slot);
+      return;
+    }
+    if (s.compressing.valid())
+      s.compressed = s.compressing.get();
+    std::vector<uint8_t> pixels(kCanvasTileBytes);
+    if (!samples::lzDecompress(s.compressed.data(), s.compressed.size(),
+                               pixels.data(), pixels.size()))
+      ag::failWith("Corrupt undo snapshot");
+    s.layer->restoreTile(device, s.tile, pixels.data());
+  }
+
+  // replaces the snapshots of a step with the current contents of the tiles,
+  // and restores the tiles from the snapshots
+  void swapStep(Device& device, Step& step, DirtyRegion& dirty,
+                std::vector<TiledLayer*>* layers) {
+    for (auto& s : step.snapshots) {
+      auto current = capture(device, *s->layer, s->tile);
+      restore(device, *s);
+      dirty.add(s->layer->getTileRect(s->tile));
+      if (layers &&
+          std::find(layers->begin(), layers->end(), s->layer) == layers->end())
+        layers->push_back(s->layer);
+      releaseSnapshot(*s);
+      s = std::move(current);
+    }
+  }
+
+  // Starts compressing the snapshots of the steps older than the hot ones,
+  // oldest first, until all readback slots are in use.
+  void compressColdSteps(Device& device) {
+    if (undoSteps.size() <= kUndoHotSteps)
+      return;
+    for (size_t i = 0; i < undoSteps.size() - kUndoHotSteps; ++i)
+      for (auto& s : undoSteps[i].snapshots)
+        if (s->slot >= 0 && !s->readbackPending &&
+            !compressSnapshot(device, s))
+          return;
+  }
+
+  // Starts copying a snapshot to the CPU, it is compressed when the copy
+  // completes. Returns false if all readback slots are in use.
+  bool compressSnapshot(Device& device, std::shared_ptr<Snapshot>& s) {
+    if (!readbackData) {
+      readbackBuffer =
+          device.createReadbackBuffer(kUndoReadbackSlots * kCanvasTileBytes);
+      readbackData = (const char*)device.mapReadbackBuffer(readbackBuffer);
+      for (unsigned i = kUndoReadbackSlots; i > 0; --i)
+        freeReadbackSlots.push_back(i - 1);
+    }
+    if (freeReadbackSlots.empty())
+      return false;
+    auto rbSlot = freeReadbackSlots.back();
+    freeReadbackSlots.pop_back();
+    RawBufferSlice dest{readbackBuffer.handle.get(), rbSlot * kCanvasTileBytes,
+                        kCanvasTileBytes};
+    ag::copy(device, pool, dest,
+             ag::Box3D{0, 0, (unsigned)s->slot, kCanvasTileSize,
+                       kCanvasTileSize, (unsigned)s->slot + 1});
+    s->readbackPending = true;
+    std::weak_ptr<bool> weakAlive = alive;
+    std::weak_ptr<Snapshot> weakSnapshot = s;
+    device.onFrameComplete([this, weakAlive, weakSnapshot, rbSlot]() {
+      if (!weakAlive.lock())
+        return;
+      auto src = (const uint8_t*)readbackData + rbSlot * kCanvasTileBytes;
+      auto snapshot = weakSnapshot.lock();
+      // the snapshot may have been dropped or restored in the meantime
+      if (snapshot && snapshot->slot >= 0) {
+        std::vector<uint8_t> pixels(src, src + kCanvasTileBytes);
+        snapshot->compressing = std::async(
+            std::launch::async, [pixels = std::move(pixels)]() {
+              return samples::lzCompress(pixels.data(), pixels.size());
+            });
+        freeSlots.push_back((unsigned)snapshot->slot);
+        snapshot->slot = -1;
+        snapshot->readbackPending = false;
+      }
+      freeReadbackSlots.push_back(rbSlot);
+    });
+    return true;
+  }
+
+  unsigned allocateSlot(Device& device) {
+    if (freeSlots.empty()) {
+      // double the size of the pool
+      auto oldSize = pool.info.layers;
+      if (oldSize >= kMaxTilePoolSize)
+        ag::failWith("Undo snapshot pool is full");
+      auto newSize = std::min(oldSize * 2, kMaxTilePoolSize);
+      auto newPool = device.createTexture2DArray<ag::RGBA8>(
+          glm::uvec2{kCanvasTileSize, kCanvasTileSize}, newSize);
+      ag::copy(device, pool,
+               ag::Box3D{0, 0, 0, kCanvasTileSize, kCanvasTileSize, oldSize},
+               newPool, glm::uvec3{0, 0, 0});
+      pool = std::move(newPool);
+      for (auto i = newSize; i > oldSize; --i)
+        freeSlots.push_back(i - 1);
+    }
+    auto slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+  }
+
+  void releaseSnapshot(Snapshot& s) {
+    if (s.slot >= 0)
+      freeSlots.push_back((unsigned)s.slot);
+    s.slot = -1;
+  }
+
+  void releaseStep(Step& step) {
+    for (auto& s : step.snapshots)
+      releaseSnapshot(*s);
+  }
+
+  size_t memoryBudget;
+  std::deque<Step> undoSteps;
+  std::vector<Step> redoSteps;
+  std::unique_ptr<Step> currentStep;
+  // snapshot tiles in GPU memory
+  Texture2DArray<ag::RGBA8> pool;
+  std::vector<unsigned> freeSlots;
+  RawBuffer readbackBuffer;
+  const char* readbackData = nullptr;
+  std::vector<unsigned> freeReadbackSlots;
+  // expires with the history, checked by the readback callbacks
+  std::shared_ptr<bool> alive;
+};
+
+#endif // !UNDO_HISTORY_HPP
@@ -1,9 +1,11 @@
 #include "backend.hpp"
 
 #include <algorithm>
+#include <memory>
 #include <iostream>
 #include <ostream>
 #include <sstream>
+#include <string>
 
 #include <format.h>
 
@@ -12,6 +14,9 @@
 namespace ag {
 namespace opengl {
 namespace {
+// GL_PARAMETER_BUFFER(_ARB), missing from the 4.5 loader
+constexpr GLenum kParameterBuffer = 0x80EE;
+
 GLFWwindow* createGlfwWindow(const DeviceOptions& options) {
   GLFWwindow* window;
   if (!glfwInit())
@@ -31,7 +36,23 @@ GLFWwindow* createGlfwWindow(const DeviceOptions& options) {
   }
 
   glfwMakeContextCurrent(window);
-  glfwSwapInterval(1);
+  switch (options.presentMode) {
+  case PresentMode::Immediate:
+    glfwSwapInterval(0);
+    break;
+  case PresentMode::Adaptive:
+    // negative swap intervals need the swap_control_tear extensions
+    if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+        glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+      glfwSwapInterval(-1);
+      break;
+    }
+  // fallthrough
+  case PresentMode::Vsync:
+  default:
+    glfwSwapInterval(1);
+    break;
+  }
 
   if (!gl::sys::LoadFunctions()) {
     glfwTerminate();
@@ -88,6 +109,18 @@ GLenum textureFilterToGLenum(TextureFilter filter) {
   }
 }
 
+GLenum minFilterToGLenum(TextureFilter filter, MipmapMode mipmapMode) {
+  bool linear = filter == TextureFilter::Linear;
+  switch (mipmapMode) {
+  case MipmapMode::Nearest:
+    return linear ? gl::LINEAR_MIPMAP_NEAREST : gl::NEAREST_MIPMAP_NEAREST;
+  case MipmapMode::Linear:
+    return linear ? gl::LINEAR_MIPMAP_LINEAR : gl::NEAREST_MIPMAP_LINEAR;
+  default:
+    return textureFilterToGLenum(filter);
+  }
+}
+
 GLenum primitiveTypeToGLenum(PrimitiveType primitiveType) {
   switch (primitiveType) {
   case PrimitiveType::Triangles:
@@ -151,12 +184,28 @@ OpenGLBackend::OpenGLBackend() : last_framebuffer_obj(0) {
   bind_state.textures.fill(0);
   bind_state.samplers.fill(0);
   bind_state.shaderStorageBuffers.fill(0);
+  bind_state.shaderStorageBufferSizes.fill(0);
+  bind_state.shaderStorageBufferOffsets.fill(0);
   bind_state.uniformBuffers.fill(0);
   bind_state.uniformBufferSizes.fill(0);
   bind_state.uniformBufferOffsets.fill(0);
   // nothing to do, the context is created on window creation
 }
 
+OpenGLBackend::~OpenGLBackend() {
+  if (loader_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(loader_mutex);
+      loader_exit = true;
+    }
+    loader_cv.notify_one();
+    loader_thread.join();
+    for (auto& c : loader_completions)
+      gl::DeleteSync(c.sync);
+    glfwDestroyWindow(loader_window);
+  }
+}
+
 // create a swap chain to draw into (color buffer + depth buffer)
 void OpenGLBackend::createWindow(const DeviceOptions& options) {
   window = createGlfwWindow(options);
@@ -166,6 +215,11 @@ void OpenGLBackend::createWindow(const DeviceOptions& options) {
   // (this is a GL 4.5 extension, so we are deliberately
   //  sacrificing compatibility here)
   gl::ClipControl(gl::UPPER_LEFT, gl::ZERO_TO_ONE);
+  // GPU-generated draw counts (core in GL 4.6, not in the 4.5 loader)
+  if (glfwExtensionSupported("GL_ARB_indirect_parameters"))
+    multi_draw_elements_indirect_count =
+        reinterpret_cast<decltype(multi_draw_elements_indirect_count)>(
+            glfwGetProcAddress("glMultiDrawElementsIndirectCountARB"));
 }
 
 bool OpenGLBackend::processWindowEvents() {
@@ -236,6 +290,24 @@ void OpenGLBackend::bindTexture3D(unsigned slot,
   }
 }
 
+void OpenGLBackend::bindTexture2DArray(unsigned slot,
+                                       TextureHandle::pointer handle) {
+  assert(slot < kMaxTextureUnits);
+  if (bind_state.textures[slot] != handle.id) {
+    bind_state.textures[slot] = handle.id;
+    bind_state.textureUpdated = true;
+  }
+}
+
+void OpenGLBackend::bindTextureCubeMap(unsigned slot,
+                                       TextureHandle::pointer handle) {
+  assert(slot < kMaxTextureUnits);
+  if (bind_state.textures[slot] != handle.id) {
+    bind_state.textures[slot] = handle.id;
+    bind_state.textureUpdated = true;
+  }
+}
+
 void OpenGLBackend::bindSampler(unsigned slot, SamplerHandle::pointer handle) {
   assert(slot < kMaxTextureUnits);
   if (bind_state.samplers[slot] != handle.id) {
@@ -249,7 +321,7 @@ OpenGLBackend::createSampler(const SamplerInfo& info) {
   GLuint sampler_obj;
   gl::CreateSamplers(1, &sampler_obj);
   gl::SamplerParameteri(sampler_obj, gl::TEXTURE_MIN_FILTER,
-                        textureFilterToGLenum(info.minFilter));
+                        minFilterToGLenum(info.minFilter, info.mipmapMode));
   gl::SamplerParameteri(sampler_obj, gl::TEXTURE_MAG_FILTER,
                         textureFilterToGLenum(info.magFilter));
   gl::SamplerParameteri(sampler_obj, gl::TEXTURE_WRAP_R,
@@ -314,6 +386,150 @@ OpenGLBackend::createComputePipeline(const ComputePipelineInfo& info) {
   return ComputePipelineHandle(pp, ComputePipelineDeleter());
 }
 
+///////////////////// Loader thread
+void OpenGLBackend::startLoaderThread() {
+  // GLFW windows must be created on the main thread
+  glfwWindowHint(GLFW_VISIBLE, gl::FALSE_);
+  loader_window = glfwCreateWindow(1, 1, "Loader", nullptr, window);
+  glfwWindowHint(GLFW_VISIBLE, gl::TRUE_);
+  if (!loader_window)
+    failWith("Could not create the loader context");
+  loader_thread = std::thread([this]() { loaderThreadMain(); });
+}
+
+void OpenGLBackend::loaderThreadMain() {
+  glfwMakeContextCurrent(loader_window);
+  for (;;) {
+    LoaderTask t;
+    {
+      std::unique_lock<std::mutex> lock(loader_mutex);
+      loader_cv.wait(lock,
+                     [this]() { return loader_exit || !loader_tasks.empty(); });
+      if (loader_exit)
+        break;
+      t = std::move(loader_tasks.front());
+      loader_tasks.pop_front();
+    }
+    std::exception_ptr error;
+    try {
+      t.task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    auto sync = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // the fence must reach the GPU to be visible from the main context
+    gl::Flush();
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    loader_completions.push_back(
+        LoaderCompletion{sync, std::move(t.publish), error});
+  }
+  glfwMakeContextCurrent(nullptr);
+}
+
+void OpenGLBackend::runOnLoaderThread(std::function<void()> task,
+                                      std::function<void()> publish) {
+  if (!loader_thread.joinable())
+    startLoaderThread();
+  {
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    loader_tasks.push_back(LoaderTask{std::move(task), std::move(publish)});
+  }
+  loader_cv.notify_one();
+}
+
+void OpenGLBackend::pollLoaderCompletions() {
+  std::vector<LoaderCompletion> ready;
+  {
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    // completions are in submission order
+    while (!loader_completions.empty()) {
+      auto& c = loader_completions.front();
+      if (gl::ClientWaitSync(c.sync, 0, 0) == gl::TIMEOUT_EXPIRED)
+        break;
+      gl::DeleteSync(c.sync);
+      ready.push_back(std::move(c));
+      loader_completions.pop_front();
+    }
+  }
+  // publish the successful tasks before reporting a failure, so that one
+  // failed task does not drop the results of the others
+  std::exception_ptr firstError;
+  for (auto& c : ready) {
+    if (c.error) {
+      if (!firstError)
+        firstError = c.error;
+    } else if (c.publish)
+      c.publish();
+  }
+  if (firstError)
+    std::rethrow_exception(firstError);
+}
+
+size_t OpenGLBackend::getLoaderPendingCount() {
+  std::lock_guard<std::mutex> lock(loader_mutex);
+  return loader_tasks.size() + loader_completions.size();
+}
+
+namespace {
+// copy of the pipeline description that outlives the caller's strings
+struct OwnedShaderSources {
+  std::string VS, GS, PS, DS, HS, CS;
+  std::vector<VertexAttribute> vertexAttribs;
+
+  static const char* get(const std::string& src) {
+    return src.empty() ? nullptr : src.c_str();
+  }
+};
+}
+
+void OpenGLBackend::createGraphicsPipelineAsync(
+    const GraphicsPipelineInfo& info,
+    std::function<void(GraphicsPipelineHandle)> onReady) {
+  auto src = std::make_shared<OwnedShaderSources>();
+  src->VS = info.VSSource ? info.VSSource : "";
+  src->GS = info.GSSource ? info.GSSource : "";
+  src->PS = info.PSSource ? info.PSSource : "";
+  src->DS = info.DSSource ? info.DSSource : "";
+  src->HS = info.HSSource ? info.HSSource : "";
+  src->vertexAttribs.assign(info.vertexAttribs.begin(),
+                            info.vertexAttribs.end());
+  auto pp = std::make_shared<GraphicsPipelineHandle>(new GraphicsPipeline,
+                                                     GraphicsPipelineDeleter());
+  pp->get()->blendState = info.blendState;
+  pp->get()->depthStencilState = info.depthStencilState;
+  pp->get()->rasterizerState = info.rasterizerState;
+  runOnLoaderThread(
+      [this, src, pp]() {
+        GraphicsPipelineInfo loaderInfo;
+        loaderInfo.VSSource = OwnedShaderSources::get(src->VS);
+        loaderInfo.GSSource = OwnedShaderSources::get(src->GS);
+        loaderInfo.PSSource = OwnedShaderSources::get(src->PS);
+        loaderInfo.DSSource = OwnedShaderSources::get(src->DS);
+        loaderInfo.HSSource = OwnedShaderSources::get(src->HS);
+        pp->get()->program = createProgramFromShaderPipeline(loaderInfo);
+      },
+      [this, src, pp, onReady]() {
+        pp->get()->vao = createVertexArrayObject(src->vertexAttribs);
+        onReady(std::move(*pp));
+      });
+}
+
+void OpenGLBackend::createComputePipelineAsync(
+    const ComputePipelineInfo& info,
+    std::function<void(ComputePipelineHandle)> onReady) {
+  auto src = std::make_shared<OwnedShaderSources>();
+  src->CS = info.CSSource ? info.CSSource : "";
+  auto pp = std::make_shared<ComputePipelineHandle>(new ComputePipeline,
+                                                    ComputePipelineDeleter());
+  runOnLoaderThread(
+      [this, src, pp]() {
+        ComputePipelineInfo loaderInfo;
+        loaderInfo.CSSource = OwnedShaderSources::get(src->CS);
+        pp->get()->program = createComputeProgram(loaderInfo);
+      },
+      [pp, onReady]() { onReady(std::move(*pp)); });
+}
+
 OpenGLBackend::FenceHandle OpenGLBackend::createFence(uint64_t initialValue) {
   auto f = new GLFence;
   f->currentValue = initialValue;
@@ -327,7 +543,9 @@ void OpenGLBackend::signal(FenceHandle::pointer fence, uint64_t value) {
 }
 
 void OpenGLBackend::signalCPU(FenceHandle::pointer fence, uint64_t value) {
-  // unimplemented (useful only for multithreaded applications?)
+  // the fence value never decreases: pending GPU sync points with a lower
+  // target value will not roll it back
+  fence->currentValue = std::max(fence->currentValue, value);
 }
 
 GLenum advanceFence(OpenGLBackend::FenceHandle::pointer handle,
@@ -337,7 +555,8 @@ GLenum advanceFence(OpenGLBackend::FenceHandle::pointer handle,
                                        gl::SYNC_FLUSH_COMMANDS_BIT, timeout);
   if (waitResult == gl::CONDITION_SATISFIED ||
       waitResult == gl::ALREADY_SIGNALED) {
-    handle->currentValue = targetSyncPoint.targetValue;
+    handle->currentValue =
+        std::max(handle->currentValue, targetSyncPoint.targetValue);
     gl::DeleteSync(targetSyncPoint.sync);
     handle->syncPoints.pop_front();
   } else if (waitResult == gl::WAIT_FAILED_)
@@ -357,6 +576,10 @@ uint64_t OpenGLBackend::getFenceValue(FenceHandle::pointer handle) {
 
 void OpenGLBackend::waitForFence(FenceHandle::pointer handle, uint64_t value) {
   while (getFenceValue(handle) < value) {
+    if (handle->syncPoints.empty())
+      failWith(fmt::format("Waiting for a fence value that was never "
+                           "signaled (target {})",
+                           value));
     auto waitResult = advanceFence(handle, kFenceWaitTimeout);
     if (waitResult == gl::TIMEOUT_EXPIRED)
       failWith(
@@ -365,6 +588,38 @@ void OpenGLBackend::waitForFence(FenceHandle::pointer handle, uint64_t value) {
   }
 }
 
+OpenGLBackend::TimestampQueryPoolHandle
+OpenGLBackend::createTimestampQueryPool(unsigned count) {
+  auto pool = new GLQueryPool;
+  pool->queries.resize(count);
+  gl::CreateQueries(gl::TIMESTAMP, count, pool->queries.data());
+  return TimestampQueryPoolHandle(pool, QueryPoolDeleter());
+}
+
+void OpenGLBackend::writeTimestamp(TimestampQueryPoolHandle::pointer pool,
+                                   unsigned index) {
+  gl::QueryCounter(pool->queries[index], gl::TIMESTAMP);
+}
+
+bool OpenGLBackend::tryGetTimestamp(TimestampQueryPoolHandle::pointer pool,
+                                    unsigned index, uint64_t& outTimestamp) {
+  GLuint query_obj = pool->queries[index];
+  GLuint available = 0;
+  gl::GetQueryObjectuiv(query_obj, gl::QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return false;
+  GLuint64 result = 0;
+  gl::GetQueryObjectui64v(query_obj, gl::QUERY_RESULT, &result);
+  outTimestamp = result;
+  return true;
+}
+
+uint64_t OpenGLBackend::getGPUTimestamp() {
+  GLint64 result = 0;
+  gl::GetInteger64v(gl::TIMESTAMP, &result);
+  return (uint64_t)result;
+}
+
 GLuint OpenGLBackend::createComputeProgram(const ComputePipelineInfo& info) {
   GLuint cs_obj = 0;
   GLuint program_obj = gl::CreateProgram();
@@ -458,17 +713,20 @@ GLuint OpenGLBackend::createProgramFromShaderPipeline(
 
 GLuint OpenGLBackend::createVertexArrayObject(
     gsl::span<const VertexAttribute> attribs) {
-  GLuint strides[OpenGLBackend::kMaxVertexBufferSlots] = {0};
+  // end of the last attribute of each slot
+  GLuint offsets[OpenGLBackend::kMaxVertexBufferSlots] = {0};
   GLuint vertex_array_obj;
   gl::CreateVertexArrays(1, &vertex_array_obj);
   for (int attribindex = 0; attribindex < attribs.size(); ++attribindex) {
     const auto& a = attribs[attribindex];
     assert(a.slot < OpenGLBackend::kMaxVertexBufferSlots);
+    GLuint offset =
+        a.offset != kVertexAttributeAutoOffset ? a.offset : offsets[a.slot];
     gl::EnableVertexArrayAttrib(vertex_array_obj, attribindex);
     gl::VertexArrayAttribFormat(vertex_array_obj, attribindex, a.size, a.type,
-                                a.normalized, strides[a.slot]);
+                                a.normalized, offset);
     gl::VertexArrayAttribBinding(vertex_array_obj, attribindex, a.slot);
-    strides[a.slot] += a.stride;
+    offsets[a.slot] = offset + a.stride;
   }
   gl::BindVertexArray(0);
   return vertex_array_obj;
@@ -504,6 +762,16 @@ void OpenGLBackend::bindUniformBuffer(unsigned slot,
   bind_state.uniformBuffersUpdated = true;
 }
 
+void OpenGLBackend::bindStorageBuffer(unsigned slot,
+                                      BufferHandle::pointer handle,
+                                      size_t offset, size_t size) {
+  assert(slot < kMaxShaderStorageBufferSlots);
+  bind_state.shaderStorageBuffers[slot] = handle->buf_obj;
+  bind_state.shaderStorageBufferSizes[slot] = size;
+  bind_state.shaderStorageBufferOffsets[slot] = offset;
+  bind_state.shaderStorageBuffersUpdated = true;
+}
+
 void OpenGLBackend::bindSurface(SurfaceHandle::pointer handle) {
   bindFramebufferObject(handle.id);
 }
@@ -537,6 +805,16 @@ void OpenGLBackend::bindRWTexture3D(unsigned slot,
   }
 }
 
+void OpenGLBackend::bindRWTexture2DArray(unsigned slot,
+                                         TextureHandle::pointer handle) {
+  // glBindImageTextures binds all layers of array textures
+  assert(slot < kMaxImageUnits);
+  if (bind_state.images[slot] != handle.id) {
+    bind_state.images[slot] = handle.id;
+    bind_state.imagesUpdated = true;
+  }
+}
+
 void OpenGLBackend::bindRenderTexture(unsigned slot,
                                       TextureHandle::pointer handle) {
   bindFramebufferObject(render_to_texture_fbo);
@@ -605,6 +883,123 @@ void OpenGLBackend::clearDepth(SurfaceHandle::pointer framebuffer_obj,
   gl::ClearNamedFramebufferfv(framebuffer_obj.id, gl::DEPTH, 0, &depth);
 }
 
+void OpenGLBackend::clearTexture1DFloat(TextureHandle::pointer handle,
+                                        const Texture1DInfo& info,
+                                        const ag::Box1D& region,
+                                        const ag::ClearColor& color) {
+  gl::ClearTexImage(handle.id, 0, gl::RGBA, gl::FLOAT, color.rgba);
+}
+
+void OpenGLBackend::clearTexture2DFloat(TextureHandle::pointer handle,
+                                        const Texture2DInfo& info,
+                                        const ag::Box2D& region,
+                                        const ag::ClearColor& color) {
+  if (region.xmin == 0 && region.ymin == 0 &&
+      region.xmax >= info.dimensions.x && region.ymax >= info.dimensions.y) {
+    gl::ClearTexImage(handle.id, 0, gl::RGBA, gl::FLOAT, color.rgba);
+    return;
+  }
+  // clip to the texture
+  auto xmax = std::min(region.xmax, info.dimensions.x);
+  auto ymax = std::min(region.ymax, info.dimensions.y);
+  if (region.xmin < xmax && region.ymin < ymax)
+    gl::ClearTexSubImage(handle.id, 0, region.xmin, region.ymin, 0,
+                         xmax - region.xmin, ymax - region.ymin, 1, gl::RGBA,
+                         gl::FLOAT, color.rgba);
+}
+
+void OpenGLBackend::clearTexture3DFloat(TextureHandle::pointer handle,
+                                        const Texture3DInfo& info,
+                                        const ag::Box3D& region,
+                                        const ag::ClearColor& color) {
+  gl::ClearTexImage(handle.id, 0, gl::RGBA, gl::FLOAT, color.rgba);
+}
+
+void OpenGLBackend::clearTexture2DArrayFloat(TextureHandle::pointer handle,
+                                             const Texture2DArrayInfo& info,
+                                             const ag::Box3D& region,
+                                             const ag::ClearColor& color) {
+  gl::ClearTexSubImage(handle.id, 0, region.xmin, region.ymin, region.zmin,
+                       region.width(), region.height(), region.depth(),
+                       gl::RGBA, gl::FLOAT, color.rgba);
+}
+
+void OpenGLBackend::clearTexture1DInteger(TextureHandle::pointer handle,
+                                          const Texture1DInfo& info,
+                                          const ag::Box1D& region,
+                                          const ag::ClearColorInt& color) {
+  gl::ClearTexImage(handle.id, 0, gl::RGBA_INTEGER, gl::UNSIGNED_INT,
+                    color.rgba);
+}
+
+void OpenGLBackend::clearTexture2DInteger(TextureHandle::pointer handle,
+                                          const Texture2DInfo& info,
+                                          const ag::Box2D& region,
+                                          const ag::ClearColorInt& color) {
+  gl::ClearTexImage(handle.id, 0, gl::RGBA_INTEGER, gl::UNSIGNED_INT,
+                    color.rgba);
+}
+
+void OpenGLBackend::clearTexture3DInteger(TextureHandle::pointer handle,
+                                          const Texture3DInfo& info,
+                                          const ag::Box3D& region,
+                                          const ag::ClearColorInt& color) {
+  gl::ClearTexImage(handle.id, 0, gl::RGBA_INTEGER, gl::UNSIGNED_INT,
+                    color.rgba);
+}
+
+void OpenGLBackend::clearTexture2DDepth(TextureHandle::pointer handle,
+                                        const Texture2DInfo& info,
+                                        const ag::Box2D& region, float depth) {
+  gl::ClearTexImage(handle.id, 0, gl::DEPTH_COMPONENT, gl::FLOAT, &depth);
+}
+
+void OpenGLBackend::copyTextureRegion1D(
+    TextureHandle::pointer src_handle, const Texture1DInfo& info,
+    BufferHandle::pointer dest_handle, size_t dest_offset, size_t dest_size,
+    const ag::Box1D& region, unsigned mipLevel) {
+  const auto& gl_fmt = pixelFormatToGL(info.format);
+  gl::BindBuffer(gl::PIXEL_PACK_BUFFER, dest_handle->buf_obj);
+  gl::GetTextureSubImage(src_handle.id, mipLevel, region.xmin, 0, 0,
+                         region.width(), 1, 1, gl_fmt.externalFormat,
+                         gl_fmt.type, (GLsizei)dest_size, (void*)dest_offset);
+  gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+}
+
+void OpenGLBackend::copyTextureRegion2D(
+    TextureHandle::pointer src_handle, const Texture2DInfo& info,
+    BufferHandle::pointer dest_handle, size_t dest_offset, size_t dest_size,
+    const ag::Box2D& region, unsigned mipLevel) {
+  const auto& gl_fmt = pixelFormatToGL(info.format);
+  gl::BindBuffer(gl::PIXEL_PACK_BUFFER, dest_handle->buf_obj);
+  gl::GetTextureSubImage(src_handle.id, mipLevel, region.xmin, region.ymin, 0,
+                         region.width(), region.height(), 1,
+                         gl_fmt.externalFormat, gl_fmt.type, (GLsizei)dest_size,
+                         (void*)dest_offset);
+  gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+}
+
+void OpenGLBackend::copyTextureRegion2DArray(
+    TextureHandle::pointer src_handle, const Texture2DArrayInfo& info,
+    BufferHandle::pointer dest_handle, size_t dest_offset, size_t dest_size,
+    const ag::Box3D& region, unsigned mipLevel) {
+  const auto& gl_fmt = pixelFormatToGL(info.format);
+  gl::BindBuffer(gl::PIXEL_PACK_BUFFER, dest_handle->buf_obj);
+  gl::GetTextureSubImage(src_handle.id, mipLevel, region.xmin, region.ymin,
+                         region.zmin, region.width(), region.height(),
+                         region.depth(), gl_fmt.externalFormat, gl_fmt.type,
+                         (GLsizei)dest_size, (void*)dest_offset);
+  gl::BindBuffer(gl::PIXEL_PACK_BUFFER, 0);
+}
+
+void OpenGLBackend::copyBuffer(BufferHandle::pointer src_handle,
+                               size_t src_offset,
+                               BufferHandle::pointer dest_handle,
+                               size_t dest_offset, size_t size) {
+  gl::CopyNamedBufferSubData(src_handle->buf_obj, dest_handle->buf_obj,
+                             src_offset, dest_offset, size);
+}
+
 void OpenGLBackend::updateTexture1D(TextureHandle::pointer handle,
                                     const Texture1DInfo& info,
                                     unsigned mipLevel, ag::Box1D region,
@@ -619,11 +1014,41 @@ void OpenGLBackend::updateTexture2D(TextureHandle::pointer handle,
                                     unsigned mipLevel, ag::Box2D region,
                                     gsl::span<const gsl::byte> data) {
   auto gl_fmt = pixelFormatToGL(info.format);
+  if (isCompressedFormat(info.format)) {
+    gl::CompressedTextureSubImage2D(handle.id, mipLevel, region.xmin,
+                                    region.ymin, region.width(),
+                                    region.height(), gl_fmt.internalFormat,
+                                    (GLsizei)data.size_bytes(), data.data());
+    return;
+  }
   gl::TextureSubImage2D(handle.id, mipLevel, region.xmin, region.ymin,
                         region.width(), region.height(), gl_fmt.externalFormat,
                         gl_fmt.type, data.data());
 }
 
+void OpenGLBackend::updateTexture2DFromBuffer(
+    TextureHandle::pointer handle, const Texture2DInfo& info,
+    unsigned mipLevel, ag::Box2D region, BufferHandle::pointer src_handle,
+    size_t src_offset) {
+  auto gl_fmt = pixelFormatToGL(info.format);
+  gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, src_handle->buf_obj);
+  gl::PixelStorei(gl::UNPACK_ALIGNMENT, 1);
+  if (isCompressedFormat(info.format)) {
+    auto size = ((region.width() + 3) / 4) * ((region.height() + 3) / 4) *
+                getCompressedBlockSize(info.format);
+    gl::CompressedTextureSubImage2D(
+        handle.id, mipLevel, region.xmin, region.ymin, region.width(),
+        region.height(), gl_fmt.internalFormat, (GLsizei)size,
+        (const void*)src_offset);
+  } else
+    gl::TextureSubImage2D(handle.id, mipLevel, region.xmin, region.ymin,
+                          region.width(), region.height(),
+                          gl_fmt.externalFormat, gl_fmt.type,
+                          (const void*)src_offset);
+  gl::PixelStorei(gl::UNPACK_ALIGNMENT, 4);
+  gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+}
+
 void OpenGLBackend::updateTexture3D(TextureHandle::pointer handle,
                                     const Texture3DInfo& info,
                                     unsigned mipLevel, ag::Box3D region,
@@ -635,6 +1060,67 @@ void OpenGLBackend::updateTexture3D(TextureHandle::pointer handle,
                         data.data());
 }
 
+void OpenGLBackend::updateTexture2DArray(TextureHandle::pointer handle,
+                                         const Texture2DArrayInfo& info,
+                                         unsigned mipLevel, unsigned layer,
+                                         ag::Box2D region,
+                                         gsl::span<const gsl::byte> data) {
+  auto gl_fmt = pixelFormatToGL(info.format);
+  gl::TextureSubImage3D(handle.id, mipLevel, region.xmin, region.ymin, layer,
+                        region.width(), region.height(), 1,
+                        gl_fmt.externalFormat, gl_fmt.type, data.data());
+}
+
+void OpenGLBackend::updateTextureCubeMap(TextureHandle::pointer handle,
+                                         const TextureCubeMapInfo& info,
+                                         unsigned mipLevel, unsigned face,
+                                         ag::Box2D region,
+                                         gsl::span<const gsl::byte> data) {
+  // with DSA, cube map faces are addressed as layers
+  auto gl_fmt = pixelFormatToGL(info.format);
+  gl::TextureSubImage3D(handle.id, mipLevel, region.xmin, region.ymin, face,
+                        region.width(), region.height(), 1,
+                        gl_fmt.externalFormat, gl_fmt.type, data.data());
+}
+
+void OpenGLBackend::copyTexture2DRegion(TextureHandle::pointer src_handle,
+                                        unsigned src_mipLevel,
+                                        const Box2D& src_region,
+                                        TextureHandle::pointer dest_handle,
+                                        unsigned dest_mipLevel,
+                                        glm::uvec2 dest_offset) {
+  gl::CopyImageSubData(src_handle.id, gl::TEXTURE_2D, src_mipLevel,
+                       src_region.xmin, src_region.ymin, 0, dest_handle.id,
+                       gl::TEXTURE_2D, dest_mipLevel, dest_offset.x,
+                       dest_offset.y, 0, src_region.width(),
+                       src_region.height(), 1);
+}
+
+void OpenGLBackend::copyTexture2DRegionToLayer(
+    TextureHandle::pointer src_handle, unsigned src_mipLevel,
+    const Box2D& src_region, TextureHandle::pointer dest_handle,
+    unsigned dest_mipLevel, unsigned dest_layer, glm::uvec2 dest_offset) {
+  gl::CopyImageSubData(src_handle.id, gl::TEXTURE_2D, src_mipLevel,
+                       src_region.xmin, src_region.ymin, 0, dest_handle.id,
+                       gl::TEXTURE_2D_ARRAY, dest_mipLevel, dest_offset.x,
+                       dest_offset.y, dest_layer, src_region.width(),
+                       src_region.height(), 1);
+}
+
+void OpenGLBackend::copyTexture2DArrayRegion(TextureHandle::pointer src_handle,
+                                             unsigned src_mipLevel,
+                                             const Box3D& src_region,
+                                             TextureHandle::pointer dest_handle,
+                                             unsigned dest_mipLevel,
+                                             glm::uvec3 dest_offset) {
+  gl::CopyImageSubData(src_handle.id, gl::TEXTURE_2D_ARRAY, src_mipLevel,
+                       src_region.xmin, src_region.ymin, src_region.zmin,
+                       dest_handle.id, gl::TEXTURE_2D_ARRAY, dest_mipLevel,
+                       dest_offset.x, dest_offset.y, dest_offset.z,
+                       src_region.width(), src_region.height(),
+                       src_region.depth());
+}
+
 void OpenGLBackend::readTexture1D(TextureHandle::pointer handle,
                                   const Texture1DInfo& info, unsigned mipLevel,
                                   Box1D region, gsl::span<gsl::byte> outData) {
@@ -659,6 +1145,182 @@ void OpenGLBackend::readTexture3D(TextureHandle::pointer handle,
                       (GLsizei)outData.size(), outData.data());
 }
 
+///////////////////// Mipmaps
+namespace {
+// Each workgroup reduces a 64x64 tile of the base level: level 1 is
+// computed from texel fetches, the next levels from the previous one in
+// shared memory. Each texel is the average of a 2x2 box: for odd
+// dimensions, the last row or column of the source level is dropped (like
+// the usual box filter of glGenerateMipmap). Fetches outside of the base
+// level are clamped to its edge, they only feed texels that are outside of
+// the destination level.
+constexpr unsigned kMipmapTileSize = 64;
+constexpr unsigned kMipmapLevelsPerPass = 6;
+
+const char kMipmapShaderSource[] = R"(
+#version 450
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(binding = 0) uniform sampler2D srcTex;
+layout(binding = 0, MIP_FORMAT) writeonly uniform image2D dstLevel1;
+layout(binding = 1, MIP_FORMAT) writeonly uniform image2D dstLevel2;
+layout(binding = 2, MIP_FORMAT) writeonly uniform image2D dstLevel3;
+layout(binding = 3, MIP_FORMAT) writeonly uniform image2D dstLevel4;
+layout(binding = 4, MIP_FORMAT) writeonly uniform image2D dstLevel5;
+layout(binding = 5, MIP_FORMAT) writeonly uniform image2D dstLevel6;
+layout(location = 0) uniform ivec2 origin;
+layout(location = 1) uniform int baseLevel;
+layout(location = 2) uniform int numLevels;
+
+shared vec4 tile[32][32];
+
+vec4 fetch(ivec2 p) {
+  ivec2 size = textureSize(srcTex, baseLevel);
+  return texelFetch(srcTex, clamp(p, ivec2(0), size - 1), baseLevel);
+}
+
+void store(int level, ivec2 p, vec4 v) {
+  switch (level) {
+  case 1: imageStore(dstLevel1, p, v); break;
+  case 2: imageStore(dstLevel2, p, v); break;
+  case 3: imageStore(dstLevel3, p, v); break;
+  case 4: imageStore(dstLevel4, p, v); break;
+  case 5: imageStore(dstLevel5, p, v); break;
+  case 6: imageStore(dstLevel6, p, v); break;
+  }
+}
+
+void main() {
+  ivec2 tileOrigin = origin + ivec2(gl_WorkGroupID.xy) * 64;
+  ivec2 t = ivec2(gl_LocalInvocationID.xy);
+  // level 1: 2x2 texels per thread
+  for (int j = 0; j < 2; ++j)
+    for (int i = 0; i < 2; ++i) {
+      ivec2 d = t * 2 + ivec2(i, j);
+      ivec2 s = tileOrigin + d * 2;
+      vec4 v = 0.25 * (fetch(s) + fetch(s + ivec2(1, 0)) +
+                       fetch(s + ivec2(0, 1)) + fetch(s + ivec2(1, 1)));
+      tile[d.y][d.x] = v;
+      store(1, tileOrigin / 2 + d, v);
+    }
+  // following levels
+  for (int level = 2; level <= numLevels; ++level) {
+    barrier();
+    int n = 64 >> level;
+    bool active = t.x < n && t.y < n;
+    vec4 v;
+    if (active) {
+      ivec2 s = t * 2;
+      v = 0.25 * (tile[s.y][s.x] + tile[s.y][s.x + 1] + tile[s.y + 1][s.x] +
+                  tile[s.y + 1][s.x + 1]);
+    }
+    barrier();
+    if (active) {
+      tile[t.y][t.x] = v;
+      store(level, (tileOrigin >> level) + t, v);
+    }
+  }
+}
+)";
+
+// GLSL image format qualifier, nullptr if the format cannot be used
+// for image stores
+const char* getImageFormatQualifier(GLenum internalFormat) {
+  switch (internalFormat) {
+  case gl::R8:
+    return "r8";
+  case gl::RG8:
+    return "rg8";
+  case gl::RGBA8:
+    return "rgba8";
+  case gl::R32F:
+    return "r32f";
+  case gl::RG32F:
+    return "rg32f";
+  case gl::RGBA32F:
+    return "rgba32f";
+  case gl::RGB10_A2:
+    return "rgb10_a2";
+  default:
+    return nullptr;
+  }
+}
+}
+
+void OpenGLBackend::generateMipmaps(TextureHandle::pointer handle) {
+  gl::GenerateTextureMipmap(handle.id);
+}
+
+GLuint OpenGLBackend::getMipmapProgram(GLenum internalFormat) {
+  auto it = mipmap_programs.find(internalFormat);
+  if (it != mipmap_programs.end())
+    return it->second;
+  GLuint program = 0;
+  if (auto qualifier = getImageFormatQualifier(internalFormat)) {
+    std::string source = kMipmapShaderSource;
+    std::string fmt = qualifier;
+    for (auto pos = source.find("MIP_FORMAT"); pos != std::string::npos;
+         pos = source.find("MIP_FORMAT", pos))
+      source.replace(pos, 10, fmt);
+    ComputePipelineInfo info;
+    info.CSSource = source.c_str();
+    program = createComputeProgram(info);
+  }
+  mipmap_programs[internalFormat] = program;
+  return program;
+}
+
+void OpenGLBackend::generateMipmaps2D(TextureHandle::pointer handle,
+                                      const Texture2DInfo& info,
+                                      unsigned baseLevel, const Box2D& region) {
+  if (baseLevel + 1 >= info.mipLevels)
+    return;
+  auto glfmt = pixelFormatToGL(info.format);
+  auto program = getMipmapProgram(glfmt.internalFormat);
+  if (!program) {
+    generateMipmaps(handle);
+    return;
+  }
+
+  gl::UseProgram(program);
+  gl::BindTextureUnit(0, handle.id);
+  gl::BindSampler(0, 0);
+  // align the region on tiles
+  unsigned xmin = region.xmin / kMipmapTileSize * kMipmapTileSize;
+  unsigned ymin = region.ymin / kMipmapTileSize * kMipmapTileSize;
+  unsigned xmax = region.xmax;
+  unsigned ymax = region.ymax;
+  for (unsigned level = baseLevel; level + 1 < info.mipLevels;
+       level += kMipmapLevelsPerPass) {
+    unsigned numLevels =
+        std::min(kMipmapLevelsPerPass, info.mipLevels - 1 - level);
+    for (unsigned i = 0; i < kMipmapLevelsPerPass; ++i) {
+      // unused units are bound to the last level (never written)
+      unsigned dstLevel = level + 1 + std::min(i, numLevels - 1);
+      gl::BindImageTexture(i, handle.id, dstLevel, gl::FALSE_, 0,
+                           gl::WRITE_ONLY, glfmt.internalFormat);
+    }
+    gl::Uniform2i(0, (GLint)xmin, (GLint)ymin);
+    gl::Uniform1i(1, (GLint)level);
+    gl::Uniform1i(2, (GLint)numLevels);
+    unsigned tilesX = (xmax - xmin + kMipmapTileSize - 1) / kMipmapTileSize;
+    unsigned tilesY = (ymax - ymin + kMipmapTileSize - 1) / kMipmapTileSize;
+    gl::DispatchCompute(std::max(tilesX, 1u), std::max(tilesY, 1u), 1);
+    // the next pass fetches the last level written by this one
+    gl::MemoryBarrier(gl::TEXTURE_FETCH_BARRIER_BIT |
+                      gl::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    // region in the texels of the next base level
+    xmin = (xmin >> kMipmapLevelsPerPass) / kMipmapTileSize * kMipmapTileSize;
+    ymin = (ymin >> kMipmapLevelsPerPass) / kMipmapTileSize * kMipmapTileSize;
+    const unsigned round = (1u << kMipmapLevelsPerPass) - 1;
+    xmax = std::max((xmax + round) >> kMipmapLevelsPerPass, 1u);
+    ymax = std::max((ymax + round) >> kMipmapLevelsPerPass, 1u);
+  }
+  // units were modified behind the bind state: rebind on the next draw
+  bind_state.textureUpdated = true;
+  bind_state.samplersUpdated = true;
+  bind_state.imagesUpdated = true;
+}
+
 void OpenGLBackend::draw(PrimitiveType primitiveType, unsigned first,
                          unsigned count) {
   bindState();
@@ -674,6 +1336,38 @@ void OpenGLBackend::drawIndexed(PrimitiveType primitiveType, unsigned first,
       ((const char*)((uintptr_t)first * indexStride)), baseVertex);
 }
 
+void OpenGLBackend::drawIndexedIndirect(PrimitiveType primitiveType,
+                                        BufferHandle::pointer indirectBuffer,
+                                        size_t indirectOffset,
+                                        BufferHandle::pointer countBuffer,
+                                        size_t countOffset,
+                                        unsigned maxDrawCount,
+                                        unsigned stride) {
+  bindState();
+  // the commands and the count are usually written by a compute shader
+  gl::MemoryBarrier(gl::COMMAND_BARRIER_BIT);
+  gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, indirectBuffer->buf_obj);
+  auto mode = primitiveTypeToGLenum(primitiveType);
+  auto indirect = (const void*)(uintptr_t)indirectOffset;
+  if (multi_draw_elements_indirect_count && countBuffer) {
+    gl::BindBuffer(kParameterBuffer, countBuffer->buf_obj);
+    multi_draw_elements_indirect_count(mode, bind_state.indexBufferType,
+                                       indirect, (GLintptr)countOffset,
+                                       maxDrawCount, stride);
+    gl::BindBuffer(kParameterBuffer, 0);
+  } else {
+    gl::MultiDrawElementsIndirect(mode, bind_state.indexBufferType, indirect,
+                                  maxDrawCount, stride);
+  }
+  gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, 0);
+}
+
+void OpenGLBackend::clearBuffer(BufferHandle::pointer handle, size_t offset,
+                                size_t size) {
+  gl::ClearNamedBufferSubData(handle->buf_obj, gl::R32UI, offset, size,
+                              gl::RED_INTEGER, gl::UNSIGNED_INT, nullptr);
+}
+
 void OpenGLBackend::dispatchCompute(unsigned threadGroupCountX,
                                     unsigned threadGroupCountY,
                                     unsigned threadGroupCountZ) {
@@ -681,6 +1375,10 @@ void OpenGLBackend::dispatchCompute(unsigned threadGroupCountX,
   gl::DispatchCompute(threadGroupCountX, threadGroupCountY, threadGroupCountZ);
 }
 
+void OpenGLBackend::memoryBarrier() {
+  gl::MemoryBarrier(gl::ALL_BARRIER_BITS);
+}
+
 void OpenGLBackend::swapBuffers() {
   glfwSwapBuffers(window);
   glfwPollEvents();
@@ -727,6 +1425,18 @@ void OpenGLBackend::bindState() {
     }
     bind_state.uniformBuffersUpdated = false;
   }
+  if (bind_state.shaderStorageBuffersUpdated) {
+    for (unsigned i = 0; i < kMaxShaderStorageBufferSlots; ++i) {
+      if (bind_state.shaderStorageBuffers[i])
+        gl::BindBufferRange(gl::SHADER_STORAGE_BUFFER, i,
+                            bind_state.shaderStorageBuffers[i],
+                            bind_state.shaderStorageBufferOffsets[i],
+                            bind_state.shaderStorageBufferSizes[i]);
+      else
+        gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, i, 0);
+    }
+    bind_state.shaderStorageBuffersUpdated = false;
+  }
   if (bind_state.indexBuffer)
     gl::BindBuffer(gl::ELEMENT_ARRAY_BUFFER, bind_state.indexBuffer);
 }
@@ -736,7 +1446,8 @@ OpenGLBackend::createTexture1D(const Texture1DInfo& info) {
   GLuint tex_obj;
   auto glfmt = pixelFormatToGL(info.format);
   gl::CreateTextures(gl::TEXTURE_1D, 1, &tex_obj);
-  gl::TextureStorage1D(tex_obj, 1, glfmt.internalFormat, info.dimensions);
+  gl::TextureStorage1D(tex_obj, info.mipLevels, glfmt.internalFormat,
+                       info.dimensions);
   return TextureHandle(GLuintHandle(tex_obj), TextureDeleter());
 }
 
@@ -745,8 +1456,8 @@ OpenGLBackend::createTexture2D(const Texture2DInfo& info) {
   GLuint tex_obj;
   auto glfmt = pixelFormatToGL(info.format);
   gl::CreateTextures(gl::TEXTURE_2D, 1, &tex_obj);
-  gl::TextureStorage2D(tex_obj, 1, glfmt.internalFormat, info.dimensions.x,
-                       info.dimensions.y);
+  gl::TextureStorage2D(tex_obj, info.mipLevels, glfmt.internalFormat,
+                       info.dimensions.x, info.dimensions.y);
   return TextureHandle(GLuintHandle(tex_obj), TextureDeleter());
 }
 
@@ -755,8 +1466,28 @@ OpenGLBackend::createTexture3D(const Texture3DInfo& info) {
   GLuint tex_obj;
   auto glfmt = pixelFormatToGL(info.format);
   gl::CreateTextures(gl::TEXTURE_3D, 1, &tex_obj);
-  gl::TextureStorage3D(tex_obj, 1, glfmt.internalFormat, info.dimensions.x,
-                       info.dimensions.y, info.dimensions.z);
+  gl::TextureStorage3D(tex_obj, info.mipLevels, glfmt.internalFormat,
+                       info.dimensions.x, info.dimensions.y, info.dimensions.z);
+  return TextureHandle(GLuintHandle(tex_obj), TextureDeleter());
+}
+
+OpenGLBackend::TextureHandle
+OpenGLBackend::createTexture2DArray(const Texture2DArrayInfo& info) {
+  GLuint tex_obj;
+  auto glfmt = pixelFormatToGL(info.format);
+  gl::CreateTextures(gl::TEXTURE_2D_ARRAY, 1, &tex_obj);
+  gl::TextureStorage3D(tex_obj, info.mipLevels, glfmt.internalFormat,
+                       info.dimensions.x, info.dimensions.y, info.layers);
+  return TextureHandle(GLuintHandle(tex_obj), TextureDeleter());
+}
+
+OpenGLBackend::TextureHandle
+OpenGLBackend::createTextureCubeMap(const TextureCubeMapInfo& info) {
+  GLuint tex_obj;
+  auto glfmt = pixelFormatToGL(info.format);
+  gl::CreateTextures(gl::TEXTURE_CUBE_MAP, 1, &tex_obj);
+  gl::TextureStorage2D(tex_obj, info.mipLevels, glfmt.internalFormat, info.size,
+                       info.size);
   return TextureHandle(GLuintHandle(tex_obj), TextureDeleter());
 }
 }
@@ -2,8 +2,15 @@
 #define OPENGL_BACKEND_HPP
 
 #include <array>
+#include <condition_variable>
 #include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 // this must be included before glfw3
 #include <gl_core_4_5.hpp>
@@ -49,6 +56,12 @@ struct is_enum_flags<ag::opengl::DataAccessHints> : public std::true_type {};
 namespace ag {
 namespace opengl {
 
+// S3TC formats are not core (EXT_texture_compression_s3tc), but are
+// supported everywhere
+constexpr GLenum kCompressedRGBA_S3TC_DXT1 = 0x83F1;
+constexpr GLenum kCompressedRGBA_S3TC_DXT3 = 0x83F2;
+constexpr GLenum kCompressedRGBA_S3TC_DXT5 = 0x83F3;
+
 struct GLPixelFormat {
   GLenum internalFormat;
   GLenum externalFormat;
@@ -77,11 +90,23 @@ inline GLPixelFormat pixelFormatToGL(PixelFormat format) {
   case PixelFormat::Float:
     return GLPixelFormat{gl::R32F, gl::RED, gl::FLOAT, 1};
   case PixelFormat::Float2:
-    return GLPixelFormat{gl::RG32F, gl::RED, gl::FLOAT, 2};
+    return GLPixelFormat{gl::RG32F, gl::RG, gl::FLOAT, 2};
   case PixelFormat::Float3:
-    return GLPixelFormat{gl::RGB32F, gl::RED, gl::FLOAT, 3};
+    return GLPixelFormat{gl::RGB32F, gl::RGB, gl::FLOAT, 3};
   case PixelFormat::Float4:
-    return GLPixelFormat{gl::RGBA32F, gl::RED, gl::FLOAT, 4};
+    return GLPixelFormat{gl::RGBA32F, gl::RGBA, gl::FLOAT, 4};
+  case PixelFormat::Float16:
+    return GLPixelFormat{gl::R16F, gl::RED, gl::HALF_FLOAT, 1};
+  case PixelFormat::Float16x2:
+    return GLPixelFormat{gl::RG16F, gl::RG, gl::HALF_FLOAT, 2};
+  case PixelFormat::Float16x4:
+    return GLPixelFormat{gl::RGBA16F, gl::RGBA, gl::HALF_FLOAT, 4};
+  case PixelFormat::Unorm16:
+    return GLPixelFormat{gl::R16, gl::RED, gl::UNSIGNED_SHORT, 1};
+  case PixelFormat::Unorm16x2:
+    return GLPixelFormat{gl::RG16, gl::RG, gl::UNSIGNED_SHORT, 2};
+  case PixelFormat::Unorm16x4:
+    return GLPixelFormat{gl::RGBA16, gl::RGBA, gl::UNSIGNED_SHORT, 4};
   case PixelFormat::Uint32:
     return GLPixelFormat{gl::R32UI, gl::RED_INTEGER, gl::UNSIGNED_INT, 1};
   case PixelFormat::Depth32:
@@ -94,6 +119,21 @@ inline GLPixelFormat pixelFormatToGL(PixelFormat format) {
   case PixelFormat::Unorm10x3_1x2:
     return GLPixelFormat{gl::RGB10_A2, gl::RGBA, gl::UNSIGNED_INT_10_10_10_2,
                          4};
+  // compressed formats have no external format
+  case PixelFormat::BC1:
+    return GLPixelFormat{kCompressedRGBA_S3TC_DXT1, 0, 0, 4};
+  case PixelFormat::BC2:
+    return GLPixelFormat{kCompressedRGBA_S3TC_DXT3, 0, 0, 4};
+  case PixelFormat::BC3:
+    return GLPixelFormat{kCompressedRGBA_S3TC_DXT5, 0, 0, 4};
+  case PixelFormat::UnormBC4:
+    return GLPixelFormat{gl::COMPRESSED_RED_RGTC1, 0, 0, 1};
+  case PixelFormat::SnormBC4:
+    return GLPixelFormat{gl::COMPRESSED_SIGNED_RED_RGTC1, 0, 0, 1};
+  case PixelFormat::UnormBC5:
+    return GLPixelFormat{gl::COMPRESSED_RG_RGTC2, 0, 0, 2};
+  case PixelFormat::SnormBC5:
+    return GLPixelFormat{gl::COMPRESSED_SIGNED_RG_RGTC2, 0, 0, 2};
   default:
     failWith("TODO");
   }
@@ -107,7 +147,7 @@ struct GLuintHandle {
   GLuintHandle(GLuint obj_id) : id(obj_id) {}
   // default and nullptr constructors folded together
   GLuintHandle(std::nullptr_t = nullptr) : id(0) {}
-  explicit operator bool() { return id != 0; }
+  explicit operator bool() const { return id != 0; }
   friend bool operator==(GLuintHandle l, GLuintHandle r) {
     return l.id == r.id;
   }
@@ -118,12 +158,23 @@ struct GLuintHandle {
   // swappable requirement fulfilled by std::swap
 };
 
+// offset of an attribute that follows the previous attribute of the same slot
+constexpr unsigned kVertexAttributeAutoOffset = ~0u;
+
+// Vertex attribute format
+// type: component type, including packed types (gl::INT_2_10_10_10_REV,
+// gl::UNSIGNED_INT_2_10_10_10_REV with size 4) and gl::HALF_FLOAT
+// size: number of components
+// stride: size in bytes of the attribute
+// normalized: integer components are normalized to [0,1] or [-1,1]
+// offset: relative offset of the attribute in the vertex, in bytes
 struct VertexAttribute {
   unsigned slot;
   GLenum type;
   unsigned size;
   unsigned stride;
   bool normalized;
+  unsigned offset = kVertexAttributeAutoOffset;
 };
 
 struct GraphicsPipelineInfo {
@@ -156,6 +207,8 @@ public:
   static constexpr unsigned kBufferAlignment = 64;
   static constexpr unsigned kUniformBufferOffsetAlignment =
       256; // TODO do not hardcode this
+  // maximum value allowed by the spec
+  static constexpr unsigned kShaderStorageBufferOffsetAlignment = 256;
 
   ///////////////////// arbitrary binding limits
   static constexpr unsigned kMaxTextureUnits = 16;
@@ -176,6 +229,9 @@ public:
     GLuint program = 0;
   };
 
+  // description of a compute pipeline for createComputePipeline
+  using ComputePipelineInfo = opengl::ComputePipelineInfo;
+
   struct GLFence {
     struct SyncPoint {
       GLsync sync;
@@ -186,6 +242,10 @@ public:
     std::deque<SyncPoint> syncPoints;
   };
 
+  struct GLQueryPool {
+    std::vector<GLuint> queries;
+  };
+
   struct GLbuffer {
     GLuint buf_obj;
     BufferUsage usage;
@@ -241,6 +301,14 @@ public:
     }
   };
 
+  struct QueryPoolDeleter {
+    using pointer = GLQueryPool*;
+    void operator()(pointer pool) {
+      gl::DeleteQueries((GLsizei)pool->queries.size(), pool->queries.data());
+      delete pool;
+    }
+  };
+
   ///////////////////// associated types
   // buffer handles
   using BufferHandle = std::unique_ptr<void, BufferDeleter>;
@@ -255,9 +323,13 @@ public:
   using ComputePipelineHandle = std::unique_ptr<void, ComputePipelineDeleter>;
   // fence handle
   using FenceHandle = std::unique_ptr<void, FenceDeleter>;
+  // timestamp query pool handle
+  using TimestampQueryPoolHandle = std::unique_ptr<void, QueryPoolDeleter>;
 
   // constructor
   OpenGLBackend();
+  // stops the loader thread
+  ~OpenGLBackend();
 
   // create a swap chain to draw into (color buffer + depth buffer)
   void createWindow(const DeviceOptions& options);
@@ -270,6 +342,8 @@ public:
   TextureHandle createTexture1D(const Texture1DInfo& info);
   TextureHandle createTexture2D(const Texture2DInfo& info);
   TextureHandle createTexture3D(const Texture3DInfo& info);
+  TextureHandle createTexture2DArray(const Texture2DArrayInfo& info);
+  TextureHandle createTextureCubeMap(const TextureCubeMapInfo& info);
 
   // used internally
   /*void destroyTexture1D(Texture1DHandle detail, const Texture1DInfo& info);
@@ -306,13 +380,54 @@ public:
   // void destroyFence(FenceHandle handle);
   void waitForFence(FenceHandle::pointer handle, uint64_t value);
 
+  ///////////////////// Timestamp queries
+  TimestampQueryPoolHandle createTimestampQueryPool(unsigned count);
+  // insert a timestamp write into the GPU command stream
+  void writeTimestamp(TimestampQueryPoolHandle::pointer pool, unsigned index);
+  // non-blocking: returns false if the result is not available yet
+  // timestamps are in nanoseconds
+  bool tryGetTimestamp(TimestampQueryPoolHandle::pointer pool, unsigned index,
+                       uint64_t& outTimestamp);
+  // current GPU time, in nanoseconds (does not wait for the GPU to finish)
+  uint64_t getGPUTimestamp();
+
+  ///////////////////// Background resource creation
+  // Resources can be created and filled on a loader thread with its own
+  // context (sharing objects with the main context).
+  // `task` runs on the loader thread; a fence is inserted after it, and
+  // `publish` is called on the render thread from pollLoaderCompletions()
+  // once the fence is signaled. Exceptions thrown by `task` are rethrown
+  // on the render thread (the first one, after publishing the other
+  // completed tasks).
+  // Must be called from the render thread.
+  void runOnLoaderThread(std::function<void()> task,
+                         std::function<void()> publish);
+  // non-blocking, called by the device at the end of each frame
+  void pollLoaderCompletions();
+  // number of tasks not yet published
+  size_t getLoaderPendingCount();
+
+  // Pipelines compiled on the loader thread
+  // (vertex array objects are not shared between contexts, so they are
+  // created on the render thread before calling `onReady`)
+  void createGraphicsPipelineAsync(
+      const GraphicsPipelineInfo& info,
+      std::function<void(GraphicsPipelineHandle)> onReady);
+  void
+  createComputePipelineAsync(const ComputePipelineInfo& info,
+                             std::function<void(ComputePipelineHandle)> onReady);
+
   ///////////////////// Bind
   void bindTexture1D(unsigned slot, TextureHandle::pointer handle);
   void bindTexture2D(unsigned slot, TextureHandle::pointer handle);
   void bindTexture3D(unsigned slot, TextureHandle::pointer handle);
+  void bindTexture2DArray(unsigned slot, TextureHandle::pointer handle);
+  void bindTextureCubeMap(unsigned slot, TextureHandle::pointer handle);
   void bindRWTexture1D(unsigned slot, TextureHandle::pointer handle);
   void bindRWTexture2D(unsigned slot, TextureHandle::pointer handle);
   void bindRWTexture3D(unsigned slot, TextureHandle::pointer handle);
+  // binds all layers
+  void bindRWTexture2DArray(unsigned slot, TextureHandle::pointer handle);
   void bindSampler(unsigned slot, SamplerHandle::pointer handle);
   void bindVertexBuffer(unsigned slot, BufferHandle::pointer handle,
                         size_t offset, size_t size, unsigned stride);
@@ -320,6 +435,8 @@ public:
                        IndexType type);
   void bindUniformBuffer(unsigned slot, BufferHandle::pointer handle,
                          size_t offset, size_t size);
+  void bindStorageBuffer(unsigned slot, BufferHandle::pointer handle,
+                         size_t offset, size_t size);
   void bindGraphicsPipeline(GraphicsPipelineHandle::pointer handle);
   void bindComputePipeline(ComputePipelineHandle::pointer handle);
 
@@ -334,82 +451,65 @@ public:
   void clearDepth(SurfaceHandle::pointer framebuffer_obj, float depth);
 
   ///////////////////// Clear texture when Pixel is a floating point pixel type
-  template <typename Pixel>
-  void clearTexture1DFloat(Texture1D<Pixel, D>& tex, const ag::Box1D& region,
-                           const ag::ClearColor& color) {
-    gl::ClearTexImage(tex.handle.get().id, 0, gl::RGBA, gl::FLOAT, color.rgba);
-  }
-
-  template <typename Pixel>
-  void clearTexture2DFloat(Texture2D<Pixel, D>& tex, const ag::Box2D& region,
-                           const ag::ClearColor& color) {
-    gl::ClearTexImage(tex.handle.get().id, 0, gl::RGBA, gl::FLOAT, color.rgba);
-  }
-
-  template <typename Pixel>
-  void clearTexture3DFloat(Texture3D<Pixel, D>& tex, const ag::Box3D& region,
-                           const ag::ClearColor& color) {
-    gl::ClearTexImage(tex.handle.get().id, 0, gl::RGBA_INTEGER, gl::FLOAT,
-                      color.rgba);
-  }
+  void clearTexture1DFloat(TextureHandle::pointer handle,
+                           const Texture1DInfo& info, const ag::Box1D& region,
+                           const ag::ClearColor& color);
+  void clearTexture2DFloat(TextureHandle::pointer handle,
+                           const Texture2DInfo& info, const ag::Box2D& region,
+                           const ag::ClearColor& color);
+  void clearTexture3DFloat(TextureHandle::pointer handle,
+                           const Texture3DInfo& info, const ag::Box3D& region,
+                           const ag::ClearColor& color);
+  // the z range of `region` is a range of layers
+  void clearTexture2DArrayFloat(TextureHandle::pointer handle,
+                                const Texture2DArrayInfo& info,
+                                const ag::Box3D& region,
+                                const ag::ClearColor& color);
 
   ///////////////////// Clear texture when Pixel is an integer pixel type
-  template <typename IPixel>
-  void clearTexture1DInteger(Texture1D<IPixel, D>& tex, const ag::Box1D& region,
-                             const ag::ClearColorInt& color) {
-
-    gl::ClearTexImage(tex.handle.get().id, 0, gl::RGBA_INTEGER,
-                      gl::UNSIGNED_INT, color.rgba);
-  }
-
-  template <typename IPixel>
-  void clearTexture2DInteger(Texture2D<IPixel, D>& tex, const ag::Box2D& region,
-                             const ag::ClearColorInt& color) {
-
-    gl::ClearTexImage(tex.handle.get().id, 0, gl::RGBA_INTEGER,
-                      gl::UNSIGNED_INT, color.rgba);
-  }
-
-  template <typename IPixel>
-  void clearTexture3DInteger(Texture3D<IPixel, D>& tex, const ag::Box3D& region,
-                             const ag::ClearColorInt& color) {
-    gl::ClearTexImage(tex.handle.get().id, 0, gl::RGBA_INTEGER,
-                      gl::UNSIGNED_INT, color.rgba);
-  }
+  void clearTexture1DInteger(TextureHandle::pointer handle,
+                             const Texture1DInfo& info, const ag::Box1D& region,
+                             const ag::ClearColorInt& color);
+  void clearTexture2DInteger(TextureHandle::pointer handle,
+                             const Texture2DInfo& info, const ag::Box2D& region,
+                             const ag::ClearColorInt& color);
+  void clearTexture3DInteger(TextureHandle::pointer handle,
+                             const Texture3DInfo& info, const ag::Box3D& region,
+                             const ag::ClearColorInt& color);
 
   ///////////////////// Clear texture when Pixel is a depth pixel type
-  template <typename Depth>
-  void clearTexture2DDepth(Texture2D<Depth, D>& tex, const ag::Box2D& region,
-                           float depth) {
-    gl::ClearTexImage(tex.handle.get().id, 0, gl::DEPTH_COMPONENT, gl::FLOAT,
-                      &depth);
-  }
+  void clearTexture2DDepth(TextureHandle::pointer handle,
+                           const Texture2DInfo& info, const ag::Box2D& region,
+                           float depth);
 
   ///////////////////// Copy tex region to buffer
-  template <typename Pixel>
-  void copyTextureRegion1D(Texture1D<Pixel, D>& src, RawBufferSlice<D>& dest,
-                           const ag::Box1D& region, unsigned mipLevel) {
-    const auto& gl_fmt = pixelFormatToGL(src.info.format);
-    gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, dest.handle->buf_obj);
-    gl::GetTextureSubImage(src.handle.get().id, mipLevel, region.xmin, 0, 0,
-                           region.width(), 1, 1, gl_fmt.externalFormat,
-                           gl_fmt.type, dest.byteSize, (void*)dest.offset);
-  }
-
-  template <typename Pixel>
-  void copyTextureRegion2D(Texture2D<Pixel, D>& src, RawBufferSlice<D>& dest,
-                           const ag::Box2D& region, unsigned mipLevel) {
-    const auto& gl_fmt = pixelFormatToGL(src.info.format);
-    gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, dest.handle->buf_obj);
-    gl::GetTextureSubImage(src.handle.get().id, mipLevel, region.xmin,
-                           region.ymin, 0, region.width(), region.height(), 1,
-                           gl_fmt.externalFormat, gl_fmt.type, dest.byteSize,
-                           (void*)dest.offset);
-  }
+  void copyTextureRegion1D(TextureHandle::pointer src_handle,
+                           const Texture1DInfo& info,
+                           BufferHandle::pointer dest_handle, size_t dest_offset,
+                           size_t dest_size, const ag::Box1D& region,
+                           unsigned mipLevel);
+  void copyTextureRegion2D(TextureHandle::pointer src_handle,
+                           const Texture2DInfo& info,
+                           BufferHandle::pointer dest_handle, size_t dest_offset,
+                           size_t dest_size, const ag::Box2D& region,
+                           unsigned mipLevel);
+  // the z range of `region` is a range of layers
+  void copyTextureRegion2DArray(TextureHandle::pointer src_handle,
+                                const Texture2DArrayInfo& info,
+                                BufferHandle::pointer dest_handle,
+                                size_t dest_offset, size_t dest_size,
+                                const ag::Box3D& region, unsigned mipLevel);
+
+  ///////////////////// Copy buffer to buffer
+  void copyBuffer(BufferHandle::pointer src_handle, size_t src_offset,
+                  BufferHandle::pointer dest_handle, size_t dest_offset,
+                  size_t size);
 
   ///////////////////// Texture upload
 
   // These are blocking
+  // (for compressed formats, data is an array of blocks and the region must
+  // be aligned on blocks, except on the right and bottom edges)
   void updateTexture1D(TextureHandle::pointer handle,
                        const Texture1DInfo& info, unsigned mipLevel,
                        Box1D region, gsl::span<const gsl::byte> data);
@@ -419,6 +519,14 @@ public:
   void updateTexture3D(TextureHandle::pointer handle,
                        const Texture3DInfo& info, unsigned mipLevel,
                        Box3D region, gsl::span<const gsl::byte> data);
+  void updateTexture2DArray(TextureHandle::pointer handle,
+                            const Texture2DArrayInfo& info, unsigned mipLevel,
+                            unsigned layer, Box2D region,
+                            gsl::span<const gsl::byte> data);
+  void updateTextureCubeMap(TextureHandle::pointer handle,
+                            const TextureCubeMapInfo& info, unsigned mipLevel,
+                            unsigned face, Box2D region,
+                            gsl::span<const gsl::byte> data);
   void readTexture1D(TextureHandle::pointer handle, const Texture1DInfo& info,
                      unsigned mipLevel, Box1D region,
                      gsl::span<gsl::byte> outData);
@@ -430,19 +538,76 @@ public:
                      gsl::span<gsl::byte> outData);
 
   // staged texture upload: copy buffer data to texture
+  // (rows are tightly packed in the buffer)
+  void updateTexture2DFromBuffer(TextureHandle::pointer handle,
+                                 const Texture2DInfo& info, unsigned mipLevel,
+                                 Box2D region, BufferHandle::pointer src_handle,
+                                 size_t src_offset);
+
+  ///////////////////// Copy between textures (no conversion: formats must
+  // have the same texel size)
+  void copyTexture2DRegion(TextureHandle::pointer src_handle,
+                           unsigned src_mipLevel, const Box2D& src_region,
+                           TextureHandle::pointer dest_handle,
+                           unsigned dest_mipLevel, glm::uvec2 dest_offset);
+  void copyTexture2DRegionToLayer(TextureHandle::pointer src_handle,
+                                  unsigned src_mipLevel,
+                                  const Box2D& src_region,
+                                  TextureHandle::pointer dest_handle,
+                                  unsigned dest_mipLevel, unsigned dest_layer,
+                                  glm::uvec2 dest_offset);
+  // the z range of `src_region` and `dest_offset.z` are layers
+  void copyTexture2DArrayRegion(TextureHandle::pointer src_handle,
+                                unsigned src_mipLevel, const Box3D& src_region,
+                                TextureHandle::pointer dest_handle,
+                                unsigned dest_mipLevel, glm::uvec3 dest_offset);
   /*void copyTextureRegion1D(Texture1DHandle::pointer src_handle, Box1D
      src_region, PixelFormat src_format,
           Texture1DHandle::pointer dest_handle, unsigned dest_offset,
      PixelFormat dest_format);*/
 
+  ///////////////////// Mipmaps
+  // Regenerates levels 1..N of a texture from level 0 (driver implementation)
+  void generateMipmaps(TextureHandle::pointer handle);
+  // Regenerates the mip levels above `baseLevel` covering `region` (given in
+  // texels of `baseLevel`) with a compute downsampler. Each dispatch reduces
+  // 64x64 tiles of the base level and writes up to 6 levels through image
+  // stores. Falls back to generateMipmaps for formats that cannot be used
+  // as storage images (RGB, integer and depth formats).
+  void generateMipmaps2D(TextureHandle::pointer handle,
+                         const Texture2DInfo& info, unsigned baseLevel,
+                         const Box2D& region);
+
   ///////////////////// Draw calls
   void draw(PrimitiveType primitiveType, unsigned first, unsigned count);
   void drawIndexed(PrimitiveType primitiveType, unsigned first, unsigned count,
                    unsigned baseVertex);
+  // Draws the DrawElementsIndirectCommands of `indirectBuffer` (typically
+  // written by a compute shader). With ARB_indirect_parameters, the number
+  // of commands is read from `countBuffer` at `countOffset` (capped at
+  // maxDrawCount); otherwise, maxDrawCount commands are drawn and unused
+  // commands must have a zero count. Shader writes to the buffers issued
+  // before the call are made visible to the command.
+  void drawIndexedIndirect(PrimitiveType primitiveType,
+                           BufferHandle::pointer indirectBuffer,
+                           size_t indirectOffset,
+                           BufferHandle::pointer countBuffer,
+                           size_t countOffset, unsigned maxDrawCount,
+                           unsigned stride);
+  bool supportsIndirectDrawCount() const {
+    return multi_draw_elements_indirect_count != nullptr;
+  }
+
+  ///////////////////// Buffer clears
+  // fills a range of a buffer with zeros (size and offset multiple of 4)
+  void clearBuffer(BufferHandle::pointer handle, size_t offset, size_t size);
 
   ///////////////////// Compute
   void dispatchCompute(unsigned threadGroupCountX, unsigned threadGroupCountY,
                        unsigned threadGroupCountZ);
+  // makes the writes of the previous commands to storage buffers and images
+  // visible to the following commands
+  void memoryBarrier();
 
   void swapBuffers();
 
@@ -454,6 +619,10 @@ private:
   GLuint createProgramFromShaderPipeline(const GraphicsPipelineInfo& info);
   GLuint createComputeProgram(const ComputePipelineInfo& info);
   GLuint createVertexArrayObject(gsl::span<const VertexAttribute> attribs);
+  // compute downsampler for an image format, 0 if unsupported
+  GLuint getMipmapProgram(GLenum internalFormat);
+  void startLoaderThread();
+  void loaderThreadMain();
 
   struct BindState {
     std::array<GLuint, kMaxVertexBufferSlots> vertexBuffers;
@@ -471,6 +640,10 @@ private:
     std::array<GLintptr, kMaxUniformBufferSlots> uniformBufferOffsets;
     bool uniformBuffersUpdated = false;
     std::array<GLuint, kMaxShaderStorageBufferSlots> shaderStorageBuffers;
+    std::array<GLsizeiptr, kMaxShaderStorageBufferSlots>
+        shaderStorageBufferSizes;
+    std::array<GLintptr, kMaxShaderStorageBufferSlots>
+        shaderStorageBufferOffsets;
     bool shaderStorageBuffersUpdated = false;
     GLuint indexBuffer;
     GLenum indexBufferType;
@@ -482,6 +655,34 @@ private:
   GLFWwindow* window;
   // bind state
   BindState bind_state;
+  // mip downsampling programs, by internal format
+  std::map<GLenum, GLuint> mipmap_programs;
+  // glMultiDrawElementsIndirectCount(ARB), null if not supported
+  void(APIENTRY* multi_draw_elements_indirect_count)(
+      GLenum mode, GLenum type, const void* indirect, GLintptr drawcount,
+      GLsizei maxdrawcount, GLsizei stride) = nullptr;
+
+  // loader thread
+  struct LoaderTask {
+    std::function<void()> task;
+    std::function<void()> publish;
+  };
+
+  struct LoaderCompletion {
+    GLsync sync;
+    std::function<void()> publish;
+    std::exception_ptr error;
+  };
+
+  // hidden window holding the loader context
+  GLFWwindow* loader_window = nullptr;
+  std::thread loader_thread;
+  std::mutex loader_mutex;
+  std::condition_variable loader_cv;
+  // guarded by loader_mutex
+  std::deque<LoaderTask> loader_tasks;
+  std::deque<LoaderCompletion> loader_completions;
+  bool loader_exit = false;
 };
 }
 }
@@ -24,6 +24,7 @@ struct BindContext {
   unsigned vertexBufferBindingIndex = 0;
   unsigned uniformBufferBindingIndex = 0;
   unsigned RWTextureBindingIndex = 0;
+  unsigned storageBufferBindingIndex = 0;
 };
 
 ////////////////////////// Binder: vertex buffer
@@ -91,6 +92,20 @@ TextureUnit_<Texture3D<T, D>, D> TextureUnit(unsigned unit_,
   return TextureUnit_<Texture3D<T, D>, D>(unit_, tex_, sampler_);
 }
 
+template <typename T, typename D>
+TextureUnit_<Texture2DArray<T, D>, D>
+TextureUnit(unsigned unit_, const Texture2DArray<T, D> &tex_,
+            const Sampler<D> &sampler_) {
+  return TextureUnit_<Texture2DArray<T, D>, D>(unit_, tex_, sampler_);
+}
+
+template <typename T, typename D>
+TextureUnit_<TextureCubeMap<T, D>, D>
+TextureUnit(unsigned unit_, const TextureCubeMap<T, D> &tex_,
+            const Sampler<D> &sampler_) {
+  return TextureUnit_<TextureCubeMap<T, D>, D>(unit_, tex_, sampler_);
+}
+
 ////////////////////////// Binder: RWTexture unit
 template <typename TextureTy> struct RWTextureUnit_ {
   RWTextureUnit_(unsigned unit_, TextureTy &tex_) : unit(unit_), tex(tex_) {}
@@ -117,6 +132,42 @@ RWTextureUnit_<Texture3D<T, D>> RWTextureUnit(unsigned unit_,
   return RWTextureUnit_<Texture3D<T, D>>(unit_, tex_);
 }
 
+template <typename T, typename D>
+RWTextureUnit_<Texture2DArray<T, D>> RWTextureUnit(unsigned unit_,
+                                                   Texture2DArray<T, D> &tex_) {
+  return RWTextureUnit_<Texture2DArray<T, D>>(unit_, tex_);
+}
+
+////////////////////////// Binder: RWBuffer unit (shader storage buffer)
+template <typename D> struct RWBufferUnit_ {
+  RWBufferUnit_(unsigned unit_, const RawBuffer<D> &buf_)
+      : unit(unit_), buf(buf_) {}
+
+  unsigned unit;
+  const RawBuffer<D> &buf;
+};
+
+template <typename D>
+RWBufferUnit_<D> RWBufferUnit(unsigned unit_, const RawBuffer<D> &buf_) {
+  return RWBufferUnit_<D>(unit_, buf_);
+}
+
+// part of a buffer, e.g. data pushed to the upload buffer (the offset must be
+// a multiple of D::kShaderStorageBufferOffsetAlignment)
+template <typename D> struct RWBufferSliceUnit_ {
+  RWBufferSliceUnit_(unsigned unit_, const RawBufferSlice<D> &slice_)
+      : unit(unit_), slice(slice_) {}
+
+  unsigned unit;
+  const RawBufferSlice<D> &slice;
+};
+
+template <typename D>
+RWBufferSliceUnit_<D> RWBufferUnit(unsigned unit_,
+                                   const RawBufferSlice<D> &slice_) {
+  return RWBufferSliceUnit_<D>(unit_, slice_);
+}
+
 ////////////////////////// Binder: uniform slot
 template <typename ResTy // Buffer, BufferSlice or just a value
           >
@@ -241,6 +292,22 @@ void bindOne(Device<D> &device, BindContext &context,
   device.backend.bindTexture3D(context.textureBindingIndex++, tex.handle.get());
 }
 
+////////////////////////// Bind<Texture2DArray>
+template <typename D, typename TPixel>
+void bindOne(Device<D> &device, BindContext &context,
+             const Texture2DArray<TPixel, D> &tex) {
+  device.backend.bindTexture2DArray(context.textureBindingIndex++,
+                                    tex.handle.get());
+}
+
+////////////////////////// Bind<TextureCubeMap>
+template <typename D, typename TPixel>
+void bindOne(Device<D> &device, BindContext &context,
+             const TextureCubeMap<TPixel, D> &tex) {
+  device.backend.bindTextureCubeMap(context.textureBindingIndex++,
+                                    tex.handle.get());
+}
+
 ////////////////////////// Bind<Sampler>
 template <typename D>
 void bindOne(Device<D> &device, BindContext &context,
@@ -285,6 +352,36 @@ void bindOne(Device<D> &device, BindContext &context,
   device.backend.bindRWTexture3D(context.RWTextureBindingIndex++, tex_unit.tex);
 }
 
+////////////////////////// Bind<RWTextureUnit<Texture2DArray<T>>>
+template <typename D, typename Pixel>
+void bindOne(Device<D> &device, BindContext &context,
+             const RWTextureUnit_<Texture2DArray<Pixel, D>> &tex_unit) {
+  context.RWTextureBindingIndex = tex_unit.unit;
+  device.backend.bindRWTexture2DArray(context.RWTextureBindingIndex++,
+                                      tex_unit.tex.handle.get());
+}
+
+////////////////////////// Bind<RWBufferUnit>
+template <typename D>
+void bindOne(Device<D> &device, BindContext &context,
+             const RWBufferUnit_<D> &buf_unit) {
+  context.storageBufferBindingIndex = buf_unit.unit;
+  device.backend.bindStorageBuffer(context.storageBufferBindingIndex++,
+                                   buf_unit.buf.handle.get(), 0,
+                                   buf_unit.buf.byteSize);
+}
+
+////////////////////////// Bind<RWBufferSliceUnit>
+template <typename D>
+void bindOne(Device<D> &device, BindContext &context,
+             const RWBufferSliceUnit_<D> &slice_unit) {
+  context.storageBufferBindingIndex = slice_unit.unit;
+  device.backend.bindStorageBuffer(context.storageBufferBindingIndex++,
+                                   slice_unit.slice.handle,
+                                   slice_unit.slice.offset,
+                                   slice_unit.slice.byteSize);
+}
+
 ////////////////////////// Bind<RawBufferSlice>
 template <typename D>
 void bindOne(Device<D> &device, BindContext &context,
@@ -303,6 +400,14 @@ void bindOne(Device<D> &device, BindContext &context, const T &value) {
   bindOne(device, context, slice);
 }
 
+////////////////////////// Bind<Uniform>
+template <typename D, typename ResTy>
+void bindOne(Device<D> &device, BindContext &context,
+             const Uniform_<ResTy> &uniform) {
+  context.uniformBufferBindingIndex = uniform.slot;
+  bindOne(device, context, uniform.buf);
+}
+
 ////////////////////////// bindImpl<T>: recursive binding of draw resources
 template <typename D, typename T>
 void bindImpl(Device<D> &device, BindContext &context, T &&resource) {
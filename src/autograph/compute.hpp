@@ -48,6 +48,12 @@ void compute(Device<D>& device, ComputePipeline<D>& computePipeline,
   device.backend.dispatchCompute(threadGroupCount.sizeX, threadGroupCount.sizeY,
                                  threadGroupCount.sizeZ);
 }
+
+// Must be issued between a dispatch that writes a storage buffer or an image
+// and a command that reads it.
+template <typename D> void memoryBarrier(Device<D>& device) {
+  device.backend.memoryBarrier();
+}
 }
 
 #endif // !COMPUTE_HPP
\ No newline at end of file
@@ -9,8 +9,12 @@
 // - between textures
 // - between buffers
 
+#include <type_traits>
+#include <vector>
+
 #include "buffer.hpp"
 #include "device.hpp"
+#include "pixel_conversion.hpp"
 #include "pixel_format.hpp"
 #include "rect.hpp"
 #include "texture.hpp"
@@ -21,15 +25,57 @@ namespace ag {
 // These operations do not stall if the texture is created with the 'Dynamic'
 // usage flag: the texture data is first copied to a staging
 // buffer and is copied to the final texture when the GPU is ready
+// If the source elements are of another pixel type than the texture, they
+// are converted with convertPixels first.
+
+namespace detail {
+// calls f with the pixels in the storage format of Pixel
+template <typename Pixel, typename Src, typename F>
+void withTexturePixels(gsl::span<const Src> pixels, F f, std::true_type) {
+  f(gsl::as_bytes(pixels));
+}
+
+template <typename Pixel, typename Src, typename F>
+void withTexturePixels(gsl::span<const Src> pixels, F f, std::false_type) {
+  using Storage = typename PixelTypeTraits<Pixel>::storage_type;
+  static_assert(!PixelTypeTraits<Pixel>::kIsCompressed &&
+                    !PixelTypeTraits<Src>::kIsCompressed,
+                "Cannot convert to or from compressed pixel types");
+  std::vector<Storage> converted(pixels.size());
+  convertPixels(PixelTypeTraits<Src>::kFormat, PixelTypeTraits<Pixel>::kFormat,
+                gsl::as_bytes(pixels),
+                gsl::as_writeable_bytes(
+                    gsl::span<Storage>(converted.data(), converted.size())));
+  f(gsl::as_bytes(
+      gsl::span<const Storage>(converted.data(), converted.size())));
+}
+
+// Elements that are not pixel types (e.g. glm vectors) are uploaded as is,
+// as are pixels of the same format
+template <typename Pixel, typename Src,
+          bool = PixelTypeTraits<Src>::kIsPixelType>
+struct IsUploadedAsIs : std::true_type {};
+
+template <typename Pixel, typename Src>
+struct IsUploadedAsIs<Pixel, Src, true>
+    : std::integral_constant<bool, PixelTypeTraits<Src>::kFormat ==
+                                       PixelTypeTraits<Pixel>::kFormat> {};
+
+template <typename Pixel, typename Src, typename F>
+void withTexturePixels(gsl::span<const Src> pixels, F f) {
+  withTexturePixels<Pixel>(pixels, f, IsUploadedAsIs<Pixel, Src>{});
+}
+}
 
 // CPU -> Texture1D
 template <typename D, typename Pixel,
           typename Storage = typename PixelTypeTraits<Pixel>::storage_type>
 void copy(Device<D>& device, gsl::span<const Storage> pixels,
           Texture1D<Pixel, D>& texture, unsigned mipLevel = 0) {
-  device.backend.updateTexture1D(texture.handle.get(), texture.info, mipLevel,
-                                 Box1D{0, texture.info.dimensions},
-                                 gsl::as_bytes(pixels));
+  detail::withTexturePixels<Pixel>(pixels, [&](gsl::span<const gsl::byte> data) {
+    device.backend.updateTexture1D(texture.handle.get(), texture.info, mipLevel,
+                                   Box1D{0, texture.info.dimensions}, data);
+  });
 }
 
 // CPU -> Texture2D
@@ -37,10 +83,12 @@ template <typename D, typename Pixel,
           typename Storage = typename PixelTypeTraits<Pixel>::storage_type>
 void copy(Device<D>& device, gsl::span<const Storage> pixels,
           Texture2D<Pixel, D>& texture, unsigned mipLevel = 0) {
-  device.backend.updateTexture2D(
-      texture.handle.get(), texture.info, mipLevel,
-      Box2D{0, 0, texture.info.dimensions.x, texture.info.dimensions.y},
-      gsl::as_bytes(pixels));
+  detail::withTexturePixels<Pixel>(pixels, [&](gsl::span<const gsl::byte> data) {
+    device.backend.updateTexture2D(
+        texture.handle.get(), texture.info, mipLevel,
+        Box2D{0, 0, texture.info.dimensions.x, texture.info.dimensions.y},
+        data);
+  });
 }
 
 // CPU -> Texture3D
@@ -48,11 +96,87 @@ template <typename D, typename Pixel,
           typename Storage = typename PixelTypeTraits<Pixel>::storage_type>
 void copy(Device<D>& device, gsl::span<const Storage> pixels,
           Texture3D<Pixel, D>& texture, unsigned mipLevel = 0) {
-  device.backend.updateTexture3D(texture.handle.get(), texture.info, mipLevel,
-                                 Box3D{0, 0, 0, texture.info.dimensions.x,
-                                       texture.info.dimensions.y,
-                                       texture.info.dimensions.z},
-                                 gsl::as_bytes(pixels));
+  detail::withTexturePixels<Pixel>(pixels, [&](gsl::span<const gsl::byte> data) {
+    device.backend.updateTexture3D(texture.handle.get(), texture.info, mipLevel,
+                                   Box3D{0, 0, 0, texture.info.dimensions.x,
+                                         texture.info.dimensions.y,
+                                         texture.info.dimensions.z},
+                                   data);
+  });
+}
+
+// CPU -> one layer of a Texture2DArray
+template <typename D, typename Pixel,
+          typename Storage = typename PixelTypeTraits<Pixel>::storage_type>
+void copy(Device<D>& device, gsl::span<const Storage> pixels,
+          Texture2DArray<Pixel, D>& texture, unsigned layer,
+          unsigned mipLevel = 0) {
+  detail::withTexturePixels<Pixel>(pixels, [&](gsl::span<const gsl::byte> data) {
+    device.backend.updateTexture2DArray(
+        texture.handle.get(), texture.info, mipLevel, layer,
+        Box2D{0, 0, texture.info.dimensions.x, texture.info.dimensions.y},
+        data);
+  });
+}
+
+// CPU -> one face of a TextureCubeMap
+template <typename D, typename Pixel,
+          typename Storage = typename PixelTypeTraits<Pixel>::storage_type>
+void copy(Device<D>& device, gsl::span<const Storage> pixels,
+          TextureCubeMap<Pixel, D>& texture, unsigned face,
+          unsigned mipLevel = 0) {
+  detail::withTexturePixels<Pixel>(pixels, [&](gsl::span<const gsl::byte> data) {
+    device.backend.updateTextureCubeMap(
+        texture.handle.get(), texture.info, mipLevel, face,
+        Box2D{0, 0, texture.info.size, texture.info.size}, data);
+  });
+}
+
+///////////////////// Texture -> Texture copy operations
+// Raw copies: the pixel types must have the same size
+
+// region of a Texture2D -> Texture2D at `destOffset`
+template <typename D, typename SrcPixel, typename DestPixel>
+void copy(Device<D>& device, const Texture2D<SrcPixel, D>& src,
+          const Box2D& srcRegion, Texture2D<DestPixel, D>& dest,
+          glm::uvec2 destOffset, unsigned srcMipLevel = 0,
+          unsigned destMipLevel = 0) {
+  static_assert(sizeof(typename PixelTypeTraits<SrcPixel>::storage_type) ==
+                    sizeof(typename PixelTypeTraits<DestPixel>::storage_type),
+                "Incompatible pixel types");
+  device.backend.copyTexture2DRegion(src.handle.get(), srcMipLevel, srcRegion,
+                                     dest.handle.get(), destMipLevel,
+                                     destOffset);
+}
+
+// region of a Texture2D -> layer of a Texture2DArray at `destOffset`
+template <typename D, typename SrcPixel, typename DestPixel>
+void copy(Device<D>& device, const Texture2D<SrcPixel, D>& src,
+          const Box2D& srcRegion, Texture2DArray<DestPixel, D>& dest,
+          unsigned destLayer, glm::uvec2 destOffset,
+          unsigned srcMipLevel = 0, unsigned destMipLevel = 0) {
+  static_assert(sizeof(typename PixelTypeTraits<SrcPixel>::storage_type) ==
+                    sizeof(typename PixelTypeTraits<DestPixel>::storage_type),
+                "Incompatible pixel types");
+  device.backend.copyTexture2DRegionToLayer(src.handle.get(), srcMipLevel,
+                                            srcRegion, dest.handle.get(),
+                                            destMipLevel, destLayer,
+                                            destOffset);
+}
+
+// region of a Texture2DArray -> Texture2DArray at `destOffset`
+// (the z coordinates are layers)
+template <typename D, typename SrcPixel, typename DestPixel>
+void copy(Device<D>& device, const Texture2DArray<SrcPixel, D>& src,
+          const Box3D& srcRegion, Texture2DArray<DestPixel, D>& dest,
+          glm::uvec3 destOffset, unsigned srcMipLevel = 0,
+          unsigned destMipLevel = 0) {
+  static_assert(sizeof(typename PixelTypeTraits<SrcPixel>::storage_type) ==
+                    sizeof(typename PixelTypeTraits<DestPixel>::storage_type),
+                "Incompatible pixel types");
+  device.backend.copyTexture2DArrayRegion(src.handle.get(), srcMipLevel,
+                                          srcRegion, dest.handle.get(),
+                                          destMipLevel, destOffset);
 }
 
 ///////////////////// Texture -> CPU async readback operations
@@ -92,7 +216,9 @@ void copy(Device<D>& device, Texture1D<Pixel, D>& texture,
           RawBufferSlice<D>& buffer, const ag::Box1D& region,
           unsigned mipLevel = 0) {
   // TODO should check that the Storage and Buffer types are compatible
-  device.backend.copyTextureRegion1D(texture, buffer, region, mipLevel);
+  device.backend.copyTextureRegion1D(texture.handle.get(), texture.info,
+                                      buffer.handle, buffer.offset,
+                                      buffer.byteSize, region, mipLevel);
 }
 
 template <typename D, typename Pixel,
@@ -101,7 +227,29 @@ void copy(Device<D>& device, Texture2D<Pixel, D>& texture,
           RawBufferSlice<D>& buffer, const ag::Box2D& region,
           unsigned mipLevel = 0) {
   // TODO should check that the Storage and Buffer types are compatible
-  device.backend.copyTextureRegion2D(texture, buffer, region, mipLevel);
+  device.backend.copyTextureRegion2D(texture.handle.get(), texture.info,
+                                      buffer.handle, buffer.offset,
+                                      buffer.byteSize, region, mipLevel);
+}
+
+// the z range of `region` is a range of layers
+template <typename D, typename Pixel>
+void copy(Device<D>& device, Texture2DArray<Pixel, D>& texture,
+          RawBufferSlice<D>& buffer, const ag::Box3D& region,
+          unsigned mipLevel = 0) {
+  device.backend.copyTextureRegion2DArray(texture.handle.get(), texture.info,
+                                           buffer.handle, buffer.offset,
+                                           buffer.byteSize, region, mipLevel);
+}
+
+// Buffer -> buffer, the slices must have the same size
+template <typename D>
+void copy(Device<D>& device, const RawBufferSlice<D>& src,
+          RawBufferSlice<D>& dest) {
+  if (src.byteSize != dest.byteSize)
+    failWith("Buffer copy: source and destination sizes differ");
+  device.backend.copyBuffer(src.handle, src.offset, dest.handle, dest.offset,
+                            src.byteSize);
 }
 
 // copy operation:
@@ -2,14 +2,20 @@
 #define DEVICE_HPP
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
+#include <vector>
 
 #include <gsl.h>
 
 #include "buffer.hpp"
 #include "error.hpp"
 #include "fence.hpp"
+#include "fence_notifier.hpp"
+#include "frame_pacing.hpp"
 #include "pipeline.hpp"
+#include "profiler.hpp"
+#include "rect.hpp"
 #include "surface.hpp"
 #include "texture.hpp"
 #include "upload_buffer.hpp"
@@ -20,9 +26,43 @@ struct DeviceOptions {
   unsigned framebufferWidth = 640;
   unsigned framebufferHeight = 480;
   bool fullscreen = false;
+  // upper bound on the number of frames the CPU can run ahead of the GPU
   unsigned maxFramesInFlight = 3;
+  PresentMode presentMode = PresentMode::Vsync;
+  // CPU-side frame rate limit, in Hz (0 = unlimited)
+  float frameRateLimit = 0.0f;
+  // tune the number of frames in flight (up to maxFramesInFlight)
+  // depending on whether the application is CPU- or GPU-bound
+  bool autoFramesInFlight = false;
+  // record CPU/GPU timings of profile zones (see profiler.hpp)
+  bool enableProfiler = false;
 };
 
+namespace detail {
+// Optional backend hooks, called only if the backend defines them
+// (see StatsBackend)
+template <typename D>
+auto notifyUploadBufferPush(D& backend, size_t size, size_t ringUsage, int)
+    -> decltype(backend.onUploadBufferPush(size, ringUsage)) {
+  backend.onUploadBufferPush(size, ringUsage);
+}
+template <typename D>
+void notifyUploadBufferPush(D& backend, size_t size, size_t ringUsage, long) {}
+
+template <typename D>
+auto notifyEndFrame(D& backend, int) -> decltype(backend.onEndFrame()) {
+  backend.onEndFrame();
+}
+template <typename D> void notifyEndFrame(D& backend, long) {}
+
+template <typename D>
+auto pollLoaderCompletions(D& backend, int)
+    -> decltype(backend.pollLoaderCompletions()) {
+  backend.pollLoaderCompletions();
+}
+template <typename D> void pollLoaderCompletions(D& backend, long) {}
+}
+
 inline FenceValue getFrameExpirationDate(unsigned frame_id) {
   // Frame N expires when the fence has reached the value N+1
   return frame_id + 1;
@@ -34,8 +74,16 @@ public:
       : options(options_), backend(backend_), frame_id(0) {
     backend.createWindow(options);
     frameFence = backend.createFence(0);
+    frameNotifier =
+        std::make_unique<FenceNotifier<D>>(backend_, frameFence.get());
     default_upload_buffer =
         std::make_unique<UploadBuffer<D>>(backend_, 3 * 1024 * 1024);
+    pacer = std::make_unique<FramePacer<D>>(
+        backend_, options.maxFramesInFlight, options.frameRateLimit,
+        options.autoFramesInFlight);
+    if (options.enableProfiler)
+      profiler =
+          std::make_unique<Profiler<D>>(backend_, options.maxFramesInFlight);
   }
 
   Surface<D, float, RGBA8> getOutputSurface() {
@@ -60,31 +108,57 @@ public:
 
   ///////////////////// createTexture1D
   template <typename Pixel>
-  Texture1D<Pixel, D> createTexture1D(glm::uint width) {
+  Texture1D<Pixel, D> createTexture1D(glm::uint width,
+                                      unsigned mipLevels = 1) {
     static_assert(PixelTypeTraits<Pixel>::kIsPixelType,
                   "Unsupported pixel type");
-    Texture1DInfo info{width, PixelTypeTraits<Pixel>::kFormat};
+    Texture1DInfo info{width, PixelTypeTraits<Pixel>::kFormat, mipLevels};
     return Texture1D<Pixel, D>{info, backend.createTexture1D(info)};
   }
 
   ///////////////////// createTexture2D
+  // use getMipLevelCount(dimensions) for a full mip chain
   template <typename Pixel>
-  Texture2D<Pixel, D> createTexture2D(glm::uvec2 dimensions) {
+  Texture2D<Pixel, D> createTexture2D(glm::uvec2 dimensions,
+                                      unsigned mipLevels = 1) {
     static_assert(PixelTypeTraits<Pixel>::kIsPixelType,
                   "Unsupported pixel type");
-    Texture2DInfo info{dimensions, PixelTypeTraits<Pixel>::kFormat};
+    Texture2DInfo info{dimensions, PixelTypeTraits<Pixel>::kFormat, mipLevels};
     return Texture2D<Pixel, D>{info, backend.createTexture2D(info)};
   }
 
   ///////////////////// createTexture3D
   template <typename Pixel>
-  Texture3D<Pixel, D> createTexture3D(glm::uvec3 dimensions) {
+  Texture3D<Pixel, D> createTexture3D(glm::uvec3 dimensions,
+                                      unsigned mipLevels = 1) {
     static_assert(PixelTypeTraits<Pixel>::kIsPixelType,
                   "Unsupported pixel type");
-    Texture3DInfo info{dimensions, PixelTypeTraits<Pixel>::kFormat};
+    Texture3DInfo info{dimensions, PixelTypeTraits<Pixel>::kFormat, mipLevels};
     return Texture3D<Pixel, D>{info, backend.createTexture3D(info)};
   }
 
+  ///////////////////// createTexture2DArray
+  template <typename Pixel>
+  Texture2DArray<Pixel, D> createTexture2DArray(glm::uvec2 dimensions,
+                                                unsigned layers,
+                                                unsigned mipLevels = 1) {
+    static_assert(PixelTypeTraits<Pixel>::kIsPixelType,
+                  "Unsupported pixel type");
+    Texture2DArrayInfo info{dimensions, layers, PixelTypeTraits<Pixel>::kFormat,
+                            mipLevels};
+    return Texture2DArray<Pixel, D>{info, backend.createTexture2DArray(info)};
+  }
+
+  ///////////////////// createTextureCubeMap
+  template <typename Pixel>
+  TextureCubeMap<Pixel, D> createTextureCubeMap(glm::uint size,
+                                                unsigned mipLevels = 1) {
+    static_assert(PixelTypeTraits<Pixel>::kIsPixelType,
+                  "Unsupported pixel type");
+    TextureCubeMapInfo info{size, PixelTypeTraits<Pixel>::kFormat, mipLevels};
+    return TextureCubeMap<Pixel, D>{info, backend.createTextureCubeMap(info)};
+  }
+
   ///////////////////// createSampler
   Sampler<D> createSampler(const SamplerInfo& info) {
     return Sampler<D>{info, backend.createSampler(info)};
@@ -110,17 +184,87 @@ public:
         N, backend.createBuffer(N * sizeof(T), data, BufferUsage::Default));
   }
 
+  ///////////////////// createReadbackBuffer
+  // CPU-readable buffer, target of GPU -> CPU copies. The contents can be
+  // read through mapReadbackBuffer once the copies have completed (see
+  // onFrameComplete).
+  RawBuffer<D> createReadbackBuffer(size_t byteSize) {
+    return RawBuffer<D>(byteSize, backend.createBuffer(byteSize, nullptr,
+                                                       BufferUsage::Readback));
+  }
+
+  // persistent mapping of a buffer created with createReadbackBuffer
+  const void* mapReadbackBuffer(RawBuffer<D>& buffer) {
+    return backend.mapBuffer(buffer.handle.get(), 0, buffer.byteSize);
+  }
+
+  ///////////////////// Asynchronous resource creation
+  // The resources are created and filled on the backend loader thread;
+  // `onReady` is called on the render thread with the new resource once the
+  // GPU has finished initializing it (checked at the end of each frame).
+  template <typename Pixel, typename F>
+  void createTexture2DAsync(
+      glm::uvec2 dimensions,
+      std::vector<typename PixelTypeTraits<Pixel>::storage_type> pixels,
+      F onReady) {
+    static_assert(PixelTypeTraits<Pixel>::kIsPixelType,
+                  "Unsupported pixel type");
+    using Storage = typename PixelTypeTraits<Pixel>::storage_type;
+    auto tex = std::make_shared<Texture2D<Pixel, D>>();
+    tex->info = Texture2DInfo{dimensions, PixelTypeTraits<Pixel>::kFormat};
+    auto data = std::make_shared<std::vector<Storage>>(std::move(pixels));
+    auto& b = backend;
+    backend.runOnLoaderThread(
+        [&b, tex, data]() {
+          tex->handle = b.createTexture2D(tex->info);
+          if (!data->empty())
+            b.updateTexture2D(
+                tex->handle.get(), tex->info, 0,
+                Box2D{0, 0, tex->info.dimensions.x, tex->info.dimensions.y},
+                gsl::as_bytes(gsl::span<const Storage>(*data)));
+        },
+        [tex, onReady]() mutable { onReady(std::move(*tex)); });
+  }
+
+  template <typename T, typename F>
+  void createBufferFromSpanAsync(std::vector<T> data, F onReady) {
+    auto buf = std::make_shared<Buffer<D, T[]>>();
+    auto contents = std::make_shared<std::vector<T>>(std::move(data));
+    auto& b = backend;
+    backend.runOnLoaderThread(
+        [&b, buf, contents]() {
+          *buf = Buffer<D, T[]>(
+              contents->size(),
+              b.createBuffer(contents->size() * sizeof(T), contents->data(),
+                             BufferUsage::Default));
+        },
+        [buf, onReady]() mutable { onReady(std::move(*buf)); });
+  }
+
+  template <typename Arg, typename F>
+  void createGraphicsPipelineAsync(Arg&& arg, F onReady) {
+    backend.createGraphicsPipelineAsync(
+        std::forward<Arg>(arg),
+        [onReady](typename D::GraphicsPipelineHandle handle) mutable {
+          onReady(GraphicsPipeline<D>{std::move(handle)});
+        });
+  }
+
+  template <typename Arg, typename F>
+  void createComputePipelineAsync(Arg&& arg, F onReady) {
+    backend.createComputePipelineAsync(
+        std::forward<Arg>(arg),
+        [onReady](typename D::ComputePipelineHandle handle) mutable {
+          onReady(ComputePipeline<D>{std::move(handle)});
+        });
+  }
+
   ///////////////////// Upload heap management
   template <typename T>
   RawBufferSlice<D> pushDataToUploadBuffer(const T& value,
                                            size_t alignment = alignof(T)) {
     RawBufferSlice<D> out_slice;
-    if (!default_upload_buffer->uploadRaw(&value, sizeof(T), alignment,
-                                          getFrameExpirationDate(frame_id),
-                                          out_slice)) {
-      // upload failed, meh, I should sync here
-      failWith("Upload buffer is full");
-    }
+    uploadRaw(&value, sizeof(T), alignment, out_slice);
     return std::move(out_slice);
   }
 
@@ -128,28 +272,69 @@ public:
   RawBufferSlice<D> pushDataToUploadBuffer(gsl::span<T> span,
                                            size_t alignment = alignof(T)) {
     RawBufferSlice<D> out_slice;
-    if (!default_upload_buffer->uploadRaw(
-            span.data(), span.size_bytes(), alignment,
-            getFrameExpirationDate(frame_id), out_slice)) {
-      // upload failed, meh, I should sync here
-      failWith("Upload buffer is full");
-    }
+    uploadRaw(span.data(), span.size_bytes(), alignment, out_slice);
     return std::move(out_slice);
   }
 
   ///////////////////// end-of-frame cleanup
   void endFrame() {
-    // sync on frame N-(max-in-flight)
+    // sync on frame N-(frames-in-flight)
+    pacer->markFrameEnd(frame_id);
     frame_id++;
     backend.signal(frameFence.get(),
                    frame_id); // this should be a command queue API
-    if (frame_id >= options.maxFramesInFlight) {
-      backend.waitForFence(
-          frameFence.get(),
-          getFrameExpirationDate(frame_id - options.maxFramesInFlight));
-      default_upload_buffer->reclaim(
-          getFrameExpirationDate(frame_id - options.maxFramesInFlight));
+    auto framesInFlight = pacer->getFramesInFlight();
+    double waitTime = 0.0;
+    if (frame_id >= framesInFlight) {
+      auto waitStart = std::chrono::steady_clock::now();
+      backend.waitForFence(frameFence.get(),
+                           getFrameExpirationDate(frame_id - framesInFlight));
+      waitTime = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - waitStart)
+                     .count();
     }
+    // fire completion callbacks and reclaim everything the GPU is done with
+    // (this can go further than frame N-(frames-in-flight))
+    auto completed = pollFences();
+    pacer->endFrame(frame_id, completed, waitTime);
+    if (profiler)
+      profiler->endFrame();
+    detail::notifyEndFrame(backend, 0);
+  }
+
+  ///////////////////// fence notifications
+  // Check GPU progress without blocking: invokes the callbacks of completed
+  // frames and reclaims upload buffer space. Returns the current value of
+  // the frame fence. Called by endFrame.
+  FenceValue pollFences() {
+    detail::pollLoaderCompletions(backend, 0);
+    auto value = frameNotifier->poll();
+    default_upload_buffer->reclaim(value);
+    return value;
+  }
+
+  // call `callback` once the GPU has finished executing the commands
+  // issued so far in the current frame
+  void onFrameComplete(typename FenceNotifier<D>::Callback callback) {
+    frameNotifier->when(getFrameExpirationDate(frame_id), std::move(callback));
+  }
+
+  // keep `resource` alive until the GPU has finished with the current frame
+  template <typename T> void deferDestroy(T&& resource) {
+    auto p = std::make_shared<std::decay_t<T>>(std::forward<T>(resource));
+    onFrameComplete([p]() {});
+  }
+
+  ///////////////////// frame pacing
+  const FramePacingStats& getFramePacingStats() const {
+    return pacer->getStats();
+  }
+
+  ///////////////////// statistics
+  // only available if the backend collects statistics (see StatsBackend)
+  template <typename B = D>
+  auto frameStats() const -> decltype(std::declval<B&>().getLastFrameStats()) {
+    return backend.getLastFrameStats();
   }
 
   ///////////////////// pipeline
@@ -164,6 +349,24 @@ public:
         backend.createComputePipeline(std::forward<Arg>(arg))};
   }
 
+  // allocate in the default upload buffer; if full, reclaim the space of
+  // the frames that the GPU has completed and try again.
+  // Only the fence value is queried: the completion callbacks can free
+  // resources that are being bound, they are left to endFrame.
+  void uploadRaw(const void* data, size_t size, size_t alignment,
+                 RawBufferSlice<D>& out_slice) {
+    auto expirationDate = getFrameExpirationDate(frame_id);
+    if (!default_upload_buffer->uploadRaw(data, size, alignment,
+                                          expirationDate, out_slice)) {
+      default_upload_buffer->reclaim(backend.getFenceValue(frameFence.get()));
+      if (!default_upload_buffer->uploadRaw(data, size, alignment,
+                                            expirationDate, out_slice))
+        failWith("Upload buffer is full");
+    }
+    detail::notifyUploadBufferPush(backend, size,
+                                   default_upload_buffer->getUsedSize(), 0);
+  }
+
   // private:
   DeviceOptions options;
   D& backend;
@@ -171,8 +374,16 @@ public:
   typename D::FenceHandle frameFence;
   unsigned frame_id;
 
+  // completion callbacks on the frame fence
+  std::unique_ptr<FenceNotifier<D>> frameNotifier;
+
+  // frame timings, frame limiter
+  std::unique_ptr<FramePacer<D>> pacer;
+
   // the default upload buffer
   std::unique_ptr<UploadBuffer<D>> default_upload_buffer;
+  // null if profiling is disabled
+  std::unique_ptr<Profiler<D>> profiler;
 };
 }
 
@@ -43,7 +43,7 @@ struct DrawArrays0_ {
   uint32_t count;
 
   template <typename D> void draw(Device<D>& device, BindContext& context) {
-    device.backend.draw(primitiveType, 0, count);
+    device.backend.draw(primitiveType, first, count);
   }
 };
 
@@ -60,7 +60,7 @@ struct DrawIndexed0_ {
   uint32_t baseVertex;
 
   template <typename D> void draw(Device<D>& device, BindContext& context) {
-    device.backend.drawIndexed(primitiveType, 0, count, baseVertex);
+    device.backend.drawIndexed(primitiveType, first, count, baseVertex);
   }
 };
 
@@ -69,6 +69,43 @@ inline DrawIndexed0_ DrawIndexed(PrimitiveType primitiveType, uint32_t first,
   return DrawIndexed0_{primitiveType, first, count, baseVertex};
 }
 
+////////////////////////// Draw command: DrawIndexedIndirect
+// Layout of the commands in indirect buffers (DrawElementsIndirectCommand)
+struct DrawIndexedIndirectCommand {
+  uint32_t count;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t baseVertex;
+  uint32_t baseInstance;
+};
+
+// Draws the commands of a buffer, with the number of commands read from
+// another buffer if the backend supports it (see
+// OpenGLBackend::drawIndexedIndirect): commands past the count must then
+// have a zero count or instanceCount.
+template <typename D> struct DrawIndexedIndirect_ {
+  PrimitiveType primitiveType;
+  typename D::BufferHandle::pointer commands;
+  typename D::BufferHandle::pointer drawCount;
+  uint32_t maxDrawCount;
+
+  void draw(Device<D>& device, BindContext& context) {
+    device.backend.drawIndexedIndirect(
+        primitiveType, commands, 0, drawCount, 0, maxDrawCount,
+        (unsigned)sizeof(DrawIndexedIndirectCommand));
+  }
+};
+
+template <typename D>
+DrawIndexedIndirect_<D>
+DrawIndexedIndirect(PrimitiveType primitiveType,
+                    const Buffer<D, DrawIndexedIndirectCommand[]>& commands,
+                    const Buffer<D, uint32_t>& drawCount) {
+  return DrawIndexedIndirect_<D>{primitiveType, commands.handle.get(),
+                                 drawCount.handle.get(),
+                                 (uint32_t)commands.size()};
+}
+
 // Immediate version (put vertex data in the default upload buffer)
 template <typename TVertex> struct DrawArraysImmediate_ {
   PrimitiveType primitiveType;
@@ -129,6 +166,12 @@ struct ClearColorInt {
   uint32_t rgba[4];
 };
 
+////////////////////////// ag::clear(Buffer)
+// fills the buffer with zeros
+template <typename D> void clear(Device<D>& device, RawBuffer<D>& buf) {
+  device.backend.clearBuffer(buf.handle.get(), 0, buf.byteSize);
+}
+
 ////////////////////////// ag::clear(Surface)
 template <typename D, typename Depth, typename... Pixels>
 void clear(Device<D>& device, Surface<D, Depth, Pixels...>& surface,
@@ -153,7 +196,8 @@ template <typename D, typename Depth>
 void clearDepth(Device<D>& device, Texture2D<Depth, D>& tex, float depth,
                 std::experimental::optional<const ag::Box2D&> region =
                     std::experimental::nullopt) {
-  device.backend.template clearTexture2DDepth<Depth>(tex, Box2D{}, depth);
+  device.backend.clearTexture2DDepth(tex.handle.get(), tex.info, Box2D{},
+                                     depth);
 }
 
 ////////////////////////// ag::clear(Texture1D)
@@ -161,15 +205,21 @@ template <typename D, typename Pixel>
 void clear(Device<D>& device, Texture1D<Pixel, D>& tex, const ClearColor& color,
            std::experimental::optional<const ag::Box1D&> region =
                std::experimental::nullopt) {
-  device.backend.template clearTexture1DFloat<Pixel>(tex, Box1D{}, color);
+  device.backend.clearTexture1DFloat(tex.handle.get(), tex.info, Box1D{},
+                                     color);
 }
 
 ////////////////////////// ag::clear(Texture2D)
+// clears the whole texture if no region is specified
 template <typename D, typename Pixel>
 void clear(Device<D>& device, Texture2D<Pixel, D>& tex, const ClearColor& color,
            std::experimental::optional<const ag::Box2D&> region =
                std::experimental::nullopt) {
-  device.backend.template clearTexture2DFloat<Pixel>(tex, Box2D{}, color);
+  device.backend.clearTexture2DFloat(
+      tex.handle.get(), tex.info,
+      region ? *region
+             : Box2D{0, 0, tex.info.dimensions.x, tex.info.dimensions.y},
+      color);
 }
 
 ////////////////////////// ag::clear(Texture3D)
@@ -177,7 +227,23 @@ template <typename D, typename Pixel>
 void clear(Device<D>& device, Texture3D<Pixel, D>& tex, const ClearColor& color,
            std::experimental::optional<const ag::Box3D&> region =
                std::experimental::nullopt) {
-  device.backend.template clearTexture3DFloat<Pixel>(tex, Box3D{}, color);
+  device.backend.clearTexture3DFloat(tex.handle.get(), tex.info, Box3D{},
+                                     color);
+}
+
+////////////////////////// ag::clear(Texture2DArray)
+// the z range of `region` is a range of layers
+template <typename D, typename Pixel>
+void clear(Device<D>& device, Texture2DArray<Pixel, D>& tex,
+           const ClearColor& color,
+           std::experimental::optional<const ag::Box3D&> region =
+               std::experimental::nullopt) {
+  device.backend.clearTexture2DArrayFloat(
+      tex.handle.get(), tex.info,
+      region ? *region
+             : Box3D{0, 0, 0, tex.info.dimensions.x, tex.info.dimensions.y,
+                     tex.info.layers},
+      color);
 }
 
 ////////////////////////// ag::clear(Texture2D<Integer>)
@@ -186,7 +252,8 @@ void clearInteger(Device<D>& device, Texture1D<IPixel, D>& tex,
                   const ClearColorInt& color,
                   std::experimental::optional<const ag::Box1D&> region =
                       std::experimental::nullopt) {
-  device.backend.template clearTexture1DInteger<IPixel>(tex, Box1D{}, color);
+  device.backend.clearTexture1DInteger(tex.handle.get(), tex.info, Box1D{},
+                                       color);
 }
 
 template <typename D, typename IPixel>
@@ -194,7 +261,8 @@ void clearInteger(Device<D>& device, Texture2D<IPixel, D>& tex,
                   const ClearColorInt& color,
                   std::experimental::optional<const ag::Box2D&> region =
                       std::experimental::nullopt) {
-  device.backend.template clearTexture2DInteger<IPixel>(tex, Box2D{}, color);
+  device.backend.clearTexture2DInteger(tex.handle.get(), tex.info, Box2D{},
+                                       color);
 }
 
 template <typename D, typename IPixel>
@@ -202,7 +270,8 @@ void clearInteger(Device<D>& device, Texture3D<IPixel, D>& tex,
                   const ClearColorInt& color,
                   std::experimental::optional<const ag::Box3D&> region =
                       std::experimental::nullopt) {
-  device.backend.template clearTexture3DInteger<IPixel>(tex, Box3D{}, color);
+  device.backend.clearTexture3DInteger(tex.handle.get(), tex.info, Box3D{},
+                                       color);
 }
 }
 
@@ -0,0 +1,59 @@
+#ifndef FENCE_NOTIFIER_HPP
+#define FENCE_NOTIFIER_HPP
+
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "fence.hpp"
+
+namespace ag {
+
+///////////////////// FenceNotifier
+// Calls functions when a fence reaches a value, without blocking.
+// The fence is polled with poll() (the device does it at the end of each
+// frame). Callbacks are invoked on the thread that calls poll(), in
+// increasing order of fence values.
+template <typename D> class FenceNotifier {
+public:
+  using Callback = std::function<void()>;
+
+  FenceNotifier(D& backend_, typename D::FenceHandle::pointer fence_)
+      : backend(backend_), fence(fence_) {}
+
+  // call `callback` once the fence has reached `value`
+  // (on the next poll if it is already reached)
+  void when(FenceValue value, Callback callback) {
+    callbacks.emplace(value, std::move(callback));
+  }
+
+  // check the fence value without blocking and invoke the callbacks
+  // whose value has been reached. Returns the current fence value.
+  FenceValue poll() {
+    auto value = backend.getFenceValue(fence);
+    if (callbacks.empty() || callbacks.begin()->first > value)
+      return value;
+    // move ready callbacks out first: callbacks may register new ones, or
+    // poll again
+    auto end = callbacks.upper_bound(value);
+    std::vector<Callback> ready;
+    for (auto it = callbacks.begin(); it != end; ++it)
+      ready.push_back(std::move(it->second));
+    callbacks.erase(callbacks.begin(), end);
+    for (auto& cb : ready)
+      cb();
+    return value;
+  }
+
+  size_t getPendingCount() const { return callbacks.size(); }
+
+private:
+  D& backend;
+  typename D::FenceHandle::pointer fence;
+  // multimap preserves insertion order for equal values
+  std::multimap<FenceValue, Callback> callbacks;
+};
+}
+
+#endif // !FENCE_NOTIFIER_HPP
@@ -0,0 +1,198 @@
+#ifndef FRAME_PACING_HPP
+#define FRAME_PACING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "fence.hpp"
+
+namespace ag {
+
+///////////////////// Present modes
+enum class PresentMode {
+  // wait for vertical blank
+  Vsync,
+  // present immediately (may tear)
+  Immediate,
+  // vsync, but present immediately if the frame is late
+  // (falls back to Vsync if unsupported)
+  Adaptive
+};
+
+///////////////////// Frame pacing statistics (times in milliseconds)
+struct FramePacingStats {
+  // time between two consecutive ends of frame
+  double cpuFrameTime = 0.0;
+  // time spent blocked on the frame fence
+  double cpuWaitTime = 0.0;
+  // time spent sleeping in the frame limiter
+  double limiterWaitTime = 0.0;
+  // GPU time between the first and last commands of the last completed frame
+  double gpuFrameTime = 0.0;
+  // number of submitted frames not yet completed by the GPU
+  unsigned queueDepth = 0;
+  // current limit on the number of frames in flight
+  unsigned framesInFlight = 0;
+};
+
+///////////////////// FramePacer
+// Measures CPU and GPU frame times, limits the frame rate, and
+// optionally tunes the number of frames in flight. Owned by the device.
+template <typename D> class FramePacer {
+public:
+  // auto-tuning window, in frames
+  static constexpr unsigned kTuningWindow = 60;
+
+  FramePacer(D& backend_, unsigned maxFramesInFlight_, float frameRateLimit,
+             bool autoTune_)
+      : backend(backend_), maxFramesInFlight(maxFramesInFlight_),
+        framesInFlight(maxFramesInFlight_), autoTune(autoTune_),
+        slots(maxFramesInFlight_ + 1) {
+    if (frameRateLimit > 0.0f)
+      targetFrameDuration =
+          std::chrono::duration_cast<clock::duration>(
+              std::chrono::duration<double>(1.0 / frameRateLimit));
+    gpuTimer = backend.createTimestampQueryPool(2 * (unsigned)slots.size());
+    lastFrameEnd = clock::now();
+    nextFrameDeadline = lastFrameEnd;
+    beginFrame(0);
+  }
+
+  // number of frames the CPU is allowed to run ahead of the GPU
+  unsigned getFramesInFlight() const { return framesInFlight; }
+
+  const FramePacingStats& getStats() const { return stats; }
+
+  // called by the device before signaling the end of frame `frame_id`
+  void markFrameEnd(uint64_t frame_id) {
+    auto i = slotIndex(frame_id);
+    backend.writeTimestamp(gpuTimer.get(), 2 * i + 1);
+    slots[i].pending = true;
+  }
+
+  // called by the device at the end of the frame, after waiting on the frame
+  // fence. `next_frame_id` is the frame about to begin, `completed` the
+  // current value of the frame fence.
+  void endFrame(uint64_t next_frame_id, FenceValue completed,
+                double fenceWaitTime) {
+    resolveGPUTimers(completed);
+    stats.cpuWaitTime = fenceWaitTime;
+    stats.queueDepth = (unsigned)(next_frame_id - std::min<uint64_t>(
+                                                      completed, next_frame_id));
+    stats.framesInFlight = framesInFlight;
+    limitFrameRate();
+    auto now = clock::now();
+    stats.cpuFrameTime =
+        std::chrono::duration<double, std::milli>(now - lastFrameEnd).count();
+    lastFrameEnd = now;
+    if (autoTune)
+      tuneFramesInFlight();
+    beginFrame(next_frame_id);
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct Slot {
+    uint64_t frame = 0;
+    bool pending = false;
+  };
+
+  unsigned slotIndex(uint64_t frame_id) const {
+    return (unsigned)(frame_id % slots.size());
+  }
+
+  void beginFrame(uint64_t frame_id) {
+    auto& slot = slots[slotIndex(frame_id)];
+    // the slot was used by a frame that is now complete; if its results were
+    // not read back yet, they are lost
+    slot.pending = false;
+    slot.frame = frame_id;
+    backend.writeTimestamp(gpuTimer.get(), 2 * slotIndex(frame_id));
+  }
+
+  void resolveGPUTimers(FenceValue completed) {
+    for (auto& slot : slots) {
+      // frame N is complete when the fence has reached N+1
+      if (!slot.pending || slot.frame + 1 > completed)
+        continue;
+      uint64_t begin, end;
+      auto i = slotIndex(slot.frame);
+      if (!backend.tryGetTimestamp(gpuTimer.get(), 2 * i, begin) ||
+          !backend.tryGetTimestamp(gpuTimer.get(), 2 * i + 1, end))
+        continue;
+      slot.pending = false;
+      if (slot.frame >= lastResolvedFrame) {
+        lastResolvedFrame = slot.frame;
+        stats.gpuFrameTime = (end - begin) * 1e-6;
+      }
+    }
+  }
+
+  void limitFrameRate() {
+    stats.limiterWaitTime = 0.0;
+    if (targetFrameDuration == clock::duration::zero())
+      return;
+    auto now = clock::now();
+    nextFrameDeadline += targetFrameDuration;
+    // do not try to catch up on late frames
+    if (nextFrameDeadline < now) {
+      nextFrameDeadline = now;
+      return;
+    }
+    std::this_thread::sleep_until(nextFrameDeadline);
+    stats.limiterWaitTime =
+        std::chrono::duration<double, std::milli>(clock::now() - now).count();
+  }
+
+  // Heuristic: if the CPU blocks on the fence nearly every frame, the GPU is
+  // the bottleneck and a shorter queue lowers latency at no throughput cost.
+  // If it blocks rarely but for long (GPU spikes), a longer queue absorbs
+  // them.
+  void tuneFramesInFlight() {
+    ++windowFrames;
+    windowFrameTime += stats.cpuFrameTime;
+    if (stats.cpuWaitTime > 0.5)
+      ++windowBlockedFrames;
+    windowMaxWait = std::max(windowMaxWait, stats.cpuWaitTime);
+    if (windowFrames < kTuningWindow)
+      return;
+    auto avgFrameTime = windowFrameTime / windowFrames;
+    unsigned minFramesInFlight = std::min(2u, maxFramesInFlight);
+    if (windowBlockedFrames * 10 >= windowFrames * 9) {
+      if (framesInFlight > minFramesInFlight)
+        --framesInFlight;
+    } else if (windowBlockedFrames * 2 < windowFrames &&
+               windowMaxWait > 0.5 * avgFrameTime) {
+      if (framesInFlight < maxFramesInFlight)
+        ++framesInFlight;
+    }
+    windowFrames = 0;
+    windowBlockedFrames = 0;
+    windowFrameTime = 0.0;
+    windowMaxWait = 0.0;
+  }
+
+  D& backend;
+  unsigned maxFramesInFlight;
+  unsigned framesInFlight;
+  bool autoTune;
+  std::vector<Slot> slots;
+  typename D::TimestampQueryPoolHandle gpuTimer;
+  uint64_t lastResolvedFrame = 0;
+  clock::duration targetFrameDuration = clock::duration::zero();
+  clock::time_point lastFrameEnd;
+  clock::time_point nextFrameDeadline;
+  FramePacingStats stats;
+  // auto-tuning state
+  unsigned windowFrames = 0;
+  unsigned windowBlockedFrames = 0;
+  double windowFrameTime = 0.0;
+  double windowMaxWait = 0.0;
+};
+}
+
+#endif // !FRAME_PACING_HPP
@@ -0,0 +1,50 @@
+#ifndef MIPMAP_HPP
+#define MIPMAP_HPP
+
+#include "device.hpp"
+#include "rect.hpp"
+#include "texture.hpp"
+
+namespace ag {
+
+///////////////////// Mip chain generation
+// Regenerates all mip levels of a texture from level 0.
+// 2D textures use a compute downsampler; the other types use the driver.
+
+template <typename D, typename Pixel>
+void generateMips(Device<D>& device, Texture2D<Pixel, D>& tex) {
+  device.backend.generateMipmaps2D(
+      tex.handle.get(), tex.info, 0,
+      Box2D{0, 0, tex.info.dimensions.x, tex.info.dimensions.y});
+}
+
+// Regenerates only the mip tiles covering `dirtyRegion` (in level 0 texels),
+// e.g. after painting in a small part of the texture
+template <typename D, typename Pixel>
+void generateMips(Device<D>& device, Texture2D<Pixel, D>& tex,
+                  const Box2D& dirtyRegion) {
+  device.backend.generateMipmaps2D(tex.handle.get(), tex.info, 0, dirtyRegion);
+}
+
+template <typename D, typename Pixel>
+void generateMips(Device<D>& device, Texture1D<Pixel, D>& tex) {
+  device.backend.generateMipmaps(tex.handle.get());
+}
+
+template <typename D, typename Pixel>
+void generateMips(Device<D>& device, Texture3D<Pixel, D>& tex) {
+  device.backend.generateMipmaps(tex.handle.get());
+}
+
+template <typename D, typename Pixel>
+void generateMips(Device<D>& device, Texture2DArray<Pixel, D>& tex) {
+  device.backend.generateMipmaps(tex.handle.get());
+}
+
+template <typename D, typename Pixel>
+void generateMips(Device<D>& device, TextureCubeMap<Pixel, D>& tex) {
+  device.backend.generateMipmaps(tex.handle.get());
+}
+}
+
+#endif // !MIPMAP_HPP
@@ -0,0 +1,696 @@
+#include "pixel_conversion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "error.hpp"
+
+#if defined(__AVX2__)
+#define AG_PC_AVX2
+#endif
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define AG_PC_F16C
+#endif
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define AG_PC_SSE41
+#endif
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AG_PC_SSE2
+#endif
+
+#if defined(AG_PC_AVX2) || defined(AG_PC_F16C)
+#include <immintrin.h>
+#elif defined(AG_PC_SSE41)
+#include <smmintrin.h>
+#elif defined(AG_PC_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace ag {
+
+namespace {
+
+///////////////////// Format descriptions
+enum class ElementKind {
+  Invalid,
+  Unorm8,
+  Snorm8,
+  Uint8,
+  Sint8,
+  Unorm16,
+  Snorm16,
+  Uint16,
+  Sint16,
+  Half,
+  Float32,
+  Uint32,
+  Sint32,
+  // one 32-bit element per pixel
+  Unorm10x3_1x2,
+  Snorm10x3_1x2
+};
+
+struct FormatDesc {
+  ElementKind kind;
+  unsigned channels;
+};
+
+FormatDesc getFormatDesc(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::Uint32x4: return {ElementKind::Uint32, 4};
+  case PixelFormat::Sint32x4: return {ElementKind::Sint32, 4};
+  case PixelFormat::Float4: return {ElementKind::Float32, 4};
+  case PixelFormat::Uint32x3: return {ElementKind::Uint32, 3};
+  case PixelFormat::Sint32x3: return {ElementKind::Sint32, 3};
+  case PixelFormat::Float3: return {ElementKind::Float32, 3};
+  case PixelFormat::Float2: return {ElementKind::Float32, 2};
+  case PixelFormat::Uint16x4: return {ElementKind::Uint16, 4};
+  case PixelFormat::Sint16x4: return {ElementKind::Sint16, 4};
+  case PixelFormat::Unorm16x4: return {ElementKind::Unorm16, 4};
+  case PixelFormat::Snorm16x4: return {ElementKind::Snorm16, 4};
+  case PixelFormat::Float16x4: return {ElementKind::Half, 4};
+  case PixelFormat::Uint16x2: return {ElementKind::Uint16, 2};
+  case PixelFormat::Sint16x2: return {ElementKind::Sint16, 2};
+  case PixelFormat::Unorm16x2: return {ElementKind::Unorm16, 2};
+  case PixelFormat::Snorm16x2: return {ElementKind::Snorm16, 2};
+  case PixelFormat::Float16x2: return {ElementKind::Half, 2};
+  case PixelFormat::Uint8x4: return {ElementKind::Uint8, 4};
+  case PixelFormat::Sint8x4: return {ElementKind::Sint8, 4};
+  case PixelFormat::Unorm8x4: return {ElementKind::Unorm8, 4};
+  case PixelFormat::Snorm8x4: return {ElementKind::Snorm8, 4};
+  case PixelFormat::Uint8x3: return {ElementKind::Uint8, 3};
+  case PixelFormat::Sint8x3: return {ElementKind::Sint8, 3};
+  case PixelFormat::Unorm8x3: return {ElementKind::Unorm8, 3};
+  case PixelFormat::Snorm8x3: return {ElementKind::Snorm8, 3};
+  case PixelFormat::Uint8x2: return {ElementKind::Uint8, 2};
+  case PixelFormat::Sint8x2: return {ElementKind::Sint8, 2};
+  case PixelFormat::Unorm8x2: return {ElementKind::Unorm8, 2};
+  case PixelFormat::Snorm8x2: return {ElementKind::Snorm8, 2};
+  case PixelFormat::Unorm10x3_1x2: return {ElementKind::Unorm10x3_1x2, 4};
+  case PixelFormat::Snorm10x3_1x2: return {ElementKind::Snorm10x3_1x2, 4};
+  case PixelFormat::Uint32: return {ElementKind::Uint32, 1};
+  case PixelFormat::Sint32: return {ElementKind::Sint32, 1};
+  case PixelFormat::Uint16: return {ElementKind::Uint16, 1};
+  case PixelFormat::Sint16: return {ElementKind::Sint16, 1};
+  case PixelFormat::Unorm16: return {ElementKind::Unorm16, 1};
+  case PixelFormat::Snorm16: return {ElementKind::Snorm16, 1};
+  case PixelFormat::Uint8: return {ElementKind::Uint8, 1};
+  case PixelFormat::Sint8: return {ElementKind::Sint8, 1};
+  case PixelFormat::Unorm8: return {ElementKind::Unorm8, 1};
+  case PixelFormat::Snorm8: return {ElementKind::Snorm8, 1};
+  case PixelFormat::Float16: return {ElementKind::Half, 1};
+  case PixelFormat::Float: return {ElementKind::Float32, 1};
+  default: return {ElementKind::Invalid, 0};
+  }
+}
+
+size_t getElementSize(ElementKind kind) {
+  switch (kind) {
+  case ElementKind::Unorm8:
+  case ElementKind::Snorm8:
+  case ElementKind::Uint8:
+  case ElementKind::Sint8:
+    return 1;
+  case ElementKind::Unorm16:
+  case ElementKind::Snorm16:
+  case ElementKind::Uint16:
+  case ElementKind::Sint16:
+  case ElementKind::Half:
+    return 2;
+  default:
+    return 4;
+  }
+}
+
+size_t getPixelSize(const FormatDesc& desc) {
+  if (desc.kind == ElementKind::Invalid)
+    return 0;
+  if (desc.kind == ElementKind::Unorm10x3_1x2 ||
+      desc.kind == ElementKind::Snorm10x3_1x2)
+    return 4;
+  return getElementSize(desc.kind) * desc.channels;
+}
+
+///////////////////// Scalar element conversions
+float clampUnit(float v) {
+  // NaN -> 0
+  v = v > 0.0f ? v : 0.0f;
+  return v < 1.0f ? v : 1.0f;
+}
+
+float clampSignedUnit(float v) {
+  v = v > -1.0f ? v : -1.0f;
+  return v < 1.0f ? v : 1.0f;
+}
+
+template <typename T> T toInteger(float v) {
+  double lo = (double)std::numeric_limits<T>::min();
+  double hi = (double)std::numeric_limits<T>::max();
+  double d = std::nearbyint((double)v);
+  d = d > lo ? d : lo;
+  return (T)(d < hi ? d : hi);
+}
+
+template <typename T> T loadElement(const uint8_t* p) {
+  T v;
+  memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+template <typename T> void storeElement(uint8_t* p, T v) {
+  memcpy(p, &v, sizeof(T));
+}
+
+float decodeElement(ElementKind kind, const uint8_t* p) {
+  switch (kind) {
+  case ElementKind::Unorm8: return (float)p[0] * (1.0f / 255.0f);
+  case ElementKind::Snorm8:
+    return std::max((float)(int8_t)p[0] * (1.0f / 127.0f), -1.0f);
+  case ElementKind::Uint8: return (float)p[0];
+  case ElementKind::Sint8: return (float)(int8_t)p[0];
+  case ElementKind::Unorm16:
+    return (float)loadElement<uint16_t>(p) * (1.0f / 65535.0f);
+  case ElementKind::Snorm16:
+    return std::max((float)loadElement<int16_t>(p) * (1.0f / 32767.0f), -1.0f);
+  case ElementKind::Uint16: return (float)loadElement<uint16_t>(p);
+  case ElementKind::Sint16: return (float)loadElement<int16_t>(p);
+  case ElementKind::Half: return halfToFloat(loadElement<uint16_t>(p));
+  case ElementKind::Float32: return loadElement<float>(p);
+  case ElementKind::Uint32: return (float)loadElement<uint32_t>(p);
+  case ElementKind::Sint32: return (float)loadElement<int32_t>(p);
+  default: return 0.0f;
+  }
+}
+
+void encodeElement(ElementKind kind, float v, uint8_t* p) {
+  switch (kind) {
+  case ElementKind::Unorm8:
+    p[0] = (uint8_t)std::nearbyint(clampUnit(v) * 255.0f);
+    break;
+  case ElementKind::Snorm8:
+    p[0] = (uint8_t)(int8_t)std::nearbyint(clampSignedUnit(v) * 127.0f);
+    break;
+  case ElementKind::Uint8: p[0] = toInteger<uint8_t>(v); break;
+  case ElementKind::Sint8: p[0] = (uint8_t)toInteger<int8_t>(v); break;
+  case ElementKind::Unorm16:
+    storeElement(p, (uint16_t)std::nearbyint(clampUnit(v) * 65535.0f));
+    break;
+  case ElementKind::Snorm16:
+    storeElement(p, (int16_t)std::nearbyint(clampSignedUnit(v) * 32767.0f));
+    break;
+  case ElementKind::Uint16: storeElement(p, toInteger<uint16_t>(v)); break;
+  case ElementKind::Sint16: storeElement(p, toInteger<int16_t>(v)); break;
+  case ElementKind::Half: storeElement(p, floatToHalf(v)); break;
+  case ElementKind::Float32: storeElement(p, v); break;
+  case ElementKind::Uint32: storeElement(p, toInteger<uint32_t>(v)); break;
+  case ElementKind::Sint32: storeElement(p, toInteger<int32_t>(v)); break;
+  default: break;
+  }
+}
+
+///////////////////// 10_10_10_2
+// Same layout as GL_UNSIGNED_INT_10_10_10_2: R in the high bits, A in the
+// low bits.
+void decode1010102(ElementKind kind, uint32_t v, float out[4]) {
+  if (kind == ElementKind::Unorm10x3_1x2) {
+    out[0] = (float)((v >> 22) & 0x3FF) * (1.0f / 1023.0f);
+    out[1] = (float)((v >> 12) & 0x3FF) * (1.0f / 1023.0f);
+    out[2] = (float)((v >> 2) & 0x3FF) * (1.0f / 1023.0f);
+    out[3] = (float)(v & 3) * (1.0f / 3.0f);
+  } else {
+    // sign-extend the fields
+    auto field = [v](unsigned shift, unsigned bits) {
+      int32_t f = (int32_t)(v << (32 - shift - bits));
+      return f >> (32 - bits);
+    };
+    out[0] = std::max((float)field(22, 10) * (1.0f / 511.0f), -1.0f);
+    out[1] = std::max((float)field(12, 10) * (1.0f / 511.0f), -1.0f);
+    out[2] = std::max((float)field(2, 10) * (1.0f / 511.0f), -1.0f);
+    out[3] = std::max((float)field(0, 2), -1.0f);
+  }
+}
+
+uint32_t encode1010102(ElementKind kind, const float in[4]) {
+  if (kind == ElementKind::Unorm10x3_1x2) {
+    uint32_t r = (uint32_t)std::nearbyint(clampUnit(in[0]) * 1023.0f);
+    uint32_t g = (uint32_t)std::nearbyint(clampUnit(in[1]) * 1023.0f);
+    uint32_t b = (uint32_t)std::nearbyint(clampUnit(in[2]) * 1023.0f);
+    uint32_t a = (uint32_t)std::nearbyint(clampUnit(in[3]) * 3.0f);
+    return (r << 22) | (g << 12) | (b << 2) | a;
+  } else {
+    auto field = [](float v, float scale, unsigned bits) {
+      int32_t f = (int32_t)std::nearbyint(clampSignedUnit(v) * scale);
+      return (uint32_t)f & ((1u << bits) - 1);
+    };
+    return (field(in[0], 511.0f, 10) << 22) | (field(in[1], 511.0f, 10) << 12) |
+           (field(in[2], 511.0f, 10) << 2) | field(in[3], 1.0f, 2);
+  }
+}
+
+///////////////////// sRGB tables
+struct SRGBTables {
+  SRGBTables() {
+    for (int i = 0; i < 256; ++i)
+      toLinear[i] = srgbToLinear((float)i / 255.0f);
+    // thresholds[k]: smallest linear value that encodes to k
+    // (midpoint of codes k-1 and k in sRGB space)
+    thresholds[0] = -std::numeric_limits<float>::infinity();
+    for (int k = 1; k < 256; ++k)
+      thresholds[k] = srgbToLinear(((float)k - 0.5f) / 255.0f);
+  }
+  float toLinear[256];
+  float thresholds[256];
+};
+
+const SRGBTables& getSRGBTables() {
+  static SRGBTables tables;
+  return tables;
+}
+
+uint8_t linearToSRGB8(const SRGBTables& tables, float v) {
+  // branchless binary search in the thresholds
+  unsigned k = 0;
+  for (unsigned step = 128; step; step >>= 1)
+    k += tables.thresholds[k + step] <= v ? step : 0;
+  // NaN compares false: 0
+  return (uint8_t)k;
+}
+
+///////////////////// Fast paths
+// element-wise: unorm8 -> float
+void unorm8ToFloat(const uint8_t* src, float* dst, size_t n) {
+  size_t i = 0;
+#if defined(AG_PC_AVX2)
+  const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+  }
+#elif defined(AG_PC_SSE2)
+  const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+    _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+    _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+  }
+#endif
+  for (; i < n; ++i)
+    dst[i] = (float)src[i] * (1.0f / 255.0f);
+}
+
+// element-wise: float -> unorm8 (clamped, rounded to nearest even)
+void floatToUnorm8(const float* src, uint8_t* dst, size_t n) {
+  size_t i = 0;
+#if defined(AG_PC_SSE2)
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  auto convert4 = [&](const float* p) {
+    // max(v, 0) returns 0 for NaN
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(p), zero), one);
+    return _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+  };
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_packs_epi32(convert4(src + i), convert4(src + i + 4));
+    __m128i b = _mm_packs_epi32(convert4(src + i + 8), convert4(src + i + 12));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+  }
+#endif
+  for (; i < n; ++i)
+    dst[i] = (uint8_t)std::nearbyint(clampUnit(src[i]) * 255.0f);
+}
+
+// element-wise: float -> half
+void floatToHalfN(const float* src, uint16_t* dst, size_t n) {
+  size_t i = 0;
+#if defined(AG_PC_F16C)
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i*)(dst + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(src + i), 0));
+#endif
+  for (; i < n; ++i)
+    dst[i] = floatToHalf(src[i]);
+}
+
+// element-wise: half -> float
+void halfToFloatN(const uint16_t* src, float* dst, size_t n) {
+  size_t i = 0;
+#if defined(AG_PC_F16C)
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(
+                                  (const __m128i*)(src + i))));
+#endif
+  for (; i < n; ++i)
+    dst[i] = halfToFloat(src[i]);
+}
+
+// 8-bit RGB -> RGBA (alpha = max), n pixels
+void expand8x3To8x4(const uint8_t* src, uint8_t* dst, size_t n, uint8_t alpha) {
+  size_t i = 0;
+#if defined(AG_PC_SSE41)
+  const __m128i shuf = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9,
+                                     10, 11, -1);
+  const __m128i alphaMask = _mm_set1_epi32((int)((uint32_t)alpha << 24));
+  // 16-byte loads of 4 pixels (12 bytes): stay in bounds
+  for (; i + 6 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 3));
+    _mm_storeu_si128((__m128i*)(dst + i * 4),
+                     _mm_or_si128(_mm_shuffle_epi8(v, shuf), alphaMask));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i * 4] = src[i * 3];
+    dst[i * 4 + 1] = src[i * 3 + 1];
+    dst[i * 4 + 2] = src[i * 3 + 2];
+    dst[i * 4 + 3] = alpha;
+  }
+}
+
+// 8-bit RGBA -> RGB, n pixels
+void drop8x4To8x3(const uint8_t* src, uint8_t* dst, size_t n) {
+  size_t i = 0;
+#if defined(AG_PC_SSE41)
+  const __m128i shuf = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                                     -1, -1, -1, -1);
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i*)(src + i * 4)), shuf);
+    _mm_storel_epi64((__m128i*)(dst + i * 3), v);
+    int last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    memcpy(dst + i * 3 + 8, &last, 4);
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i * 3] = src[i * 4];
+    dst[i * 3 + 1] = src[i * 4 + 1];
+    dst[i * 3 + 2] = src[i * 4 + 2];
+  }
+}
+
+// Unorm10x3_1x2 -> RGBA float, n pixels
+void unpack1010102(const uint8_t* src, float* dst, size_t n) {
+  size_t i = 0;
+#if defined(AG_PC_SSE2)
+  // fields moved to the low 30 bits (positive as int32), then scaled
+  const __m128i rgbMask =
+      _mm_setr_epi32(0x3FF << 20, 0x3FF << 10, 0x3FF, 0);
+  const __m128i alphaMask = _mm_setr_epi32(0, 0, 0, 3);
+  const __m128 scale =
+      _mm_setr_ps(1.0f / (1023.0f * 1048576.0f), 1.0f / (1023.0f * 1024.0f),
+                  1.0f / 1023.0f, 1.0f / 3.0f);
+  for (; i < n; ++i) {
+    __m128i v = _mm_set1_epi32((int)loadElement<uint32_t>(src + i * 4));
+    __m128i fields = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 2), rgbMask),
+                                  _mm_and_si128(v, alphaMask));
+    _mm_storeu_ps(dst + i * 4, _mm_mul_ps(_mm_cvtepi32_ps(fields), scale));
+  }
+#endif
+  for (; i < n; ++i)
+    decode1010102(ElementKind::Unorm10x3_1x2,
+                  loadElement<uint32_t>(src + i * 4), dst + i * 4);
+}
+
+// RGBA float -> Unorm10x3_1x2, n pixels
+void pack1010102(const float* src, uint8_t* dst, size_t n) {
+  size_t i = 0;
+#if defined(AG_PC_SSE2)
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f);
+  for (; i + 4 <= n; i += 4) {
+    // four pixels, transposed to R, G, B, A vectors
+    __m128 p0 = _mm_loadu_ps(src + i * 4), p1 = _mm_loadu_ps(src + i * 4 + 4),
+           p2 = _mm_loadu_ps(src + i * 4 + 8),
+           p3 = _mm_loadu_ps(src + i * 4 + 12);
+    auto q = [&](__m128 p) {
+      return _mm_cvtps_epi32(
+          _mm_mul_ps(_mm_min_ps(_mm_max_ps(p, zero), one), scale));
+    };
+    __m128i q0 = q(p0), q1 = q(p1), q2 = q(p2), q3 = q(p3);
+    __m128i t0 = _mm_unpacklo_epi32(q0, q1), t1 = _mm_unpacklo_epi32(q2, q3);
+    __m128i t2 = _mm_unpackhi_epi32(q0, q1), t3 = _mm_unpackhi_epi32(q2, q3);
+    __m128i r = _mm_unpacklo_epi64(t0, t1), g = _mm_unpackhi_epi64(t0, t1);
+    __m128i b = _mm_unpacklo_epi64(t2, t3), a = _mm_unpackhi_epi64(t2, t3);
+    __m128i packed = _mm_or_si128(
+        _mm_or_si128(_mm_slli_epi32(r, 22), _mm_slli_epi32(g, 12)),
+        _mm_or_si128(_mm_slli_epi32(b, 2), a));
+    _mm_storeu_si128((__m128i*)(dst + i * 4), packed);
+  }
+#endif
+  for (; i < n; ++i)
+    storeElement(dst + i * 4,
+                 encode1010102(ElementKind::Unorm10x3_1x2, src + i * 4));
+}
+
+// sRGB unorm8 -> linear float (alpha is linear), n pixels of c channels
+void srgb8ToLinearFloat(const uint8_t* src, float* dst, size_t n,
+                        unsigned c) {
+  const auto& tables = getSRGBTables();
+  for (size_t i = 0; i < n; ++i)
+    for (unsigned k = 0; k < c; ++k)
+      dst[i * c + k] = k < 3 ? tables.toLinear[src[i * c + k]]
+                             : (float)src[i * c + k] * (1.0f / 255.0f);
+}
+
+// linear float -> sRGB unorm8 (alpha is linear), n pixels of c channels
+void linearFloatToSRGB8(const float* src, uint8_t* dst, size_t n,
+                        unsigned c) {
+  const auto& tables = getSRGBTables();
+  for (size_t i = 0; i < n; ++i)
+    for (unsigned k = 0; k < c; ++k)
+      dst[i * c + k] =
+          k < 3 ? linearToSRGB8(tables, src[i * c + k])
+                : (uint8_t)std::nearbyint(clampUnit(src[i * c + k]) * 255.0f);
+}
+
+bool convertFast(const FormatDesc& s, const FormatDesc& d,
+                 ColorTransfer transfer, const uint8_t* src, uint8_t* dst,
+                 size_t n) {
+  if (s.kind == ElementKind::Unorm8 && d.kind == ElementKind::Float32 &&
+      s.channels == d.channels) {
+    if (transfer == ColorTransfer::None)
+      unorm8ToFloat(src, (float*)dst, n * s.channels);
+    else if (transfer == ColorTransfer::SRGBToLinear)
+      srgb8ToLinearFloat(src, (float*)dst, n, s.channels);
+    else
+      return false;
+    return true;
+  }
+  if (s.kind == ElementKind::Float32 && d.kind == ElementKind::Unorm8 &&
+      s.channels == d.channels) {
+    if (transfer == ColorTransfer::None)
+      floatToUnorm8((const float*)src, dst, n * s.channels);
+    else if (transfer == ColorTransfer::LinearToSRGB)
+      linearFloatToSRGB8((const float*)src, dst, n, s.channels);
+    else
+      return false;
+    return true;
+  }
+  // the remaining fast paths do not touch color values
+  if (transfer != ColorTransfer::None)
+    return false;
+  if (s.kind == ElementKind::Float32 && d.kind == ElementKind::Half &&
+      s.channels == d.channels) {
+    floatToHalfN((const float*)src, (uint16_t*)dst, n * s.channels);
+    return true;
+  }
+  if (s.kind == ElementKind::Half && d.kind == ElementKind::Float32 &&
+      s.channels == d.channels) {
+    halfToFloatN((const uint16_t*)src, (float*)dst, n * s.channels);
+    return true;
+  }
+  bool bytes = (s.kind == ElementKind::Unorm8 && d.kind == ElementKind::Unorm8) ||
+               (s.kind == ElementKind::Uint8 && d.kind == ElementKind::Uint8);
+  if (bytes && s.channels == 3 && d.channels == 4) {
+    expand8x3To8x4(src, dst, n, s.kind == ElementKind::Unorm8 ? 255 : 1);
+    return true;
+  }
+  if (bytes && s.channels == 4 && d.channels == 3) {
+    drop8x4To8x3(src, dst, n);
+    return true;
+  }
+  if (s.kind == ElementKind::Unorm10x3_1x2 && d.kind == ElementKind::Float32 &&
+      d.channels == 4) {
+    unpack1010102(src, (float*)dst, n);
+    return true;
+  }
+  if (s.kind == ElementKind::Float32 && s.channels == 4 &&
+      d.kind == ElementKind::Unorm10x3_1x2) {
+    pack1010102((const float*)src, dst, n);
+    return true;
+  }
+  return false;
+}
+
+///////////////////// Generic path
+// source pixels -> RGBA float
+void decodePixels(const FormatDesc& desc, const uint8_t* src, size_t n,
+                  float* out) {
+  if (desc.kind == ElementKind::Unorm10x3_1x2 ||
+      desc.kind == ElementKind::Snorm10x3_1x2) {
+    for (size_t i = 0; i < n; ++i)
+      decode1010102(desc.kind, loadElement<uint32_t>(src + i * 4),
+                    out + i * 4);
+    return;
+  }
+  size_t elemSize = getElementSize(desc.kind);
+  for (size_t i = 0; i < n; ++i) {
+    float* p = out + i * 4;
+    p[0] = p[1] = p[2] = 0.0f;
+    p[3] = 1.0f;
+    for (unsigned k = 0; k < desc.channels; ++k)
+      p[k] = decodeElement(desc.kind, src + (i * desc.channels + k) * elemSize);
+  }
+}
+
+// RGBA float -> destination pixels
+void encodePixels(const FormatDesc& desc, const float* in, size_t n,
+                  uint8_t* dst) {
+  if (desc.kind == ElementKind::Unorm10x3_1x2 ||
+      desc.kind == ElementKind::Snorm10x3_1x2) {
+    for (size_t i = 0; i < n; ++i)
+      storeElement(dst + i * 4, encode1010102(desc.kind, in + i * 4));
+    return;
+  }
+  size_t elemSize = getElementSize(desc.kind);
+  for (size_t i = 0; i < n; ++i)
+    for (unsigned k = 0; k < desc.channels; ++k)
+      encodeElement(desc.kind, in[i * 4 + k],
+                    dst + (i * desc.channels + k) * elemSize);
+}
+
+void applyTransfer(ColorTransfer transfer, float* rgba, size_t n) {
+  if (transfer == ColorTransfer::None)
+    return;
+  for (size_t i = 0; i < n; ++i)
+    for (unsigned k = 0; k < 3; ++k) {
+      float& v = rgba[i * 4 + k];
+      v = transfer == ColorTransfer::SRGBToLinear ? srgbToLinear(v)
+                                                   : linearToSRGB(v);
+    }
+}
+}
+
+size_t getPixelSize(PixelFormat format) {
+  return getPixelSize(getFormatDesc(format));
+}
+
+bool canConvertPixels(PixelFormat srcFormat, PixelFormat dstFormat) {
+  return getFormatDesc(srcFormat).kind != ElementKind::Invalid &&
+         getFormatDesc(dstFormat).kind != ElementKind::Invalid;
+}
+
+void convertPixels(PixelFormat srcFormat, PixelFormat dstFormat,
+                   gsl::span<const gsl::byte> src, gsl::span<gsl::byte> dst,
+                   ColorTransfer transfer) {
+  auto s = getFormatDesc(srcFormat);
+  auto d = getFormatDesc(dstFormat);
+  if (s.kind == ElementKind::Invalid || d.kind == ElementKind::Invalid)
+    failWith("convertPixels: unsupported pixel format");
+  size_t srcPixelSize = getPixelSize(s);
+  size_t dstPixelSize = getPixelSize(d);
+  size_t n = (size_t)src.size_bytes() / srcPixelSize;
+  if ((size_t)dst.size_bytes() < n * dstPixelSize)
+    failWith("convertPixels: destination too small");
+  auto srcBytes = (const uint8_t*)src.data();
+  auto dstBytes = (uint8_t*)dst.data();
+
+  if (srcFormat == dstFormat && transfer == ColorTransfer::None) {
+    memcpy(dstBytes, srcBytes, n * srcPixelSize);
+    return;
+  }
+  if (convertFast(s, d, transfer, srcBytes, dstBytes, n))
+    return;
+
+  // through RGBA float, in chunks that fit in L1
+  constexpr size_t kChunkSize = 256;
+  float rgba[kChunkSize * 4];
+  for (size_t i = 0; i < n; i += kChunkSize) {
+    size_t count = std::min(kChunkSize, n - i);
+    decodePixels(s, srcBytes + i * srcPixelSize, count, rgba);
+    applyTransfer(transfer, rgba, count);
+    encodePixels(d, rgba, count, dstBytes + i * dstPixelSize);
+  }
+}
+
+uint16_t floatToHalf(float v) {
+  uint32_t x;
+  memcpy(&x, &v, 4);
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t absx = x & 0x7FFFFFFF;
+  if (absx >= 0x7F800000) {
+    // inf, NaN (quiet)
+    return (uint16_t)(sign | 0x7C00 |
+                      (absx > 0x7F800000 ? 0x200 | ((absx >> 13) & 0x3FF) : 0));
+  }
+  if (absx >= 0x477FF000) // rounds to 65536 or more
+    return (uint16_t)(sign | 0x7C00);
+  // round to nearest even, as F16C
+  auto round = [](uint32_t m, unsigned shift) {
+    uint32_t r = m >> shift;
+    uint32_t rem = m & ((1u << shift) - 1);
+    uint32_t half = 1u << (shift - 1);
+    if (rem > half || (rem == half && (r & 1)))
+      ++r;
+    return r;
+  };
+  if (absx < 0x38800000) {
+    // denormal half (or zero)
+    unsigned shift = 126 - (absx >> 23);
+    if (shift > 24)
+      return (uint16_t)sign;
+    return (uint16_t)(sign | round((absx & 0x7FFFFF) | 0x800000, shift));
+  }
+  // the rounding carry may increment the exponent, which is correct
+  return (uint16_t)(sign | (round(absx, 13) - (112 << 10)));
+}
+
+float halfToFloat(uint16_t v) {
+  uint32_t sign = (uint32_t)(v & 0x8000) << 16;
+  uint32_t e = (v >> 10) & 0x1F;
+  uint32_t m = v & 0x3FF;
+  uint32_t x;
+  if (e == 0) {
+    float f = (float)m * (1.0f / 16777216.0f);
+    memcpy(&x, &f, 4);
+    x |= sign;
+  } else if (e == 31)
+    x = sign | 0x7F800000 | (m << 13);
+  else
+    x = sign | ((e + 112) << 23) | (m << 13);
+  float f;
+  memcpy(&f, &x, 4);
+  return f;
+}
+
+float srgbToLinear(float v) {
+  return v <= 0.04045f ? v * (1.0f / 12.92f)
+                       : std::pow((v + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+float linearToSRGB(float v) {
+  return v <= 0.0031308f ? v * 12.92f
+                         : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+}
+
+const char* getPixelConversionSIMDPath() {
+#if defined(AG_PC_AVX2) && defined(AG_PC_F16C)
+  return "AVX2+F16C";
+#elif defined(AG_PC_AVX2)
+  return "AVX2";
+#elif defined(AG_PC_SSE41)
+  return "SSE4.1";
+#elif defined(AG_PC_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+}
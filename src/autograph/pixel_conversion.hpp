@@ -0,0 +1,54 @@
+#ifndef PIXEL_CONVERSION_HPP
+#define PIXEL_CONVERSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gsl.h>
+
+#include "pixel_format.hpp"
+
+namespace ag {
+
+// Transfer function applied to the color channels (not alpha) during a
+// conversion.
+enum class ColorTransfer {
+  None,
+  // sRGB-encoded source, linear destination
+  SRGBToLinear,
+  // linear source, sRGB-encoded destination
+  LinearToSRGB
+};
+
+// size in bytes of one pixel, 0 for compressed and depth formats
+size_t getPixelSize(PixelFormat format);
+
+// Returns true if convertPixels supports the conversion: all uncompressed
+// color formats can be converted to each other.
+bool canConvertPixels(PixelFormat srcFormat, PixelFormat dstFormat);
+
+// Converts an array of pixels from one format to another.
+// Normalized values are converted to [0,1] (or [-1,1]) floats, integer
+// values are converted as is (values above 2^24 lose precision). Missing
+// channels are (0,0,0,1). Float to normalized conversions clamp and round
+// to nearest.
+// The number of pixels is src.size() / getPixelSize(srcFormat), dst must
+// be large enough.
+// Common pairs (Unorm8 <-> Float, Float <-> Float16, 8x3 <-> 8x4,
+// 10_10_10_2, sRGB) have SSE/AVX2/F16C paths, chosen at compile time.
+void convertPixels(PixelFormat srcFormat, PixelFormat dstFormat,
+                   gsl::span<const gsl::byte> src, gsl::span<gsl::byte> dst,
+                   ColorTransfer transfer = ColorTransfer::None);
+
+// single-value conversions
+uint16_t floatToHalf(float v);
+float halfToFloat(uint16_t v);
+float srgbToLinear(float v);
+float linearToSRGB(float v);
+
+// instruction set used by the conversion fast paths ("AVX2+F16C",
+// "SSE4.1", "SSE2" or "scalar")
+const char* getPixelConversionSIMDPath();
+}
+
+#endif // !PIXEL_CONVERSION_HPP
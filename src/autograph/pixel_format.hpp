@@ -86,6 +86,7 @@ template <typename T> struct PixelTypeTraits {
 template <PixelFormat Format, typename Sample, typename Storage = Sample>
 struct PixelTypeTraitsImpl {
   static constexpr bool kIsPixelType = true;
+  static constexpr bool kIsCompressed = false;
   static constexpr PixelFormat kFormat = Format;
   // type of elements in raw texture data
   using storage_type = Storage;
@@ -143,6 +144,34 @@ struct PixelTypeTraits<std::array<Normalized<uint8_t>, 4>>
     : public PixelTypeTraitsImpl<PixelFormat::Unorm8x4,
                                  std::array<Normalized<uint8_t>, 4> > {};
 
+template <>
+struct PixelTypeTraits<Normalized<uint16_t>>
+    : public PixelTypeTraitsImpl<PixelFormat::Unorm16, Normalized<uint16_t>> {};
+template <>
+struct PixelTypeTraits<std::array<Normalized<uint16_t>, 2>>
+    : public PixelTypeTraitsImpl<PixelFormat::Unorm16x2,
+                                 std::array<Normalized<uint16_t>, 2> > {};
+template <>
+struct PixelTypeTraits<std::array<Normalized<uint16_t>, 4>>
+    : public PixelTypeTraitsImpl<PixelFormat::Unorm16x4,
+                                 std::array<Normalized<uint16_t>, 4> > {};
+
+// IEEE 754 half-precision float (storage only, see pixel_conversion.hpp for
+// conversions)
+struct Half { uint16_t bits; };
+
+template <>
+struct PixelTypeTraits<Half>
+    : public PixelTypeTraitsImpl<PixelFormat::Float16, float, Half> {};
+template <>
+struct PixelTypeTraits<std::array<Half, 2>>
+    : public PixelTypeTraitsImpl<PixelFormat::Float16x2, std::array<float, 2>,
+                                 std::array<Half, 2>> {};
+template <>
+struct PixelTypeTraits<std::array<Half, 4>>
+    : public PixelTypeTraitsImpl<PixelFormat::Float16x4, std::array<float, 4>,
+                                 std::array<Half, 4>> {};
+
 // Packed formats
 struct Snorm10x3_1x2
 {
@@ -162,6 +191,81 @@ template <>
 struct PixelTypeTraits<Unorm10x3_1x2>
     : public PixelTypeTraitsImpl<PixelFormat::Unorm10x3_1x2, Unorm10x3_1x2> {};
 
+// Block-compressed formats
+// The storage type is a 4x4 block: texture data is an array of blocks, in
+// row-major order. Dimensions that are not multiples of 4 are padded.
+struct BC1 { uint8_t block[8]; };      // RGB, 1-bit alpha
+struct BC2 { uint8_t block[16]; };     // RGB, 4-bit alpha
+struct BC3 { uint8_t block[16]; };     // RGB, interpolated alpha
+struct UnormBC4 { uint8_t block[8]; }; // R
+struct SnormBC4 { uint8_t block[8]; };
+struct UnormBC5 { uint8_t block[16]; }; // RG
+struct SnormBC5 { uint8_t block[16]; };
+
+template <PixelFormat Format, typename Block, typename Sample>
+struct CompressedPixelTypeTraitsImpl
+    : public PixelTypeTraitsImpl<Format, Sample, Block> {
+  static constexpr bool kIsCompressed = true;
+  static constexpr unsigned kBlockWidth = 4;
+  static constexpr unsigned kBlockHeight = 4;
+};
+
+template <>
+struct PixelTypeTraits<BC1>
+    : public CompressedPixelTypeTraitsImpl<PixelFormat::BC1, BC1,
+                                           std::array<float, 4>> {};
+template <>
+struct PixelTypeTraits<BC2>
+    : public CompressedPixelTypeTraitsImpl<PixelFormat::BC2, BC2,
+                                           std::array<float, 4>> {};
+template <>
+struct PixelTypeTraits<BC3>
+    : public CompressedPixelTypeTraitsImpl<PixelFormat::BC3, BC3,
+                                           std::array<float, 4>> {};
+template <>
+struct PixelTypeTraits<UnormBC4>
+    : public CompressedPixelTypeTraitsImpl<PixelFormat::UnormBC4, UnormBC4,
+                                           float> {};
+template <>
+struct PixelTypeTraits<SnormBC4>
+    : public CompressedPixelTypeTraitsImpl<PixelFormat::SnormBC4, SnormBC4,
+                                           float> {};
+template <>
+struct PixelTypeTraits<UnormBC5>
+    : public CompressedPixelTypeTraitsImpl<PixelFormat::UnormBC5, UnormBC5,
+                                           std::array<float, 2>> {};
+template <>
+struct PixelTypeTraits<SnormBC5>
+    : public CompressedPixelTypeTraitsImpl<PixelFormat::SnormBC5, SnormBC5,
+                                           std::array<float, 2>> {};
+
+inline bool isCompressedFormat(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::BC1:
+  case PixelFormat::BC2:
+  case PixelFormat::BC3:
+  case PixelFormat::UnormBC4:
+  case PixelFormat::SnormBC4:
+  case PixelFormat::UnormBC5:
+  case PixelFormat::SnormBC5:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// size in bytes of a 4x4 block of a compressed format
+inline unsigned getCompressedBlockSize(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::BC1:
+  case PixelFormat::UnormBC4:
+  case PixelFormat::SnormBC4:
+    return 8;
+  default:
+    return 16;
+  }
+}
+
 // depth and depth-stencil format type
 struct Depth32 { uint32_t v;};
 struct Depth24_Stencil8 { uint32_t v; };
@@ -183,6 +287,12 @@ using RG32F = std::array<float,2>;
 using RGB32F = std::array<float,3>;
 using RGBA32F = std::array<float,4>;
 using R8 = Normalized<uint8_t>;
+using R16 = Normalized<uint16_t>;
+using RG16 = std::array<Normalized<uint16_t>, 2>;
+using RGBA16 = std::array<Normalized<uint16_t>, 4>;
+using R16F = Half;
+using RG16F = std::array<Half, 2>;
+using RGBA16F = std::array<Half, 4>;
 using R32UI = uint32_t;
 
 }
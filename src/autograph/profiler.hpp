@@ -0,0 +1,299 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+
+namespace ag {
+
+template <typename D> class Device;
+
+///////////////////// Accumulated timings for a named zone (in milliseconds)
+struct ProfileZoneStats {
+  unsigned count = 0;
+  double cpuMin = 0.0;
+  double cpuMax = 0.0;
+  double cpuTotal = 0.0;
+  double gpuMin = 0.0;
+  double gpuMax = 0.0;
+  double gpuTotal = 0.0;
+
+  double cpuAvg() const { return count ? cpuTotal / count : 0.0; }
+  double gpuAvg() const { return count ? gpuTotal / count : 0.0; }
+
+  void add(double cpu, double gpu) {
+    if (!count) {
+      cpuMin = cpuMax = cpu;
+      gpuMin = gpuMax = gpu;
+    } else {
+      cpuMin = std::min(cpuMin, cpu);
+      cpuMax = std::max(cpuMax, cpu);
+      gpuMin = std::min(gpuMin, gpu);
+      gpuMax = std::max(gpuMax, gpu);
+    }
+    cpuTotal += cpu;
+    gpuTotal += gpu;
+    ++count;
+  }
+};
+
+///////////////////// A resolved zone instance
+// All timestamps are in nanoseconds since the creation of the profiler.
+// GPU timestamps are rebased on the CPU timeline.
+struct ProfileZoneEvent {
+  const char* name;
+  unsigned depth;
+  uint64_t frame;
+  int64_t cpuStart;
+  int64_t cpuEnd;
+  int64_t gpuStart;
+  int64_t gpuEnd;
+};
+
+///////////////////// Profiler
+// Records CPU and GPU timings for nested named zones.
+// GPU timings are measured with timestamp queries, which are read back
+// without stalling a few frames later (one set of queries per frame in
+// flight).
+// Zone names must outlive the profiler (use string literals).
+template <typename D> class Profiler {
+public:
+  static constexpr unsigned kMaxZonesPerFrame = 128;
+  // number of frames kept for trace export
+  static constexpr unsigned kMaxTraceFrames = 300;
+  // resynchronize GPU and CPU clocks every N frames
+  static constexpr unsigned kCalibrationInterval = 300;
+
+  Profiler(D& backend_, unsigned maxFramesInFlight)
+      : backend(backend_), frames(maxFramesInFlight + 1) {
+    for (auto& f : frames)
+      f.queryPool = backend.createTimestampQueryPool(2 * kMaxZonesPerFrame);
+    epoch = clock::now();
+    calibrate();
+  }
+
+  void beginZone(const char* name) {
+    auto& f = frames[current];
+    if (f.zones.size() >= kMaxZonesPerFrame) {
+      // out of queries for this frame: ignore the zone
+      ++droppedZones;
+      openZones.push_back(-1);
+      return;
+    }
+    int index = (int)f.zones.size();
+    f.zones.push_back(Zone{name, (unsigned)openZones.size(), cpuNow(), 0});
+    backend.writeTimestamp(f.queryPool.get(), 2 * index);
+    openZones.push_back(index);
+  }
+
+  void endZone() {
+    if (openZones.empty())
+      failWith("Profiler: endZone without matching beginZone");
+    int index = openZones.back();
+    openZones.pop_back();
+    if (index < 0)
+      return;
+    auto& f = frames[current];
+    backend.writeTimestamp(f.queryPool.get(), 2 * index + 1);
+    f.zones[index].cpuEnd = cpuNow();
+  }
+
+  // Called by the device at the end of each frame, after waiting for the
+  // frame that used the oldest set of queries.
+  void endFrame() {
+    if (!openZones.empty())
+      failWith("Profiler: unbalanced zones at the end of the frame");
+    frames[current].frame = frame_id;
+    frames[current].pending = true;
+    ++frame_id;
+    current = (current + 1) % frames.size();
+
+    // resolve completed frames, oldest first (current is the oldest)
+    for (size_t i = 0; i < frames.size(); ++i) {
+      auto& f = frames[(current + i) % frames.size()];
+      if (!f.pending)
+        continue;
+      if (!resolve(f))
+        break;
+    }
+
+    // the oldest slot is reused for the next frame
+    auto& next = frames[current];
+    if (next.pending) {
+      // results still not available: drop them
+      ++droppedFrames;
+      next.pending = false;
+    }
+    next.zones.clear();
+
+    if (frame_id % kCalibrationInterval == 0)
+      calibrate();
+  }
+
+  ///////////////////// Results
+  const std::vector<std::pair<std::string, ProfileZoneStats>>&
+  getSummary() const {
+    return summary;
+  }
+
+  void resetSummary() { summary.clear(); }
+
+  // zones of the last resolved frame, in begin order
+  const std::vector<ProfileZoneEvent>& getLastFrameEvents() const {
+    return lastFrameEvents;
+  }
+
+  unsigned getDroppedFrameCount() const { return droppedFrames; }
+  unsigned getDroppedZoneCount() const { return droppedZones; }
+
+  // Export the recorded zones of the last frames in the Chrome trace event
+  // format (load in chrome://tracing)
+  void exportChromeTrace(std::ostream& out) const {
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+           "\"args\":{\"name\":\"CPU\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+           "\"args\":{\"name\":\"GPU\"}}";
+    for (const auto& e : trace) {
+      writeTraceEvent(out, e, 0, e.cpuStart, e.cpuEnd);
+      writeTraceEvent(out, e, 1, e.gpuStart, e.gpuEnd);
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct Zone {
+    const char* name;
+    unsigned depth;
+    int64_t cpuStart;
+    int64_t cpuEnd;
+  };
+
+  struct Frame {
+    typename D::TimestampQueryPoolHandle queryPool;
+    std::vector<Zone> zones;
+    uint64_t frame = 0;
+    bool pending = false;
+  };
+
+  int64_t cpuNow() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                                epoch)
+        .count();
+  }
+
+  void calibrate() {
+    // GPU time is sampled when previous commands reach the GPU
+    // this is precise enough for visualization purposes
+    gpuToCpuOffset = cpuNow() - (int64_t)backend.getGPUTimestamp();
+  }
+
+  // returns false if the GPU has not finished with the frame yet
+  bool resolve(Frame& f) {
+    gpuTimes.resize(2 * f.zones.size());
+    for (size_t i = 0; i < gpuTimes.size(); ++i)
+      if (!backend.tryGetTimestamp(f.queryPool.get(), (unsigned)i,
+                                   gpuTimes[i]))
+        return false;
+
+    lastFrameEvents.clear();
+    for (size_t i = 0; i < f.zones.size(); ++i) {
+      const auto& z = f.zones[i];
+      ProfileZoneEvent e;
+      e.name = z.name;
+      e.depth = z.depth;
+      e.frame = f.frame;
+      e.cpuStart = z.cpuStart;
+      e.cpuEnd = z.cpuEnd;
+      e.gpuStart = (int64_t)gpuTimes[2 * i] + gpuToCpuOffset;
+      e.gpuEnd = (int64_t)gpuTimes[2 * i + 1] + gpuToCpuOffset;
+      getStats(z.name).add((e.cpuEnd - e.cpuStart) * 1e-6,
+                           (e.gpuEnd - e.gpuStart) * 1e-6);
+      lastFrameEvents.push_back(e);
+      trace.push_back(e);
+    }
+    while (!trace.empty() && trace.front().frame + kMaxTraceFrames <= f.frame)
+      trace.pop_front();
+    f.pending = false;
+    return true;
+  }
+
+  ProfileZoneStats& getStats(const char* name) {
+    // few zones: linear search is fine, and keeps the first-seen order
+    for (auto& s : summary)
+      if (s.first == name)
+        return s.second;
+    summary.emplace_back(name, ProfileZoneStats{});
+    return summary.back().second;
+  }
+
+  static void writeTraceEvent(std::ostream& out, const ProfileZoneEvent& e,
+                              int tid, int64_t start, int64_t end) {
+    out << ",\n{\"name\":\"";
+    for (const char* p = e.name; *p; ++p) {
+      if (*p == '"' || *p == '\\')
+        out << '\\';
+      out << *p;
+    }
+    out << "\",\"cat\":\"" << (tid ? "gpu" : "cpu")
+        << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+        << ",\"ts\":" << start / 1000.0 << ",\"dur\":" << (end - start) / 1000.0
+        << ",\"args\":{\"frame\":" << e.frame << "}}";
+  }
+
+  D& backend;
+  std::vector<Frame> frames;
+  size_t current = 0;
+  uint64_t frame_id = 0;
+  std::vector<int> openZones;
+  std::vector<uint64_t> gpuTimes;
+  clock::time_point epoch;
+  int64_t gpuToCpuOffset = 0;
+
+  std::vector<std::pair<std::string, ProfileZoneStats>> summary;
+  std::vector<ProfileZoneEvent> lastFrameEvents;
+  std::deque<ProfileZoneEvent> trace;
+  unsigned droppedFrames = 0;
+  unsigned droppedZones = 0;
+};
+
+///////////////////// RAII profile zone
+// Does nothing if the device was created without a profiler.
+template <typename D> class ProfileZone {
+public:
+  ProfileZone(Device<D>& device, const char* name)
+      : profiler(device.profiler.get()) {
+    if (profiler)
+      profiler->beginZone(name);
+  }
+
+  ~ProfileZone() {
+    if (profiler)
+      profiler->endZone();
+  }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+  Profiler<D>* profiler;
+};
+}
+
+#endif // !PROFILER_HPP
@@ -0,0 +1,337 @@
+#ifndef STATS_BACKEND_HPP
+#define STATS_BACKEND_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "bind.hpp"
+
+namespace ag {
+
+///////////////////// Per-frame device statistics
+struct FrameStats {
+  unsigned drawCalls = 0;
+  unsigned dispatchCalls = 0;
+  unsigned pipelineBinds = 0;
+  unsigned resourceBinds = 0;
+  // binds of a resource that was already bound to the same slot (skipped)
+  unsigned redundantBinds = 0;
+  // bytes pushed to the upload ring during the frame
+  size_t uploadBytes = 0;
+  // max. number of bytes in use in the upload ring during the frame
+  size_t uploadHighWater = 0;
+  unsigned fenceWaits = 0;
+  // time spent blocked in waitForFence, in milliseconds
+  double fenceWaitTime = 0.0;
+  unsigned texturesCreated = 0;
+  unsigned texturesDestroyed = 0;
+  unsigned buffersCreated = 0;
+  unsigned buffersDestroyed = 0;
+};
+
+///////////////////// Rolling history of frame statistics
+class FrameStatsHistory {
+public:
+  static constexpr unsigned kHistorySize = 256;
+
+  void push(const FrameStats& stats) {
+    frames[next] = stats;
+    next = (next + 1) % kHistorySize;
+    if (count < kHistorySize)
+      ++count;
+  }
+
+  unsigned size() const { return count; }
+
+  // i = 0 is the oldest frame
+  const FrameStats& operator[](unsigned i) const {
+    return frames[(next + kHistorySize - count + i) % kHistorySize];
+  }
+
+  // values of a counter over the history, oldest first
+  // (suitable for ImGui::PlotHistogram)
+  template <typename T>
+  std::vector<float> series(T FrameStats::*counter) const {
+    std::vector<float> out(count);
+    for (unsigned i = 0; i < count; ++i)
+      out[i] = (float)((*this)[i].*counter);
+    return out;
+  }
+
+private:
+  std::array<FrameStats, kHistorySize> frames;
+  unsigned next = 0;
+  unsigned count = 0;
+};
+
+///////////////////// StatsBackend
+// Backend decorator that counts device events.
+// Use StatsBackend<D> in place of D (e.g. Device<StatsBackend<OpenGLBackend>>)
+// and query the counters with Device::frameStats(). The examples use it when
+// built with AG_FRAME_STATS.
+// Binds of a resource to the slot it is already bound to are counted and
+// skipped.
+// Handles created through this backend must not outlive it.
+template <typename D> class StatsBackend : public D {
+public:
+  // Counters of resource creations and destructions, which can happen on
+  // the loader thread (see runOnLoaderThread). Folded into the frame stats
+  // at the end of each frame.
+  struct ResourceCounters {
+    std::atomic<unsigned> texturesCreated{0};
+    std::atomic<unsigned> buffersCreated{0};
+    std::atomic<unsigned> texturesDestroyed{0};
+    std::atomic<unsigned> buffersDestroyed{0};
+    // set when a texture or a sampler is destroyed: a new object can get
+    // the same name, the bind caches are stale
+    std::atomic<bool> bindsStale{false};
+  };
+
+  // counting deleters (wrap the deleters of the underlying backend)
+  template <typename Deleter> struct CountingDeleter : Deleter {
+    using pointer = typename Deleter::pointer;
+    CountingDeleter(std::atomic<unsigned>* counter_ = nullptr,
+                    std::atomic<bool>* bindsStale_ = nullptr)
+        : counter(counter_), bindsStale(bindsStale_) {}
+    void operator()(pointer p) {
+      if (counter)
+        ++*counter;
+      // before the name is released
+      if (bindsStale)
+        *bindsStale = true;
+      Deleter::operator()(p);
+    }
+    std::atomic<unsigned>* counter;
+    std::atomic<bool>* bindsStale;
+  };
+
+  using TextureHandle =
+      std::unique_ptr<void, CountingDeleter<typename D::TextureDeleter>>;
+  using BufferHandle =
+      std::unique_ptr<void, CountingDeleter<typename D::BufferDeleter>>;
+  using SamplerHandle =
+      std::unique_ptr<void, CountingDeleter<typename D::SamplerDeleter>>;
+
+  template <typename... Args>
+  StatsBackend(Args&&... args) : D(std::forward<Args>(args)...) {
+    resetBindCaches();
+  }
+
+  StatsBackend(const StatsBackend&) = delete;
+  StatsBackend& operator=(const StatsBackend&) = delete;
+
+  ///////////////////// Resources
+  TextureHandle createTexture1D(const Texture1DInfo& info) {
+    return countTexture(D::createTexture1D(info));
+  }
+  TextureHandle createTexture2D(const Texture2DInfo& info) {
+    return countTexture(D::createTexture2D(info));
+  }
+  TextureHandle createTexture3D(const Texture3DInfo& info) {
+    return countTexture(D::createTexture3D(info));
+  }
+  TextureHandle createTexture2DArray(const Texture2DArrayInfo& info) {
+    return countTexture(D::createTexture2DArray(info));
+  }
+  TextureHandle createTextureCubeMap(const TextureCubeMapInfo& info) {
+    return countTexture(D::createTextureCubeMap(info));
+  }
+
+  BufferHandle createBuffer(std::size_t size, const void* data,
+                            BufferUsage usage) {
+    ++resources.buffersCreated;
+    return BufferHandle(D::createBuffer(size, data, usage).release(),
+                        CountingDeleter<typename D::BufferDeleter>{
+                            &resources.buffersDestroyed});
+  }
+
+  SamplerHandle createSampler(const SamplerInfo& info) {
+    return SamplerHandle(D::createSampler(info).release(),
+                         CountingDeleter<typename D::SamplerDeleter>{
+                             nullptr, &resources.bindsStale});
+  }
+
+  ///////////////////// Fences
+  void waitForFence(typename D::FenceHandle::pointer handle, uint64_t value) {
+    auto start = std::chrono::steady_clock::now();
+    D::waitForFence(handle, value);
+    ++current.fenceWaits;
+    current.fenceWaitTime +=
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+  }
+
+  ///////////////////// Bind
+  void bindTexture1D(unsigned slot, typename TextureHandle::pointer handle) {
+    if (trackBind(textures, slot, handle))
+      D::bindTexture1D(slot, handle);
+  }
+  void bindTexture2D(unsigned slot, typename TextureHandle::pointer handle) {
+    if (trackBind(textures, slot, handle))
+      D::bindTexture2D(slot, handle);
+  }
+  void bindTexture3D(unsigned slot, typename TextureHandle::pointer handle) {
+    if (trackBind(textures, slot, handle))
+      D::bindTexture3D(slot, handle);
+  }
+  void bindTexture2DArray(unsigned slot,
+                          typename TextureHandle::pointer handle) {
+    if (trackBind(textures, slot, handle))
+      D::bindTexture2DArray(slot, handle);
+  }
+  void bindTextureCubeMap(unsigned slot,
+                          typename TextureHandle::pointer handle) {
+    if (trackBind(textures, slot, handle))
+      D::bindTextureCubeMap(slot, handle);
+  }
+  void bindRWTexture1D(unsigned slot, typename TextureHandle::pointer handle) {
+    if (trackBind(images, slot, handle))
+      D::bindRWTexture1D(slot, handle);
+  }
+  void bindRWTexture2D(unsigned slot, typename TextureHandle::pointer handle) {
+    if (trackBind(images, slot, handle))
+      D::bindRWTexture2D(slot, handle);
+  }
+  void bindRWTexture3D(unsigned slot, typename TextureHandle::pointer handle) {
+    if (trackBind(images, slot, handle))
+      D::bindRWTexture3D(slot, handle);
+  }
+  void bindRWTexture2DArray(unsigned slot,
+                            typename TextureHandle::pointer handle) {
+    if (trackBind(images, slot, handle))
+      D::bindRWTexture2DArray(slot, handle);
+  }
+  void bindSampler(unsigned slot, typename SamplerHandle::pointer handle) {
+    if (trackBind(samplers, slot, handle))
+      D::bindSampler(slot, handle);
+  }
+  void bindVertexBuffer(unsigned slot, typename BufferHandle::pointer handle,
+                        size_t offset, size_t size, unsigned stride) {
+    ++current.resourceBinds;
+    D::bindVertexBuffer(slot, handle, offset, size, stride);
+  }
+  void bindIndexBuffer(typename BufferHandle::pointer handle, size_t offset,
+                       size_t size, IndexType type) {
+    ++current.resourceBinds;
+    D::bindIndexBuffer(handle, offset, size, type);
+  }
+  void bindUniformBuffer(unsigned slot, typename BufferHandle::pointer handle,
+                         size_t offset, size_t size) {
+    ++current.resourceBinds;
+    D::bindUniformBuffer(slot, handle, offset, size);
+  }
+  void bindStorageBuffer(unsigned slot, typename BufferHandle::pointer handle,
+                         size_t offset, size_t size) {
+    ++current.resourceBinds;
+    D::bindStorageBuffer(slot, handle, offset, size);
+  }
+  void bindGraphicsPipeline(
+      typename D::GraphicsPipelineHandle::pointer handle) {
+    ++current.pipelineBinds;
+    D::bindGraphicsPipeline(handle);
+  }
+  void bindComputePipeline(typename D::ComputePipelineHandle::pointer handle) {
+    ++current.pipelineBinds;
+    D::bindComputePipeline(handle);
+  }
+
+  ///////////////////// Draw calls
+  void draw(PrimitiveType primitiveType, unsigned first, unsigned count) {
+    ++current.drawCalls;
+    D::draw(primitiveType, first, count);
+  }
+  void drawIndexed(PrimitiveType primitiveType, unsigned first, unsigned count,
+                   unsigned baseVertex) {
+    ++current.drawCalls;
+    D::drawIndexed(primitiveType, first, count, baseVertex);
+  }
+  // counts as one draw call, whatever the number of commands
+  void drawIndexedIndirect(PrimitiveType primitiveType,
+                           typename BufferHandle::pointer indirectBuffer,
+                           size_t indirectOffset,
+                           typename BufferHandle::pointer countBuffer,
+                           size_t countOffset, unsigned maxDrawCount,
+                           unsigned stride) {
+    ++current.drawCalls;
+    D::drawIndexedIndirect(primitiveType, indirectBuffer, indirectOffset,
+                           countBuffer, countOffset, maxDrawCount, stride);
+  }
+
+  ///////////////////// Compute
+  void dispatchCompute(unsigned threadGroupCountX, unsigned threadGroupCountY,
+                       unsigned threadGroupCountZ) {
+    ++current.dispatchCalls;
+    D::dispatchCompute(threadGroupCountX, threadGroupCountY,
+                       threadGroupCountZ);
+  }
+
+  ///////////////////// Hooks called by the device
+  void onUploadBufferPush(size_t size, size_t ringUsage) {
+    current.uploadBytes += size;
+    current.uploadHighWater = std::max(current.uploadHighWater, ringUsage);
+  }
+
+  void onEndFrame() {
+    current.texturesCreated = resources.texturesCreated.exchange(0);
+    current.buffersCreated = resources.buffersCreated.exchange(0);
+    current.texturesDestroyed = resources.texturesDestroyed.exchange(0);
+    current.buffersDestroyed = resources.buffersDestroyed.exchange(0);
+    last = current;
+    history.push(current);
+    current = FrameStats{};
+  }
+
+  ///////////////////// Results
+  const FrameStats& getLastFrameStats() const { return last; }
+  const FrameStatsHistory& getFrameStatsHistory() const { return history; }
+
+private:
+  TextureHandle countTexture(typename D::TextureHandle handle) {
+    ++resources.texturesCreated;
+    return TextureHandle(handle.release(),
+                         CountingDeleter<typename D::TextureDeleter>{
+                             &resources.texturesDestroyed,
+                             &resources.bindsStale});
+  }
+
+  // Returns false if `handle` is already bound to `slot`: the bind can be
+  // skipped. Slots out of range are not tracked (the backend checks them).
+  template <typename Ptr, size_t N>
+  bool trackBind(std::array<Ptr, N>& slots, unsigned slot, Ptr handle) {
+    ++current.resourceBinds;
+    if (resources.bindsStale.exchange(false))
+      resetBindCaches();
+    if (slot >= N)
+      return true;
+    if (slots[slot] == handle) {
+      ++current.redundantBinds;
+      return false;
+    }
+    slots[slot] = handle;
+    return true;
+  }
+
+  void resetBindCaches() {
+    std::fill(textures.begin(), textures.end(), nullptr);
+    std::fill(samplers.begin(), samplers.end(), nullptr);
+    std::fill(images.begin(), images.end(), nullptr);
+  }
+
+  ResourceCounters resources;
+  FrameStats current;
+  FrameStats last;
+  FrameStatsHistory history;
+  std::array<typename TextureHandle::pointer, D::kMaxTextureUnits> textures;
+  std::array<typename SamplerHandle::pointer, D::kMaxTextureUnits> samplers;
+  std::array<typename TextureHandle::pointer, D::kMaxImageUnits> images;
+};
+}
+
+#endif // !STATS_BACKEND_HPP
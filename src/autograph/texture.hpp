@@ -1,6 +1,8 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
+#include <algorithm>
+
 #include <glm/glm.hpp>
 
 #include "pixel_format.hpp"
@@ -10,6 +12,9 @@ enum class TextureAddressMode { Repeat, Clamp, Mirror };
 
 enum class TextureFilter { Nearest, Linear };
 
+// filtering between mip levels (None: sample level 0 only)
+enum class MipmapMode { None, Nearest, Linear };
+
 ////////////////////////// Sampler
 struct SamplerInfo {
   TextureAddressMode addrU = TextureAddressMode::Repeat;
@@ -17,6 +22,7 @@ struct SamplerInfo {
   TextureAddressMode addrW = TextureAddressMode::Repeat;
   TextureFilter minFilter = TextureFilter::Nearest;
   TextureFilter magFilter = TextureFilter::Linear;
+  MipmapMode mipmapMode = MipmapMode::None;
 };
 
 template <typename D> struct Sampler {
@@ -24,10 +30,31 @@ template <typename D> struct Sampler {
   typename D::SamplerHandle handle;
 };
 
+////////////////////////// Mip levels
+// number of levels in a full mip chain (down to 1x1)
+inline unsigned getMipLevelCount(glm::uint size) {
+  unsigned n = 1;
+  while (size > 1) {
+    size >>= 1;
+    ++n;
+  }
+  return n;
+}
+
+inline unsigned getMipLevelCount(glm::uvec2 dimensions) {
+  return getMipLevelCount(std::max(dimensions.x, dimensions.y));
+}
+
+inline unsigned getMipLevelCount(glm::uvec3 dimensions) {
+  return getMipLevelCount(
+      std::max(std::max(dimensions.x, dimensions.y), dimensions.z));
+}
+
 ////////////////////////// Texture1D
 struct Texture1DInfo {
   glm::uint dimensions;
   PixelFormat format;
+  unsigned mipLevels = 1;
 };
 
 template <typename T, typename D> struct Texture1D {
@@ -39,6 +66,7 @@ template <typename T, typename D> struct Texture1D {
 struct Texture2DInfo {
   glm::uvec2 dimensions;
   PixelFormat format;
+  unsigned mipLevels = 1;
 };
 
 template <typename T, typename D> struct Texture2D {
@@ -50,6 +78,7 @@ template <typename T, typename D> struct Texture2D {
 struct Texture3DInfo {
   glm::uvec3 dimensions;
   PixelFormat format;
+  unsigned mipLevels = 1;
 };
 
 template <typename T, typename D> struct Texture3D {
@@ -57,6 +86,32 @@ template <typename T, typename D> struct Texture3D {
   typename D::TextureHandle handle;
 };
 
+////////////////////////// Texture2DArray
+struct Texture2DArrayInfo {
+  glm::uvec2 dimensions;
+  unsigned layers;
+  PixelFormat format;
+  unsigned mipLevels = 1;
+};
+
+template <typename T, typename D> struct Texture2DArray {
+  Texture2DArrayInfo info;
+  typename D::TextureHandle handle;
+};
+
+////////////////////////// TextureCubeMap
+// Faces are in the order +X, -X, +Y, -Y, +Z, -Z
+struct TextureCubeMapInfo {
+  glm::uint size;
+  PixelFormat format;
+  unsigned mipLevels = 1;
+};
+
+template <typename T, typename D> struct TextureCubeMap {
+  TextureCubeMapInfo info;
+  typename D::TextureHandle handle;
+};
+
 ////////////////////////// TextureDataRaw
 /*template <typename D>
 struct TextureDataRaw 
@@ -2,6 +2,7 @@
 #define RING_BUFFER_HPP
 
 #include <algorithm>
+#include <cstring>
 #include <mutex>
 #include <queue>
 #include <vector>
@@ -111,7 +112,18 @@ public:
     return true;
   }
 
+  // CPU address of an allocated slice (the buffer is persistently mapped)
+  void* getMappedPointer(const RawBufferSlice<D>& slice) const {
+    return (char*)mappedRegion + slice.offset;
+  }
+
+  size_t getSize() const { return buf_size; }
+
+  // number of bytes currently in use
+  size_t getUsedSize() const { return used; }
+
   void reclaim(FenceValue date) {
+    std::lock_guard<std::mutex> guard(mutex);
     while (!fencedRegions.empty() &&
            fencedRegions.front().expirationDate <= date) {
       auto& r = fencedRegions.front();
@@ -0,0 +1,66 @@
+// Accumulation side of ag::extra::histogram::GpuHistogram.
+// Each workgroup accumulates a private histogram in shared memory, and writes
+// it to its own slot of the buffer of partial histograms.
+//
+// Define before including:
+//   HISTOGRAM_BINS      number of bins
+//   HISTOGRAM_CHANNELS  number of values of each bin
+//   HISTOGRAM_BINDING   (optional) storage buffer binding of the partial
+//                       histograms, must match kPartialsBinding
+// In main():
+//   histogramBegin() first,
+//   histogramAdd(bin, channel, value) or histogramSubtract(...) any number
+//   of times,
+//   histogramEnd() last. All invocations of the workgroup must reach
+//   histogramBegin and histogramEnd (no early return).
+
+#ifndef HISTOGRAM_BINDING
+#define HISTOGRAM_BINDING 7
+#endif
+
+#define HISTOGRAM_VALUES (HISTOGRAM_BINS * HISTOGRAM_CHANNELS)
+
+layout(std430, binding = HISTOGRAM_BINDING) writeonly buffer HistogramPartials {
+  uint histogramPartials[];
+};
+
+shared uint histogramShared[HISTOGRAM_VALUES];
+
+uint histogramWorkGroupIndex()
+{
+  return gl_WorkGroupID.x + gl_NumWorkGroups.x *
+    (gl_WorkGroupID.y + gl_NumWorkGroups.y * gl_WorkGroupID.z);
+}
+
+uint histogramInvocationCount()
+{
+  return gl_WorkGroupSize.x * gl_WorkGroupSize.y * gl_WorkGroupSize.z;
+}
+
+void histogramBegin()
+{
+  for (uint i = gl_LocalInvocationIndex; i < HISTOGRAM_VALUES; i += histogramInvocationCount())
+    histogramShared[i] = 0;
+  memoryBarrierShared();
+  barrier();
+}
+
+void histogramAdd(uint bin, uint channel, uint value)
+{
+  atomicAdd(histogramShared[bin * HISTOGRAM_CHANNELS + channel], value);
+}
+
+// for incremental updates (GpuHistogram::accumulate), modulo 2^32
+void histogramSubtract(uint bin, uint channel, uint value)
+{
+  atomicAdd(histogramShared[bin * HISTOGRAM_CHANNELS + channel], 0u - value);
+}
+
+void histogramEnd()
+{
+  memoryBarrierShared();
+  barrier();
+  uint base = histogramWorkGroupIndex() * HISTOGRAM_VALUES;
+  for (uint i = gl_LocalInvocationIndex; i < HISTOGRAM_VALUES; i += histogramInvocationCount())
+    histogramPartials[base + i] = histogramShared[i];
+}
@@ -0,0 +1,186 @@
+#ifndef EXTRAS_HISTOGRAM_HPP
+#define EXTRAS_HISTOGRAM_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include <gsl.h>
+
+#include <autograph/buffer.hpp>
+#include <autograph/compute.hpp>
+#include <autograph/copy.hpp>
+#include <autograph/device.hpp>
+#include <autograph/draw.hpp>
+#include <autograph/error.hpp>
+#include <autograph/pipeline.hpp>
+
+namespace ag {
+namespace extra {
+namespace histogram {
+
+// storage buffer binding of the per-workgroup histograms,
+// must match HISTOGRAM_BINDING in glsl/histogram.glsl
+constexpr unsigned kPartialsBinding = 7;
+constexpr unsigned kMergeGroupSize = 64;
+
+namespace detail {
+constexpr const char* kMergeShader = R"(
+#version 450
+layout(local_size_x = 64) in;
+layout(std140, binding = 0) uniform U0 {
+  uint binValueCount;
+  uint workGroupCount;
+  uint accumulate;
+};
+layout(std430, binding = 0) readonly buffer Partials { uint partials[]; };
+layout(std430, binding = 1) buffer Bins { uint bins[]; };
+
+void main() {
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= binValueCount)
+    return;
+  uint sum = 0;
+  for (uint g = 0; g < workGroupCount; ++g)
+    sum += partials[g * binValueCount + i];
+  bins[i] = accumulate != 0 ? bins[i] + sum : sum;
+}
+)";
+
+struct MergeParams {
+  uint32_t binValueCount;
+  uint32_t workGroupCount;
+  uint32_t accumulate;
+};
+}
+
+///////////////////////////////////////
+// GpuHistogram
+// Histogram computed entirely on the GPU, in two passes:
+// - an accumulation pass provided by the caller (a compute shader including
+//   glsl/histogram.glsl), in which each workgroup accumulates a private
+//   histogram in shared memory with shared atomics, and writes it out to its
+//   own slot of a buffer of partial histograms (no global atomics);
+// - a merge pass that sums the partial histograms into the bins buffer.
+// Each bin has `channelCount` values (e.g. a count and sums of values), the
+// bins buffer holds binCount * channelCount uints, channels of a bin being
+// contiguous. It stays on the GPU and can be bound by the following passes
+// (RWBufferUnit), or copied to the CPU with readbackAsync.
+// The bins can also be updated incrementally (accumulate): a pass that
+// subtracts the old contribution of a region (histogramSubtract) followed by
+// a pass that adds the new one. The arithmetic is modulo 2^32, so the result
+// is exact as long as the true totals fit in 32 bits.
+template <typename D> class GpuHistogram {
+public:
+  GpuHistogram(Device<D>& device, unsigned binCount_, unsigned channelCount_,
+               unsigned maxWorkGroups_)
+      : binCount(binCount_), channelCount(channelCount_),
+        maxWorkGroups(maxWorkGroups_), alive(std::make_shared<bool>(true)) {
+    auto binBytes = (size_t)binCount * channelCount * sizeof(uint32_t);
+    partials = RawBuffer<D>(maxWorkGroups * binBytes,
+                            device.backend.createBuffer(
+                                maxWorkGroups * binBytes, nullptr,
+                                BufferUsage::Default));
+    bins = RawBuffer<D>(binBytes, device.backend.createBuffer(
+                                      binBytes, nullptr, BufferUsage::Default));
+    typename D::ComputePipelineInfo info;
+    info.CSSource = detail::kMergeShader;
+    ppMerge = device.createComputePipeline(info);
+  }
+
+  GpuHistogram(const GpuHistogram&) = delete;
+  GpuHistogram& operator=(const GpuHistogram&) = delete;
+
+  // Runs `accumulatePipeline` over `threadGroupCount` workgroups with the
+  // given resources (the partial histograms are bound to kPartialsBinding),
+  // then merges the partial histograms into the bins.
+  template <typename... TShaderResources>
+  void compute(Device<D>& device, ComputePipeline<D>& accumulatePipeline,
+               ThreadGroupCount threadGroupCount,
+               TShaderResources&&... resources) {
+    run(device, accumulatePipeline, threadGroupCount, false,
+        std::forward<TShaderResources>(resources)...);
+  }
+
+  // Same as compute, but adds the partial histograms to the current bins.
+  template <typename... TShaderResources>
+  void accumulate(Device<D>& device, ComputePipeline<D>& accumulatePipeline,
+                  ThreadGroupCount threadGroupCount,
+                  TShaderResources&&... resources) {
+    run(device, accumulatePipeline, threadGroupCount, true,
+        std::forward<TShaderResources>(resources)...);
+  }
+
+  // resets all bins to zero
+  void clear(Device<D>& device) { ag::clear(device, bins); }
+
+  // Copies the bins to the CPU; `onReady` is called with them once the GPU
+  // has completed the current frame. Returns false (and does nothing) if the
+  // previous readback has not completed yet.
+  bool readbackAsync(Device<D>& device,
+                     std::function<void(gsl::span<const uint32_t>)> onReady) {
+    if (readbackPending)
+      return false;
+    if (!readbackData) {
+      readbackBuffer = device.createReadbackBuffer(bins.byteSize);
+      readbackData = (const uint32_t*)device.mapReadbackBuffer(readbackBuffer);
+    }
+    RawBufferSlice<D> src{bins.handle.get(), 0, bins.byteSize};
+    RawBufferSlice<D> dest{readbackBuffer.handle.get(), 0, bins.byteSize};
+    ag::copy(device, src, dest);
+    readbackPending = true;
+    std::weak_ptr<bool> weakAlive = alive;
+    device.onFrameComplete([this, weakAlive, onReady]() {
+      if (!weakAlive.lock())
+        return;
+      readbackPending = false;
+      onReady(gsl::span<const uint32_t>{
+          readbackData, (std::ptrdiff_t)(binCount * channelCount)});
+    });
+    return true;
+  }
+
+  const RawBuffer<D>& getBins() const { return bins; }
+  unsigned getBinCount() const { return binCount; }
+  unsigned getChannelCount() const { return channelCount; }
+
+private:
+  template <typename... TShaderResources>
+  void run(Device<D>& device, ComputePipeline<D>& accumulatePipeline,
+           ThreadGroupCount threadGroupCount, bool addToBins,
+           TShaderResources&&... resources) {
+    auto workGroups = threadGroupCount.sizeX * threadGroupCount.sizeY *
+                      threadGroupCount.sizeZ;
+    if (workGroups > maxWorkGroups)
+      failWith("GpuHistogram: too many workgroups");
+    ag::compute(device, accumulatePipeline, threadGroupCount,
+                std::forward<TShaderResources>(resources)...,
+                RWBufferUnit(kPartialsBinding, partials));
+    ag::memoryBarrier(device);
+    auto binValueCount = binCount * channelCount;
+    ag::compute(device, ppMerge,
+                ThreadGroupCount{(unsigned)divRoundUp((int)binValueCount,
+                                                      (int)kMergeGroupSize)},
+                detail::MergeParams{binValueCount, workGroups, addToBins},
+                RWBufferUnit(0, partials), RWBufferUnit(1, bins));
+    ag::memoryBarrier(device);
+  }
+
+  unsigned binCount = 0;
+  unsigned channelCount = 0;
+  unsigned maxWorkGroups = 0;
+  RawBuffer<D> partials;
+  RawBuffer<D> bins;
+  ComputePipeline<D> ppMerge;
+  RawBuffer<D> readbackBuffer;
+  const uint32_t* readbackData = nullptr;
+  bool readbackPending = false;
+  // expires with the histogram, checked by the readback callbacks
+  std::shared_ptr<bool> alive;
+};
+}
+}
+}
+
+#endif // !EXTRAS_HISTOGRAM_HPP
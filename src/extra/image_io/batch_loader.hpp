@@ -0,0 +1,265 @@
+#ifndef EXTRAS_BATCH_LOADER_HPP
+#define EXTRAS_BATCH_LOADER_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <format.h>
+
+#include <autograph/device.hpp>
+#include <autograph/pixel_format.hpp>
+#include <autograph/rect.hpp>
+#include <autograph/texture.hpp>
+#include <autograph/upload_buffer.hpp>
+
+#include <stb_image.h>
+
+namespace ag {
+namespace extra {
+namespace image_io {
+
+// Loads many image files in parallel, without stalling the render thread.
+// Files are decoded on a pool of threads, which copy the pixels into a
+// persistently-mapped staging ring buffer. update() (called once per frame
+// on the render thread) creates the textures and issues the buffer to
+// texture copies, up to a byte budget per frame. Staging memory is
+// reclaimed once the frame that consumed it has completed on the GPU.
+// Pixel must be an 8-bit normalized type (R8, RG8, RGB8 or RGBA8); the
+// images are converted to this number of components by the decoder.
+template <typename D, typename Pixel = ag::RGBA8> class BatchTextureLoader {
+public:
+  using Storage = typename PixelTypeTraits<Pixel>::storage_type;
+  static constexpr int kNumComponents = (int)sizeof(Storage);
+  static_assert(PixelTypeTraits<Pixel>::kFormat == PixelFormat::Unorm8 ||
+                    PixelTypeTraits<Pixel>::kFormat == PixelFormat::Unorm8x2 ||
+                    PixelTypeTraits<Pixel>::kFormat == PixelFormat::Unorm8x3 ||
+                    PixelTypeTraits<Pixel>::kFormat == PixelFormat::Unorm8x4,
+                "Unsupported pixel type");
+
+  BatchTextureLoader(Device<D>& device_, unsigned numThreads = 0,
+                     size_t stagingSize = 32 * 1024 * 1024,
+                     size_t uploadBudget_ = 8 * 1024 * 1024)
+      : device(device_), uploadBudget(uploadBudget_),
+        shared(std::make_shared<Shared>(device_.backend, stagingSize)) {
+    // hardware_concurrency returns 0 if unknown
+    if (!numThreads)
+      numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    for (unsigned i = 0; i < numThreads; ++i)
+      workers.emplace_back([this]() { workerMain(); });
+  }
+
+  ~BatchTextureLoader() {
+    {
+      std::lock_guard<std::mutex> lock(jobsMutex);
+      stopping = true;
+    }
+    {
+      std::lock_guard<std::mutex> lock(shared->mutex);
+      shared->stopping = true;
+    }
+    jobsCV.notify_all();
+    shared->reclaimed.notify_all();
+    for (auto& t : workers)
+      t.join();
+  }
+
+  // queue a file for loading
+  // the future is ready after the call to update() that issues the upload
+  std::future<Texture2D<Pixel, D>> load(std::string filename) {
+    Job job;
+    job.filename = std::move(filename);
+    auto future = job.promise.get_future();
+    {
+      std::lock_guard<std::mutex> lock(jobsMutex);
+      jobs.push_back(std::move(job));
+      ++pending;
+    }
+    jobsCV.notify_one();
+    return future;
+  }
+
+  // Issue the uploads of decoded images. Call once per frame on the render
+  // thread. At least one image is uploaded per call even if it exceeds the
+  // budget.
+  void update() {
+    size_t uploadedBytes = 0;
+    std::vector<FenceValue> tickets;
+    for (;;) {
+      Decoded d;
+      {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        if (decoded.empty() || (uploadedBytes && uploadedBytes >= uploadBudget))
+          break;
+        d = std::move(decoded.front());
+        decoded.pop_front();
+        --pending;
+      }
+      Texture2D<Pixel, D> tex;
+      tex.info = d.info;
+      tex.handle = device.backend.createTexture2D(tex.info);
+      Box2D region{0, 0, d.info.dimensions.x, d.info.dimensions.y};
+      if (d.ticket) {
+        device.backend.updateTexture2DFromBuffer(tex.handle.get(), tex.info, 0,
+                                                 region, d.slice.handle,
+                                                 d.slice.offset);
+        tickets.push_back(d.ticket);
+        uploadedBytes += d.slice.byteSize;
+      } else {
+        // did not fit in the staging buffer
+        device.backend.updateTexture2D(tex.handle.get(), tex.info, 0, region,
+                                       gsl::as_bytes(gsl::span<const Storage>(
+                                           d.heapData.data(),
+                                           d.heapData.size())));
+        uploadedBytes += d.heapData.size() * sizeof(Storage);
+      }
+      // commands are ordered: the texture can be used right away
+      d.promise.set_value(std::move(tex));
+    }
+
+    if (!tickets.empty()) {
+      std::weak_ptr<Shared> weakShared = shared;
+      device.onFrameComplete([weakShared, tickets]() {
+        if (auto s = weakShared.lock())
+          s->complete(tickets);
+      });
+    }
+  }
+
+  // number of files queued, being decoded, or waiting for upload
+  size_t getPendingCount() {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    return pending;
+  }
+
+private:
+  struct Job {
+    std::string filename;
+    std::promise<Texture2D<Pixel, D>> promise;
+  };
+
+  struct Decoded {
+    Texture2DInfo info;
+    std::promise<Texture2D<Pixel, D>> promise;
+    // 0 if the image is in heapData
+    FenceValue ticket = 0;
+    RawBufferSlice<D> slice;
+    std::vector<Storage> heapData;
+  };
+
+  // state shared with the frame completion callbacks
+  struct Shared {
+    Shared(D& backend, size_t size) : staging(backend, size) {}
+
+    // Tickets are the expiration dates of the staging regions. They are
+    // allocated in order, but can complete out of order: the staging buffer
+    // is reclaimed up to the last ticket of the completed prefix.
+    void complete(const std::vector<FenceValue>& tickets) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        completed.insert(tickets.begin(), tickets.end());
+        while (!completed.empty() && *completed.begin() == completedPrefix + 1) {
+          completed.erase(completed.begin());
+          ++completedPrefix;
+        }
+        staging.reclaim(completedPrefix);
+      }
+      reclaimed.notify_all();
+    }
+
+    UploadBuffer<D> staging;
+    std::mutex mutex;
+    std::condition_variable reclaimed;
+    FenceValue nextTicket = 1;
+    FenceValue completedPrefix = 0;
+    std::set<FenceValue> completed;
+    bool stopping = false;
+  };
+
+  // blocks until there is enough space in the staging buffer
+  // returns false if the image is too large (or the loader is stopping)
+  bool allocateStaging(size_t size, RawBufferSlice<D>& slice,
+                       FenceValue& ticket) {
+    if (size >= shared->staging.getSize() / 2)
+      return false;
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    for (;;) {
+      if (shared->stopping)
+        return false;
+      if (shared->staging.allocateRaw(shared->nextTicket, size, 4, slice)) {
+        ticket = shared->nextTicket++;
+        return true;
+      }
+      shared->reclaimed.wait(lock);
+    }
+  }
+
+  void workerMain() {
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(jobsMutex);
+        jobsCV.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping)
+          return;
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+
+      int x, y, comp;
+      auto raw_data =
+          stbi_load(job.filename.c_str(), &x, &y, &comp, kNumComponents);
+      if (!raw_data) {
+        job.promise.set_exception(std::make_exception_ptr(std::runtime_error(
+            fmt::format("Missing or corrupt image file: {}", job.filename))));
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        --pending;
+        continue;
+      }
+
+      Decoded d;
+      d.info = Texture2DInfo{glm::uvec2((unsigned)x, (unsigned)y),
+                             PixelTypeTraits<Pixel>::kFormat};
+      d.promise = std::move(job.promise);
+      size_t size = (size_t)x * (size_t)y * sizeof(Storage);
+      if (allocateStaging(size, d.slice, d.ticket)) {
+        memcpy(shared->staging.getMappedPointer(d.slice), raw_data, size);
+      } else {
+        d.ticket = 0;
+        d.heapData.assign((const Storage*)raw_data,
+                          (const Storage*)raw_data + (size_t)x * y);
+      }
+      stbi_image_free(raw_data);
+
+      std::lock_guard<std::mutex> lock(jobsMutex);
+      decoded.push_back(std::move(d));
+    }
+  }
+
+  Device<D>& device;
+  size_t uploadBudget;
+  std::shared_ptr<Shared> shared;
+  std::vector<std::thread> workers;
+
+  std::mutex jobsMutex;
+  std::condition_variable jobsCV;
+  // guarded by jobsMutex
+  std::deque<Job> jobs;
+  std::deque<Decoded> decoded;
+  size_t pending = 0;
+  bool stopping = false;
+};
+}
+}
+}
+
+#endif // !EXTRAS_BATCH_LOADER_HPP
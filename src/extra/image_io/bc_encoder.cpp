@@ -0,0 +1,410 @@
+#include "bc_encoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define AG_BC_AVX2
+#define AG_BC_SSE41
+#elif defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#define AG_BC_SSE41
+#endif
+
+namespace ag {
+namespace extra {
+namespace image_io {
+namespace {
+
+// the channels of the 16 pixels of a 4x4 block, planar
+struct BlockPlanes {
+  alignas(16) uint8_t r[16];
+  alignas(16) uint8_t g[16];
+  alignas(16) uint8_t b[16];
+  alignas(16) uint8_t a[16];
+};
+
+///////////////////// Block load (RGBA -> planar)
+void loadBlock(const uint8_t* pixels, unsigned width, unsigned height,
+               unsigned bx, unsigned by, BlockPlanes& out) {
+  alignas(16) uint8_t rgba[64];
+  if (bx * 4 + 4 <= width && by * 4 + 4 <= height) {
+    for (unsigned y = 0; y < 4; ++y)
+      memcpy(&rgba[y * 16], &pixels[((by * 4 + y) * width + bx * 4) * 4], 16);
+  } else {
+    // edge block: clamp
+    for (unsigned y = 0; y < 4; ++y) {
+      unsigned sy = std::min(by * 4 + y, height - 1);
+      for (unsigned x = 0; x < 4; ++x) {
+        unsigned sx = std::min(bx * 4 + x, width - 1);
+        memcpy(&rgba[(y * 4 + x) * 4], &pixels[(sy * width + sx) * 4], 4);
+      }
+    }
+  }
+
+#ifdef AG_BC_SSE41
+  // gather the channels of each group of 4 pixels, then transpose
+  const __m128i shuf =
+      _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  __m128i p0 = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)rgba), shuf);
+  __m128i p1 =
+      _mm_shuffle_epi8(_mm_load_si128((const __m128i*)(rgba + 16)), shuf);
+  __m128i p2 =
+      _mm_shuffle_epi8(_mm_load_si128((const __m128i*)(rgba + 32)), shuf);
+  __m128i p3 =
+      _mm_shuffle_epi8(_mm_load_si128((const __m128i*)(rgba + 48)), shuf);
+  __m128i t0 = _mm_unpacklo_epi32(p0, p1);
+  __m128i t1 = _mm_unpacklo_epi32(p2, p3);
+  __m128i t2 = _mm_unpackhi_epi32(p0, p1);
+  __m128i t3 = _mm_unpackhi_epi32(p2, p3);
+  _mm_store_si128((__m128i*)out.r, _mm_unpacklo_epi64(t0, t1));
+  _mm_store_si128((__m128i*)out.g, _mm_unpackhi_epi64(t0, t1));
+  _mm_store_si128((__m128i*)out.b, _mm_unpacklo_epi64(t2, t3));
+  _mm_store_si128((__m128i*)out.a, _mm_unpackhi_epi64(t2, t3));
+#else
+  for (unsigned i = 0; i < 16; ++i) {
+    out.r[i] = rgba[i * 4];
+    out.g[i] = rgba[i * 4 + 1];
+    out.b[i] = rgba[i * 4 + 2];
+    out.a[i] = rgba[i * 4 + 3];
+  }
+#endif
+}
+
+///////////////////// Min/max of a channel
+void getMinMax(const uint8_t* values, int& outMin, int& outMax) {
+#ifdef AG_BC_SSE41
+  __m128i v = _mm_load_si128((const __m128i*)values);
+  __m128i mn = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+  __m128i mx = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 2));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 2));
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 1));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 1));
+  outMin = _mm_cvtsi128_si32(mn) & 0xFF;
+  outMax = _mm_cvtsi128_si32(mx) & 0xFF;
+#else
+  outMin = 255;
+  outMax = 0;
+  for (unsigned i = 0; i < 16; ++i) {
+    outMin = std::min<int>(outMin, values[i]);
+    outMax = std::max<int>(outMax, values[i]);
+  }
+#endif
+}
+
+///////////////////// Color indices
+// Pixels are projected on the axis between the endpoints e1 (index 1) and
+// e0 (index 0); the palette is e1, 1/3 (index 3), 2/3 (index 2), e0.
+// With m1, m2, m3 = position above 1/6, 1/2, 5/6 of the axis:
+//   bit 0 of the index = !m2, bit 1 = m1 && !m3
+uint32_t getColorIndices(const BlockPlanes& block, const int e0[3],
+                         const int e1[3]) {
+  int dr = e0[0] - e1[0], dg = e0[1] - e1[1], db = e0[2] - e1[2];
+  int d1 = e1[0] * dr + e1[1] * dg + e1[2] * db;
+  int range = e0[0] * dr + e0[1] * dg + e0[2] * db - d1;
+  uint32_t indices = 0;
+
+#if defined(AG_BC_AVX2)
+  const __m256i vdr = _mm256_set1_epi32(dr), vdg = _mm256_set1_epi32(dg),
+                vdb = _mm256_set1_epi32(db), vd1 = _mm256_set1_epi32(d1),
+                vrange = _mm256_set1_epi32(range),
+                vrange5 = _mm256_set1_epi32(5 * range),
+                one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2),
+                shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+  for (int k = 0; k < 2; ++k) {
+    __m256i r = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i*)(block.r + 8 * k)));
+    __m256i g = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i*)(block.g + 8 * k)));
+    __m256i b = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i*)(block.b + 8 * k)));
+    __m256i dot = _mm256_add_epi32(
+        _mm256_add_epi32(_mm256_mullo_epi32(r, vdr), _mm256_mullo_epi32(g, vdg)),
+        _mm256_mullo_epi32(b, vdb));
+    __m256i t = _mm256_sub_epi32(dot, vd1);
+    __m256i t2 = _mm256_add_epi32(t, t);
+    __m256i t6 = _mm256_add_epi32(t2, _mm256_add_epi32(t2, t2));
+    __m256i m1 = _mm256_cmpgt_epi32(t6, vrange);
+    __m256i m2 = _mm256_cmpgt_epi32(t2, vrange);
+    __m256i m3 = _mm256_cmpgt_epi32(t6, vrange5);
+    __m256i idx =
+        _mm256_or_si256(_mm256_andnot_si256(m2, one),
+                        _mm256_and_si256(_mm256_andnot_si256(m3, m1), two));
+    idx = _mm256_sllv_epi32(idx, shifts);
+    __m128i v = _mm_or_si128(_mm256_castsi256_si128(idx),
+                             _mm256_extracti128_si256(idx, 1));
+    v = _mm_or_si128(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_or_si128(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    indices |= (uint32_t)_mm_cvtsi128_si32(v) << (16 * k);
+  }
+#elif defined(AG_BC_SSE41)
+  const __m128i vdr = _mm_set1_epi32(dr), vdg = _mm_set1_epi32(dg),
+                vdb = _mm_set1_epi32(db), vd1 = _mm_set1_epi32(d1),
+                vrange = _mm_set1_epi32(range),
+                vrange5 = _mm_set1_epi32(5 * range), one = _mm_set1_epi32(1),
+                two = _mm_set1_epi32(2),
+                shifts = _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6);
+  __m128i r8 = _mm_load_si128((const __m128i*)block.r);
+  __m128i g8 = _mm_load_si128((const __m128i*)block.g);
+  __m128i b8 = _mm_load_si128((const __m128i*)block.b);
+  for (int k = 0; k < 4; ++k) {
+    __m128i dot = _mm_add_epi32(
+        _mm_add_epi32(_mm_mullo_epi32(_mm_cvtepu8_epi32(r8), vdr),
+                      _mm_mullo_epi32(_mm_cvtepu8_epi32(g8), vdg)),
+        _mm_mullo_epi32(_mm_cvtepu8_epi32(b8), vdb));
+    r8 = _mm_srli_si128(r8, 4);
+    g8 = _mm_srli_si128(g8, 4);
+    b8 = _mm_srli_si128(b8, 4);
+    __m128i t = _mm_sub_epi32(dot, vd1);
+    __m128i t2 = _mm_add_epi32(t, t);
+    __m128i t6 = _mm_add_epi32(t2, _mm_add_epi32(t2, t2));
+    __m128i m1 = _mm_cmpgt_epi32(t6, vrange);
+    __m128i m2 = _mm_cmpgt_epi32(t2, vrange);
+    __m128i m3 = _mm_cmpgt_epi32(t6, vrange5);
+    __m128i idx = _mm_or_si128(_mm_andnot_si128(m2, one),
+                               _mm_and_si128(_mm_andnot_si128(m3, m1), two));
+    idx = _mm_mullo_epi32(idx, shifts);
+    idx = _mm_or_si128(idx, _mm_shuffle_epi32(idx, _MM_SHUFFLE(1, 0, 3, 2)));
+    idx = _mm_or_si128(idx, _mm_shuffle_epi32(idx, _MM_SHUFFLE(2, 3, 0, 1)));
+    indices |= (uint32_t)_mm_cvtsi128_si32(idx) << (8 * k);
+  }
+#else
+  for (unsigned i = 0; i < 16; ++i) {
+    int t = block.r[i] * dr + block.g[i] * dg + block.b[i] * db - d1;
+    bool m1 = 6 * t > range;
+    bool m2 = 2 * t > range;
+    bool m3 = 6 * t > 5 * range;
+    uint32_t idx = (m2 ? 0 : 1) | ((m1 && !m3) ? 2 : 0);
+    indices |= idx << (2 * i);
+  }
+#endif
+  return indices;
+}
+
+///////////////////// Alpha (BC4) indices
+// Palette (a0 > a1): a0 (index 0), a1 (index 1), then 6 values from a0 to
+// a1 (indices 2 to 7). t = round((a0 - v) * 7 / (a0 - a1)) is the position
+// on the palette; the index is 0 for t = 0, 1 for t = 7, t + 1 otherwise.
+uint64_t getAlphaIndices(const uint8_t* values, int a0, int a1) {
+  float scale = 7.0f / (float)(a0 - a1);
+  uint64_t indices = 0;
+
+#if defined(AG_BC_AVX2)
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256i va0 = _mm256_set1_epi32(a0), zero = _mm256_setzero_si256(),
+                one = _mm256_set1_epi32(1), seven = _mm256_set1_epi32(7),
+                shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  for (int k = 0; k < 2; ++k) {
+    __m256i v =
+        _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(values + 8 * k)));
+    __m256i t = _mm256_cvtps_epi32(
+        _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(va0, v)), vscale));
+    t = _mm256_min_epi32(_mm256_max_epi32(t, zero), seven);
+    __m256i idx = _mm256_add_epi32(t, one);
+    idx = _mm256_add_epi32(idx, _mm256_cmpeq_epi32(t, zero));
+    idx = _mm256_sub_epi32(idx,
+                           _mm256_and_si256(_mm256_cmpeq_epi32(t, seven), seven));
+    idx = _mm256_sllv_epi32(idx, shifts);
+    __m128i r = _mm_or_si128(_mm256_castsi256_si128(idx),
+                             _mm256_extracti128_si256(idx, 1));
+    r = _mm_or_si128(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2)));
+    r = _mm_or_si128(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(2, 3, 0, 1)));
+    indices |= (uint64_t)(uint32_t)_mm_cvtsi128_si32(r) << (24 * k);
+  }
+#elif defined(AG_BC_SSE41)
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128i va0 = _mm_set1_epi32(a0), zero = _mm_setzero_si128(),
+                one = _mm_set1_epi32(1), seven = _mm_set1_epi32(7),
+                shifts = _mm_setr_epi32(1, 1 << 3, 1 << 6, 1 << 9);
+  __m128i v8 = _mm_load_si128((const __m128i*)values);
+  for (int k = 0; k < 4; ++k) {
+    __m128i v = _mm_cvtepu8_epi32(v8);
+    v8 = _mm_srli_si128(v8, 4);
+    __m128i t = _mm_cvtps_epi32(
+        _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(va0, v)), vscale));
+    t = _mm_min_epi32(_mm_max_epi32(t, zero), seven);
+    __m128i idx = _mm_add_epi32(t, one);
+    idx = _mm_add_epi32(idx, _mm_cmpeq_epi32(t, zero));
+    idx = _mm_sub_epi32(idx, _mm_and_si128(_mm_cmpeq_epi32(t, seven), seven));
+    idx = _mm_mullo_epi32(idx, shifts);
+    idx = _mm_or_si128(idx, _mm_shuffle_epi32(idx, _MM_SHUFFLE(1, 0, 3, 2)));
+    idx = _mm_or_si128(idx, _mm_shuffle_epi32(idx, _MM_SHUFFLE(2, 3, 0, 1)));
+    indices |= (uint64_t)(uint32_t)_mm_cvtsi128_si32(idx) << (12 * k);
+  }
+#else
+  for (unsigned i = 0; i < 16; ++i) {
+    // same rounding as cvtps (round to nearest even)
+    int t = (int)std::nearbyint((float)(a0 - values[i]) * scale);
+    t = std::min(std::max(t, 0), 7);
+    uint64_t idx = t == 0 ? 0 : t == 7 ? 1 : t + 1;
+    indices |= idx << (3 * i);
+  }
+#endif
+  return indices;
+}
+
+///////////////////// Block encoders
+uint16_t to565(int r, int g, int b) {
+  return (uint16_t)((((r * 31 + 127) / 255) << 11) |
+                    (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+}
+
+void from565(uint16_t c, int out[3]) {
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  out[0] = (r << 3) | (r >> 2);
+  out[1] = (g << 2) | (g >> 4);
+  out[2] = (b << 3) | (b >> 2);
+}
+
+// 8 bytes: endpoints (565), 2-bit indices
+void encodeColorBlock(const BlockPlanes& block, uint8_t* out) {
+  int mn[3], mx[3];
+  getMinMax(block.r, mn[0], mx[0]);
+  getMinMax(block.g, mn[1], mx[1]);
+  getMinMax(block.b, mn[2], mx[2]);
+  // inset the bounding box by 1/16 of its size: the extremes are usually
+  // outliers, and this lowers the error of the interpolated colors
+  for (int c = 0; c < 3; ++c) {
+    int inset = (mx[c] - mn[c]) >> 4;
+    mn[c] += inset;
+    mx[c] -= inset;
+  }
+  // quantization is monotonic: c0 >= c1, and c0 > c1 (4-color mode) unless
+  // the block is uniform
+  uint16_t c0 = to565(mx[0], mx[1], mx[2]);
+  uint16_t c1 = to565(mn[0], mn[1], mn[2]);
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int e0[3], e1[3];
+    from565(c0, e0);
+    from565(c1, e1);
+    indices = getColorIndices(block, e0, e1);
+  }
+  out[0] = (uint8_t)(c0 & 0xFF);
+  out[1] = (uint8_t)(c0 >> 8);
+  out[2] = (uint8_t)(c1 & 0xFF);
+  out[3] = (uint8_t)(c1 >> 8);
+  for (int i = 0; i < 4; ++i)
+    out[4 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+// 8 bytes: endpoints, 3-bit indices
+void encodeAlphaBlock(const uint8_t* values, uint8_t* out) {
+  int mn, mx;
+  getMinMax(values, mn, mx);
+  int inset = (mx - mn) >> 5;
+  mn += inset;
+  mx -= inset;
+  uint64_t indices = 0;
+  if (mx != mn)
+    indices = getAlphaIndices(values, mx, mn);
+  out[0] = (uint8_t)mx;
+  out[1] = (uint8_t)mn;
+  for (int i = 0; i < 6; ++i)
+    out[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+void encodeBlock(const BlockPlanes& block, ag::BC1& out) {
+  encodeColorBlock(block, out.block);
+}
+
+void encodeBlock(const BlockPlanes& block, ag::BC3& out) {
+  encodeAlphaBlock(block.a, out.block);
+  encodeColorBlock(block, out.block + 8);
+}
+
+void encodeBlock(const BlockPlanes& block, ag::UnormBC4& out) {
+  encodeAlphaBlock(block.r, out.block);
+}
+
+void encodeBlock(const BlockPlanes& block, ag::UnormBC5& out) {
+  encodeAlphaBlock(block.r, out.block);
+  encodeAlphaBlock(block.g, out.block + 8);
+}
+
+///////////////////// Image encoder
+template <typename Block>
+std::vector<Block> compressImage(const ag::RGBA8* pixels, unsigned width,
+                                 unsigned height, unsigned numThreads) {
+  unsigned blocksX = (width + 3) / 4;
+  unsigned blocksY = (height + 3) / 4;
+  std::vector<Block> blocks(blocksX * blocksY);
+  if (!width || !height)
+    return blocks;
+  auto data = (const uint8_t*)pixels;
+
+  auto encodeRows = [&](unsigned rowBegin, unsigned rowEnd) {
+    BlockPlanes block;
+    for (unsigned by = rowBegin; by < rowEnd; ++by)
+      for (unsigned bx = 0; bx < blocksX; ++bx) {
+        loadBlock(data, width, height, bx, by, block);
+        encodeBlock(block, blocks[by * blocksX + bx]);
+      }
+  };
+
+  if (!numThreads)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, blocksY);
+  if (numThreads <= 1) {
+    encodeRows(0, blocksY);
+    return blocks;
+  }
+  // contiguous ranges of block rows
+  std::vector<std::thread> threads;
+  unsigned rowsPerThread = (blocksY + numThreads - 1) / numThreads;
+  for (unsigned row = 0; row < blocksY; row += rowsPerThread)
+    threads.emplace_back(encodeRows, row,
+                         std::min(row + rowsPerThread, blocksY));
+  for (auto& t : threads)
+    t.join();
+  return blocks;
+}
+}
+
+template <>
+std::vector<ag::BC1> compressBC<ag::BC1>(const ag::RGBA8* pixels,
+                                         unsigned width, unsigned height,
+                                         unsigned numThreads) {
+  return compressImage<ag::BC1>(pixels, width, height, numThreads);
+}
+
+template <>
+std::vector<ag::BC3> compressBC<ag::BC3>(const ag::RGBA8* pixels,
+                                         unsigned width, unsigned height,
+                                         unsigned numThreads) {
+  return compressImage<ag::BC3>(pixels, width, height, numThreads);
+}
+
+template <>
+std::vector<ag::UnormBC4>
+compressBC<ag::UnormBC4>(const ag::RGBA8* pixels, unsigned width,
+                         unsigned height, unsigned numThreads) {
+  return compressImage<ag::UnormBC4>(pixels, width, height, numThreads);
+}
+
+template <>
+std::vector<ag::UnormBC5>
+compressBC<ag::UnormBC5>(const ag::RGBA8* pixels, unsigned width,
+                         unsigned height, unsigned numThreads) {
+  return compressImage<ag::UnormBC5>(pixels, width, height, numThreads);
+}
+
+const char* getBCEncoderSIMDPath() {
+#if defined(AG_BC_AVX2)
+  return "AVX2";
+#elif defined(AG_BC_SSE41)
+  return "SSE4.1";
+#else
+  return "scalar";
+#endif
+}
+}
+}
+}
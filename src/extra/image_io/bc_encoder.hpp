@@ -0,0 +1,48 @@
+#ifndef EXTRAS_BC_ENCODER_HPP
+#define EXTRAS_BC_ENCODER_HPP
+
+#include <vector>
+
+#include <autograph/pixel_format.hpp>
+
+namespace ag {
+namespace extra {
+namespace image_io {
+
+// Block compression (BC1, BC3, BC4, BC5) of RGBA8 images on the CPU.
+// Fast rather than high-quality: endpoints are the inset bounding box of
+// the block colors, and pixels are projected on the endpoint axis.
+// `pixels` are tightly packed rows. Dimensions need not be multiples of 4
+// (edge blocks repeat the last row/column). Blocks are encoded on
+// `numThreads` threads (0: one per core). The result is an array of
+// ceil(width/4) * ceil(height/4) blocks, in row-major order.
+// BC4 is encoded from the red channel, BC5 from red and green.
+template <typename Block>
+std::vector<Block> compressBC(const ag::RGBA8* pixels, unsigned width,
+                              unsigned height, unsigned numThreads = 0);
+
+template <>
+std::vector<ag::BC1> compressBC<ag::BC1>(const ag::RGBA8* pixels,
+                                         unsigned width, unsigned height,
+                                         unsigned numThreads);
+template <>
+std::vector<ag::BC3> compressBC<ag::BC3>(const ag::RGBA8* pixels,
+                                         unsigned width, unsigned height,
+                                         unsigned numThreads);
+template <>
+std::vector<ag::UnormBC4>
+compressBC<ag::UnormBC4>(const ag::RGBA8* pixels, unsigned width,
+                         unsigned height, unsigned numThreads);
+template <>
+std::vector<ag::UnormBC5>
+compressBC<ag::UnormBC5>(const ag::RGBA8* pixels, unsigned width,
+                         unsigned height, unsigned numThreads);
+
+// instruction set used by the encoder ("AVX2", "SSE4.1" or "scalar"),
+// chosen at compile time
+const char* getBCEncoderSIMDPath();
+}
+}
+}
+
+#endif // !EXTRAS_BC_ENCODER_HPP
@@ -1,6 +1,9 @@
 #ifndef EXTRAS_LOAD_IMAGE_HPP
 #define EXTRAS_LOAD_IMAGE_HPP
 
+#include <memory>
+#include <string>
+
 #include <format.h>
 
 #include <autograph/copy.hpp>
@@ -11,25 +14,86 @@
 
 #include <stb_image.h>
 
+#include "bc_encoder.hpp"
+
 namespace ag {
 namespace extra {
 namespace image_io {
 
 // loads texture data from a file directly in GPU memory
-// the texture is loaded using stb_image, and must be in RGBA8/RGB8 format
-template <typename D>
-ag::Texture2D<ag::RGBA8, D> loadTexture2D(Device<D>& device,
-                                          const char* filename) {
+// the image is decoded with stb_image to RGBA8 (RGBA32F for HDR files), then
+// converted to the pixel type of the texture if necessary
+template <typename Pixel = ag::RGBA8, typename D>
+ag::Texture2D<Pixel, D> loadTexture2D(Device<D>& device, const char* filename) {
+  static_assert(!PixelTypeTraits<Pixel>::kIsCompressed,
+                "Use loadCompressedTexture2D for compressed pixel types");
   int x, y, comp;
-  auto raw_data = stbi_load(filename, &x, &y, &comp, 4);
+  bool hdr = stbi_is_hdr(filename) != 0;
+  void* raw_data = hdr ? (void*)stbi_loadf(filename, &x, &y, &comp, 4)
+                       : (void*)stbi_load(filename, &x, &y, &comp, 4);
   if (!raw_data) 
 	  ag::failWith(fmt::format("Missing or corrupt image file: {}", filename));
   auto tex =
-      device.template createTexture2D<ag::RGBA8>(glm::uvec2((unsigned)x, (unsigned)y));
-  auto pixels_data_span =
-      gsl::span<const ag::RGBA8>((const ag::RGBA8*)raw_data, x * y);
-  ag::copy(device, pixels_data_span, tex);
-  return std::move(tex);
+      device.template createTexture2D<Pixel>(glm::uvec2((unsigned)x, (unsigned)y));
+  if (hdr)
+    ag::copy(device,
+             gsl::span<const ag::RGBA32F>((const ag::RGBA32F*)raw_data, x * y),
+             tex);
+  else
+    ag::copy(device,
+             gsl::span<const ag::RGBA8>((const ag::RGBA8*)raw_data, x * y),
+             tex);
+  stbi_image_free(raw_data);
+  return tex;
+}
+
+// loads an image file and compresses it to a BCn format (BC1, BC3, UnormBC4
+// or UnormBC5) before the upload. The texture has an eighth (BC1, BC4) or a
+// quarter (BC3, BC5) of the memory footprint of the RGBA8 image.
+// Use for static images: compression is done on the CPU, on all cores.
+template <typename Block, typename D>
+ag::Texture2D<Block, D> loadCompressedTexture2D(Device<D>& device,
+                                                const char* filename) {
+  static_assert(PixelTypeTraits<Block>::kIsCompressed,
+                "Block must be a compressed pixel type");
+  int x, y, comp;
+  auto raw_data = stbi_load(filename, &x, &y, &comp, 4);
+  if (!raw_data)
+    ag::failWith(fmt::format("Missing or corrupt image file: {}", filename));
+  auto blocks = compressBC<Block>((const ag::RGBA8*)raw_data, (unsigned)x,
+                                  (unsigned)y);
+  stbi_image_free(raw_data);
+  auto tex = device.template createTexture2D<Block>(
+      glm::uvec2((unsigned)x, (unsigned)y));
+  ag::copy(device, gsl::span<const Block>(blocks.data(), blocks.size()), tex);
+  return tex;
+}
+
+// decodes the file and uploads the texture on the loader thread of the
+// backend; `onReady` is called on the render thread with the texture
+// once it is ready to use
+template <typename D, typename F>
+void loadTexture2DAsync(Device<D>& device, std::string filename, F onReady) {
+  auto tex = std::make_shared<ag::Texture2D<ag::RGBA8, D>>();
+  auto& backend = device.backend;
+  backend.runOnLoaderThread(
+      [&backend, tex, filename]() {
+        int x, y, comp;
+        auto raw_data = stbi_load(filename.c_str(), &x, &y, &comp, 4);
+        if (!raw_data)
+          ag::failWith(
+              fmt::format("Missing or corrupt image file: {}", filename));
+        tex->info = ag::Texture2DInfo{glm::uvec2((unsigned)x, (unsigned)y),
+                                      ag::PixelTypeTraits<ag::RGBA8>::kFormat};
+        tex->handle = backend.createTexture2D(tex->info);
+        backend.updateTexture2D(
+            tex->handle.get(), tex->info, 0,
+            ag::Box2D{0, 0, (unsigned)x, (unsigned)y},
+            gsl::as_bytes(gsl::span<const ag::RGBA8>(
+                (const ag::RGBA8*)raw_data, x * y)));
+        stbi_image_free(raw_data);
+      },
+      [tex, onReady]() mutable { onReady(std::move(*tex)); });
 }
 }
 }
@@ -0,0 +1,42 @@
+#ifndef EXTRAS_FENCE_OBSERVABLE_HPP
+#define EXTRAS_FENCE_OBSERVABLE_HPP
+
+#include <rxcpp/rx.hpp>
+
+#include <autograph/device.hpp>
+#include <autograph/fence_notifier.hpp>
+
+namespace ag {
+namespace extra {
+namespace rx {
+
+// returns an observable that emits the fence value and completes once
+// `notifier` observes that the fence has reached `value`
+// the notifier must outlive the subscriptions
+template <typename D>
+rxcpp::observable<FenceValue> fence_reached(FenceNotifier<D>& notifier,
+                                            FenceValue value) {
+  return rxcpp::observable<>::create<FenceValue>(
+      [&notifier, value](rxcpp::subscriber<FenceValue> s) {
+        notifier.when(value, [s, value]() {
+          if (!s.is_subscribed())
+            return;
+          s.on_next(value);
+          s.on_completed();
+        });
+      });
+}
+
+// returns an observable that completes when the GPU has finished executing
+// the commands issued so far in the current frame of `device`
+// Notifications are emitted from Device::pollFences (end of frame)
+template <typename D>
+rxcpp::observable<FenceValue> frame_completed(Device<D>& device) {
+  return fence_reached(*device.frameNotifier,
+                       getFrameExpirationDate(device.frame_id));
+}
+}
+}
+}
+
+#endif // !EXTRAS_FENCE_OBSERVABLE_HPP